@@ -1,4 +1,4 @@
-// swift-tools-version:5.1
+// swift-tools-version:5.7
 // The swift-tools-version declares the minimum version of Swift required to build this package.
 
 import PackageDescription
@@ -10,6 +10,18 @@ let package = Package(
         .library(
             name: "KKBOXOpenAPI",
             targets: ["KKBOXOpenAPI"]),
+        .library(
+            name: "KKBOXOpenAPISwift",
+            targets: ["KKBOXOpenAPISwift"]),
+        .library(
+            name: "KKBOXStandIn",
+            targets: ["KKBOXStandIn"]),
+        .executable(
+            name: "kkbox-stand-in",
+            targets: ["KKBOXStandInServer"]),
+        .executable(
+            name: "kkbox-load",
+            targets: ["KKBOXLoadDriver"]),
     ],
     dependencies: [
         // Dependencies declare other packages that this package depends on.
@@ -23,8 +35,25 @@ let package = Package(
             dependencies: [],
             publicHeadersPath: "include"
             ),
+        .target(
+            name: "KKBOXOpenAPISwift",
+            dependencies: ["KKBOXOpenAPI"]),
+        .target(
+            name: "KKBOXStandIn",
+            dependencies: []),
+        .executableTarget(
+            name: "KKBOXStandInServer",
+            dependencies: ["KKBOXStandIn"]),
+        // KKBOXOpenAPI needs the Objective-C runtime, so on Linux the
+        // load driver is built without it and only explains that.
+        .executableTarget(
+            name: "KKBOXLoadDriver",
+            dependencies: [
+                "KKBOXStandIn",
+                .target(name: "KKBOXOpenAPI", condition: .when(platforms: [.macOS, .iOS, .tvOS, .watchOS])),
+            ]),
         .testTarget(
             name: "KKBOXOpenAPITests",
-            dependencies: ["KKBOXOpenAPI"]),
+            dependencies: ["KKBOXOpenAPI", "KKBOXOpenAPISwift", "KKBOXStandIn"]),
     ]
 )
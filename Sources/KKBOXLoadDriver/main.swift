@@ -0,0 +1,248 @@
+//
+// main.swift
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+import Foundation
+import KKBOXStandIn
+
+#if canImport(ObjectiveC)
+import KKBOXOpenAPI
+
+let usage = """
+	Usage: kkbox-load [--clients N] [--duration S] [--server URL] [options]
+
+	Runs virtual clients that call the API through KKBOXOpenAPI as fast
+	as they can, and reports the throughput, the latency percentiles and
+	the memory. Without --server, a stand-in server is started in the
+	process with the options below.
+
+		--clients N             the amount of concurrent clients (16)
+		--duration S            how long to run, in seconds (10)
+		--server URL            the root URL of a running stand-in server
+		--response-cache        give every client a response cache
+	\(StandInConfiguration.usage)
+
+	"""
+
+/// The latencies and the failures of all the clients. Thread-safe.
+final class LoadStatistics {
+	private let lock = NSLock()
+	private(set) var latencies = [TimeInterval]()
+	private(set) var failures = [String: Int]()
+	private(set) var tokenCount = 0
+
+	func record(latency: TimeInterval, error: Error?) {
+		self.lock.lock()
+		defer { self.lock.unlock() }
+		self.latencies.append(latency)
+		if let error = error as NSError? {
+			self.failures["\(error.domain) \(error.code)", default: 0] += 1
+		}
+	}
+
+	func recordToken() {
+		self.lock.lock()
+		self.tokenCount += 1
+		self.lock.unlock()
+	}
+}
+
+/// Calls the API in a loop with its own KKBOXOpenAPI object, fetching
+/// a new access token whenever the current one is rejected.
+final class VirtualClient {
+	private static let callbackQueue = DispatchQueue(label: "kkbox-load.callbacks", attributes: .concurrent)
+	private let API: KKBOXOpenAPI
+	private let statistics: LoadStatistics
+	private let deadline: Date
+	private var completion: (() -> Void)?
+	private var generator = SystemRandomNumberGenerator()
+
+	init(index: Int, apiBaseURL: URL, tokenURL: URL, usesResponseCache: Bool, statistics: LoadStatistics, deadline: Date) {
+		self.API = KKBOXOpenAPI(clientID: "load-client-\(index)", secret: "secret")
+		self.API.apiBaseURL = apiBaseURL
+		self.API.tokenURL = tokenURL
+		self.API.urlSession = URLSession(configuration: .ephemeral)
+		if usesResponseCache {
+			self.API.responseCache = ResponseCache()
+		}
+		self.statistics = statistics
+		self.deadline = deadline
+	}
+
+	func run(completion: @escaping () -> Void) {
+		self.completion = completion
+		self.fetchToken()
+	}
+
+	private func fetchToken() {
+		guard Date() < self.deadline else {
+			self.finish()
+			return
+		}
+		self.API.fetchAccessTokenByClientCredential { token, error in
+			if token != nil {
+				self.statistics.recordToken()
+				self.next()
+			}
+			else {
+				DispatchQueue.main.asyncAfter(deadline: .now() + 0.1) {
+					self.fetchToken()
+				}
+			}
+		}
+	}
+
+	private func next() {
+		guard Date() < self.deadline else {
+			self.finish()
+			return
+		}
+		let start = Date()
+		let finish = { (error: Error?) in
+			self.statistics.record(latency: Date().timeIntervalSince(start), error: error)
+			if let error = error as NSError?, error.domain == KKBOXOpenAPIErrorDomain, error.code == 401 {
+				DispatchQueue.main.async {
+					self.fetchToken()
+				}
+				return
+			}
+			self.next()
+		}
+		let id = "id\(Int.random(in: 0..<1000, using: &self.generator))"
+		let call = Int.random(in: 0..<8, using: &self.generator)
+		self.API.perform(callbackQueue: VirtualClient.callbackQueue) {
+			switch call {
+			case 0:
+				_ = self.API.fetchTrack(id: id, territory: .taiwan) { _, error in finish(error) }
+			case 1:
+				_ = self.API.fetchAlbum(id: id, territory: .taiwan) { _, error in finish(error) }
+			case 2:
+				_ = self.API.fetchAlbumTracks(id: id, territory: .taiwan) { _, _, _, error in finish(error) }
+			case 3:
+				_ = self.API.fetchArtist(id: id, territory: .taiwan) { _, error in finish(error) }
+			case 4:
+				_ = self.API.fetchPlaylist(id: id, territory: .taiwan) { _, _, _, error in finish(error) }
+			case 5:
+				_ = self.API.fetchCharts(territory: .taiwan) { _, _, _, error in finish(error) }
+			case 6:
+				_ = self.API.fetchMoodStations(territory: .taiwan) { _, _, _, error in finish(error) }
+			default:
+				_ = self.API.search(keyword: id, types: [.track, .album], territory: .taiwan) { _, error in finish(error) }
+			}
+		}
+	}
+
+	private func finish() {
+		let completion = self.completion
+		self.completion = nil
+		DispatchQueue.main.async {
+			completion?()
+		}
+	}
+}
+
+func percentile(_ sorted: [TimeInterval], _ fraction: Double) -> TimeInterval {
+	guard !sorted.isEmpty else {
+		return 0
+	}
+	return sorted[min(Int(Double(sorted.count) * fraction), sorted.count - 1)]
+}
+
+func peakResidentBytes() -> Int {
+	var usage = rusage()
+	getrusage(RUSAGE_SELF, &usage)
+	// Bytes on Apple platforms.
+	return Int(usage.ru_maxrss)
+}
+
+var configuration = StandInConfiguration()
+var clientCount = 16
+var duration: TimeInterval = 10
+var serverURL: URL?
+var usesResponseCache = false
+var arguments = CommandLine.arguments.dropFirst()
+while let option = arguments.popFirst() {
+	if option == "--response-cache" {
+		usesResponseCache = true
+		continue
+	}
+	guard let value = arguments.popFirst() else {
+		FileHandle.standardError.write(usage.data(using: .utf8)!)
+		exit(2)
+	}
+	switch option {
+	case "--clients" where (Int(value) ?? 0) > 0:
+		clientCount = Int(value)!
+	case "--duration" where (TimeInterval(value) ?? 0) > 0:
+		duration = TimeInterval(value)!
+	case "--server" where URL(string: value) != nil:
+		serverURL = URL(string: value)!
+	default:
+		if !configuration.apply(option: option, value: value) {
+			FileHandle.standardError.write("Invalid option \(option) \(value)\n\n\(usage)".data(using: .utf8)!)
+			exit(2)
+		}
+	}
+}
+
+var server: StandInServer?
+let apiBaseURL: URL
+let tokenURL: URL
+if let serverURL = serverURL {
+	apiBaseURL = serverURL.appendingPathComponent("v1.1/")
+	tokenURL = serverURL.appendingPathComponent("oauth2/token")
+}
+else {
+	let inProcessServer = StandInServer(configuration: configuration)
+	do {
+		try inProcessServer.start()
+	}
+	catch {
+		FileHandle.standardError.write("\(error)\n".data(using: .utf8)!)
+		exit(1)
+	}
+	server = inProcessServer
+	apiBaseURL = inProcessServer.apiBaseURL
+	tokenURL = inProcessServer.tokenURL
+}
+
+let statistics = LoadStatistics()
+let startDate = Date()
+let deadline = startDate.addingTimeInterval(duration)
+let group = DispatchGroup()
+var clients = [VirtualClient]()
+for index in 0..<clientCount {
+	let client = VirtualClient(index: index, apiBaseURL: apiBaseURL, tokenURL: tokenURL, usesResponseCache: usesResponseCache, statistics: statistics, deadline: deadline)
+	clients.append(client)
+	group.enter()
+	client.run {
+		group.leave()
+	}
+}
+group.notify(queue: .main) {
+	let elapsed = Date().timeIntervalSince(startDate)
+	let latencies = statistics.latencies.sorted()
+	let failureCount = statistics.failures.values.reduce(0, +)
+	print(String(format: "Clients: %d, duration: %.1f s", clientCount, elapsed))
+	print(String(format: "Requests: %d (%.1f per second), failures: %d, access tokens: %d", latencies.count, Double(latencies.count) / elapsed, failureCount, statistics.tokenCount))
+	for (failure, count) in statistics.failures.sorted(by: { $0.key < $1.key }) {
+		print("  \(failure): \(count)")
+	}
+	print(String(format: "Latency (ms): p50 %.1f, p90 %.1f, p99 %.1f, max %.1f", percentile(latencies, 0.5) * 1000, percentile(latencies, 0.9) * 1000, percentile(latencies, 0.99) * 1000, (latencies.last ?? 0) * 1000))
+	print(String(format: "Peak resident memory: %.1f MB", Double(peakResidentBytes()) / 1048576))
+	server?.stop()
+	exit(0)
+}
+dispatchMain()
+
+#else
+
+// KKBOXOpenAPI is built on the Objective-C runtime and the Foundation
+// of Apple platforms. On Linux, run the stand-in server alone and
+// drive it from elsewhere.
+FileHandle.standardError.write("kkbox-load needs KKBOXOpenAPI, which only builds on Apple platforms. Run kkbox-stand-in on Linux instead.\n".data(using: .utf8)!)
+exit(1)
+
+#endif
@@ -28,32 +28,89 @@
 
 #import "NSData+LFHTTPFormExtensions.h"
 
-NS_INLINE NSString *LFHFEEscape(NSString *inValue) {
-	NSMutableCharacterSet *URLQueryPartAllowedCharacterSet = [[NSCharacterSet URLQueryAllowedCharacterSet] mutableCopy];
-	[URLQueryPartAllowedCharacterSet removeCharactersInString:@"&+"];
+// The bytes of URLQueryAllowedCharacterSet except "&" and "+", which
+// a form decoder would take as a separator and a space. Every other
+// byte, including the bytes of non-ASCII UTF-8 sequences, is escaped.
+static BOOL LFHFEUnreservedBytes[256];
 
-	NSString *escapedString = [inValue stringByAddingPercentEncodingWithAllowedCharacters:URLQueryPartAllowedCharacterSet];
-	return escapedString;
+static void LFHFEPrepareTable(void)
+{
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		const char *unreserved = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-._~!$'()*,;=:@/?";
+		for (const char *c = unreserved; *c; c++) {
+			LFHFEUnreservedBytes[(unsigned char) *c] = YES;
+		}
+	});
 }
 
-@implementation NSData (LFHTTPFormExtensions)
-+ (id)dataAsWWWURLEncodedFormFromDictionary:(NSDictionary *)formDictionary
+NS_INLINE char *LFHFEEscape(char *output, const char *input, size_t length)
 {
-	NSMutableString *combinedDataString = [NSMutableString string];
-	NSEnumerator *enumerator = [formDictionary keyEnumerator];
-	id key;
-	id value;
-
-	if ((key = [enumerator nextObject])) {
-		value = formDictionary[key];
-		[combinedDataString appendString:[NSString stringWithFormat:@"%@=%@", LFHFEEscape(key), LFHFEEscape(value)]];
-
-		while ((key = [enumerator nextObject])) {
-			value = formDictionary[key];
-			[combinedDataString appendString:[NSString stringWithFormat:@"&%@=%@", LFHFEEscape(key), LFHFEEscape(value)]];
+	static const char hexDigits[] = "0123456789ABCDEF";
+	for (size_t i = 0; i < length; i++) {
+		unsigned char byte = (unsigned char) input[i];
+		if (LFHFEUnreservedBytes[byte]) {
+			*output++ = (char) byte;
+		}
+		else {
+			*output++ = '%';
+			*output++ = hexDigits[byte >> 4];
+			*output++ = hexDigits[byte & 0x0f];
 		}
 	}
+	return output;
+}
+
+NS_INLINE NSString *LFHFEString(id value)
+{
+	return [value isKindOfClass:[NSString class]] ? value : [value description];
+}
+
+@implementation NSData (LFHTTPFormExtensions)
++ (NSData *)dataAsWWWURLEncodedFormFromDictionary:(NSDictionary *)formDictionary
+{
+	LFHFEPrepareTable();
+	NSArray *keys = [formDictionary.allKeys sortedArrayUsingSelector:@selector(compare:)];
+	NSUInteger count = keys.count;
+	if (!count) {
+		return [NSData data];
+	}
 
-	return [combinedDataString dataUsingEncoding:NSUTF8StringEncoding allowLossyConversion:NO];
+	// Take the UTF-8 bytes of every key and value once, and size the
+	// buffer for the worst case, in which every byte is escaped. The
+	// bytes belong to the strings, and the descriptions of values that
+	// are not strings are made here, so the strings are held until the
+	// bytes are escaped.
+	NS_VALID_UNTIL_END_OF_SCOPE NSMutableArray<NSString *> *heldStrings = [NSMutableArray arrayWithCapacity:count * 2];
+	const char **strings = malloc(sizeof(char *) * count * 2);
+	size_t *lengths = malloc(sizeof(size_t) * count * 2);
+	size_t capacity = count * 2;
+	for (NSUInteger i = 0; i < count; i++) {
+		NSString *key = LFHFEString(keys[i]) ?: @"";
+		NSString *value = LFHFEString(formDictionary[keys[i]]) ?: @"";
+		[heldStrings addObject:key];
+		[heldStrings addObject:value];
+		strings[i * 2] = key.UTF8String ?: "";
+		strings[i * 2 + 1] = value.UTF8String ?: "";
+		lengths[i * 2] = strlen(strings[i * 2]);
+		lengths[i * 2 + 1] = strlen(strings[i * 2 + 1]);
+		capacity += (lengths[i * 2] + lengths[i * 2 + 1]) * 3;
+	}
+
+	NSMutableData *data = [NSMutableData dataWithLength:capacity];
+	char *start = data.mutableBytes;
+	char *output = start;
+	for (NSUInteger i = 0; i < count; i++) {
+		if (i) {
+			*output++ = '&';
+		}
+		output = LFHFEEscape(output, strings[i * 2], lengths[i * 2]);
+		*output++ = '=';
+		output = LFHFEEscape(output, strings[i * 2 + 1], lengths[i * 2 + 1]);
+	}
+	free(strings);
+	free(lengths);
+	data.length = (NSUInteger) (output - start);
+	return data;
 }
 @end
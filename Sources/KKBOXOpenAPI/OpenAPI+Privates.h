@@ -0,0 +1,293 @@
+//
+// OpenAPI+Privates.h
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+#import "OpenAPI.h"
+#import "OpenAPIResponseCache.h"
+#import "OpenAPIHedging.h"
+#import "OpenAPICircuitBreaker.h"
+#import "OpenAPIEndpointMetrics.h"
+#import "OpenAPIBinaryArchive.h"
+#import "OpenAPICatalogSnapshot.h"
+
+NSString *_Nonnull KKStringFromTerritoryCode(KKTerritoryCode code);
+/** A deep copy of a JSON object whose dictionaries are marked as stale. */
+id _Nonnull KKStaleCopyOfJSONObject(id _Nonnull JSONObject);
+/** If a JSON object is a dictionary marked as stale. */
+BOOL KKIsStaleJSONObject(id _Nullable JSONObject);
+
+@class KKBOXOpenAPI;
+
+@interface KKBOXOpenAPI (Privates)
+
+/** POSTs the parameters as a form, with the pairs sorted by key. */
+- (nonnull NSURLSessionDataTask *)_postToURL:(nonnull NSURL *)URL POSTParameters:(nonnull NSDictionary *)parameters headers:(nonnull NSDictionary<NSString *, NSString *> *)headers callback:(nonnull void (^)(id _Nullable, NSError *_Nullable))callback;
+
+/** POSTs a body, as a form unless the headers give another Content-Type. */
+- (nonnull NSURLSessionDataTask *)_postToURL:(nonnull NSURL *)URL POSTData:(nonnull NSData *)POSTData headers:(nonnull NSDictionary<NSString *, NSString * > *)headers callback:(nonnull void (^)(id _Nullable, NSError *_Nullable))callback;
+
+/** A GET request for an API URL, authorized with the access token. */
+- (nonnull NSMutableURLRequest *)_APIRequestWithURL:(nonnull NSURL *)URL;
+
+/**
+ * GET an API URL through the response cache, the circuit breaker and
+ * the hedging policy.
+ *
+ * @param URL the API URL
+ * @param endpointKey the name of the endpoint that the circuit breaker
+ * and the hedging policy keep their state by, such as
+ * `albums/{id}/tracks`. Nil uses the path of the URL.
+ * @param callbackQueue the queue to call the callback on
+ * @param callback the callback
+ */
+- (nonnull NSURLSessionDataTask *)_apiTaskWithURL:(nonnull NSURL *)URL endpointKey:(nullable NSString *)endpointKey callbackQueue:(nonnull dispatch_queue_t)callbackQueue callback:(nonnull KKBOXOpenAPIDataCallback)callback;
+@end
+
+#pragma mark - Endpoints
+
+/** How the models of an endpoint are laid out in its responses. */
+typedef NS_ENUM(NSInteger, KKEndpointShape)
+{
+	/** One model made of the whole response. */
+	KKEndpointShapeObject,
+	/** A list of models at `dataKeyPath`. */
+	KKEndpointShapeList,
+	/** A container model made of the rest of the response, and a list of models at `dataKeyPath`. */
+	KKEndpointShapeContainerAndList,
+};
+
+/**
+ * Spells the name of a model class, and fails to compile if there is
+ * no such class.
+ */
+#define KK_MODEL(C) (sizeof(C *) ? #C : "")
+
+/** Describes an API endpoint. Descriptors are static constants. */
+typedef struct
+{
+	/** The path after the API version, with `{id}` where the ID goes. Also names the endpoint in the metrics. */
+	NSString *__unsafe_unretained _Nonnull pathTemplate;
+	/** If the endpoint takes `offset` and `limit`. */
+	BOOL paged;
+	KKEndpointShape shape;
+	/** The class of the models, spelled with KK_MODEL. */
+	const char *_Nonnull modelClassName;
+	/** The class of the container, spelled with KK_MODEL. Only used by KKEndpointShapeContainerAndList. */
+	const char *_Nullable containerClassName;
+	/** The key path of the list of models, like `tracks.data`. */
+	NSString *__unsafe_unretained _Nullable dataKeyPath;
+	/** The key path of the dictionary that holds `paging` and `summary`, or an empty string for the root. Nil if there is no paging. */
+	NSString *__unsafe_unretained _Nullable pagingKeyPath;
+} KKEndpointDescriptor;
+
+/** The descriptors of the lists that KKBulkDownloader fetches. */
+FOUNDATION_EXTERN const KKEndpointDescriptor KKAlbumTracksEndpoint;
+FOUNDATION_EXTERN const KKEndpointDescriptor KKChildrenCategoryPlaylistsEndpoint;
+FOUNDATION_EXTERN const KKEndpointDescriptor KKNewReleaseCategoryEndpoint;
+
+/** The models parsed from a response. */
+@interface KKEndpointResult : NSObject
+/** The model of KKEndpointShapeObject, or the container of KKEndpointShapeContainerAndList. */
+@property (strong, nullable, nonatomic) id object;
+@property (strong, nullable, nonatomic) NSArray *objects;
+@property (strong, nullable, nonatomic) KKPagingInfo *paging;
+@property (strong, nullable, nonatomic) KKSummary *summary;
+@end
+
+typedef void (^KKEndpointCallback)(KKEndpointResult *_Nullable, NSError *_Nullable);
+
+@interface KKBOXOpenAPI ()
+/** The calls in flight keyed by their URLs, for coalescing. Guarded by synchronizing on itself. */
+@property (strong, nonnull, nonatomic) NSMutableDictionary *endpointCalls;
+/** Guarded by synchronizing on itself. */
+@property (strong, nonnull, nonatomic) NSMutableDictionary<NSString *, KKEndpointMetrics *> *mutableEndpointMetrics;
+/** The session that hedges are sent on. Guarded by synchronizing on the API. */
+@property (strong, nullable, nonatomic) NSURLSession *hedgingSession;
+/** The session that `hedgingSession` copies the configuration of. Guarded by synchronizing on the API. */
+@property (weak, nullable, nonatomic) NSURLSession *hedgingSessionSource;
+
+/** The queue that the callbacks of the calls made now on the current thread are called on. */
+- (nonnull dispatch_queue_t)_currentCallbackQueue;
+@end
+
+@interface KKBOXOpenAPI (Endpoints)
+
+/**
+ * Build the URL of a call.
+ *
+ * @param endpoint the descriptor of the endpoint
+ * @param ID the ID in the path, or nil if the path has none
+ * @param parameters the query parameters other than the territory, the offset and the limit
+ * @param territory the territory
+ * @param offset the offset, ignored if the endpoint is not paged
+ * @param limit the limit, ignored if the endpoint is not paged
+ * @param requestKey set to the path and the query without the offset and the limit
+ */
+- (nonnull NSURL *)_URLForEndpoint:(nonnull const KKEndpointDescriptor *)endpoint ID:(nullable NSString *)ID parameters:(nullable NSDictionary<NSString *, NSString *> *)parameters territory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit requestKey:(NSString *_Nullable *_Nullable)requestKey;
+
+/**
+ * Call an endpoint: build the URL, join an identical call in flight,
+ * send the request through the response cache, the circuit breaker
+ * and the hedging policy, retry transient errors, parse the models,
+ * upsert them into the catalog store, and count the metrics. The
+ * callback is called on the current callback queue.
+ *
+ * @param endpoint the descriptor of the endpoint
+ * @param ID the ID in the path, or nil if the path has none
+ * @param parameters the query parameters other than the territory, the offset and the limit
+ * @param territory the territory
+ * @param offset the offset, ignored if the endpoint is not paged
+ * @param limit the limit, ignored if the endpoint is not paged
+ * @param callback the callback
+ */
+- (nonnull NSURLSessionDataTask *)_taskWithEndpoint:(nonnull const KKEndpointDescriptor *)endpoint ID:(nullable NSString *)ID parameters:(nullable NSDictionary<NSString *, NSString *> *)parameters territory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit callback:(nonnull KKEndpointCallback)callback;
+@end
+
+/** A remembered response. */
+@interface KKCachedResponse : NSObject
+@property (strong, nullable, nonatomic) NSString *ETag;
+@property (strong, nullable, nonatomic) NSString *lastModified;
+@property (strong, nonnull, nonatomic) id JSONObject;
+@property (assign, nonatomic) NSUInteger byteCount;
+@end
+
+@interface KKResponseCache (Privates)
+
+- (nullable KKCachedResponse *)cachedResponseForURL:(nonnull NSURL *)URL;
+
+/** Add the conditional headers of a cached response to a request. */
+- (void)prepareRequest:(nonnull NSMutableURLRequest *)request withCachedResponse:(nullable KKCachedResponse *)cachedResponse;
+
+/** Count a response, and tell if it is a 304 that the cached response answers. */
+- (BOOL)isNotModifiedResponse:(nonnull NSURLResponse *)response cachedResponse:(nullable KKCachedResponse *)cachedResponse;
+
+/**
+ * Remember a response. One without a validator can only serve as a
+ * stale fallback, so it is only kept if `keepsWithoutValidators` is
+ * YES, that is when a circuit breaker is set.
+ */
+- (void)storeJSONObject:(nonnull id)JSONObject byteCount:(NSUInteger)byteCount forResponse:(nonnull NSURLResponse *)response URL:(nonnull NSURL *)URL keepsWithoutValidators:(BOOL)keepsWithoutValidators;
+@end
+
+@interface KKHedgingPolicy (Privates)
+
+/** Count a request, and tell how long to wait before hedging it, or -1 not to hedge. */
+- (NSTimeInterval)hedgeDelayForEndpointKey:(nonnull NSString *)key;
+
+/** Count a hedge if the budget allows one. */
+- (BOOL)acquireHedge;
+
+/**
+ * Count the latency of an original request, whether or not its hedge
+ * won. An original request that lost is counted with the time it ran
+ * before it was cancelled.
+ */
+- (void)recordLatency:(NSTimeInterval)latency forEndpointKey:(nonnull NSString *)key;
+
+/** Count a hedge that answered before the original request. */
+- (void)recordHedgeWin;
+@end
+
+typedef NS_ENUM(NSInteger, KKCircuitPermission)
+{
+	KKCircuitPermissionRejected,
+	KKCircuitPermissionAllowed,
+	/** Allowed as one of the trial calls of a half-open circuit. */
+	KKCircuitPermissionTrial,
+};
+
+@interface KKCircuitBreaker (Privates)
+
+/** Ask whether a call may be sent. Counts a rejection if not. */
+- (KKCircuitPermission)permissionForEndpointKey:(nonnull NSString *)key;
+
+- (void)recordCallWithPermission:(KKCircuitPermission)permission succeeded:(BOOL)succeeded latency:(NSTimeInterval)latency forEndpointKey:(nonnull NSString *)key;
+
+/** Give back the slot of a trial call that was cancelled. */
+- (void)cancelCallWithPermission:(KKCircuitPermission)permission forEndpointKey:(nonnull NSString *)key;
+@end
+
+@interface KKBOXOpenAPIObject (Privates)
+/** The dictionary that the object is made of. */
+- (nullable NSDictionary *)dictionary;
+@end
+
+#pragma mark - Binary Archives
+
+/** Where an entry of a binary archive is in its data. Both fields are little-endian. */
+typedef struct
+{
+	uint32_t location;
+	uint32_t length;
+} KKBinaryRange;
+
+/** The range of an entry in a table of KKBinaryRange, or NO if the table has no such entry or the range is outside the data. */
+BOOL KKBinaryRangeAtIndex(NSData *_Nonnull table, NSUInteger index, NSUInteger dataLength, NSRange *_Nonnull range);
+
+/** Encodes objects into the string table and the records of a binary archive. */
+@interface KKBinaryArchiveWriter : NSObject
+
+/** Encode an object, and return the index of its record. */
+- (NSUInteger)appendObject:(nonnull KKBOXOpenAPIObject *)object;
+
+/** Add a string to the table if it is not there yet, and return its index. */
+- (NSUInteger)indexOfString:(nonnull NSString *)string;
+
+@property (readonly, strong, nonnull, nonatomic) NSArray<NSString *> *strings;
+/** The records, one after another. */
+@property (readonly, strong, nonnull, nonatomic) NSData *records;
+@property (readonly, strong, nonnull, nonatomic) NSArray<NSNumber *> *recordLengths;
+
+/** The archive of the objects appended so far. */
+- (nonnull NSData *)archivedData;
+@end
+
+@interface KKBinaryArchive (Privates)
+
+/**
+ * Read strings and records laid out in some other file, without
+ * walking them.
+ *
+ * @param data the data that holds the strings and the records
+ * @param stringRanges a table of KKBinaryRange locating the strings in the data
+ * @param objectRanges a table of KKBinaryRange locating the records in the data
+ * @param version the version of the archive format the records are written in
+ */
+- (nonnull instancetype)_initWithData:(nonnull NSData *)data stringRanges:(nonnull NSData *)stringRanges objectRanges:(nonnull NSData *)objectRanges version:(NSUInteger)version;
+
+/** Decode the dictionary of an object without making the object. */
+- (nullable NSDictionary *)_dictionaryAtIndex:(NSUInteger)index className:(NSString *_Nullable *_Nullable)className;
+@end
+
+#pragma mark - Catalog Snapshots
+
+@interface KKCatalogSnapshotBuilder (Privates)
+
+/**
+ * Record the result of a call.
+ *
+ * @param result the result
+ * @param paged if the endpoint is paged
+ * @param requestKey the path and the query of the call without the offset and the limit
+ * @param offset the offset of the call, ignored if the endpoint is not paged
+ */
+- (void)_recordResult:(nonnull KKEndpointResult *)result paged:(BOOL)paged requestKey:(nonnull NSString *)requestKey offset:(NSInteger)offset;
+@end
+
+@interface KKCatalogSnapshot (Privates)
+
+/**
+ * Look up the result of a call.
+ *
+ * @param requestKey the path and the query of the call without the offset and the limit
+ * @param modelClass the class of the objects in the list
+ * @param object set to the object or the container, or nil if there is none
+ * @param objects set to the whole list, built as it is accessed, or nil if there is none
+ * @param paging set to the paging of a list embedded in the object, or nil if there is none
+ * @param total set to the total of the list reported by the API
+ * @return NO if the snapshot does not have the request
+ */
+- (BOOL)_lookUpRequestKey:(nonnull NSString *)requestKey modelClass:(nonnull Class)modelClass object:(id _Nullable *_Nonnull)object objects:(NSArray *_Nullable *_Nonnull)objects paging:(KKPagingInfo *_Nullable *_Nonnull)paging total:(NSInteger *_Nonnull)total;
+@end
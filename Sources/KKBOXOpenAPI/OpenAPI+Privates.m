@@ -5,10 +5,32 @@
 //
 
 #import "OpenAPI.h"
+#import "OpenAPI+Privates.h"
 #import "NSData+LFHTTPFormExtensions.h"
 
 static NSString *const KKUserAgent = @"KKBOX Open API iOS SDK";
 
+/** The state that the response of an API call is handled with. */
+@interface KKAPIRequestContext : NSObject
+@property (strong, nonatomic) NSURL *URL;
+@property (strong, nonatomic) NSString *endpointKey;
+@property (copy, nonatomic) KKBOXOpenAPIDataCallback callback;
+@property (strong, nonatomic) dispatch_queue_t callbackQueue;
+@property (strong, nonatomic, nullable) KKResponseCache *responseCache;
+@property (strong, nonatomic, nullable) KKCachedResponse *cachedResponse;
+@property (strong, nonatomic, nullable) KKCircuitBreaker *circuitBreaker;
+@property (assign, nonatomic) KKCircuitPermission permission;
+@property (assign, nonatomic) CFAbsoluteTime startTime;
+@end
+
+/** The state of a request and its hedge. Guarded by synchronizing on itself. */
+@interface KKHedgedRequest : NSObject
+@property (strong, nonatomic) NSURLSessionDataTask *task;
+@property (strong, nonatomic, nullable) NSURLSessionDataTask *hedgeTask;
+@property (assign, nonatomic) NSUInteger outstandingCount;
+@property (assign, nonatomic) BOOL finished;
+@end
+
 NSString *KKStringFromTerritoryCode(KKTerritoryCode code) {
 	switch (code) {
 		case KKTerritoryCodeTaiwan:
@@ -31,10 +53,8 @@ NSString *KKStringFromTerritoryCode(KKTerritoryCode code) {
 
 - (NSURLSessionDataTask *)_postToURL:(NSURL *)URL POSTParameters:(NSDictionary *)parameters headers:(NSDictionary<NSString *, NSString *> *)headers callback:(void (^)(id, NSError *))callback
 {
-	NSMutableDictionary<NSString *, NSString *> *newHeaders = [headers mutableCopy];
-	newHeaders[@"Content-type"] = @"application/x-www-form-urlencoded";
 	NSData *POSTData = [NSData dataAsWWWURLEncodedFormFromDictionary:parameters];
-	return [self _postToURL:URL POSTData:POSTData headers:newHeaders callback:callback];
+	return [self _postToURL:URL POSTData:POSTData headers:headers callback:callback];
 }
 
 - (NSURLSessionDataTask *)_postToURL:(NSURL *)URL POSTData:(NSData *)POSTData headers:(NSDictionary<NSString *, NSString *> *)headers callback:(void (^)(id, NSError *))callback
@@ -47,13 +67,14 @@ NSString *KKStringFromTerritoryCode(KKTerritoryCode code) {
 	NSMutableURLRequest *request = [[NSMutableURLRequest alloc] initWithURL:URL];
 	[request setHTTPMethod:@"POST"];
 
-	for (NSString *key in headers.allKeys) {
-		[request setValue:headers[key] forHTTPHeaderField:key];
-	}
+	[request setValue:@"application/x-www-form-urlencoded" forHTTPHeaderField:@"Content-Type"];
+	[headers enumerateKeysAndObjectsUsingBlock:^(NSString *key, NSString *value, BOOL *stop) {
+		[request setValue:value forHTTPHeaderField:key];
+	}];
 	[request setValue:KKUserAgent forHTTPHeaderField:@"User-Agent"];
 	[request setHTTPBody:POSTData];
 
-	NSURLSessionDataTask *task = [[NSURLSession sharedSession] dataTaskWithRequest:request completionHandler:^(NSData *_Nullable data, NSURLResponse *_Nullable response, NSError *_Nullable error) {
+	NSURLSessionDataTask *task = [self.URLSession dataTaskWithRequest:request completionHandler:^(NSData *_Nullable data, NSURLResponse *_Nullable response, NSError *_Nullable error) {
 		if (error) {
 			dispatch_async(dispatch_get_main_queue(), ^{
 				callback(nil, error);
@@ -66,6 +87,7 @@ NSString *KKStringFromTerritoryCode(KKTerritoryCode code) {
 			dispatch_async(dispatch_get_main_queue(), ^{
 				callback(nil, JSONError);
 			});
+			return;
 		}
 		dispatch_async(dispatch_get_main_queue(), ^{
 			callback(JSONObject, nil);
@@ -75,48 +97,220 @@ NSString *KKStringFromTerritoryCode(KKTerritoryCode code) {
 	return task;
 }
 
-- (nonnull NSURLSessionDataTask *)_apiTaskWithURL:(nonnull NSURL *)URL callback:(nonnull KKBOXOpenAPIDataCallback)callback;
+- (NSMutableURLRequest *)_APIRequestWithURL:(NSURL *)URL
 {
-	NSParameterAssert(self.accessToken);
-	NSParameterAssert(URL);
-	NSParameterAssert(callback);
-
 	NSMutableURLRequest *request = [[NSMutableURLRequest alloc] initWithURL:URL];
 	[request setHTTPMethod:@"GET"];
 	[request setValue:KKUserAgent forHTTPHeaderField:@"User-Agent"];
 	NSString *auth = [NSString stringWithFormat:@"Bearer %@", self.accessToken.accessToken];
 	[request setValue:auth forHTTPHeaderField:@"Authorization"];
-	NSURLSessionDataTask *task = [[NSURLSession sharedSession] dataTaskWithRequest:request completionHandler:^(NSData *_Nullable data, NSURLResponse *_Nullable response, NSError *_Nullable error) {
-		if (error) {
-			dispatch_async(dispatch_get_main_queue(), ^{
-				callback(nil, error);
-			});
-			return;
+	return request;
+}
+
+- (nonnull NSURLSessionDataTask *)_apiTaskWithURL:(nonnull NSURL *)URL endpointKey:(nullable NSString *)endpointKey callbackQueue:(nonnull dispatch_queue_t)callbackQueue callback:(nonnull KKBOXOpenAPIDataCallback)callback;
+{
+	NSParameterAssert(self.accessToken);
+	NSParameterAssert(URL);
+	NSParameterAssert(callbackQueue);
+	NSParameterAssert(callback);
+
+	NSMutableURLRequest *request = [self _APIRequestWithURL:URL];
+
+	KKAPIRequestContext *context = [[KKAPIRequestContext alloc] init];
+	context.URL = URL;
+	context.endpointKey = endpointKey ?: URL.path;
+	context.callback = callback;
+	context.callbackQueue = callbackQueue;
+	context.responseCache = self.responseCache;
+	context.cachedResponse = [context.responseCache cachedResponseForURL:URL];
+	[context.responseCache prepareRequest:request withCachedResponse:context.cachedResponse];
+
+	context.circuitBreaker = self.circuitBreaker;
+	if (context.circuitBreaker) {
+		context.permission = [context.circuitBreaker permissionForEndpointKey:context.endpointKey];
+		if (context.permission == KKCircuitPermissionRejected) {
+			// The task of the endpoint call forwards to one that never
+			// goes out, and stays running until the callback.
+			NSURLSessionDataTask *task = [self.URLSession dataTaskWithRequest:request];
+			[task cancel];
+			NSError *error = [NSError errorWithDomain:KKBOXOpenAPIErrorDomain code:4 userInfo:@{NSLocalizedDescriptionKey: @"The endpoint is unavailable"}];
+			[self _deliverStaleResponseWithContext:context error:error];
+			return task;
 		}
-		NSError *JSONError = nil;
-		id JSONObject = [NSJSONSerialization JSONObjectWithData:data options:0 error:&JSONError];
-		if (JSONError) {
-			dispatch_async(dispatch_get_main_queue(), ^{
-				callback(nil, JSONError);
-			});
-			return;
+	}
+	context.startTime = CFAbsoluteTimeGetCurrent();
+
+	KKHedgingPolicy *hedgingPolicy = self.hedgingPolicy;
+	if (hedgingPolicy) {
+		return [self _hedgedTaskWithRequest:request policy:hedgingPolicy context:context];
+	}
+	NSURLSessionDataTask *task = [self.URLSession dataTaskWithRequest:request completionHandler:^(NSData *_Nullable data, NSURLResponse *_Nullable response, NSError *_Nullable error) {
+		[self _handleAPIResponse:response data:data error:error context:context];
+	}];
+	[task resume];
+	return task;
+}
+
+/** Answer with the remembered response marked as stale, or with the error if there is none. */
+- (void)_deliverStaleResponseWithContext:(KKAPIRequestContext *)context error:(NSError *)error
+{
+	id staleJSONObject = context.cachedResponse ? KKStaleCopyOfJSONObject(context.cachedResponse.JSONObject) : nil;
+	KKBOXOpenAPIDataCallback callback = context.callback;
+	dispatch_async(context.callbackQueue, ^{
+		callback(staleJSONObject, staleJSONObject ? nil : error);
+	});
+}
+
+- (void)_handleAPIResponse:(NSURLResponse *)response data:(NSData *)data error:(NSError *)error context:(KKAPIRequestContext *)context
+{
+	KKBOXOpenAPIDataCallback callback = context.callback;
+	dispatch_queue_t callbackQueue = context.callbackQueue;
+	KKResponseCache *responseCache = context.responseCache;
+	KKCachedResponse *cachedResponse = context.cachedResponse;
+	KKCircuitBreaker *circuitBreaker = context.circuitBreaker;
+	if (circuitBreaker) {
+		if ([error.domain isEqualToString:NSURLErrorDomain] && error.code == NSURLErrorCancelled) {
+			[circuitBreaker cancelCallWithPermission:context.permission forEndpointKey:context.endpointKey];
 		}
-		NSDictionary *APIErrorDictionary = JSONObject[@"error"];
-		if ([APIErrorDictionary isKindOfClass:[NSDictionary class]]) {
-			NSInteger code = [APIErrorDictionary[@"code"] integerValue];
-			NSString *errorMessage = APIErrorDictionary[@"message"] ?: @"API Error";
-			NSError *APIError = [NSError errorWithDomain:@"KKBOXOpenAPIErrorDomain" code:code userInfo:@{NSLocalizedDescriptionKey: errorMessage}];
-			dispatch_async(dispatch_get_main_queue(), ^{
-				callback(nil, APIError);
-			});
-			return;
+		else {
+			NSInteger statusCode = [response isKindOfClass:[NSHTTPURLResponse class]] ? ((NSHTTPURLResponse *)response).statusCode : 0;
+			BOOL failed = error || statusCode >= 500 || statusCode == 429;
+			[circuitBreaker recordCallWithPermission:context.permission succeeded:!failed latency:CFAbsoluteTimeGetCurrent() - context.startTime forEndpointKey:context.endpointKey];
+			if (failed && cachedResponse) {
+				[self _deliverStaleResponseWithContext:context error:error];
+				return;
+			}
 		}
-		dispatch_async(dispatch_get_main_queue(), ^{
-			callback(JSONObject, nil);
+	}
+	if (error) {
+		dispatch_async(callbackQueue, ^{
+			callback(nil, error);
+		});
+		return;
+	}
+	if ([responseCache isNotModifiedResponse:response cachedResponse:cachedResponse]) {
+		dispatch_async(callbackQueue, ^{
+			callback(cachedResponse.JSONObject, nil);
+		});
+		return;
+	}
+	NSError *JSONError = nil;
+	id JSONObject = [NSJSONSerialization JSONObjectWithData:data options:0 error:&JSONError];
+	if (JSONError) {
+		dispatch_async(callbackQueue, ^{
+			callback(nil, JSONError);
 		});
+		return;
+	}
+	NSDictionary *APIErrorDictionary = JSONObject[@"error"];
+	if ([APIErrorDictionary isKindOfClass:[NSDictionary class]]) {
+		NSInteger code = [APIErrorDictionary[@"code"] integerValue];
+		NSString *errorMessage = APIErrorDictionary[@"message"] ?: @"API Error";
+		NSError *APIError = [NSError errorWithDomain:@"KKBOXOpenAPIErrorDomain" code:code userInfo:@{NSLocalizedDescriptionKey: errorMessage}];
+		dispatch_async(callbackQueue, ^{
+			callback(nil, APIError);
+		});
+		return;
+	}
+	[responseCache storeJSONObject:JSONObject byteCount:data.length forResponse:response URL:context.URL keepsWithoutValidators:circuitBreaker != nil];
+	dispatch_async(callbackQueue, ^{
+		callback(JSONObject, nil);
+	});
+}
+
+#pragma mark - Hedging
+
+/**
+ * A session with the configuration of `URLSession` but connections of
+ * its own, so that a hedge does not queue behind the request it hedges.
+ */
+- (NSURLSession *)_hedgingSession
+{
+	NSURLSession *source = self.URLSession;
+	NSURLSession *replacedSession = nil;
+	NSURLSession *session = nil;
+	@synchronized (self) {
+		if (!self.hedgingSession || self.hedgingSessionSource != source) {
+			replacedSession = self.hedgingSession;
+			self.hedgingSession = [NSURLSession sessionWithConfiguration:source.configuration];
+			self.hedgingSessionSource = source;
+		}
+		session = self.hedgingSession;
+	}
+	[replacedSession finishTasksAndInvalidate];
+	return session;
+}
+
+- (NSURLSessionDataTask *)_hedgedTaskWithRequest:(NSURLRequest *)request policy:(KKHedgingPolicy *)policy context:(KKAPIRequestContext *)context
+{
+	NSString *key = context.endpointKey;
+	KKHedgedRequest *hedgedRequest = [[KKHedgedRequest alloc] init];
+
+	void (^complete)(BOOL, NSData *, NSURLResponse *, NSError *) = ^(BOOL isHedge, NSData *data, NSURLResponse *response, NSError *error) {
+		NSInteger statusCode = [response isKindOfClass:[NSHTTPURLResponse class]] ? ((NSHTTPURLResponse *)response).statusCode : 0;
+		BOOL failed = error || statusCode >= 500 || statusCode == 429;
+		NSURLSessionDataTask *loser = nil;
+		BOOL timesOriginal = NO;
+		@synchronized (hedgedRequest) {
+			hedgedRequest.outstandingCount--;
+			if (hedgedRequest.finished) {
+				return;
+			}
+			// A failure waits for the other request, unless the caller
+			// cancelled the original one.
+			BOOL cancelledByCaller = !isHedge && [error.domain isEqualToString:NSURLErrorDomain] && error.code == NSURLErrorCancelled;
+			if (failed && !cancelledByCaller && hedgedRequest.outstandingCount > 0) {
+				return;
+			}
+			hedgedRequest.finished = YES;
+			if (hedgedRequest.outstandingCount > 0) {
+				loser = isHedge ? hedgedRequest.task : hedgedRequest.hedgeTask;
+			}
+			timesOriginal = !failed && (!isHedge || loser);
+		}
+		// Whichever request lost is cancelled, and its response dropped.
+		[loser cancel];
+		if (timesOriginal) {
+			// The original request is timed even when the hedge won, so
+			// that hedges do not pull the percentile down. An original
+			// request that lost ran at least until now.
+			[policy recordLatency:CFAbsoluteTimeGetCurrent() - context.startTime forEndpointKey:key];
+		}
+		if (isHedge && !failed) {
+			[policy recordHedgeWin];
+		}
+		[self _handleAPIResponse:response data:data error:error context:context];
+	};
+
+	NSURLSessionDataTask *task = [self.URLSession dataTaskWithRequest:request completionHandler:^(NSData *_Nullable data, NSURLResponse *_Nullable response, NSError *_Nullable error) {
+		complete(NO, data, response, error);
 	}];
+	hedgedRequest.task = task;
+	hedgedRequest.outstandingCount = 1;
 	[task resume];
+
+	NSTimeInterval delay = [policy hedgeDelayForEndpointKey:key];
+	if (delay >= 0) {
+		dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t) (delay * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+			@synchronized (hedgedRequest) {
+				if (hedgedRequest.finished || ![policy acquireHedge]) {
+					return;
+				}
+				hedgedRequest.outstandingCount++;
+				hedgedRequest.hedgeTask = [[self _hedgingSession] dataTaskWithRequest:request completionHandler:^(NSData *_Nullable data, NSURLResponse *_Nullable response, NSError *_Nullable error) {
+					complete(YES, data, response, error);
+				}];
+				[hedgedRequest.hedgeTask resume];
+			}
+		});
+	}
 	return task;
 }
 
 @end
+
+@implementation KKAPIRequestContext
+@end
+
+@implementation KKHedgedRequest
+@end
@@ -5,19 +5,10 @@
 //
 
 #import "OpenAPI.h"
-
-NSString *_Nonnull KKStringFromTerritoryCode(KKTerritoryCode code);
-
-@class KKBOXOpenAPI;
-
-@interface KKBOXOpenAPI (Privates)
-
-- (nonnull NSURLSessionDataTask *)_postToURL:(nonnull NSURL *)URL POSTParameters:(nonnull NSDictionary *)parameters headers:(nonnull NSDictionary<NSString *, NSString *> *)headers callback:(nonnull void (^)(id _Nullable, NSError *_Nullable))callback;
-
-- (nonnull NSURLSessionDataTask *)_postToURL:(nonnull NSURL *)URL POSTData:(nonnull NSData *)POSTData headers:(nonnull NSDictionary<NSString *, NSString * > *)headers callback:(nonnull void (^)(id _Nullable, NSError *_Nullable))callback;
-
-- (nonnull NSURLSessionDataTask *)_apiTaskWithURL:(nonnull NSURL *)URL callback:(nonnull KKBOXOpenAPIDataCallback)callback;
-@end;
+#import "OpenAPI+Privates.h"
+#import "OpenAPIResponseCache.h"
+#import "OpenAPIEndpointMetrics.h"
+#import "NSData+LFHTTPFormExtensions.h"
 
 
 @interface KKAccessToken () <NSCoding>
@@ -68,7 +59,6 @@ NSString *_Nonnull KKStringFromTerritoryCode(KKTerritoryCode code);
 #pragma mark -
 
 static NSString *const KKBOXAccessTokenSettingKey = @"KKBOX OPEN API Access Token";
-static NSString *const KKOAuthTokenURLString = @"https://account.kkbox.com/oauth2/token";
 
 NSString *const KKBOXOpenAPIErrorDomain = @"KKBOXOpenAPIErrorDomain";
 NSString *const KKBOXOpenAPIDidLoginNotification = @"KKBOXOpenAPIDidLoginNotification";
@@ -79,6 +69,10 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 @property (nonatomic) KKScope requestScope;
 @property (strong, nonnull, nonatomic) NSString *clientID;
 @property (strong, nonnull, nonatomic) NSString *clientSecret;
+/** The headers of the token request, with the Basic authorization of the client credential. */
+@property (strong, nonnull, nonatomic) NSDictionary<NSString *, NSString *> *tokenRequestHeaders;
+/** The form body of the token request, which only depends on the scope. */
+@property (strong, nonnull, nonatomic) NSData *tokenRequestBody;
 @end
 
 @implementation KKBOXOpenAPI
@@ -97,11 +91,27 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 		self.clientID = clientID;
 		self.clientSecret = secret;
 		self.requestScope = scope;
+		// The credential and the scope never change, so the token request
+		// is encoded once.
+		NSString *clientCredential = [[[NSString stringWithFormat:@"%@:%@", clientID, secret] dataUsingEncoding:NSUTF8StringEncoding] base64EncodedStringWithOptions:0];
+		self.tokenRequestHeaders = @{@"Authorization": [@"Basic " stringByAppendingString:clientCredential]};
+		self.tokenRequestBody = [NSData dataAsWWWURLEncodedFormFromDictionary:@{@"grant_type": @"client_credentials", @"scope": [self _scopeParameter:scope]}];
+		self.APIBaseURL = [NSURL URLWithString:@"https://api.kkbox.com/v1.1/"];
+		self.tokenURL = [NSURL URLWithString:@"https://account.kkbox.com/oauth2/token"];
+		self.URLSession = [NSURLSession sharedSession];
+		self.retryInterval = 0.5;
+		self.endpointCalls = [NSMutableDictionary dictionary];
+		self.mutableEndpointMetrics = [NSMutableDictionary dictionary];
 		[self _restoreAccessToken];
 	}
 	return self;
 }
 
+- (void)dealloc
+{
+	[_hedgingSession finishTasksAndInvalidate];
+}
+
 - (void)logout
 {
 	if (!self.accessToken) {
@@ -112,6 +122,42 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 	[[NSUserDefaults standardUserDefaults] removeObjectForKey:key];
 }
 
+- (void)performWithCallbackQueue:(dispatch_queue_t)queue block:(NS_NOESCAPE void (^)(void))block
+{
+	NSParameterAssert(queue);
+	NSParameterAssert(block);
+	NSMutableDictionary *threadDictionary = [NSThread currentThread].threadDictionary;
+	NSValue *key = [NSValue valueWithNonretainedObject:self];
+	id previousQueue = threadDictionary[key];
+	threadDictionary[key] = queue;
+	block();
+	threadDictionary[key] = previousQueue;
+}
+
+- (dispatch_queue_t)_currentCallbackQueue
+{
+	NSValue *key = [NSValue valueWithNonretainedObject:self];
+	return [NSThread currentThread].threadDictionary[key] ?: dispatch_get_main_queue();
+}
+
+- (NSDictionary<NSString *, KKEndpointMetrics *> *)endpointMetrics
+{
+	NSMutableDictionary *endpointMetrics = [NSMutableDictionary dictionary];
+	@synchronized (self.mutableEndpointMetrics) {
+		for (NSString *name in self.mutableEndpointMetrics) {
+			endpointMetrics[name] = [self.mutableEndpointMetrics[name] copy];
+		}
+	}
+	return endpointMetrics;
+}
+
+- (void)resetEndpointMetrics
+{
+	@synchronized (self.mutableEndpointMetrics) {
+		[self.mutableEndpointMetrics removeAllObjects];
+	}
+}
+
 - (void)_saveAccessToken
 {
 	if (!self.accessToken) {
@@ -146,13 +192,13 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 	if (scope == KKScopeNone) {
 		return @"";
 	}
+	// In a fixed order, so that the same scope gives the same request body.
+	static const KKScope scopes[] = {KKScopeUserProfile, KKScopeUserTerritory, KKScopeUserAccountStatus};
+	NSArray *names = @[@"user_profile", @"user_territory", @"user_account_status"];
 	NSMutableArray *components = [NSMutableArray array];
-	NSDictionary *map = @{@(KKScopeUserProfile): @"user_profile", @(KKScopeUserTerritory): @"user_territory", @(KKScopeUserAccountStatus): @"user_account_status"};
-	NSArray *scopes = [map allKeys];
-	for (NSNumber *scopeNumber in scopes) {
-		NSUInteger currentScope = [scopeNumber unsignedIntegerValue];
-		if (scope & currentScope) {
-			[components addObject:map[scopeNumber]];
+	for (NSUInteger i = 0; i < sizeof(scopes) / sizeof(scopes[0]); i++) {
+		if (scope & scopes[i]) {
+			[components addObject:names[i]];
 		}
 	}
 	return [components componentsJoinedByString:@" "];
@@ -203,52 +249,42 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 
 - (NSURLSessionDataTask *)fetchAccessTokenByClientCredentialWithCallback:(KKBOXOpenAPILoginCallback)callback
 {
-	NSString *clientCredentialBase = [NSString stringWithFormat:@"%@:%@", self.clientID, self.clientSecret];
-	NSString *clientCredential = [[clientCredentialBase dataUsingEncoding:NSUTF8StringEncoding] base64EncodedStringWithOptions:0];
-	NSDictionary *headers = @{@"Authorization": [NSString stringWithFormat:@"Basic %@", clientCredential]};
-	NSDictionary < NSString *, NSString * > *parameters = @{@"grant_type": @"client_credentials", @"scope": [self _scopeParameter:self.requestScope]};
-	return [self _postToURL:[NSURL URLWithString:KKOAuthTokenURLString] POSTParameters:parameters headers:headers callback:[self _loginHandlerWithCallback:callback]];
+	return [self _postToURL:self.tokenURL POSTData:self.tokenRequestBody headers:self.tokenRequestHeaders callback:[self _loginHandlerWithCallback:callback]];
 }
 
 @end
 
 @implementation KKBOXOpenAPI (API)
 
-#define CALL_API [self _apiTaskWithURL:[NSURL URLWithString:URLString] callback:callback]
-#define ESCAPE(X) [X stringByAddingPercentEncodingWithAllowedCharacters:[NSCharacterSet URLPathAllowedCharacterSet]]
-#define ESCAPE_ARG(X) [X stringByAddingPercentEncodingWithAllowedCharacters:[NSCharacterSet URLQueryAllowedCharacterSet]]
-
 #pragma mark - Metadata
 #pragma mark - Song Tracks
 
+static const KKEndpointDescriptor KKTrackEndpoint = {
+	.pathTemplate = @"tracks/{id}",
+	.shape = KKEndpointShapeObject,
+	.modelClassName = KK_MODEL(KKTrackInfo),
+};
+
 - (nonnull NSURLSessionDataTask *)fetchTrackWithTrackID:(nonnull NSString *)trackID territory:(KKTerritoryCode)territory callback:(nonnull void (^)(KKTrackInfo *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/tracks/%@?territory=%@", ESCAPE(trackID), KKStringFromTerritoryCode(territory)];
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, error);
-			return;
-		}
-		KKTrackInfo *info = [[KKTrackInfo alloc] initWithDictionary:dictionary];
-		inCallback(info, nil);
-	};
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKTrackEndpoint ID:trackID parameters:nil territory:territory offset:0 limit:0 callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.object, error);
+	}];
 }
 
 #pragma mark - Albums
 
+static const KKEndpointDescriptor KKAlbumEndpoint = {
+	.pathTemplate = @"albums/{id}",
+	.shape = KKEndpointShapeObject,
+	.modelClassName = KK_MODEL(KKAlbumInfo),
+};
+
 - (nonnull NSURLSessionDataTask *)fetchAlbumWithAlbumID:(nonnull NSString *)albumID territory:(KKTerritoryCode)territory callback:(nonnull nonnull void (^)(KKAlbumInfo *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/albums/%@?territory=%@", ESCAPE(albumID), KKStringFromTerritoryCode(territory)];
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, error);
-			return;
-		}
-		KKAlbumInfo *info = [[KKAlbumInfo alloc] initWithDictionary:dictionary];
-		inCallback(info, nil);
-	};
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKAlbumEndpoint ID:albumID parameters:nil territory:territory offset:0 limit:0 callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.object, error);
+	}];
 }
 
 - (nonnull NSURLSessionDataTask *)fetchTracksWithAlbumID:(nonnull NSString *)albumID territory:(KKTerritoryCode)territory callback:(nonnull void (^)(NSArray <KKTrackInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
@@ -256,40 +292,35 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 	return [self fetchTracksWithAlbumID:albumID territory:territory offset:0 limit:500 callback:inCallback];
 }
 
+const KKEndpointDescriptor KKAlbumTracksEndpoint = {
+	.pathTemplate = @"albums/{id}/tracks",
+	.paged = YES,
+	.shape = KKEndpointShapeList,
+	.modelClassName = KK_MODEL(KKTrackInfo),
+	.dataKeyPath = @"data",
+	.pagingKeyPath = @"",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchTracksWithAlbumID:(nonnull NSString *)albumID territory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit callback:(nonnull void (^)(NSArray <KKTrackInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/albums/%@/tracks?territory=%@", ESCAPE(albumID), KKStringFromTerritoryCode(territory)];
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, error);
-			return;
-		}
-		NSMutableArray *tracks = [[NSMutableArray alloc] init];
-		for (NSDictionary *d in dictionary[@"data"]) {
-			KKTrackInfo *track = [[KKTrackInfo alloc] initWithDictionary:d];
-			[tracks addObject:track];
-		}
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"summary"]];
-		inCallback(tracks, paging, summary, nil);
-	};
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKAlbumTracksEndpoint ID:albumID parameters:nil territory:territory offset:offset limit:limit callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.objects, result.paging, result.summary, error);
+	}];
 }
 
 #pragma mark - Artists
 
+static const KKEndpointDescriptor KKArtistEndpoint = {
+	.pathTemplate = @"artists/{id}",
+	.shape = KKEndpointShapeObject,
+	.modelClassName = KK_MODEL(KKArtistInfo),
+};
+
 - (nonnull NSURLSessionDataTask *)fetchArtistInfoWithArtistID:(nonnull NSString *)artistID territory:(KKTerritoryCode)territory callback:(nonnull void (^)(KKArtistInfo *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/artists/%@?territory=%@", ESCAPE(artistID), KKStringFromTerritoryCode(territory)];
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, error);
-			return;
-		}
-		KKArtistInfo *artist = [[KKArtistInfo alloc] initWithDictionary:dictionary];
-		inCallback(artist, nil);
-	};
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKArtistEndpoint ID:artistID parameters:nil territory:territory offset:0 limit:0 callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.object, error);
+	}];
 }
 
 - (nonnull NSURLSessionDataTask *)fetchAlbumsBelongToArtistID:(nonnull NSString *)artistID territory:(KKTerritoryCode)territory callback:(nonnull void (^)(NSArray <KKAlbumInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
@@ -297,24 +328,20 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 	return [self fetchAlbumsBelongToArtistID:artistID territory:territory offset:0 limit:200 callback:inCallback];
 }
 
+static const KKEndpointDescriptor KKArtistAlbumsEndpoint = {
+	.pathTemplate = @"artists/{id}/albums",
+	.paged = YES,
+	.shape = KKEndpointShapeList,
+	.modelClassName = KK_MODEL(KKAlbumInfo),
+	.dataKeyPath = @"data",
+	.pagingKeyPath = @"",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchAlbumsBelongToArtistID:(nonnull NSString *)artistID territory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit callback:(nonnull void (^)(NSArray <KKAlbumInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/artists/%@/albums?territory=%@&offset=%ld&limit=%ld", ESCAPE(artistID), KKStringFromTerritoryCode(territory), (long) offset, (long) limit];
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, error);
-			return;
-		}
-		NSMutableArray *albums = [[NSMutableArray alloc] init];
-		for (NSDictionary *albumDictionary in dictionary[@"data"]) {
-			KKAlbumInfo *album = [[KKAlbumInfo alloc] initWithDictionary:albumDictionary];
-			[albums addObject:album];
-		}
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"summary"]];
-		inCallback(albums, paging, summary, nil);
-	};
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKArtistAlbumsEndpoint ID:artistID parameters:nil territory:territory offset:offset limit:limit callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.objects, result.paging, result.summary, error);
+	}];
 }
 
 - (nonnull NSURLSessionDataTask *)fetchTopTracksWithArtistID:(nonnull NSString *)artistID territory:(KKTerritoryCode)territory callback:(nonnull void (^)(NSArray <KKTrackInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
@@ -322,24 +349,20 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 	return [self fetchTopTracksWithArtistID:artistID territory:territory offset:0 limit:200 callback:inCallback];
 }
 
+static const KKEndpointDescriptor KKArtistTopTracksEndpoint = {
+	.pathTemplate = @"artists/{id}/top-tracks",
+	.paged = YES,
+	.shape = KKEndpointShapeList,
+	.modelClassName = KK_MODEL(KKTrackInfo),
+	.dataKeyPath = @"data",
+	.pagingKeyPath = @"",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchTopTracksWithArtistID:(nonnull NSString *)artistID territory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit callback:(nonnull void (^)(NSArray <KKTrackInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/artists/%@/top-tracks?territory=%@&offset=%ld&limit=%ld", ESCAPE(artistID), KKStringFromTerritoryCode(territory), (long) offset, (long) limit];
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, error);
-			return;
-		}
-		NSMutableArray *tracks = [[NSMutableArray alloc] init];
-		for (NSDictionary *trackDictionary in dictionary[@"data"]) {
-			KKTrackInfo *track = [[KKTrackInfo alloc] initWithDictionary:trackDictionary];
-			[tracks addObject:track];
-		}
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"summary"]];
-		inCallback(tracks, paging, summary, nil);
-	};
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKArtistTopTracksEndpoint ID:artistID parameters:nil territory:territory offset:offset limit:limit callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.objects, result.paging, result.summary, error);
+	}];
 }
 
 - (nonnull NSURLSessionDataTask *)fetchRelatedArtistsWithArtistID:(nonnull NSString *)artistID territory:(KKTerritoryCode)territory callback:(nonnull void (^)(NSArray <KKArtistInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
@@ -347,42 +370,36 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 	return [self fetchRelatedArtistsWithArtistID:artistID territory:territory offset:0 limit:20 callback:inCallback];
 }
 
+static const KKEndpointDescriptor KKRelatedArtistsEndpoint = {
+	.pathTemplate = @"artists/{id}/related-artists",
+	.paged = YES,
+	.shape = KKEndpointShapeList,
+	.modelClassName = KK_MODEL(KKArtistInfo),
+	.dataKeyPath = @"data",
+	.pagingKeyPath = @"",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchRelatedArtistsWithArtistID:(nonnull NSString *)artistID territory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit callback:(nonnull void (^)(NSArray <KKArtistInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/artists/%@/related-artists?territory=%@&offset=%ld&limit=%ld", ESCAPE(artistID), KKStringFromTerritoryCode(territory), (long) offset, (long) limit];
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, error);
-			return;
-		}
-		NSMutableArray *artists = [[NSMutableArray alloc] init];
-		for (NSDictionary *d in dictionary[@"data"]) {
-			KKArtistInfo *track = [[KKArtistInfo alloc] initWithDictionary:d];
-			[artists addObject:track];
-		}
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"summary"]];
-		inCallback(artists, paging, summary, nil);
-	};
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKRelatedArtistsEndpoint ID:artistID parameters:nil territory:territory offset:offset limit:limit callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.objects, result.paging, result.summary, error);
+	}];
 }
 
 #pragma mark - Shared Playlists
 
+static const KKEndpointDescriptor KKPlaylistEndpoint = {
+	.pathTemplate = @"shared-playlists/{id}",
+	.shape = KKEndpointShapeObject,
+	.modelClassName = KK_MODEL(KKPlaylistInfo),
+	.pagingKeyPath = @"tracks",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchPlaylistWithPlaylistID:(nonnull NSString *)playlistID territory:(KKTerritoryCode)territory callback:(nonnull void (^)(KKPlaylistInfo *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/shared-playlists/%@?territory=%@", ESCAPE(playlistID), KKStringFromTerritoryCode(territory)];
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, error);
-			return;
-		}
-		KKPlaylistInfo *playlist = [[KKPlaylistInfo alloc] initWithDictionary:dictionary];
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"tracks"][@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"tracks"][@"summary"]];
-		inCallback(playlist, paging, summary, nil);
-	};
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKPlaylistEndpoint ID:playlistID parameters:nil territory:territory offset:0 limit:0 callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.object, result.paging, result.summary, error);
+	}];
 }
 
 - (nonnull NSURLSessionDataTask *)fetchTracksInPlaylistWithPlaylistID:(nonnull NSString *)playlistID territory:(KKTerritoryCode)territory callback:(nonnull void (^)(NSArray <KKTrackInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
@@ -390,26 +407,20 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 	return [self fetchTracksInPlaylistWithPlaylistID:playlistID territory:territory offset:0 limit:20 callback:inCallback];
 }
 
+static const KKEndpointDescriptor KKPlaylistTracksEndpoint = {
+	.pathTemplate = @"shared-playlists/{id}/tracks",
+	.paged = YES,
+	.shape = KKEndpointShapeList,
+	.modelClassName = KK_MODEL(KKTrackInfo),
+	.dataKeyPath = @"data",
+	.pagingKeyPath = @"",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchTracksInPlaylistWithPlaylistID:(nonnull NSString *)playlistID territory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit callback:(nonnull void (^)(NSArray <KKTrackInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/shared-playlists/%@/tracks?territory=%@&offset=%ld&limit=%ld", ESCAPE(playlistID), KKStringFromTerritoryCode(territory), (long) offset, (long) limit];
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, error);
-			return;
-		}
-		NSMutableArray *array = [[NSMutableArray alloc] init];
-		if ([dictionary[@"data"] isKindOfClass:[NSArray class]]) {
-			for (NSDictionary *trackDictionary in dictionary[@"data"]) {
-				KKTrackInfo *track = [[KKTrackInfo alloc] initWithDictionary:trackDictionary];
-				[array addObject:track];
-			}
-		}
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"summary"]];
-		inCallback(array, paging, summary, nil);
-	};
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKPlaylistTracksEndpoint ID:playlistID parameters:nil territory:territory offset:offset limit:limit callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.objects, result.paging, result.summary, error);
+	}];
 }
 
 #pragma mark - Featured Playlists
@@ -419,26 +430,20 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 	return [self fetchFeaturedPlaylistsForTerritory:territory offset:0 limit:100 callback:inCallback];
 }
 
+static const KKEndpointDescriptor KKFeaturedPlaylistsEndpoint = {
+	.pathTemplate = @"featured-playlists",
+	.paged = YES,
+	.shape = KKEndpointShapeList,
+	.modelClassName = KK_MODEL(KKPlaylistInfo),
+	.dataKeyPath = @"data",
+	.pagingKeyPath = @"",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchFeaturedPlaylistsForTerritory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit callback:(nonnull void (^)(NSArray <KKPlaylistInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/featured-playlists?territory=%@&offset=%ld&limit=%ld", KKStringFromTerritoryCode(territory), (long) offset, (long) limit];
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, error);
-			return;
-		}
-		NSMutableArray *playlists = [[NSMutableArray alloc] init];
-		if ([dictionary[@"data"] isKindOfClass:[NSArray class]]) {
-			for (NSDictionary *playlistDictionary in dictionary[@"data"]) {
-				KKPlaylistInfo *playlist = [[KKPlaylistInfo alloc] initWithDictionary:playlistDictionary];
-				[playlists addObject:playlist];
-			}
-		}
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"summary"]];
-		inCallback(playlists, paging, summary, nil);
-	};
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKFeaturedPlaylistsEndpoint ID:nil parameters:nil territory:territory offset:offset limit:limit callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.objects, result.paging, result.summary, error);
+	}];
 }
 
 #pragma mark - New-Hits Playlists
@@ -448,26 +453,20 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 	return [self fetchNewHitsPlaylistsForTerritory:territory offset:0 limit:10 callback:inCallback];
 }
 
+static const KKEndpointDescriptor KKNewHitsPlaylistsEndpoint = {
+	.pathTemplate = @"new-hits-playlists",
+	.paged = YES,
+	.shape = KKEndpointShapeList,
+	.modelClassName = KK_MODEL(KKPlaylistInfo),
+	.dataKeyPath = @"data",
+	.pagingKeyPath = @"",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchNewHitsPlaylistsForTerritory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit callback:(nonnull void (^)(NSArray <KKPlaylistInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/new-hits-playlists?territory=%@&offset=%ld&limit=%ld", KKStringFromTerritoryCode(territory), (long) offset, (long) limit];
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, error);
-			return;
-		}
-		NSMutableArray *playlists = [[NSMutableArray alloc] init];
-		if ([dictionary[@"data"] isKindOfClass:[NSArray class]]) {
-			for (NSDictionary *playlistDictionary in dictionary[@"data"]) {
-				KKPlaylistInfo *playlist = [[KKPlaylistInfo alloc] initWithDictionary:playlistDictionary];
-				[playlists addObject:playlist];
-			}
-		}
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"summary"]];
-		inCallback(playlists, paging, summary, nil);
-	};
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKNewHitsPlaylistsEndpoint ID:nil parameters:nil territory:territory offset:offset limit:limit callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.objects, result.paging, result.summary, error);
+	}];
 }
 
 #pragma mark - Featured Playlists Categories
@@ -477,26 +476,20 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 	return [self fetchFeaturedPlaylistCategoriesForTerritory:territory offset:0 limit:100 callback:inCallback];
 }
 
+static const KKEndpointDescriptor KKFeaturedPlaylistCategoriesEndpoint = {
+	.pathTemplate = @"featured-playlist-categories",
+	.paged = YES,
+	.shape = KKEndpointShapeList,
+	.modelClassName = KK_MODEL(KKFeaturedPlaylistCategory),
+	.dataKeyPath = @"data",
+	.pagingKeyPath = @"",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchFeaturedPlaylistCategoriesForTerritory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit callback:(nonnull void (^)(NSArray <KKFeaturedPlaylistCategory *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/featured-playlist-categories?territory=%@&offset=%ld&limit=%ld", KKStringFromTerritoryCode(territory), (long) offset, (long) limit];
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, error);
-			return;
-		}
-		NSMutableArray *array = [[NSMutableArray alloc] init];
-		if ([dictionary[@"data"] isKindOfClass:[NSArray class]]) {
-			for (NSDictionary *playlistDictionary in dictionary[@"data"]) {
-				KKFeaturedPlaylistCategory *category = [[KKFeaturedPlaylistCategory alloc] initWithDictionary:playlistDictionary];
-				[array addObject:category];
-			}
-		}
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"summary"]];
-		inCallback(array, paging, summary, nil);
-	};
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKFeaturedPlaylistCategoriesEndpoint ID:nil parameters:nil territory:territory offset:offset limit:limit callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.objects, result.paging, result.summary, error);
+	}];
 }
 
 - (nonnull NSURLSessionDataTask *)fetchFeaturedPlaylistsInCategory:(nonnull NSString *)category territory:(KKTerritoryCode)territory callback:(nonnull void (^)(KKFeaturedPlaylistCategory *_Nullable, NSArray <KKPlaylistInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
@@ -504,58 +497,39 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 	return [self fetchFeaturedPlaylistsInCategory:category territory:territory offset:0 limit:100 callback:inCallback];
 }
 
+static const KKEndpointDescriptor KKFeaturedPlaylistCategoryEndpoint = {
+	.pathTemplate = @"featured-playlist-categories/{id}",
+	.paged = YES,
+	.shape = KKEndpointShapeContainerAndList,
+	.modelClassName = KK_MODEL(KKPlaylistInfo),
+	.containerClassName = KK_MODEL(KKFeaturedPlaylistCategory),
+	.dataKeyPath = @"playlists.data",
+	.pagingKeyPath = @"playlists",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchFeaturedPlaylistsInCategory:(nonnull NSString *)category territory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit callback:(nonnull void (^)(KKFeaturedPlaylistCategory *_Nullable, NSArray <KKPlaylistInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/featured-playlist-categories/%@?territory=%@&offset=%ld&limit=%ld", ESCAPE(category), KKStringFromTerritoryCode(territory), (long) offset, (long) limit];
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, nil, error);
-			return;
-		}
-		NSMutableDictionary *categoryDictionary = [[NSMutableDictionary alloc] init];
-		categoryDictionary[@"id"] = dictionary[@"id"];
-		categoryDictionary[@"title"] = dictionary[@"title"];
-		categoryDictionary[@"images"] = dictionary[@"images"];
-		KKFeaturedPlaylistCategory *category = [[KKFeaturedPlaylistCategory alloc] initWithDictionary:categoryDictionary];
-
-		NSMutableArray *array = [[NSMutableArray alloc] init];
-		if ([dictionary[@"playlists"] isKindOfClass:[NSDictionary class]] && [dictionary[@"playlists"][@"data"] isKindOfClass:[NSArray class]]) {
-			for (NSDictionary *playlistDictionary in dictionary[@"playlists"][@"data"]) {
-				KKPlaylistInfo *playlist = [[KKPlaylistInfo alloc] initWithDictionary:playlistDictionary];
-				[array addObject:playlist];
-			}
-		}
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"playlists"][@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"playlists"][@"summary"]];
-		inCallback(category, array, paging, summary, nil);
-	};
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKFeaturedPlaylistCategoryEndpoint ID:category parameters:nil territory:territory offset:offset limit:limit callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.object, result.objects, result.paging, result.summary, error);
+	}];
 }
 
 #pragma mark - Radio
 #pragma mark Mood Station
 
+static const KKEndpointDescriptor KKMoodStationsEndpoint = {
+	.pathTemplate = @"mood-stations",
+	.shape = KKEndpointShapeList,
+	.modelClassName = KK_MODEL(KKRadioStation),
+	.dataKeyPath = @"data",
+	.pagingKeyPath = @"",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchMoodStationsForTerritory:(KKTerritoryCode)territory callback:(nonnull void (^)(NSArray <KKRadioStation *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/mood-stations?territory=%@", KKStringFromTerritoryCode(territory)];
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, error);
-			return;
-		}
-
-		NSMutableArray *stations = [[NSMutableArray alloc] init];
-		if ([dictionary[@"data"] isKindOfClass:[NSArray class]]) {
-			for (NSDictionary *playlistDictionary in dictionary[@"data"]) {
-				KKRadioStation *radioStation = [[KKRadioStation alloc] initWithDictionary:playlistDictionary];
-				[stations addObject:radioStation];
-			}
-		}
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"summary"]];
-		inCallback(stations, paging, summary, nil);
-	};
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKMoodStationsEndpoint ID:nil parameters:nil territory:territory offset:0 limit:0 callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.objects, result.paging, result.summary, error);
+	}];
 }
 
 - (nonnull NSURLSessionDataTask *)fetchMoodStationWithStationID:(nonnull NSString *)stationID territory:(KKTerritoryCode)territory callback:(nonnull void (^)(KKRadioStation *_Nullable, NSArray<KKTrackInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
@@ -563,59 +537,38 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 	return [self fetchMoodStationWithStationID:stationID territory:territory offset:0 limit:100 callback:inCallback];
 }
 
+static const KKEndpointDescriptor KKMoodStationEndpoint = {
+	.pathTemplate = @"mood-stations/{id}",
+	.paged = YES,
+	.shape = KKEndpointShapeContainerAndList,
+	.modelClassName = KK_MODEL(KKTrackInfo),
+	.containerClassName = KK_MODEL(KKRadioStation),
+	.dataKeyPath = @"tracks.data",
+	.pagingKeyPath = @"tracks",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchMoodStationWithStationID:(nonnull NSString *)stationID territory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit callback:(nonnull void (^)(KKRadioStation *_Nullable, NSArray <KKTrackInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/mood-stations/%@?territory=%@&offset=%ld&limit=%ld", ESCAPE(stationID), KKStringFromTerritoryCode(territory), (long) offset, (long) limit];
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, nil, error);
-			return;
-		}
-
-		NSMutableDictionary *stationDictionary = [[NSMutableDictionary alloc] init];
-		stationDictionary[@"id"] = dictionary[@"id"];
-		stationDictionary[@"name"] = dictionary[@"name"];
-		stationDictionary[@"images"] = dictionary[@"images"];
-
-		KKRadioStation *station = [[KKRadioStation alloc] initWithDictionary:stationDictionary];
-
-		NSMutableArray *tracks = [[NSMutableArray alloc] init];
-		if ([dictionary[@"tracks"][@"data"] isKindOfClass:[NSArray class]]) {
-			for (NSDictionary *playlistDictionary in dictionary[@"tracks"][@"data"]) {
-				KKTrackInfo *radioStation = [[KKTrackInfo alloc] initWithDictionary:playlistDictionary];
-				[tracks addObject:radioStation];
-			}
-		}
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"tracks"][@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"tracks"][@"summary"]];
-		inCallback(station, tracks, paging, summary, nil);
-	};
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKMoodStationEndpoint ID:stationID parameters:nil territory:territory offset:offset limit:limit callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.object, result.objects, result.paging, result.summary, error);
+	}];
 }
 
 #pragma mark Genre Station
 
+static const KKEndpointDescriptor KKGenreStationsEndpoint = {
+	.pathTemplate = @"genre-stations",
+	.shape = KKEndpointShapeList,
+	.modelClassName = KK_MODEL(KKRadioStation),
+	.dataKeyPath = @"data",
+	.pagingKeyPath = @"",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchGenreStationsForTerritory:(KKTerritoryCode)territory callback:(nonnull void (^)(NSArray <KKRadioStation *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/genre-stations?territory=%@", KKStringFromTerritoryCode(territory)];
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, error);
-			return;
-		}
-
-		NSMutableArray *stations = [[NSMutableArray alloc] init];
-		if ([dictionary[@"data"] isKindOfClass:[NSArray class]]) {
-			for (NSDictionary *playlistDictionary in dictionary[@"data"]) {
-				KKRadioStation *radioStation = [[KKRadioStation alloc] initWithDictionary:playlistDictionary];
-				[stations addObject:radioStation];
-			}
-		}
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"summary"]];
-		inCallback(stations, paging, summary, nil);
-	};
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKGenreStationsEndpoint ID:nil parameters:nil territory:territory offset:0 limit:0 callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.objects, result.paging, result.summary, error);
+	}];
 }
 
 - (nonnull NSURLSessionDataTask *)fetchGenreStationWithStationID:(nonnull NSString *)stationID territory:(KKTerritoryCode)territory callback:(nonnull void (^)(KKRadioStation *_Nullable, NSArray<KKTrackInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
@@ -623,34 +576,21 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 	return [self fetchGenreStationWithStationID:stationID territory:territory offset:0 limit:100 callback:inCallback];
 }
 
+static const KKEndpointDescriptor KKGenreStationEndpoint = {
+	.pathTemplate = @"genre-stations/{id}",
+	.paged = YES,
+	.shape = KKEndpointShapeContainerAndList,
+	.modelClassName = KK_MODEL(KKTrackInfo),
+	.containerClassName = KK_MODEL(KKRadioStation),
+	.dataKeyPath = @"tracks.data",
+	.pagingKeyPath = @"tracks",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchGenreStationWithStationID:(nonnull NSString *)stationID territory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit callback:(nonnull void (^)(KKRadioStation *_Nullable, NSArray <KKTrackInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/genre-stations/%@?territory=%@&offset=%ld&limit=%ld", ESCAPE(stationID), KKStringFromTerritoryCode(territory), (long) offset, (long) limit];
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, nil, error);
-			return;
-		}
-
-		NSMutableDictionary *stationDictionary = [[NSMutableDictionary alloc] init];
-		stationDictionary[@"id"] = dictionary[@"id"];
-		stationDictionary[@"name"] = dictionary[@"name"];
-		stationDictionary[@"images"] = dictionary[@"images"];
-
-		KKRadioStation *station = [[KKRadioStation alloc] initWithDictionary:stationDictionary];
-
-		NSMutableArray *tracks = [[NSMutableArray alloc] init];
-		if ([dictionary[@"tracks"][@"data"] isKindOfClass:[NSArray class]]) {
-			for (NSDictionary *playlistDictionary in dictionary[@"tracks"][@"data"]) {
-				KKTrackInfo *raioStation = [[KKTrackInfo alloc] initWithDictionary:playlistDictionary];
-				[tracks addObject:raioStation];
-			}
-		}
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"tracks"][@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"tracks"][@"summary"]];
-		inCallback(station, tracks, paging, summary, nil);
-	};
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKGenreStationEndpoint ID:stationID parameters:nil territory:territory offset:offset limit:limit callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.object, result.objects, result.paging, result.summary, error);
+	}];
 }
 
 #pragma mark - Search
@@ -661,6 +601,13 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 	return [self searchWithKeyword:keyword searchTypes:searchTypes territory:territory offset:0 limit:50 callback:inCallback];
 }
 
+static const KKEndpointDescriptor KKSearchEndpoint = {
+	.pathTemplate = @"search",
+	.paged = YES,
+	.shape = KKEndpointShapeObject,
+	.modelClassName = KK_MODEL(KKSearchResults),
+};
+
 - (nonnull NSURLSessionDataTask *)searchWithKeyword:(nonnull NSString *)keyword searchTypes:(KKSearchType)searchTypes territory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit callback:(nonnull void (^)(KKSearchResults *_Nullable, NSError *_Nullable))inCallback
 {
 	NSParameterAssert(keyword);
@@ -677,21 +624,13 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 	if (searchTypes & KKSearchTypePlaylist) {
 		[types addObject:@"playlist"];
 	}
-	NSMutableString *URLString = [NSMutableString stringWithFormat:@"https://api.kkbox.com/v1.1/search?q=%@&offset=%ld&limit=%ld", ESCAPE_ARG(keyword), (long) offset, (long) limit];
+	NSMutableDictionary<NSString *, NSString *> *parameters = [NSMutableDictionary dictionaryWithObject:keyword forKey:@"q"];
 	if ([types count] > 0) {
-		[URLString appendFormat:@"&type=%@", [types componentsJoinedByString:@","]];
+		parameters[@"type"] = [types componentsJoinedByString:@","];
 	}
-	[URLString appendFormat:@"&territory=%@", KKStringFromTerritoryCode(territory)];
-
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, error);
-			return;
-		}
-		KKSearchResults *results = [[KKSearchResults alloc] initWithDictionary:dictionary];
-		inCallback(results, nil);
-	};
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKSearchEndpoint ID:nil parameters:parameters territory:territory offset:offset limit:limit callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.object, error);
+	}];
 }
 
 #pragma mark - New Releases
@@ -701,27 +640,20 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 	return [self fetchNewReleaseAlbumCategoriesForTerritory:territory offset:0 limit:100 callback:inCallback];
 }
 
+static const KKEndpointDescriptor KKNewReleaseCategoriesEndpoint = {
+	.pathTemplate = @"new-release-categories",
+	.paged = YES,
+	.shape = KKEndpointShapeList,
+	.modelClassName = KK_MODEL(KKNewReleaseAlbumsCategory),
+	.dataKeyPath = @"data",
+	.pagingKeyPath = @"",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchNewReleaseAlbumCategoriesForTerritory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit callback:(nonnull void (^)(NSArray <KKNewReleaseAlbumsCategory *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/new-release-categories?territory=%@&offset=%ld&limit=%ld", KKStringFromTerritoryCode(territory), (long) offset, (long) limit];
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, error);
-			return;
-		}
-
-		NSMutableArray *categories = [[NSMutableArray alloc] init];
-		if ([dictionary[@"data"] isKindOfClass:[NSArray class]]) {
-			for (NSDictionary *categoryDictionary in dictionary[@"data"]) {
-				KKNewReleaseAlbumsCategory *category = [[KKNewReleaseAlbumsCategory alloc] initWithDictionary:categoryDictionary];
-				[categories addObject:category];
-			}
-		}
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"summary"]];
-		inCallback(categories, paging, summary, nil);
-	};
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKNewReleaseCategoriesEndpoint ID:nil parameters:nil territory:territory offset:offset limit:limit callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.objects, result.paging, result.summary, error);
+	}];
 }
 
 - (nonnull NSURLSessionDataTask *)fetchNewReleaseAlbumsUnderCategory:(nonnull NSString *)categoryID territory:(KKTerritoryCode)territory callback:(nonnull void (^)(KKNewReleaseAlbumsCategory *_Nullable, NSArray
@@ -731,36 +663,23 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 	return [self fetchNewReleaseAlbumsUnderCategory:categoryID territory:territory offset:0 limit:200 callback:inCallback];
 }
 
+const KKEndpointDescriptor KKNewReleaseCategoryEndpoint = {
+	.pathTemplate = @"new-release-categories/{id}",
+	.paged = YES,
+	.shape = KKEndpointShapeContainerAndList,
+	.modelClassName = KK_MODEL(KKAlbumInfo),
+	.containerClassName = KK_MODEL(KKNewReleaseAlbumsCategory),
+	.dataKeyPath = @"albums.data",
+	.pagingKeyPath = @"albums",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchNewReleaseAlbumsUnderCategory:(nonnull NSString *)categoryID territory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit callback:(nonnull void (^)(KKNewReleaseAlbumsCategory *_Nullable, NSArray
 
 <KKAlbumInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/new-release-categories/%@?territory=%@&offset=%ld&limit=%ld", categoryID, KKStringFromTerritoryCode(territory), (long) offset, (long) limit];
-
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, nil, error);
-			return;
-		}
-
-		NSMutableDictionary *categoryDictionary = [[NSMutableDictionary alloc] init];
-		categoryDictionary[@"id"] = dictionary[@"id"];
-		categoryDictionary[@"title"] = dictionary[@"title"];
-		KKNewReleaseAlbumsCategory *category = [[KKNewReleaseAlbumsCategory alloc] initWithDictionary:categoryDictionary];
-
-		NSMutableArray *albums = [[NSMutableArray alloc] init];
-		if ([dictionary[@"albums"][@"data"] isKindOfClass:[NSArray class]]) {
-			for (NSDictionary *albumDictionary in dictionary[@"albums"][@"data"]) {
-				KKAlbumInfo *category = [[KKAlbumInfo alloc] initWithDictionary:albumDictionary];
-				[albums addObject:category];
-			}
-		}
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"albums"][@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"albums"][@"summary"]];
-		inCallback(category, albums, paging, summary, nil);
-	};
-
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKNewReleaseCategoryEndpoint ID:categoryID parameters:nil territory:territory offset:offset limit:limit callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.object, result.objects, result.paging, result.summary, error);
+	}];
 }
 
 #pragma mark - Charts
@@ -770,75 +689,51 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 	return [self fetchChartsForTerritory:territory offset:0 limit:50 callback:callback];
 }
 
+static const KKEndpointDescriptor KKChartsEndpoint = {
+	.pathTemplate = @"charts",
+	.paged = YES,
+	.shape = KKEndpointShapeList,
+	.modelClassName = KK_MODEL(KKPlaylistInfo),
+	.dataKeyPath = @"data",
+	.pagingKeyPath = @"",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchChartsForTerritory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit callback:(nonnull void (^)(NSArray <KKPlaylistInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/charts?territory=%@&offset=%ld&limit=%ld", KKStringFromTerritoryCode(territory), (long) offset, (long) limit];
-
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, error);
-			return;
-		}
-
-		NSMutableArray *playlists = [[NSMutableArray alloc] init];
-		if ([dictionary[@"data"] isKindOfClass:[NSArray class]]) {
-			for (NSDictionary *playlistDictionary in dictionary[@"data"]) {
-				KKPlaylistInfo *category = [[KKPlaylistInfo alloc] initWithDictionary:playlistDictionary];
-				[playlists addObject:category];
-			}
-		}
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"summary"]];
-		inCallback(playlists, paging, summary, nil);
-	};
-
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKChartsEndpoint ID:nil parameters:nil territory:territory offset:offset limit:limit callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.objects, result.paging, result.summary, error);
+	}];
 }
 
 #pragma mark - Children Contents
 
+static const KKEndpointDescriptor KKChildrenCategoriesEndpoint = {
+	.pathTemplate = @"children-categories",
+	.shape = KKEndpointShapeList,
+	.modelClassName = KK_MODEL(KKChildrenCategory),
+	.dataKeyPath = @"data",
+	.pagingKeyPath = @"",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchChildrenCategories:(KKTerritoryCode)territory callback:(nonnull void (^)(NSArray <KKChildrenCategory *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/children-categories?territory=%@", KKStringFromTerritoryCode(territory)];
-
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, error);
-			return;
-		}
-
-		NSMutableArray *categories = [[NSMutableArray alloc] init];
-		if ([dictionary[@"data"] isKindOfClass:[NSArray class]]) {
-			for (NSDictionary *playlistDictionary in dictionary[@"data"]) {
-				KKChildrenCategory *category = [[KKChildrenCategory alloc] initWithDictionary:playlistDictionary];
-				[categories addObject:category];
-			}
-		}
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"summary"]];
-		inCallback(categories, paging, summary, nil);
-	};
-
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKChildrenCategoriesEndpoint ID:nil parameters:nil territory:territory offset:0 limit:0 callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.objects, result.paging, result.summary, error);
+	}];
 }
 
+static const KKEndpointDescriptor KKChildrenCategoryEndpoint = {
+	.pathTemplate = @"children-categories/{id}",
+	.shape = KKEndpointShapeObject,
+	.modelClassName = KK_MODEL(KKChildrenCategoryGroup),
+	.pagingKeyPath = @"",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchChildrenCategory:(nonnull NSString *)categoryID territory:(KKTerritoryCode)territory callback:(nonnull void (^)(KKChildrenCategoryGroup *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/children-categories/%@?territory=%@", categoryID, KKStringFromTerritoryCode(territory)];
-
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, error);
-			return;
-		}
-
-		KKChildrenCategoryGroup *group = [[KKChildrenCategoryGroup alloc] initWithDictionary:dictionary];
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"summary"]];
-		inCallback(group, paging, summary, nil);
-	};
-
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKChildrenCategoryEndpoint ID:categoryID parameters:nil territory:territory offset:0 limit:0 callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.object, result.paging, result.summary, error);
+	}];
 }
 
 - (nonnull NSURLSessionDataTask *)fetchChildrenCategoryPlaylists:(nonnull NSString *)categoryID territory:(KKTerritoryCode)territory callback:(nonnull void (^)(NSArray <KKPlaylistInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))callback
@@ -846,31 +741,21 @@ NSString *const KKBOXOpenAPIDidRestoreAccessTokenNotification = @"KKBOXOpenAPIDi
 	return [self fetchChildrenCategoryPlaylists:categoryID territory:territory offset:0 limit:100 callback:callback];
 }
 
+const KKEndpointDescriptor KKChildrenCategoryPlaylistsEndpoint = {
+	.pathTemplate = @"children-categories/{id}/playlists",
+	.paged = YES,
+	.shape = KKEndpointShapeList,
+	.modelClassName = KK_MODEL(KKPlaylistInfo),
+	.dataKeyPath = @"data",
+	.pagingKeyPath = @"",
+};
+
 - (nonnull NSURLSessionDataTask *)fetchChildrenCategoryPlaylists:(nonnull NSString *)categoryID territory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit callback:(nonnull void (^)(NSArray <KKPlaylistInfo *> *_Nullable, KKPagingInfo *_Nullable, KKSummary *_Nullable, NSError *_Nullable))inCallback
 {
-	NSString *URLString = [NSString stringWithFormat:@"https://api.kkbox.com/v1.1/children-categories/%@/playlists?territory=%@", categoryID, KKStringFromTerritoryCode(territory)];
-
-	KKBOXOpenAPIDataCallback callback = ^(NSDictionary *dictionary, NSError *error) {
-		if (error) {
-			inCallback(nil, nil, nil, error);
-			return;
-		}
-
-		NSMutableArray *playlists = [[NSMutableArray alloc] init];
-		if ([dictionary[@"data"] isKindOfClass:[NSArray class]]) {
-			for (NSDictionary *playlistDictionary in dictionary[@"data"]) {
-				KKPlaylistInfo *category = [[KKPlaylistInfo alloc] initWithDictionary:playlistDictionary];
-				[playlists addObject:category];
-			}
-		}
-		KKPagingInfo *paging = [[KKPagingInfo alloc] initWithDictionary:dictionary[@"paging"]];
-		KKSummary *summary = [[KKSummary alloc] initWithDictionary:dictionary[@"summary"]];
-		inCallback(playlists, paging, summary, nil);
-	};
-
-	return CALL_API;
+	return [self _taskWithEndpoint:&KKChildrenCategoryPlaylistsEndpoint ID:categoryID parameters:nil territory:territory offset:offset limit:limit callback:^(KKEndpointResult *result, NSError *error) {
+		inCallback(result.objects, result.paging, result.summary, error);
+	}];
 }
 
 @end
 
-#undef CALL_API
@@ -0,0 +1,547 @@
+//
+// OpenAPIBinaryArchive.m
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+#import "OpenAPIBinaryArchive.h"
+#import "OpenAPI+Privates.h"
+
+const NSUInteger KKBinaryArchiveVersion = 1;
+
+static const uint8_t KKBinaryArchiveMagic[4] = {'K', 'K', 'B', 'A'};
+/** Nested arrays and dictionaries deeper than this are malformed. */
+static const NSUInteger KKBinaryArchiveMaximumDepth = 64;
+
+typedef NS_ENUM(uint8_t, KKBinaryTag)
+{
+	KKBinaryTagNull,
+	KKBinaryTagFalse,
+	KKBinaryTagTrue,
+	/** Followed by a varint. */
+	KKBinaryTagInteger,
+	/** Followed by a varint of `-1 - value`. */
+	KKBinaryTagNegativeInteger,
+	/** Followed by 8 bytes, little-endian. */
+	KKBinaryTagDouble,
+	/** Followed by the varint index of the string. */
+	KKBinaryTagString,
+	/** Followed by the varint count and the values. */
+	KKBinaryTagArray,
+	/** Followed by the varint count and the pairs of key indexes and values. */
+	KKBinaryTagDictionary,
+	/** An array of territory codes like `["TW", "HK"]`, followed by a varint `KKTerritoryMask`. */
+	KKBinaryTagTerritories,
+};
+
+typedef NS_OPTIONS(uint8_t, KKBinaryRecordFlags)
+{
+	KKBinaryRecordFlagStale = 1 << 0,
+};
+
+static NSError *KKBinaryArchiveError(NSString *description)
+{
+	return [NSError errorWithDomain:KKBOXOpenAPIErrorDomain code:5 userInfo:@{NSLocalizedDescriptionKey: description}];
+}
+
+#pragma mark - Writing
+
+static void KKAppendVarint(NSMutableData *data, uint64_t value)
+{
+	uint8_t buffer[10];
+	NSUInteger length = 0;
+	while (value >= 0x80) {
+		buffer[length++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	buffer[length++] = (uint8_t)value;
+	[data appendBytes:buffer length:length];
+}
+
+static void KKAppendByte(NSMutableData *data, uint8_t byte)
+{
+	[data appendBytes:&byte length:1];
+}
+
+/** The mask of an array of distinct territory codes in the order of `KKTerritoryCode`, or 0 if it is not one. */
+static KKTerritoryMask KKTerritoryMaskOfArray(NSArray *array)
+{
+	KKTerritoryMask mask = KKTerritoryMaskNone;
+	NSInteger lastCode = -1;
+	for (id item in array) {
+		if (![item isKindOfClass:[NSString class]]) {
+			return KKTerritoryMaskNone;
+		}
+		NSInteger code = lastCode + 1;
+		while (code <= (NSInteger)KKTerritoryCodeJapan && ![KKStringFromTerritoryCode(code) isEqualToString:item]) {
+			code++;
+		}
+		if (code > (NSInteger)KKTerritoryCodeJapan) {
+			return KKTerritoryMaskNone;
+		}
+		mask |= 1 << code;
+		lastCode = code;
+	}
+	return mask;
+}
+
+@interface KKBinaryArchiveWriter ()
+@property (strong, nonatomic) NSMutableDictionary <NSString *, NSNumber *> *stringIndexes;
+@property (strong, nonatomic) NSMutableArray <NSString *> *mutableStrings;
+@property (strong, nonatomic) NSMutableData *mutableRecords;
+@property (strong, nonatomic) NSMutableArray <NSNumber *> *mutableRecordLengths;
+@end
+
+@implementation KKBinaryArchiveWriter
+
+- (instancetype)init
+{
+	self = [super init];
+	if (self) {
+		self.stringIndexes = [NSMutableDictionary dictionary];
+		self.mutableStrings = [NSMutableArray array];
+		self.mutableRecords = [NSMutableData data];
+		self.mutableRecordLengths = [NSMutableArray array];
+	}
+	return self;
+}
+
+- (NSArray <NSString *> *)strings
+{
+	return self.mutableStrings;
+}
+
+- (NSData *)records
+{
+	return self.mutableRecords;
+}
+
+- (NSArray <NSNumber *> *)recordLengths
+{
+	return self.mutableRecordLengths;
+}
+
+- (NSUInteger)indexOfString:(NSString *)string
+{
+	NSNumber *index = self.stringIndexes[string];
+	if (!index) {
+		index = @(self.mutableStrings.count);
+		self.stringIndexes[string] = index;
+		[self.mutableStrings addObject:string];
+	}
+	return index.unsignedIntegerValue;
+}
+
+- (void)appendString:(NSString *)string toData:(NSMutableData *)data
+{
+	KKAppendVarint(data, [self indexOfString:string]);
+}
+
+- (void)appendValue:(id)value toData:(NSMutableData *)data
+{
+	if ([value isKindOfClass:[NSString class]]) {
+		KKAppendByte(data, KKBinaryTagString);
+		[self appendString:value toData:data];
+	}
+	else if ([value isKindOfClass:[NSNumber class]]) {
+		NSNumber *number = value;
+		if (CFGetTypeID((__bridge CFTypeRef)number) == CFBooleanGetTypeID()) {
+			KKAppendByte(data, number.boolValue ? KKBinaryTagTrue : KKBinaryTagFalse);
+		}
+		else if (CFNumberIsFloatType((__bridge CFNumberRef)number)) {
+			double doubleValue = number.doubleValue;
+			uint64_t bits;
+			memcpy(&bits, &doubleValue, sizeof(bits));
+			bits = CFSwapInt64HostToLittle(bits);
+			KKAppendByte(data, KKBinaryTagDouble);
+			[data appendBytes:&bits length:sizeof(bits)];
+		}
+		else if (number.longLongValue < 0) {
+			KKAppendByte(data, KKBinaryTagNegativeInteger);
+			KKAppendVarint(data, (uint64_t)(-1 - number.longLongValue));
+		}
+		else {
+			KKAppendByte(data, KKBinaryTagInteger);
+			KKAppendVarint(data, number.unsignedLongLongValue);
+		}
+	}
+	else if ([value isKindOfClass:[NSDictionary class]]) {
+		NSDictionary *dictionary = value;
+		NSMutableData *pairs = [NSMutableData data];
+		__block NSUInteger count = 0;
+		[dictionary enumerateKeysAndObjectsUsingBlock:^(id key, id object, BOOL *stop) {
+			if ([key isKindOfClass:[NSString class]]) {
+				[self appendString:key toData:pairs];
+				[self appendValue:object toData:pairs];
+				count++;
+			}
+		}];
+		KKAppendByte(data, KKBinaryTagDictionary);
+		KKAppendVarint(data, count);
+		[data appendData:pairs];
+	}
+	else if ([value isKindOfClass:[NSArray class]]) {
+		NSArray *array = value;
+		KKTerritoryMask mask = KKTerritoryMaskOfArray(array);
+		if (mask != KKTerritoryMaskNone) {
+			KKAppendByte(data, KKBinaryTagTerritories);
+			KKAppendVarint(data, mask);
+			return;
+		}
+		KKAppendByte(data, KKBinaryTagArray);
+		KKAppendVarint(data, array.count);
+		for (id item in array) {
+			[self appendValue:item toData:data];
+		}
+	}
+	else {
+		KKAppendByte(data, KKBinaryTagNull);
+	}
+}
+
+- (NSUInteger)appendObject:(KKBOXOpenAPIObject *)object
+{
+	NSUInteger start = self.mutableRecords.length;
+	[self appendString:NSStringFromClass([object class]) toData:self.mutableRecords];
+	KKAppendByte(self.mutableRecords, object.isStale ? KKBinaryRecordFlagStale : 0);
+	[self appendValue:object.dictionary ?: @{} toData:self.mutableRecords];
+	[self.mutableRecordLengths addObject:@(self.mutableRecords.length - start)];
+	return self.mutableRecordLengths.count - 1;
+}
+
+- (NSData *)archivedData
+{
+	NSMutableData *data = [NSMutableData dataWithCapacity:self.mutableRecords.length + self.mutableStrings.count * 16 + self.mutableRecordLengths.count * 2 + 16];
+	[data appendBytes:KKBinaryArchiveMagic length:sizeof(KKBinaryArchiveMagic)];
+	KKAppendVarint(data, KKBinaryArchiveVersion);
+	KKAppendVarint(data, self.mutableStrings.count);
+	for (NSString *string in self.mutableStrings) {
+		NSUInteger length = [string lengthOfBytesUsingEncoding:NSUTF8StringEncoding];
+		KKAppendVarint(data, length);
+		NSUInteger offset = data.length;
+		[data increaseLengthBy:length];
+		[string getBytes:(uint8_t *)data.mutableBytes + offset maxLength:length usedLength:NULL encoding:NSUTF8StringEncoding options:0 range:NSMakeRange(0, string.length) remainingRange:NULL];
+	}
+	KKAppendVarint(data, self.mutableRecordLengths.count);
+	const uint8_t *records = self.mutableRecords.bytes;
+	for (NSNumber *length in self.mutableRecordLengths) {
+		KKAppendVarint(data, length.unsignedIntegerValue);
+		[data appendBytes:records length:length.unsignedIntegerValue];
+		records += length.unsignedIntegerValue;
+	}
+	return data;
+}
+
+@end
+
+#pragma mark - Reading
+
+typedef struct
+{
+	const uint8_t *bytes;
+	NSUInteger length;
+	NSUInteger position;
+	BOOL failed;
+} KKBinaryCursor;
+
+static uint64_t KKReadVarint(KKBinaryCursor *cursor)
+{
+	uint64_t value = 0;
+	for (unsigned shift = 0; shift < 64 && cursor->position < cursor->length; shift += 7) {
+		uint8_t byte = cursor->bytes[cursor->position++];
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) {
+			return value;
+		}
+	}
+	cursor->failed = YES;
+	return 0;
+}
+
+static uint8_t KKReadByte(KKBinaryCursor *cursor)
+{
+	if (cursor->position >= cursor->length) {
+		cursor->failed = YES;
+		return 0;
+	}
+	return cursor->bytes[cursor->position++];
+}
+
+/** Read a length and skip that many bytes, appending their range to a table of KKBinaryRange. */
+static void KKReadLengthPrefixedRange(KKBinaryCursor *cursor, NSMutableData *table)
+{
+	uint64_t length = KKReadVarint(cursor);
+	if (cursor->failed || length > cursor->length - cursor->position) {
+		cursor->failed = YES;
+		return;
+	}
+	KKBinaryRange range = {CFSwapInt32HostToLittle((uint32_t)cursor->position), CFSwapInt32HostToLittle((uint32_t)length)};
+	[table appendBytes:&range length:sizeof(range)];
+	cursor->position += (NSUInteger)length;
+}
+
+/** Read a count and then that many length-prefixed entries. */
+static void KKReadLengthPrefixedRanges(KKBinaryCursor *cursor, NSMutableData *table)
+{
+	uint64_t count = KKReadVarint(cursor);
+	// Every entry takes at least one byte, which bounds the count
+	// before anything is allocated.
+	if (cursor->failed || count > cursor->length - cursor->position) {
+		cursor->failed = YES;
+		return;
+	}
+	for (uint64_t i = 0; i < count && !cursor->failed; i++) {
+		KKReadLengthPrefixedRange(cursor, table);
+	}
+}
+
+BOOL KKBinaryRangeAtIndex(NSData *table, NSUInteger index, NSUInteger dataLength, NSRange *range)
+{
+	if (index >= table.length / sizeof(KKBinaryRange)) {
+		return NO;
+	}
+	KKBinaryRange entry;
+	memcpy(&entry, (const uint8_t *)table.bytes + index * sizeof(KKBinaryRange), sizeof(entry));
+	NSUInteger location = CFSwapInt32LittleToHost(entry.location);
+	NSUInteger length = CFSwapInt32LittleToHost(entry.length);
+	if (location > dataLength || length > dataLength - location) {
+		return NO;
+	}
+	*range = NSMakeRange(location, length);
+	return YES;
+}
+
+@interface KKBinaryArchive ()
+@property (strong, nonatomic) NSData *data;
+@property (strong, nonatomic) NSData *stringRanges;
+@property (strong, nonatomic) NSData *objectRanges;
+@property (assign, nonatomic) NSUInteger version;
+/** The strings read so far, keyed by their indexes. Guarded by itself. */
+@property (strong, nonatomic) NSMutableDictionary <NSNumber *, NSString *> *strings;
+@end
+
+@implementation KKBinaryArchive
+
++ (NSData *)archivedDataWithObjects:(NSArray <KKBOXOpenAPIObject *> *)objects
+{
+	KKBinaryArchiveWriter *writer = [[KKBinaryArchiveWriter alloc] init];
+	for (KKBOXOpenAPIObject *object in objects) {
+		[writer appendObject:object];
+	}
+	return [writer archivedData];
+}
+
+- (instancetype)_initWithData:(NSData *)data stringRanges:(NSData *)stringRanges objectRanges:(NSData *)objectRanges version:(NSUInteger)version
+{
+	self = [super init];
+	if (self) {
+		self.data = data;
+		self.stringRanges = stringRanges;
+		self.objectRanges = objectRanges;
+		self.version = version;
+		self.strings = [NSMutableDictionary dictionary];
+	}
+	return self;
+}
+
+- (instancetype)initWithData:(NSData *)data error:(NSError **)error
+{
+	if (data.length < sizeof(KKBinaryArchiveMagic) || memcmp(data.bytes, KKBinaryArchiveMagic, sizeof(KKBinaryArchiveMagic)) != 0) {
+		if (error) {
+			*error = KKBinaryArchiveError(@"The data is not a binary archive");
+		}
+		return nil;
+	}
+	KKBinaryCursor cursor = {data.bytes, data.length, sizeof(KKBinaryArchiveMagic), NO};
+	uint64_t version = KKReadVarint(&cursor);
+	if (!cursor.failed && version > KKBinaryArchiveVersion) {
+		if (error) {
+			*error = KKBinaryArchiveError(@"The binary archive is written in a newer version of the format");
+		}
+		return nil;
+	}
+	NSMutableData *stringRanges = [NSMutableData data];
+	NSMutableData *objectRanges = [NSMutableData data];
+	KKReadLengthPrefixedRanges(&cursor, stringRanges);
+	KKReadLengthPrefixedRanges(&cursor, objectRanges);
+	if (cursor.failed || version == 0 || data.length > UINT32_MAX) {
+		if (error) {
+			*error = KKBinaryArchiveError(@"The binary archive is malformed");
+		}
+		return nil;
+	}
+	return [self _initWithData:data stringRanges:stringRanges objectRanges:objectRanges version:(NSUInteger)version];
+}
+
+- (instancetype)initWithContentsOfURL:(NSURL *)URL error:(NSError **)error
+{
+	NSData *data = [NSData dataWithContentsOfURL:URL options:NSDataReadingMappedIfSafe error:error];
+	if (!data) {
+		return nil;
+	}
+	return [self initWithData:data error:error];
+}
+
+- (NSUInteger)count
+{
+	return self.objectRanges.length / sizeof(KKBinaryRange);
+}
+
+- (KKBOXOpenAPIObject *)objectAtIndex:(NSUInteger)index
+{
+	NSString *className = nil;
+	NSDictionary *dictionary = [self _dictionaryAtIndex:index className:&className];
+	Class objectClass = className ? NSClassFromString(className) : Nil;
+	if (!dictionary || ![objectClass isSubclassOfClass:[KKBOXOpenAPIObject class]]) {
+		return nil;
+	}
+	return [[objectClass alloc] initWithDictionary:dictionary];
+}
+
+- (NSArray <KKBOXOpenAPIObject *> *)objects
+{
+	NSMutableArray *objects = [NSMutableArray arrayWithCapacity:self.count];
+	for (NSUInteger i = 0; i < self.count; i++) {
+		KKBOXOpenAPIObject *object = [self objectAtIndex:i];
+		if (object) {
+			[objects addObject:object];
+		}
+	}
+	return objects;
+}
+
+- (NSDictionary *)_dictionaryAtIndex:(NSUInteger)index className:(NSString **)className
+{
+	NSRange range;
+	if (!KKBinaryRangeAtIndex(self.objectRanges, index, self.data.length, &range)) {
+		return nil;
+	}
+	KKBinaryCursor cursor = {(const uint8_t *)self.data.bytes + range.location, range.length, 0, NO};
+	id dictionary = nil;
+	@synchronized (self.strings) {
+		NSString *name = [self _readStringWithCursor:&cursor];
+		uint8_t flags = KKReadByte(&cursor);
+		dictionary = [self _readValueWithCursor:&cursor depth:0];
+		if (cursor.failed || ![dictionary isKindOfClass:[NSDictionary class]]) {
+			return nil;
+		}
+		if (flags & KKBinaryRecordFlagStale) {
+			dictionary = KKStaleCopyOfJSONObject(dictionary);
+		}
+		if (className) {
+			*className = name;
+		}
+	}
+	return dictionary;
+}
+
+- (NSString *)_readStringWithCursor:(KKBinaryCursor *)cursor
+{
+	uint64_t index = KKReadVarint(cursor);
+	NSRange range;
+	if (cursor->failed || !KKBinaryRangeAtIndex(self.stringRanges, (NSUInteger)index, self.data.length, &range)) {
+		cursor->failed = YES;
+		return nil;
+	}
+	NSString *string = self.strings[@(index)];
+	if (!string) {
+		string = [[NSString alloc] initWithBytes:(const uint8_t *)self.data.bytes + range.location length:range.length encoding:NSUTF8StringEncoding];
+		if (!string) {
+			cursor->failed = YES;
+			return nil;
+		}
+		self.strings[@(index)] = string;
+	}
+	return string;
+}
+
+- (id)_readValueWithCursor:(KKBinaryCursor *)cursor depth:(NSUInteger)depth
+{
+	if (depth > KKBinaryArchiveMaximumDepth) {
+		cursor->failed = YES;
+		return nil;
+	}
+	switch (KKReadByte(cursor)) {
+		case KKBinaryTagNull:
+			return [NSNull null];
+		case KKBinaryTagFalse:
+			return @NO;
+		case KKBinaryTagTrue:
+			return @YES;
+		case KKBinaryTagInteger: {
+			uint64_t value = KKReadVarint(cursor);
+			return value <= LLONG_MAX ? @((long long)value) : @(value);
+		}
+		case KKBinaryTagNegativeInteger: {
+			uint64_t value = KKReadVarint(cursor);
+			if (value > LLONG_MAX) {
+				cursor->failed = YES;
+				return nil;
+			}
+			return @(-1 - (long long)value);
+		}
+		case KKBinaryTagDouble: {
+			if (cursor->length - cursor->position < sizeof(uint64_t)) {
+				cursor->failed = YES;
+				return nil;
+			}
+			uint64_t bits;
+			memcpy(&bits, cursor->bytes + cursor->position, sizeof(bits));
+			cursor->position += sizeof(bits);
+			bits = CFSwapInt64LittleToHost(bits);
+			double value;
+			memcpy(&value, &bits, sizeof(value));
+			return @(value);
+		}
+		case KKBinaryTagString:
+			return [self _readStringWithCursor:cursor];
+		case KKBinaryTagArray: {
+			uint64_t count = KKReadVarint(cursor);
+			if (cursor->failed || count > cursor->length - cursor->position) {
+				cursor->failed = YES;
+				return nil;
+			}
+			NSMutableArray *array = [[NSMutableArray alloc] initWithCapacity:(NSUInteger)count];
+			for (uint64_t i = 0; i < count; i++) {
+				id item = [self _readValueWithCursor:cursor depth:depth + 1];
+				if (cursor->failed) {
+					return nil;
+				}
+				[array addObject:item];
+			}
+			return array;
+		}
+		case KKBinaryTagDictionary: {
+			uint64_t count = KKReadVarint(cursor);
+			if (cursor->failed || count > (cursor->length - cursor->position) / 2) {
+				cursor->failed = YES;
+				return nil;
+			}
+			NSMutableDictionary *dictionary = [[NSMutableDictionary alloc] initWithCapacity:(NSUInteger)count];
+			for (uint64_t i = 0; i < count; i++) {
+				NSString *key = [self _readStringWithCursor:cursor];
+				id value = [self _readValueWithCursor:cursor depth:depth + 1];
+				if (cursor->failed) {
+					return nil;
+				}
+				dictionary[key] = value;
+			}
+			return dictionary;
+		}
+		case KKBinaryTagTerritories: {
+			uint64_t mask = KKReadVarint(cursor);
+			NSMutableArray *territories = [NSMutableArray array];
+			for (KKTerritoryCode code = KKTerritoryCodeTaiwan; code <= KKTerritoryCodeJapan; code++) {
+				if (mask & (1 << code)) {
+					[territories addObject:KKStringFromTerritoryCode(code)];
+				}
+			}
+			return territories;
+		}
+		default:
+			cursor->failed = YES;
+			return nil;
+	}
+}
+
+@end
@@ -0,0 +1,652 @@
+//
+// OpenAPIBulkDownload.m
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+#import "OpenAPIBulkDownload.h"
+#import "OpenAPI+Privates.h"
+#import <objc/runtime.h>
+
+static NSString *const KKBulkManifestFileName = @"manifest.plist";
+static NSString *const KKBulkPageFileName = @"page.json";
+static NSString *const KKBulkManifestVersionKey = @"version";
+static NSString *const KKBulkManifestListsKey = @"lists";
+static NSString *const KKBulkListKindKey = @"list";
+static NSString *const KKBulkListIDKey = @"id";
+static NSString *const KKBulkListTerritoryKey = @"territory";
+static NSString *const KKBulkListOffsetKey = @"offset";
+static NSString *const KKBulkListTotalKey = @"total";
+static NSString *const KKBulkListFinishedKey = @"finished";
+static NSString *const KKBulkListResumeDataKey = @"resume_data";
+static const NSInteger KKBulkManifestVersion = 1;
+static const NSUInteger KKBulkReadLength = 64 * 1024;
+
+static const KKEndpointDescriptor *KKEndpointForBulkDownloadList(KKBulkDownloadList list)
+{
+	switch (list) {
+		case KKBulkDownloadListAlbumTracks:
+			return &KKAlbumTracksEndpoint;
+		case KKBulkDownloadListChildrenCategoryPlaylists:
+			return &KKChildrenCategoryPlaylistsEndpoint;
+		case KKBulkDownloadListNewReleaseAlbums:
+			return &KKNewReleaseCategoryEndpoint;
+	}
+	return NULL;
+}
+
+static NSError *KKBulkInvalidResponseError(void)
+{
+	return [NSError errorWithDomain:KKBOXOpenAPIErrorDomain code:1 userInfo:@{NSLocalizedDescriptionKey: @"Invalid response"}];
+}
+
+#pragma mark - Reader
+
+/** A container open at the current position of a JSON text. */
+@interface KKJSONReaderFrame : NSObject
+@property (assign, nonatomic) BOOL array;
+/** If the array is the list being read. */
+@property (assign, nonatomic) BOOL list;
+/** The key of the current member of an object. */
+@property (strong, nonatomic) NSString *key;
+@end
+
+@implementation KKJSONReaderFrame
+@end
+
+/**
+ * Reads the elements of the list at a key path of a JSON file one by
+ * one, without reading the rest of the file into memory. Only the
+ * bytes of one element, and of the value at a second key path, are
+ * collected and parsed at a time.
+ */
+@interface KKJSONListReader : NSObject
+- (instancetype)initWithListKeyPath:(NSString *)listKeyPath valueKeyPath:(NSString *)valueKeyPath;
+/**
+ * @param URL the file
+ * @param elementHandler called with every element of the list, in order
+ * @param value set to the value at the value key path, if any
+ * @param error set if the file cannot be read or is not JSON
+ * @return YES on success
+ */
+- (BOOL)readFileAtURL:(NSURL *)URL elementHandler:(void (^)(id element))elementHandler value:(id *)value error:(NSError **)error;
+@property (strong, nonatomic) NSArray<NSString *> *listPath;
+@property (strong, nonatomic) NSArray<NSString *> *valuePath;
+@end
+
+@implementation KKJSONListReader
+
+- (instancetype)initWithListKeyPath:(NSString *)listKeyPath valueKeyPath:(NSString *)valueKeyPath
+{
+	self = [super init];
+	if (self) {
+		self.listPath = [listKeyPath componentsSeparatedByString:@"."];
+		self.valuePath = [valueKeyPath componentsSeparatedByString:@"."];
+	}
+	return self;
+}
+
+/** If the value about to start is at a path, that is, if all the open containers are objects whose current keys spell the path. */
+static BOOL KKFramesMatchPath(NSArray<KKJSONReaderFrame *> *frames, NSArray<NSString *> *path)
+{
+	if (frames.count != path.count) {
+		return NO;
+	}
+	for (NSUInteger i = 0; i < path.count; i++) {
+		if (frames[i].array || ![frames[i].key isEqualToString:path[i]]) {
+			return NO;
+		}
+	}
+	return YES;
+}
+
+static NSString *KKKeyFromQuotedData(NSData *data)
+{
+	if (!memchr(data.bytes, '\\', data.length)) {
+		return [[NSString alloc] initWithBytes:(const uint8_t *)data.bytes + 1 length:data.length - 2 encoding:NSUTF8StringEncoding];
+	}
+	id key = [NSJSONSerialization JSONObjectWithData:data options:NSJSONReadingAllowFragments error:nil];
+	return [key isKindOfClass:[NSString class]] ? key : nil;
+}
+
+- (BOOL)readFileAtURL:(NSURL *)URL elementHandler:(void (^)(id element))elementHandler value:(id *)outValue error:(NSError **)outError
+{
+	NSInputStream *stream = [NSInputStream inputStreamWithURL:URL];
+	[stream open];
+	NSMutableData *buffer = [NSMutableData dataWithLength:KKBulkReadLength];
+	uint8_t *bytes = buffer.mutableBytes;
+
+	NSMutableArray<KKJSONReaderFrame *> *frames = [NSMutableArray array];
+	NSMutableData *key = [NSMutableData data];
+	// The bytes of the value being collected, nil if none is.
+	NSMutableData *capture = nil;
+	NSUInteger captureFrom = 0;
+	NSUInteger captureDepth = 0;
+	BOOL captureIsElement = NO;
+	BOOL inString = NO;
+	BOOL escaped = NO;
+	BOOL inKey = NO;
+	BOOL expectingKey = NO;
+	BOOL expectingValue = YES;
+	BOOL sawRoot = NO;
+	id value = nil;
+	NSError *error = nil;
+
+	NSInteger length = 0;
+	while (!error && (length = [stream read:bytes maxLength:KKBulkReadLength]) > 0) {
+		for (NSUInteger i = 0; i < (NSUInteger) length && !error; i++) {
+			uint8_t c = bytes[i];
+			if (inString) {
+				if (inKey) {
+					[key appendBytes:&c length:1];
+				}
+				if (escaped) {
+					escaped = NO;
+				}
+				else if (c == '\\') {
+					escaped = YES;
+				}
+				else if (c == '"') {
+					inString = NO;
+					if (inKey) {
+						inKey = NO;
+						frames.lastObject.key = KKKeyFromQuotedData(key);
+					}
+				}
+				continue;
+			}
+			if (c == ' ' || c == '\n' || c == '\r' || c == '\t') {
+				continue;
+			}
+			if (capture) {
+				if (c == '"') {
+					inString = YES;
+					continue;
+				}
+				if (c == '{' || c == '[') {
+					captureDepth++;
+					continue;
+				}
+				if ((c == '}' || c == ']') && captureDepth > 0) {
+					captureDepth--;
+					continue;
+				}
+				if (c != '}' && c != ']' && (c != ',' || captureDepth > 0)) {
+					continue;
+				}
+				// The end of the value; the byte belongs to the container.
+				[capture appendBytes:bytes + captureFrom length:i - captureFrom];
+				id object = [NSJSONSerialization JSONObjectWithData:capture options:NSJSONReadingAllowFragments error:&error];
+				capture = nil;
+				if (!object) {
+					break;
+				}
+				if (captureIsElement) {
+					elementHandler(object);
+				}
+				else {
+					value = object;
+				}
+			}
+			if (expectingKey) {
+				expectingKey = NO;
+				if (c == '"') {
+					inString = YES;
+					inKey = YES;
+					[key setLength:0];
+					[key appendBytes:&c length:1];
+					continue;
+				}
+			}
+			if (expectingValue && c != ']' && c != '}') {
+				expectingValue = NO;
+				sawRoot = YES;
+				BOOL isElement = frames.lastObject.list;
+				if (isElement || KKFramesMatchPath(frames, self.valuePath)) {
+					capture = [NSMutableData data];
+					captureFrom = i;
+					captureIsElement = isElement;
+					captureDepth = (c == '{' || c == '[') ? 1 : 0;
+					inString = (c == '"');
+					continue;
+				}
+				if (c == '{' || c == '[') {
+					KKJSONReaderFrame *frame = [[KKJSONReaderFrame alloc] init];
+					frame.array = (c == '[');
+					frame.list = frame.array && KKFramesMatchPath(frames, self.listPath);
+					[frames addObject:frame];
+					expectingKey = !frame.array;
+					expectingValue = frame.array;
+				}
+				else if (c == '"') {
+					inString = YES;
+				}
+				continue;
+			}
+			switch (c) {
+				case '}':
+				case ']':
+					if (!frames.count || frames.lastObject.array != (c == ']')) {
+						error = KKBulkInvalidResponseError();
+						break;
+					}
+					[frames removeLastObject];
+					expectingValue = NO;
+					break;
+				case ',':
+					expectingKey = !frames.lastObject.array;
+					expectingValue = frames.lastObject.array;
+					break;
+				case ':':
+					expectingValue = YES;
+					break;
+				default:
+					// Within a number or a literal that is not collected.
+					break;
+			}
+		}
+		if (capture && !error) {
+			[capture appendBytes:bytes + captureFrom length:(NSUInteger) length - captureFrom];
+			captureFrom = 0;
+		}
+	}
+	[stream close];
+
+	if (!error && length < 0) {
+		error = stream.streamError ?: KKBulkInvalidResponseError();
+	}
+	if (!error && (!sawRoot || frames.count || capture || inString)) {
+		error = KKBulkInvalidResponseError();
+	}
+	if (error) {
+		if (outError) {
+			*outError = error;
+		}
+		return NO;
+	}
+	if (outValue) {
+		*outValue = value;
+	}
+	return YES;
+}
+
+@end
+
+#pragma mark - Manifest
+
+/** A list in the manifest. */
+@interface KKBulkDownloadJob : NSObject
+@property (assign, nonatomic) KKBulkDownloadList list;
+@property (strong, nonatomic) NSString *ID;
+@property (assign, nonatomic) KKTerritoryCode territory;
+/** The offset of the next page. */
+@property (assign, nonatomic) NSInteger offset;
+/** The total reported by the last page, or NSIntegerMax before the first. */
+@property (assign, nonatomic) NSInteger total;
+@property (assign, nonatomic) BOOL finished;
+/** The resume data of the interrupted download of the next page. */
+@property (strong, nonatomic) NSData *resumeData;
+@end
+
+@implementation KKBulkDownloadJob
+
++ (instancetype)jobWithPropertyList:(NSDictionary *)propertyList
+{
+	if (![propertyList isKindOfClass:[NSDictionary class]] || ![propertyList[KKBulkListIDKey] isKindOfClass:[NSString class]]) {
+		return nil;
+	}
+	NSInteger list = [propertyList[KKBulkListKindKey] integerValue];
+	if (list < KKBulkDownloadListAlbumTracks || list > KKBulkDownloadListNewReleaseAlbums) {
+		return nil;
+	}
+	KKBulkDownloadJob *job = [[KKBulkDownloadJob alloc] init];
+	job.list = (KKBulkDownloadList) list;
+	job.ID = propertyList[KKBulkListIDKey];
+	job.territory = (KKTerritoryCode) [propertyList[KKBulkListTerritoryKey] unsignedIntegerValue];
+	job.offset = [propertyList[KKBulkListOffsetKey] integerValue];
+	job.total = [propertyList[KKBulkListTotalKey] integerValue];
+	job.finished = [propertyList[KKBulkListFinishedKey] boolValue];
+	id resumeData = propertyList[KKBulkListResumeDataKey];
+	job.resumeData = [resumeData isKindOfClass:[NSData class]] ? resumeData : nil;
+	return job;
+}
+
+- (NSDictionary *)propertyList
+{
+	NSMutableDictionary *propertyList = [@{
+		KKBulkListKindKey: @(self.list),
+		KKBulkListIDKey: self.ID,
+		KKBulkListTerritoryKey: @(self.territory),
+		KKBulkListOffsetKey: @(self.offset),
+		KKBulkListTotalKey: @(self.total),
+		KKBulkListFinishedKey: @(self.finished),
+	} mutableCopy];
+	if (self.resumeData) {
+		propertyList[KKBulkListResumeDataKey] = self.resumeData;
+	}
+	return propertyList;
+}
+
+- (BOOL)isSameListAs:(KKBulkDownloadJob *)job
+{
+	return self.list == job.list && self.territory == job.territory && [self.ID isEqualToString:job.ID];
+}
+
+/** Names the download of the next page. It starts with the list, which is all that the session delegate reads from it. */
+- (NSString *)pageDescription
+{
+	return [NSString stringWithFormat:@"%lu %lu %ld %@", (unsigned long) self.list, (unsigned long) self.territory, (long) self.offset, self.ID];
+}
+
+@end
+
+#pragma mark - Downloader
+
+@interface KKBulkDownloader () <NSURLSessionDownloadDelegate>
+@property (strong, nonatomic) KKBOXOpenAPI *API;
+@property (strong, nonatomic) NSURLSessionConfiguration *configuration;
+@property (strong, nonatomic) NSURLSession *session;
+@property (strong, nonatomic) NSMutableArray<KKBulkDownloadJob *> *jobs;
+@property (strong, nonatomic) NSURLSessionDownloadTask *currentTask;
+@property (readwrite, assign, nonatomic, getter=isRunning) BOOL running;
+/** The downloaded page waiting to be read. Only used on the delegate queue. */
+@property (strong, nonatomic) NSURL *downloadedFileURL;
+@end
+
+@implementation KKBulkDownloader
+
+- (instancetype)initWithAPI:(KKBOXOpenAPI *)API directoryURL:(NSURL *)directoryURL
+{
+	return [self initWithAPI:API directoryURL:directoryURL configuration:API.URLSession.configuration];
+}
+
+- (instancetype)initWithAPI:(KKBOXOpenAPI *)API directoryURL:(NSURL *)directoryURL configuration:(NSURLSessionConfiguration *)configuration
+{
+	NSParameterAssert(API);
+	NSParameterAssert(directoryURL);
+	NSParameterAssert(configuration);
+	self = [super init];
+	if (self) {
+		self.API = API;
+		_directoryURL = directoryURL;
+		self.configuration = configuration;
+		self.pageSize = 500;
+		self.batchSize = 100;
+		self.jobs = [NSMutableArray array];
+		[[NSFileManager defaultManager] createDirectoryAtURL:directoryURL withIntermediateDirectories:YES attributes:nil error:nil];
+
+		NSDictionary *manifest = [NSDictionary dictionaryWithContentsOfURL:[directoryURL URLByAppendingPathComponent:KKBulkManifestFileName]];
+		if ([manifest[KKBulkManifestVersionKey] integerValue] == KKBulkManifestVersion) {
+			for (NSDictionary *propertyList in manifest[KKBulkManifestListsKey]) {
+				KKBulkDownloadJob *job = [KKBulkDownloadJob jobWithPropertyList:propertyList];
+				if (job) {
+					[self.jobs addObject:job];
+				}
+			}
+		}
+	}
+	return self;
+}
+
+- (void)addList:(KKBulkDownloadList)list ID:(NSString *)ID territory:(KKTerritoryCode)territory
+{
+	NSAssert([NSThread isMainThread], @"The downloader must be used on the main thread.");
+	NSParameterAssert(ID);
+	KKBulkDownloadJob *job = [[KKBulkDownloadJob alloc] init];
+	job.list = list;
+	job.ID = ID;
+	job.territory = territory;
+	job.total = NSIntegerMax;
+	for (KKBulkDownloadJob *existingJob in self.jobs) {
+		if ([existingJob isSameListAs:job]) {
+			return;
+		}
+	}
+	[self.jobs addObject:job];
+	[self _saveManifest];
+}
+
+- (NSUInteger)pendingListCount
+{
+	NSUInteger count = 0;
+	for (KKBulkDownloadJob *job in self.jobs) {
+		count += job.finished ? 0 : 1;
+	}
+	return count;
+}
+
+- (void)start
+{
+	NSAssert([NSThread isMainThread], @"The downloader must be used on the main thread.");
+	NSAssert(self.pageSize > 0, @"pageSize must be greater than 0.");
+	if (self.running) {
+		return;
+	}
+	self.running = YES;
+	if (!self.session) {
+		NSOperationQueue *delegateQueue = [[NSOperationQueue alloc] init];
+		delegateQueue.maxConcurrentOperationCount = 1;
+		self.session = [NSURLSession sessionWithConfiguration:self.configuration delegate:self delegateQueue:delegateQueue];
+	}
+	// A background session may still be fetching the page for a
+	// downloader of an earlier launch; take that download over.
+	[self.session getTasksWithCompletionHandler:^(NSArray *dataTasks, NSArray *uploadTasks, NSArray<NSURLSessionDownloadTask *> *downloadTasks) {
+		dispatch_async(dispatch_get_main_queue(), ^{
+			if (!self.running || self.currentTask) {
+				return;
+			}
+			NSString *pageDescription = [self _currentJob].pageDescription;
+			for (NSURLSessionDownloadTask *task in downloadTasks) {
+				if ([task.taskDescription isEqualToString:pageDescription]) {
+					self.currentTask = task;
+					[task resume];
+					return;
+				}
+			}
+			[self _startNextPage];
+		});
+	}];
+}
+
+- (void)cancel
+{
+	NSAssert([NSThread isMainThread], @"The downloader must be used on the main thread.");
+	if (!self.running) {
+		return;
+	}
+	KKBulkDownloadJob *job = [self _currentJob];
+	NSURLSessionDownloadTask *task = self.currentTask;
+	self.currentTask = nil;
+	[task cancelByProducingResumeData:^(NSData *resumeData) {
+		dispatch_async(dispatch_get_main_queue(), ^{
+			if (resumeData && !self.running) {
+				job.resumeData = resumeData;
+				[self _saveManifest];
+			}
+		});
+	}];
+	[self _finishWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+}
+
+#pragma mark - Pages
+
+- (KKBulkDownloadJob *)_currentJob
+{
+	for (KKBulkDownloadJob *job in self.jobs) {
+		if (!job.finished) {
+			return job;
+		}
+	}
+	return nil;
+}
+
+- (void)_startNextPage
+{
+	KKBulkDownloadJob *job = [self _currentJob];
+	if (!job) {
+		[self _finishWithError:nil];
+		return;
+	}
+	NSURLSessionDownloadTask *task = nil;
+	if (job.resumeData) {
+		task = [self.session downloadTaskWithResumeData:job.resumeData];
+		job.resumeData = nil;
+	}
+	if (!task) {
+		NSURL *URL = [self.API _URLForEndpoint:KKEndpointForBulkDownloadList(job.list) ID:job.ID parameters:nil territory:job.territory offset:job.offset limit:self.pageSize requestKey:NULL];
+		task = [self.session downloadTaskWithRequest:[self.API _APIRequestWithURL:URL]];
+	}
+	task.taskDescription = job.pageDescription;
+	self.currentTask = task;
+	[task resume];
+}
+
+/** The job whose next page a download is, or nil if the download is no longer wanted. */
+- (KKBulkDownloadJob *)_jobOfPage:(NSString *)pageDescription
+{
+	KKBulkDownloadJob *job = [self _currentJob];
+	return (self.running && [job.pageDescription isEqualToString:pageDescription]) ? job : nil;
+}
+
+- (void)_deliverObjects:(NSArray *)objects ofPage:(NSString *)pageDescription
+{
+	KKBulkDownloadJob *job = [self _jobOfPage:pageDescription];
+	if (job && [self.delegate respondsToSelector:@selector(bulkDownloader:didReceiveObjects:ofList:ID:)]) {
+		[self.delegate bulkDownloader:self didReceiveObjects:objects ofList:job.list ID:job.ID];
+	}
+}
+
+- (void)_completePage:(NSString *)pageDescription task:(NSURLSessionTask *)task count:(NSUInteger)count total:(NSInteger)total
+{
+	KKBulkDownloadJob *job = [self _jobOfPage:pageDescription];
+	if (!job) {
+		return;
+	}
+	if (self.currentTask != task) {
+		// Taken over from an earlier launch after a new download started.
+		[self.currentTask cancel];
+	}
+	self.currentTask = nil;
+	job.offset += (NSInteger) count;
+	job.total = total;
+	job.finished = (count == 0 || job.offset >= total);
+	[self _saveManifest];
+	if (job.finished && [self.delegate respondsToSelector:@selector(bulkDownloader:didFinishList:ID:)]) {
+		[self.delegate bulkDownloader:self didFinishList:job.list ID:job.ID];
+	}
+	if (self.running) {
+		[self _startNextPage];
+	}
+}
+
+- (void)_failPage:(NSString *)pageDescription task:(NSURLSessionTask *)task error:(NSError *)error
+{
+	KKBulkDownloadJob *job = [self _jobOfPage:pageDescription];
+	if (!job || task != self.currentTask) {
+		return;
+	}
+	self.currentTask = nil;
+	job.resumeData = error.userInfo[NSURLSessionDownloadTaskResumeData];
+	[self _saveManifest];
+	[self _finishWithError:error];
+}
+
+- (void)_finishWithError:(NSError *)error
+{
+	self.running = NO;
+	[self.session finishTasksAndInvalidate];
+	self.session = nil;
+	[self _saveManifest];
+	[self.delegate bulkDownloaderDidFinish:self error:error];
+}
+
+- (void)_saveManifest
+{
+	NSMutableArray *lists = [NSMutableArray array];
+	for (KKBulkDownloadJob *job in self.jobs) {
+		[lists addObject:job.propertyList];
+	}
+	NSDictionary *manifest = @{KKBulkManifestVersionKey: @(KKBulkManifestVersion), KKBulkManifestListsKey: lists};
+	[manifest writeToURL:[self.directoryURL URLByAppendingPathComponent:KKBulkManifestFileName] atomically:YES];
+}
+
+#pragma mark - NSURLSessionDownloadDelegate
+
+- (void)URLSession:(NSURLSession *)session downloadTask:(NSURLSessionDownloadTask *)downloadTask didFinishDownloadingToURL:(NSURL *)location
+{
+	// The file is removed when this returns.
+	NSURL *fileURL = [self.directoryURL URLByAppendingPathComponent:KKBulkPageFileName];
+	[[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+	if ([[NSFileManager defaultManager] moveItemAtURL:location toURL:fileURL error:nil]) {
+		self.downloadedFileURL = fileURL;
+	}
+}
+
+- (void)URLSession:(NSURLSession *)session task:(NSURLSessionTask *)task didCompleteWithError:(NSError *)error
+{
+	NSString *pageDescription = task.taskDescription;
+	NSURL *fileURL = self.downloadedFileURL;
+	self.downloadedFileURL = nil;
+	NSInteger statusCode = [task.response isKindOfClass:[NSHTTPURLResponse class]] ? ((NSHTTPURLResponse *)task.response).statusCode : 0;
+	if (!error && (statusCode < 200 || statusCode >= 300)) {
+		error = [NSError errorWithDomain:KKBOXOpenAPIErrorDomain code:statusCode userInfo:@{NSLocalizedDescriptionKey: [NSHTTPURLResponse localizedStringForStatusCode:statusCode]}];
+	}
+	else if (!error && !fileURL) {
+		error = KKBulkInvalidResponseError();
+	}
+
+	KKBulkDownloadList list = (KKBulkDownloadList) pageDescription.integerValue;
+	const KKEndpointDescriptor *endpoint = KKEndpointForBulkDownloadList(list);
+	if (!error && endpoint) {
+		NSString *summaryKeyPath = endpoint->pagingKeyPath.length ? [endpoint->pagingKeyPath stringByAppendingString:@".summary"] : @"summary";
+		KKJSONListReader *reader = [[KKJSONListReader alloc] initWithListKeyPath:endpoint->dataKeyPath valueKeyPath:summaryKeyPath];
+		Class modelClass = objc_getClass(endpoint->modelClassName);
+		NSUInteger batchSize = MAX(self.batchSize, (NSUInteger) 1);
+		__block NSMutableArray *batch = [NSMutableArray array];
+		__block NSUInteger count = 0;
+		// A batch is handed to the main queue only once the one before
+		// it is delivered, so that a slow delegate holds the reading
+		// back instead of letting the batches pile up.
+		dispatch_semaphore_t deliverySlot = dispatch_semaphore_create(1);
+		id summary = nil;
+		BOOL read = [reader readFileAtURL:fileURL elementHandler:^(id element) {
+			if (![element isKindOfClass:[NSDictionary class]]) {
+				return;
+			}
+			[batch addObject:[[modelClass alloc] initWithDictionary:element]];
+			count++;
+			if (batch.count == batchSize) {
+				NSArray *objects = batch;
+				batch = [NSMutableArray array];
+				dispatch_semaphore_wait(deliverySlot, DISPATCH_TIME_FOREVER);
+				dispatch_async(dispatch_get_main_queue(), ^{
+					[self _deliverObjects:objects ofPage:pageDescription];
+					dispatch_semaphore_signal(deliverySlot);
+				});
+			}
+		} value:&summary error:&error];
+		[[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+		if (read) {
+			NSInteger total = [summary isKindOfClass:[NSDictionary class]] && summary[@"total"] ? [summary[@"total"] integerValue] : NSIntegerMax;
+			NSArray *objects = batch;
+			dispatch_async(dispatch_get_main_queue(), ^{
+				if (objects.count) {
+					[self _deliverObjects:objects ofPage:pageDescription];
+				}
+				[self _completePage:pageDescription task:task count:count total:total];
+			});
+			return;
+		}
+	}
+	if (fileURL) {
+		[[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+	}
+	if (!error) {
+		error = KKBulkInvalidResponseError();
+	}
+	dispatch_async(dispatch_get_main_queue(), ^{
+		[self _failPage:pageDescription task:task error:error];
+	});
+}
+
+@end
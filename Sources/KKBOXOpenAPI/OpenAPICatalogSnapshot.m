@@ -0,0 +1,535 @@
+//
+// OpenAPICatalogSnapshot.m
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+#import "OpenAPICatalogSnapshot.h"
+#import "OpenAPI+Privates.h"
+
+const NSUInteger KKCatalogSnapshotVersion = 1;
+
+static const uint8_t KKCatalogSnapshotMagic[4] = {'K', 'K', 'C', 'S'};
+
+/**
+ * The header at the start of a snapshot file. The integers here and
+ * in the tables are little-endian, and the offsets are from the start
+ * of the file.
+ *
+ * The header is followed by the bytes of the strings and of the
+ * records of the objects, laid out as in a binary archive, and then
+ * by the tables: a KKBinaryRange for every string and every record,
+ * a KKSnapshotRequestEntry for every request, the hash buckets, and
+ * the record indexes of the objects in the lists.
+ */
+typedef struct
+{
+	uint8_t magic[4];
+	uint32_t version;
+	uint32_t stringRangesOffset;
+	uint32_t stringCount;
+	uint32_t recordRangesOffset;
+	uint32_t recordCount;
+	uint32_t requestsOffset;
+	uint32_t requestCount;
+	/** The buckets hold the indexes of the requests plus one, 0 for an empty bucket. */
+	uint32_t bucketsOffset;
+	/** A power of two. */
+	uint32_t bucketCount;
+	uint32_t itemsOffset;
+	uint32_t itemCount;
+} KKSnapshotHeader;
+
+typedef NS_OPTIONS(uint32_t, KKSnapshotRequestFlags)
+{
+	KKSnapshotRequestFlagHasList = 1 << 0,
+};
+
+typedef struct
+{
+	/** The index of the request key in the strings. */
+	uint32_t keyString;
+	uint32_t hash;
+	/** The index of the record of the object plus one, 0 if there is none. */
+	uint32_t objectRecord;
+	uint32_t flags;
+	/** Where the list starts in the items. */
+	uint32_t firstItem;
+	uint32_t itemCount;
+	/** The total of the list reported by the API, at least `itemCount`. */
+	uint32_t total;
+	/**
+	 * The index of the record of the paging of a list embedded in the
+	 * object plus one, 0 if there is none.
+	 */
+	uint32_t pagingRecord;
+} KKSnapshotRequestEntry;
+
+static NSError *KKCatalogSnapshotError(NSString *description)
+{
+	return [NSError errorWithDomain:KKBOXOpenAPIErrorDomain code:5 userInfo:@{NSLocalizedDescriptionKey: description}];
+}
+
+/** FNV-1a. */
+static uint32_t KKSnapshotHash(const uint8_t *bytes, NSUInteger length)
+{
+	uint32_t hash = 2166136261u;
+	for (NSUInteger i = 0; i < length; i++) {
+		hash = (hash ^ bytes[i]) * 16777619u;
+	}
+	return hash;
+}
+
+static void KKAppendUInt32(NSMutableData *data, NSUInteger value)
+{
+	uint32_t littleEndian = CFSwapInt32HostToLittle((uint32_t)value);
+	[data appendBytes:&littleEndian length:sizeof(littleEndian)];
+}
+
+static uint32_t KKUInt32AtIndex(NSData *table, NSUInteger index)
+{
+	uint32_t value;
+	memcpy(&value, (const uint8_t *)table.bytes + index * sizeof(value), sizeof(value));
+	return CFSwapInt32LittleToHost(value);
+}
+
+#pragma mark - Builder
+
+/** The results recorded for one request. */
+@interface KKSnapshotRequest : NSObject
+@property (strong, nonatomic) KKBOXOpenAPIObject *object;
+/** The paging of a list embedded in the object, like the tracks of a playlist. */
+@property (strong, nonatomic) KKPagingInfo *paging;
+/** The pages of the list keyed by their offsets, or nil if there is no list. */
+@property (strong, nonatomic) NSMutableDictionary <NSNumber *, NSArray *> *pages;
+@property (assign, nonatomic) NSInteger total;
+@end
+
+@implementation KKSnapshotRequest
+
+/** The pages joined from offset 0 up to the first gap. */
+- (NSArray *)joinedPages
+{
+	NSMutableArray *objects = [NSMutableArray array];
+	for (NSNumber *offset in [self.pages.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+		NSInteger start = offset.integerValue;
+		if (start < 0 || start > (NSInteger)objects.count) {
+			break;
+		}
+		NSArray *page = self.pages[offset];
+		for (NSUInteger i = 0; i < page.count; i++) {
+			if (start + i < objects.count) {
+				objects[start + i] = page[i];
+			}
+			else {
+				[objects addObject:page[i]];
+			}
+		}
+	}
+	return objects;
+}
+
+@end
+
+@interface KKCatalogSnapshotBuilder ()
+/** Guarded by synchronizing on itself. */
+@property (strong, nonatomic) NSMutableDictionary <NSString *, KKSnapshotRequest *> *requests;
+@end
+
+@implementation KKCatalogSnapshotBuilder
+
+- (instancetype)init
+{
+	self = [super init];
+	if (self) {
+		self.requests = [NSMutableDictionary dictionary];
+	}
+	return self;
+}
+
+- (NSUInteger)requestCount
+{
+	@synchronized (self.requests) {
+		return self.requests.count;
+	}
+}
+
+- (void)removeAllResults
+{
+	@synchronized (self.requests) {
+		[self.requests removeAllObjects];
+	}
+}
+
+- (void)_recordResult:(KKEndpointResult *)result paged:(BOOL)paged requestKey:(NSString *)requestKey offset:(NSInteger)offset
+{
+	@synchronized (self.requests) {
+		KKSnapshotRequest *request = self.requests[requestKey];
+		if (!request) {
+			request = [[KKSnapshotRequest alloc] init];
+			self.requests[requestKey] = request;
+		}
+		if (result.object) {
+			request.object = result.object;
+		}
+		if (result.objects) {
+			if (!paged || !request.pages) {
+				request.pages = [NSMutableDictionary dictionary];
+			}
+			request.pages[@(paged ? offset : 0)] = result.objects;
+			request.total = result.summary.total;
+		}
+		else if (result.paging) {
+			// An object that embeds the first page of a list.
+			request.paging = result.paging;
+			request.total = result.summary.total;
+		}
+	}
+}
+
+- (BOOL)writeToURL:(NSURL *)URL error:(NSError **)error
+{
+	NSMutableArray <NSString *> *keys = [NSMutableArray array];
+	NSMutableArray <KKSnapshotRequest *> *requests = [NSMutableArray array];
+	@synchronized (self.requests) {
+		for (NSString *key in [self.requests.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+			KKSnapshotRequest *source = self.requests[key];
+			KKSnapshotRequest *request = [[KKSnapshotRequest alloc] init];
+			request.object = source.object;
+			request.paging = source.paging;
+			request.total = source.total;
+			if (source.pages) {
+				request.pages = [NSMutableDictionary dictionaryWithObject:[source joinedPages] forKey:@0];
+			}
+			[keys addObject:key];
+			[requests addObject:request];
+		}
+	}
+
+	// Objects with the same class, ID and contents share a record.
+	KKBinaryArchiveWriter *writer = [[KKBinaryArchiveWriter alloc] init];
+	NSMutableArray <KKBOXOpenAPIObject *> *recordObjects = [NSMutableArray array];
+	NSMutableDictionary <NSString *, NSMutableArray <NSNumber *> *> *recordsByIdentity = [NSMutableDictionary dictionary];
+	NSUInteger (^recordOfObject)(KKBOXOpenAPIObject *) = ^NSUInteger(KKBOXOpenAPIObject *object) {
+		id ID = object.dictionary[@"id"];
+		NSString *identity = [NSString stringWithFormat:@"%@/%@", NSStringFromClass([object class]), [ID isKindOfClass:[NSString class]] ? ID : @""];
+		NSMutableArray <NSNumber *> *candidates = recordsByIdentity[identity];
+		for (NSNumber *candidate in candidates) {
+			KKBOXOpenAPIObject *recordObject = recordObjects[candidate.unsignedIntegerValue];
+			if (recordObject.isStale == object.isStale && (recordObject.dictionary == object.dictionary || [recordObject.dictionary isEqualToDictionary:object.dictionary])) {
+				return candidate.unsignedIntegerValue;
+			}
+		}
+		NSUInteger index = [writer appendObject:object];
+		[recordObjects addObject:object];
+		if (!candidates) {
+			candidates = [NSMutableArray array];
+			recordsByIdentity[identity] = candidates;
+		}
+		[candidates addObject:@(index)];
+		return index;
+	};
+
+	NSMutableData *entries = [NSMutableData dataWithCapacity:requests.count * sizeof(KKSnapshotRequestEntry)];
+	NSMutableData *items = [NSMutableData data];
+	NSUInteger bucketCount = 1;
+	while (bucketCount < requests.count * 2) {
+		bucketCount <<= 1;
+	}
+	NSMutableData *buckets = [NSMutableData dataWithLength:bucketCount * sizeof(uint32_t)];
+	uint32_t *bucketValues = buckets.mutableBytes;
+	[keys enumerateObjectsUsingBlock:^(NSString *key, NSUInteger index, BOOL *stop) {
+		KKSnapshotRequest *request = requests[index];
+		NSData *keyData = [key dataUsingEncoding:NSUTF8StringEncoding];
+		KKSnapshotRequestEntry entry = {0};
+		entry.keyString = (uint32_t)[writer indexOfString:key];
+		entry.hash = KKSnapshotHash(keyData.bytes, keyData.length);
+		entry.objectRecord = request.object ? (uint32_t)recordOfObject(request.object) + 1 : 0;
+		if (request.paging) {
+			entry.pagingRecord = (uint32_t)recordOfObject(request.paging) + 1;
+			entry.total = (uint32_t)MAX(request.total, 0);
+		}
+		if (request.pages) {
+			NSArray *objects = request.pages[@0];
+			entry.flags = KKSnapshotRequestFlagHasList;
+			entry.firstItem = (uint32_t)(items.length / sizeof(uint32_t));
+			entry.itemCount = (uint32_t)objects.count;
+			entry.total = (uint32_t)MAX(request.total, (NSInteger)objects.count);
+			for (KKBOXOpenAPIObject *object in objects) {
+				KKAppendUInt32(items, recordOfObject(object));
+			}
+		}
+		NSUInteger bucket = entry.hash & (bucketCount - 1);
+		while (bucketValues[bucket]) {
+			bucket = (bucket + 1) & (bucketCount - 1);
+		}
+		bucketValues[bucket] = CFSwapInt32HostToLittle((uint32_t)index + 1);
+
+		KKSnapshotRequestEntry littleEndian = {
+			CFSwapInt32HostToLittle(entry.keyString),
+			CFSwapInt32HostToLittle(entry.hash),
+			CFSwapInt32HostToLittle(entry.objectRecord),
+			CFSwapInt32HostToLittle(entry.flags),
+			CFSwapInt32HostToLittle(entry.firstItem),
+			CFSwapInt32HostToLittle(entry.itemCount),
+			CFSwapInt32HostToLittle(entry.total),
+			CFSwapInt32HostToLittle(entry.pagingRecord),
+		};
+		[entries appendBytes:&littleEndian length:sizeof(littleEndian)];
+	}];
+
+	NSMutableData *file = [NSMutableData dataWithLength:sizeof(KKSnapshotHeader)];
+	NSMutableData *stringRanges = [NSMutableData dataWithCapacity:writer.strings.count * sizeof(KKBinaryRange)];
+	for (NSString *string in writer.strings) {
+		NSData *bytes = [string dataUsingEncoding:NSUTF8StringEncoding];
+		KKAppendUInt32(stringRanges, file.length);
+		KKAppendUInt32(stringRanges, bytes.length);
+		[file appendData:bytes];
+	}
+	NSMutableData *recordRanges = [NSMutableData dataWithCapacity:writer.recordLengths.count * sizeof(KKBinaryRange)];
+	NSUInteger recordLocation = file.length;
+	for (NSNumber *length in writer.recordLengths) {
+		KKAppendUInt32(recordRanges, recordLocation);
+		KKAppendUInt32(recordRanges, length.unsignedIntegerValue);
+		recordLocation += length.unsignedIntegerValue;
+	}
+	[file appendData:writer.records];
+	[file increaseLengthBy:(4 - file.length % 4) % 4];
+
+	KKSnapshotHeader header = {{0}};
+	memcpy(header.magic, KKCatalogSnapshotMagic, sizeof(KKCatalogSnapshotMagic));
+	header.version = CFSwapInt32HostToLittle((uint32_t)KKCatalogSnapshotVersion);
+	header.stringRangesOffset = CFSwapInt32HostToLittle((uint32_t)file.length);
+	header.stringCount = CFSwapInt32HostToLittle((uint32_t)writer.strings.count);
+	[file appendData:stringRanges];
+	header.recordRangesOffset = CFSwapInt32HostToLittle((uint32_t)file.length);
+	header.recordCount = CFSwapInt32HostToLittle((uint32_t)writer.recordLengths.count);
+	[file appendData:recordRanges];
+	header.requestsOffset = CFSwapInt32HostToLittle((uint32_t)file.length);
+	header.requestCount = CFSwapInt32HostToLittle((uint32_t)requests.count);
+	[file appendData:entries];
+	header.bucketsOffset = CFSwapInt32HostToLittle((uint32_t)file.length);
+	header.bucketCount = CFSwapInt32HostToLittle((uint32_t)bucketCount);
+	[file appendData:buckets];
+	header.itemsOffset = CFSwapInt32HostToLittle((uint32_t)file.length);
+	header.itemCount = CFSwapInt32HostToLittle((uint32_t)(items.length / sizeof(uint32_t)));
+	[file appendData:items];
+	if (file.length > UINT32_MAX) {
+		if (error) {
+			*error = KKCatalogSnapshotError(@"The snapshot is larger than 4 GB");
+		}
+		return NO;
+	}
+	[file replaceBytesInRange:NSMakeRange(0, sizeof(header)) withBytes:&header];
+	return [file writeToURL:URL options:NSDataWritingAtomic error:error];
+}
+
+@end
+
+#pragma mark - Snapshot
+
+@interface KKCatalogSnapshot ()
+@property (strong, nonatomic) NSData *data;
+@property (strong, nonatomic) KKBinaryArchive *archive;
+/** The tables below point into `data`, which keeps them alive. */
+@property (strong, nonatomic) NSData *stringRanges;
+@property (strong, nonatomic) NSData *requests;
+@property (strong, nonatomic) NSData *buckets;
+@property (strong, nonatomic) NSData *items;
+@property (assign, nonatomic) NSUInteger requestCount;
+/** The size of the request entries, which are shorter in older versions. */
+@property (assign, nonatomic) NSUInteger objectCount;
+
+- (KKBOXOpenAPIObject *)_objectAtItem:(NSUInteger)item;
+@end
+
+/** The objects of a list in a snapshot, built when they are accessed. */
+@interface KKSnapshotObjectArray : NSArray
+{
+	KKCatalogSnapshot *_snapshot;
+	Class _modelClass;
+	NSUInteger _firstItem;
+	NSUInteger _count;
+	/** Guarded by synchronizing on itself. */
+	NSMutableDictionary <NSNumber *, id> *_objects;
+}
+- (instancetype)initWithSnapshot:(KKCatalogSnapshot *)snapshot modelClass:(Class)modelClass firstItem:(NSUInteger)firstItem count:(NSUInteger)count;
+@end
+
+@implementation KKSnapshotObjectArray
+
+- (instancetype)initWithSnapshot:(KKCatalogSnapshot *)snapshot modelClass:(Class)modelClass firstItem:(NSUInteger)firstItem count:(NSUInteger)count
+{
+	self = [super init];
+	if (self) {
+		_snapshot = snapshot;
+		_modelClass = modelClass;
+		_firstItem = firstItem;
+		_count = count;
+		_objects = [NSMutableDictionary dictionary];
+	}
+	return self;
+}
+
+- (NSUInteger)count
+{
+	return _count;
+}
+
+- (id)objectAtIndex:(NSUInteger)index
+{
+	if (index >= _count) {
+		[NSException raise:NSRangeException format:@"Index %lu beyond bounds [0 .. %lu]", (unsigned long) index, (unsigned long) _count];
+	}
+	@synchronized (_objects) {
+		id object = _objects[@(index)];
+		if (!object) {
+			// A damaged record still yields an object of the expected class.
+			object = [_snapshot _objectAtItem:_firstItem + index] ?: [[_modelClass alloc] initWithDictionary:@{}];
+			_objects[@(index)] = object;
+		}
+		return object;
+	}
+}
+
+- (NSArray *)subarrayWithRange:(NSRange)range
+{
+	if (range.location > _count || range.length > _count - range.location) {
+		[NSException raise:NSRangeException format:@"Range %@ beyond bounds [0 .. %lu]", NSStringFromRange(range), (unsigned long) _count];
+	}
+	return [[KKSnapshotObjectArray alloc] initWithSnapshot:_snapshot modelClass:_modelClass firstItem:_firstItem + range.location count:range.length];
+}
+
+@end
+
+/** A table of `count` entries of `size` bytes at `offset`, or nil if it does not fit in the data. */
+static NSData *KKSnapshotTable(NSData *data, uint32_t offset, uint32_t count, size_t size)
+{
+	if ((uint64_t)offset + (uint64_t)count * size > data.length) {
+		return nil;
+	}
+	return [NSData dataWithBytesNoCopy:(void *)((const uint8_t *)data.bytes + offset) length:count * size freeWhenDone:NO];
+}
+
+@implementation KKCatalogSnapshot
+
+- (instancetype)initWithContentsOfURL:(NSURL *)URL error:(NSError **)error
+{
+	NSData *data = [NSData dataWithContentsOfURL:URL options:NSDataReadingMappedAlways error:error];
+	if (!data) {
+		return nil;
+	}
+	return [self initWithData:data error:error];
+}
+
+- (instancetype)initWithData:(NSData *)data error:(NSError **)error
+{
+	KKSnapshotHeader header;
+	if (data.length < sizeof(header) || memcmp(data.bytes, KKCatalogSnapshotMagic, sizeof(KKCatalogSnapshotMagic)) != 0) {
+		if (error) {
+			*error = KKCatalogSnapshotError(@"The data is not a catalog snapshot");
+		}
+		return nil;
+	}
+	memcpy(&header, data.bytes, sizeof(header));
+	uint32_t version = CFSwapInt32LittleToHost(header.version);
+	if (version > KKCatalogSnapshotVersion) {
+		if (error) {
+			*error = KKCatalogSnapshotError(@"The catalog snapshot is written in a newer version of the format");
+		}
+		return nil;
+	}
+	NSData *stringRanges = KKSnapshotTable(data, CFSwapInt32LittleToHost(header.stringRangesOffset), CFSwapInt32LittleToHost(header.stringCount), sizeof(KKBinaryRange));
+	NSData *recordRanges = KKSnapshotTable(data, CFSwapInt32LittleToHost(header.recordRangesOffset), CFSwapInt32LittleToHost(header.recordCount), sizeof(KKBinaryRange));
+	NSData *requests = KKSnapshotTable(data, CFSwapInt32LittleToHost(header.requestsOffset), CFSwapInt32LittleToHost(header.requestCount), sizeof(KKSnapshotRequestEntry));
+	uint32_t bucketCount = CFSwapInt32LittleToHost(header.bucketCount);
+	NSData *buckets = KKSnapshotTable(data, CFSwapInt32LittleToHost(header.bucketsOffset), bucketCount, sizeof(uint32_t));
+	NSData *items = KKSnapshotTable(data, CFSwapInt32LittleToHost(header.itemsOffset), CFSwapInt32LittleToHost(header.itemCount), sizeof(uint32_t));
+	if (!stringRanges || !recordRanges || !requests || !buckets || !items || bucketCount == 0 || (bucketCount & (bucketCount - 1))) {
+		if (error) {
+			*error = KKCatalogSnapshotError(@"The catalog snapshot is malformed");
+		}
+		return nil;
+	}
+
+	self = [super init];
+	if (self) {
+		self.data = data;
+		self.archive = [[KKBinaryArchive alloc] _initWithData:data stringRanges:stringRanges objectRanges:recordRanges version:KKBinaryArchiveVersion];
+		self.stringRanges = stringRanges;
+		self.requests = requests;
+		self.buckets = buckets;
+		self.items = items;
+		self.requestCount = requests.length / sizeof(KKSnapshotRequestEntry);
+		self.objectCount = recordRanges.length / sizeof(KKBinaryRange);
+	}
+	return self;
+}
+
+- (KKBOXOpenAPIObject *)_objectAtItem:(NSUInteger)item
+{
+	if (item >= self.items.length / sizeof(uint32_t)) {
+		return nil;
+	}
+	return [self.archive objectAtIndex:KKUInt32AtIndex(self.items, item)];
+}
+
+- (BOOL)_lookUpRequestKey:(NSString *)requestKey modelClass:(Class)modelClass object:(id *)object objects:(NSArray **)objects paging:(KKPagingInfo **)paging total:(NSInteger *)total
+{
+	NSData *keyData = [requestKey dataUsingEncoding:NSUTF8StringEncoding];
+	uint32_t hash = KKSnapshotHash(keyData.bytes, keyData.length);
+	NSUInteger bucketCount = self.buckets.length / sizeof(uint32_t);
+	for (NSUInteger probe = 0; probe < bucketCount; probe++) {
+		uint32_t requestIndex = KKUInt32AtIndex(self.buckets, (hash + probe) & (bucketCount - 1));
+		if (requestIndex == 0) {
+			return NO;
+		}
+		if (requestIndex > self.requestCount) {
+			continue;
+		}
+		KKSnapshotRequestEntry entry;
+		memcpy(&entry, (const uint8_t *)self.requests.bytes + (requestIndex - 1) * sizeof(entry), sizeof(entry));
+		NSRange keyRange;
+		if (CFSwapInt32LittleToHost(entry.hash) != hash ||
+			!KKBinaryRangeAtIndex(self.stringRanges, CFSwapInt32LittleToHost(entry.keyString), self.data.length, &keyRange) ||
+			keyRange.length != keyData.length ||
+			memcmp((const uint8_t *)self.data.bytes + keyRange.location, keyData.bytes, keyData.length) != 0) {
+			continue;
+		}
+
+		uint32_t objectRecord = CFSwapInt32LittleToHost(entry.objectRecord);
+		id foundObject = nil;
+		if (objectRecord) {
+			foundObject = [self.archive objectAtIndex:objectRecord - 1];
+			if (!foundObject) {
+				return NO;
+			}
+		}
+		uint32_t pagingRecord = CFSwapInt32LittleToHost(entry.pagingRecord);
+		KKPagingInfo *foundPaging = nil;
+		if (pagingRecord) {
+			foundPaging = [self.archive objectAtIndex:pagingRecord - 1];
+			if (![foundPaging isKindOfClass:[KKPagingInfo class]]) {
+				return NO;
+			}
+		}
+		NSArray *foundObjects = nil;
+		if (CFSwapInt32LittleToHost(entry.flags) & KKSnapshotRequestFlagHasList) {
+			NSUInteger firstItem = CFSwapInt32LittleToHost(entry.firstItem);
+			NSUInteger itemCount = CFSwapInt32LittleToHost(entry.itemCount);
+			NSUInteger allItemCount = self.items.length / sizeof(uint32_t);
+			if (firstItem > allItemCount || itemCount > allItemCount - firstItem) {
+				return NO;
+			}
+			foundObjects = [[KKSnapshotObjectArray alloc] initWithSnapshot:self modelClass:modelClass firstItem:firstItem count:itemCount];
+		}
+		*object = foundObject;
+		*objects = foundObjects;
+		*paging = foundPaging;
+		*total = CFSwapInt32LittleToHost(entry.total);
+		return YES;
+	}
+	return NO;
+}
+
+@end
@@ -0,0 +1,386 @@
+//
+// OpenAPICatalogStore.m
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+#import "OpenAPICatalogStore.h"
+
+static NSString *KKCatalogNormalizedName(NSString *name)
+{
+	NSString *trimmed = [name stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceAndNewlineCharacterSet]];
+	return [trimmed stringByFoldingWithOptions:NSCaseInsensitiveSearch | NSDiacriticInsensitiveSearch | NSWidthInsensitiveSearch locale:nil];
+}
+
+/** An entry in the sorted name index. */
+@interface KKCatalogNameEntry : NSObject
+@property (strong, nonatomic) NSString *key;
+@property (strong, nonatomic) NSString *objectID;
+@property (assign, nonatomic) KKSearchType type;
+@end
+
+@implementation KKCatalogNameEntry
+@end
+
+static NSComparisonResult KKCatalogCompareEntries(KKCatalogNameEntry *a, KKCatalogNameEntry *b)
+{
+	NSComparisonResult result = [a.key compare:b.key options:NSLiteralSearch];
+	if (result != NSOrderedSame) {
+		return result;
+	}
+	if (a.type != b.type) {
+		return a.type < b.type ? NSOrderedAscending : NSOrderedDescending;
+	}
+	return [a.objectID compare:b.objectID options:NSLiteralSearch];
+}
+
+@interface KKCatalogStore ()
+@property (strong, nonatomic) NSMutableDictionary <NSString *, KKTrackInfo *> *tracks;
+@property (strong, nonatomic) NSMutableDictionary <NSString *, KKAlbumInfo *> *albums;
+@property (strong, nonatomic) NSMutableDictionary <NSString *, KKArtistInfo *> *artists;
+@property (strong, nonatomic) NSMutableDictionary <NSString *, KKPlaylistInfo *> *playlists;
+@property (strong, nonatomic) NSMutableDictionary <NSString *, NSMutableOrderedSet <NSString *> *> *artistAlbumIDs;
+@property (strong, nonatomic) NSMutableDictionary <NSString *, NSMutableOrderedSet <NSString *> *> *albumTrackIDs;
+/** Sorted by normalized name, then type, then ID. */
+@property (strong, nonatomic) NSMutableArray <KKCatalogNameEntry *> *nameIndex;
+@end
+
+@implementation KKCatalogStore
+
+- (instancetype)init
+{
+	self = [super init];
+	if (self) {
+		self.tracks = [[NSMutableDictionary alloc] init];
+		self.albums = [[NSMutableDictionary alloc] init];
+		self.artists = [[NSMutableDictionary alloc] init];
+		self.playlists = [[NSMutableDictionary alloc] init];
+		self.artistAlbumIDs = [[NSMutableDictionary alloc] init];
+		self.albumTrackIDs = [[NSMutableDictionary alloc] init];
+		self.nameIndex = [[NSMutableArray alloc] init];
+	}
+	return self;
+}
+
+#pragma mark - Name index
+
+- (NSUInteger)_indexOfEntry:(KKCatalogNameEntry *)entry options:(NSBinarySearchingOptions)options
+{
+	return [self.nameIndex indexOfObject:entry inSortedRange:NSMakeRange(0, self.nameIndex.count) options:options usingComparator:^NSComparisonResult(KKCatalogNameEntry *a, KKCatalogNameEntry *b) {
+		return KKCatalogCompareEntries(a, b);
+	}];
+}
+
+- (void)_replaceName:(NSString *)oldName withName:(NSString *)newName objectID:(NSString *)objectID type:(KKSearchType)type
+{
+	if (oldName && [oldName isEqualToString:newName]) {
+		return;
+	}
+	KKCatalogNameEntry *entry = [[KKCatalogNameEntry alloc] init];
+	entry.objectID = objectID;
+	entry.type = type;
+	if (oldName) {
+		entry.key = KKCatalogNormalizedName(oldName);
+		NSUInteger index = [self _indexOfEntry:entry options:NSBinarySearchingFirstEqual];
+		if (index != NSNotFound) {
+			[self.nameIndex removeObjectAtIndex:index];
+		}
+	}
+	entry.key = KKCatalogNormalizedName(newName);
+	if (!entry.key.length) {
+		return;
+	}
+	NSUInteger index = [self _indexOfEntry:entry options:NSBinarySearchingInsertionIndex];
+	[self.nameIndex insertObject:entry atIndex:index];
+}
+
+#pragma mark - Upserting
+
+- (void)_storeArtist:(KKArtistInfo *)artist replace:(BOOL)replace
+{
+	if (!artist.artistID.length) {
+		return;
+	}
+	KKArtistInfo *existing = self.artists[artist.artistID];
+	if (existing && !replace) {
+		return;
+	}
+	self.artists[artist.artistID] = artist;
+	[self _replaceName:existing.artistName withName:artist.artistName objectID:artist.artistID type:KKSearchTypeArtist];
+}
+
+- (void)_storeAlbum:(KKAlbumInfo *)album replace:(BOOL)replace
+{
+	if (!album.albumID.length) {
+		return;
+	}
+	KKAlbumInfo *existing = self.albums[album.albumID];
+	if (existing && !replace) {
+		return;
+	}
+	self.albums[album.albumID] = album;
+	[self _replaceName:existing.albumName withName:album.albumName objectID:album.albumID type:KKSearchTypeAlbum];
+
+	NSString *artistID = album.artist.artistID;
+	if (artistID.length) {
+		[self _storeArtist:album.artist replace:NO];
+		NSString *oldArtistID = existing.artist.artistID;
+		if (oldArtistID.length && ![oldArtistID isEqualToString:artistID]) {
+			[self.artistAlbumIDs[oldArtistID] removeObject:album.albumID];
+		}
+		NSMutableOrderedSet *albumIDs = self.artistAlbumIDs[artistID];
+		if (!albumIDs) {
+			albumIDs = [[NSMutableOrderedSet alloc] init];
+			self.artistAlbumIDs[artistID] = albumIDs;
+		}
+		[albumIDs addObject:album.albumID];
+	}
+}
+
+- (void)_storeTrack:(KKTrackInfo *)track replace:(BOOL)replace
+{
+	if (!track.trackID.length) {
+		return;
+	}
+	KKTrackInfo *existing = self.tracks[track.trackID];
+	if (existing && !replace) {
+		return;
+	}
+	self.tracks[track.trackID] = track;
+	[self _replaceName:existing.trackName withName:track.trackName objectID:track.trackID type:KKSearchTypeTrack];
+
+	NSString *albumID = track.album.albumID;
+	if (albumID.length) {
+		[self _storeAlbum:track.album replace:NO];
+		NSString *oldAlbumID = existing.album.albumID;
+		if (oldAlbumID.length && ![oldAlbumID isEqualToString:albumID]) {
+			[self.albumTrackIDs[oldAlbumID] removeObject:track.trackID];
+		}
+		NSMutableOrderedSet *trackIDs = self.albumTrackIDs[albumID];
+		if (!trackIDs) {
+			trackIDs = [[NSMutableOrderedSet alloc] init];
+			self.albumTrackIDs[albumID] = trackIDs;
+		}
+		[trackIDs addObject:track.trackID];
+	}
+}
+
+- (void)_storePlaylist:(KKPlaylistInfo *)playlist
+{
+	if (!playlist.playlistID.length) {
+		return;
+	}
+	KKPlaylistInfo *existing = self.playlists[playlist.playlistID];
+	self.playlists[playlist.playlistID] = playlist;
+	[self _replaceName:existing.playlistTitle withName:playlist.playlistTitle objectID:playlist.playlistID type:KKSearchTypePlaylist];
+	for (KKTrackInfo *track in playlist.tracks) {
+		[self _storeTrack:track replace:YES];
+	}
+}
+
+- (void)_storeObject:(KKBOXOpenAPIObject *)object
+{
+	if ([object isKindOfClass:[KKTrackInfo class]]) {
+		[self _storeTrack:(KKTrackInfo *)object replace:YES];
+	}
+	else if ([object isKindOfClass:[KKAlbumInfo class]]) {
+		[self _storeAlbum:(KKAlbumInfo *)object replace:YES];
+	}
+	else if ([object isKindOfClass:[KKArtistInfo class]]) {
+		[self _storeArtist:(KKArtistInfo *)object replace:YES];
+	}
+	else if ([object isKindOfClass:[KKPlaylistInfo class]]) {
+		[self _storePlaylist:(KKPlaylistInfo *)object];
+	}
+	else if ([object isKindOfClass:[KKSearchResults class]]) {
+		KKSearchResults *results = (KKSearchResults *)object;
+		for (KKArtistInfo *artist in results.artists) {
+			[self _storeArtist:artist replace:YES];
+		}
+		for (KKAlbumInfo *album in results.albums) {
+			[self _storeAlbum:album replace:YES];
+		}
+		for (KKTrackInfo *track in results.tracks) {
+			[self _storeTrack:track replace:YES];
+		}
+		for (KKPlaylistInfo *playlist in results.playlists) {
+			[self _storePlaylist:playlist];
+		}
+	}
+}
+
+- (void)storeObject:(KKBOXOpenAPIObject *)object
+{
+	NSParameterAssert(object);
+	@synchronized (self) {
+		[self _storeObject:object];
+	}
+}
+
+- (void)storeObjects:(NSArray <KKBOXOpenAPIObject *> *)objects
+{
+	NSParameterAssert(objects);
+	@synchronized (self) {
+		for (KKBOXOpenAPIObject *object in objects) {
+			[self _storeObject:object];
+		}
+	}
+}
+
+- (void)removeAllObjects
+{
+	@synchronized (self) {
+		[self.tracks removeAllObjects];
+		[self.albums removeAllObjects];
+		[self.artists removeAllObjects];
+		[self.playlists removeAllObjects];
+		[self.artistAlbumIDs removeAllObjects];
+		[self.albumTrackIDs removeAllObjects];
+		[self.nameIndex removeAllObjects];
+	}
+}
+
+#pragma mark - Look-up
+
+- (KKTrackInfo *)trackWithID:(NSString *)trackID
+{
+	@synchronized (self) {
+		return self.tracks[trackID];
+	}
+}
+
+- (KKAlbumInfo *)albumWithID:(NSString *)albumID
+{
+	@synchronized (self) {
+		return self.albums[albumID];
+	}
+}
+
+- (KKArtistInfo *)artistWithID:(NSString *)artistID
+{
+	@synchronized (self) {
+		return self.artists[artistID];
+	}
+}
+
+- (KKPlaylistInfo *)playlistWithID:(NSString *)playlistID
+{
+	@synchronized (self) {
+		return self.playlists[playlistID];
+	}
+}
+
+- (NSArray <KKAlbumInfo *> *)albumsOfArtistWithID:(NSString *)artistID
+{
+	@synchronized (self) {
+		NSMutableArray *albums = [[NSMutableArray alloc] init];
+		for (NSString *albumID in self.artistAlbumIDs[artistID]) {
+			KKAlbumInfo *album = self.albums[albumID];
+			if (album) {
+				[albums addObject:album];
+			}
+		}
+		return albums;
+	}
+}
+
+- (NSArray <KKTrackInfo *> *)tracksInAlbumWithID:(NSString *)albumID
+{
+	NSMutableArray <KKTrackInfo *> *tracks = [[NSMutableArray alloc] init];
+	@synchronized (self) {
+		for (NSString *trackID in self.albumTrackIDs[albumID]) {
+			KKTrackInfo *track = self.tracks[trackID];
+			if (track) {
+				[tracks addObject:track];
+			}
+		}
+	}
+	[tracks sortWithOptions:NSSortStable usingComparator:^NSComparisonResult(KKTrackInfo *a, KKTrackInfo *b) {
+		if (a.trackOrderInAlbum == b.trackOrderInAlbum) {
+			return NSOrderedSame;
+		}
+		return a.trackOrderInAlbum < b.trackOrderInAlbum ? NSOrderedAscending : NSOrderedDescending;
+	}];
+	return tracks;
+}
+
+- (KKBOXOpenAPIObject *)_objectForEntry:(KKCatalogNameEntry *)entry
+{
+	switch (entry.type) {
+		case KKSearchTypeArtist:
+			return self.artists[entry.objectID];
+		case KKSearchTypeAlbum:
+			return self.albums[entry.objectID];
+		case KKSearchTypeTrack:
+			return self.tracks[entry.objectID];
+		case KKSearchTypePlaylist:
+			return self.playlists[entry.objectID];
+		default:
+			break;
+	}
+	return nil;
+}
+
+- (NSArray <KKBOXOpenAPIObject *> *)objectsWithNamePrefix:(NSString *)prefix types:(KKSearchType)types limit:(NSUInteger)limit
+{
+	NSParameterAssert(prefix);
+	NSString *key = KKCatalogNormalizedName(prefix);
+	NSMutableArray *results = [[NSMutableArray alloc] init];
+	@synchronized (self) {
+		KKCatalogNameEntry *lowerBound = [[KKCatalogNameEntry alloc] init];
+		lowerBound.key = key;
+		lowerBound.objectID = @"";
+		lowerBound.type = KKSearchTypeNone;
+		NSUInteger index = [self _indexOfEntry:lowerBound options:NSBinarySearchingInsertionIndex];
+		NSUInteger count = self.nameIndex.count;
+		for (; index < count; index++) {
+			KKCatalogNameEntry *entry = self.nameIndex[index];
+			if (![entry.key hasPrefix:key]) {
+				break;
+			}
+			if (types != KKSearchTypeNone && !(types & entry.type)) {
+				continue;
+			}
+			KKBOXOpenAPIObject *object = [self _objectForEntry:entry];
+			if (object) {
+				[results addObject:object];
+			}
+			if (limit && results.count >= limit) {
+				break;
+			}
+		}
+	}
+	return results;
+}
+
+#pragma mark - Properties
+
+- (NSUInteger)trackCount
+{
+	@synchronized (self) {
+		return self.tracks.count;
+	}
+}
+
+- (NSUInteger)albumCount
+{
+	@synchronized (self) {
+		return self.albums.count;
+	}
+}
+
+- (NSUInteger)artistCount
+{
+	@synchronized (self) {
+		return self.artists.count;
+	}
+}
+
+- (NSUInteger)playlistCount
+{
+	@synchronized (self) {
+		return self.playlists.count;
+	}
+}
+
+@end
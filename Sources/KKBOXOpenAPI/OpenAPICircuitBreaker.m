@@ -0,0 +1,230 @@
+//
+// OpenAPICircuitBreaker.m
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+#import "OpenAPICircuitBreaker.h"
+#import "OpenAPI+Privates.h"
+#import <objc/runtime.h>
+
+NSString *const KKCircuitBreakerStateDidChangeNotification = @"KKCircuitBreakerStateDidChangeNotification";
+NSString *const KKCircuitBreakerEndpointKey = @"endpoint";
+NSString *const KKCircuitBreakerStateKey = @"state";
+
+static char KKStaleKey;
+
+id KKStaleCopyOfJSONObject(id JSONObject)
+{
+	if ([JSONObject isKindOfClass:[NSDictionary class]]) {
+		// Always a mutable dictionary: immutable empty dictionaries may
+		// be a shared singleton, which must not be marked.
+		NSMutableDictionary *copy = [[NSMutableDictionary alloc] initWithCapacity:[JSONObject count]];
+		[(NSDictionary *)JSONObject enumerateKeysAndObjectsUsingBlock:^(id key, id object, BOOL *stop) {
+			copy[key] = KKStaleCopyOfJSONObject(object);
+		}];
+		objc_setAssociatedObject(copy, &KKStaleKey, @YES, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+		return copy;
+	}
+	if ([JSONObject isKindOfClass:[NSArray class]]) {
+		NSMutableArray *copy = [[NSMutableArray alloc] initWithCapacity:[JSONObject count]];
+		for (id object in JSONObject) {
+			[copy addObject:KKStaleCopyOfJSONObject(object)];
+		}
+		return copy;
+	}
+	return JSONObject;
+}
+
+BOOL KKIsStaleJSONObject(id JSONObject)
+{
+	return JSONObject && [objc_getAssociatedObject(JSONObject, &KKStaleKey) boolValue];
+}
+
+/** The circuit of an endpoint. */
+@interface KKCircuit : NSObject
+@property (assign, nonatomic) KKCircuitState state;
+/** The recent outcomes, YES for success. */
+@property (strong, nonatomic) NSMutableArray <NSNumber *> *outcomes;
+@property (assign, nonatomic) NSUInteger failureCount;
+@property (assign, nonatomic) CFAbsoluteTime openedTime;
+@property (assign, nonatomic) NSUInteger trialsInFlight;
+@property (assign, nonatomic) NSUInteger trialSuccessCount;
+@end
+
+@implementation KKCircuit
+@end
+
+@interface KKCircuitBreaker ()
+@property (strong, nonatomic) NSMutableDictionary <NSString *, KKCircuit *> *circuits;
+@property (assign) NSUInteger rejectedCallCount;
+@end
+
+@implementation KKCircuitBreaker
+
+- (instancetype)init
+{
+	self = [super init];
+	if (self) {
+		self.circuits = [[NSMutableDictionary alloc] init];
+		self.failureRateThreshold = 0.5;
+		self.minimumCallCount = 10;
+		self.windowSize = 20;
+		self.slowCallDuration = 10;
+		self.openDuration = 30;
+		self.trialCallCount = 3;
+	}
+	return self;
+}
+
+- (KKCircuitState)stateForEndpoint:(NSString *)key
+{
+	@synchronized (self) {
+		KKCircuit *circuit = self.circuits[key];
+		if (!circuit) {
+			return KKCircuitStateClosed;
+		}
+		[self _updateStateOfCircuit:circuit endpointKey:key];
+		return circuit.state;
+	}
+}
+
+- (NSDictionary <NSString *, NSNumber *> *)endpointStates
+{
+	NSMutableDictionary *states = [[NSMutableDictionary alloc] init];
+	@synchronized (self) {
+		[self.circuits enumerateKeysAndObjectsUsingBlock:^(NSString *key, KKCircuit *circuit, BOOL *stop) {
+			[self _updateStateOfCircuit:circuit endpointKey:key];
+			states[key] = @(circuit.state);
+		}];
+	}
+	return states;
+}
+
+- (void)reset
+{
+	NSArray <NSString *> *reopenedKeys = nil;
+	@synchronized (self) {
+		reopenedKeys = [self.circuits keysOfEntriesPassingTest:^BOOL(NSString *key, KKCircuit *circuit, BOOL *stop) {
+			return circuit.state != KKCircuitStateClosed;
+		}].allObjects;
+		[self.circuits removeAllObjects];
+		self.rejectedCallCount = 0;
+	}
+	for (NSString *key in reopenedKeys) {
+		[self _postState:KKCircuitStateClosed forEndpointKey:key];
+	}
+}
+
+#pragma mark - Privates
+
+- (void)_postState:(KKCircuitState)state forEndpointKey:(NSString *)key
+{
+	dispatch_async(dispatch_get_main_queue(), ^{
+		[[NSNotificationCenter defaultCenter] postNotificationName:KKCircuitBreakerStateDidChangeNotification object:self userInfo:@{KKCircuitBreakerEndpointKey: key, KKCircuitBreakerStateKey: @(state)}];
+	});
+}
+
+- (KKCircuit *)_circuitForEndpointKey:(NSString *)key
+{
+	KKCircuit *circuit = self.circuits[key];
+	if (!circuit) {
+		circuit = [[KKCircuit alloc] init];
+		circuit.outcomes = [[NSMutableArray alloc] init];
+		self.circuits[key] = circuit;
+	}
+	return circuit;
+}
+
+- (void)_setState:(KKCircuitState)state ofCircuit:(KKCircuit *)circuit endpointKey:(NSString *)key
+{
+	circuit.state = state;
+	circuit.trialsInFlight = 0;
+	circuit.trialSuccessCount = 0;
+	if (state == KKCircuitStateOpen) {
+		circuit.openedTime = CFAbsoluteTimeGetCurrent();
+	}
+	if (state == KKCircuitStateClosed) {
+		[circuit.outcomes removeAllObjects];
+		circuit.failureCount = 0;
+	}
+	[self _postState:state forEndpointKey:key];
+}
+
+/** Turn an open circuit half-open once it has been open for `openDuration`. */
+- (void)_updateStateOfCircuit:(KKCircuit *)circuit endpointKey:(NSString *)key
+{
+	if (circuit.state == KKCircuitStateOpen && CFAbsoluteTimeGetCurrent() - circuit.openedTime >= self.openDuration) {
+		[self _setState:KKCircuitStateHalfOpen ofCircuit:circuit endpointKey:key];
+	}
+}
+
+- (KKCircuitPermission)permissionForEndpointKey:(NSString *)key
+{
+	@synchronized (self) {
+		KKCircuit *circuit = [self _circuitForEndpointKey:key];
+		[self _updateStateOfCircuit:circuit endpointKey:key];
+		switch (circuit.state) {
+			case KKCircuitStateClosed:
+				return KKCircuitPermissionAllowed;
+			case KKCircuitStateHalfOpen:
+				if (circuit.trialsInFlight < self.trialCallCount) {
+					circuit.trialsInFlight++;
+					return KKCircuitPermissionTrial;
+				}
+				break;
+			case KKCircuitStateOpen:
+				break;
+		}
+		self.rejectedCallCount++;
+		return KKCircuitPermissionRejected;
+	}
+}
+
+- (void)recordCallWithPermission:(KKCircuitPermission)permission succeeded:(BOOL)succeeded latency:(NSTimeInterval)latency forEndpointKey:(NSString *)key
+{
+	BOOL success = succeeded && latency < self.slowCallDuration;
+	@synchronized (self) {
+		KKCircuit *circuit = [self _circuitForEndpointKey:key];
+		if (permission == KKCircuitPermissionTrial) {
+			if (circuit.state != KKCircuitStateHalfOpen) {
+				return;
+			}
+			circuit.trialsInFlight--;
+			if (!success) {
+				[self _setState:KKCircuitStateOpen ofCircuit:circuit endpointKey:key];
+			}
+			else if (++circuit.trialSuccessCount >= self.trialCallCount) {
+				[self _setState:KKCircuitStateClosed ofCircuit:circuit endpointKey:key];
+			}
+			return;
+		}
+		if (permission != KKCircuitPermissionAllowed || circuit.state != KKCircuitStateClosed) {
+			return;
+		}
+		[circuit.outcomes addObject:@(success)];
+		circuit.failureCount += success ? 0 : 1;
+		while (circuit.outcomes.count > MAX(self.windowSize, 1)) {
+			circuit.failureCount -= [circuit.outcomes.firstObject boolValue] ? 0 : 1;
+			[circuit.outcomes removeObjectAtIndex:0];
+		}
+		if (circuit.outcomes.count >= self.minimumCallCount && (double) circuit.failureCount / circuit.outcomes.count >= self.failureRateThreshold) {
+			[self _setState:KKCircuitStateOpen ofCircuit:circuit endpointKey:key];
+		}
+	}
+}
+
+- (void)cancelCallWithPermission:(KKCircuitPermission)permission forEndpointKey:(NSString *)key
+{
+	if (permission != KKCircuitPermissionTrial) {
+		return;
+	}
+	@synchronized (self) {
+		KKCircuit *circuit = self.circuits[key];
+		if (circuit.state == KKCircuitStateHalfOpen && circuit.trialsInFlight > 0) {
+			circuit.trialsInFlight--;
+		}
+	}
+}
+
+@end
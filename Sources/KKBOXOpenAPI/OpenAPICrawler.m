@@ -0,0 +1,333 @@
+//
+// OpenAPICrawler.m
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+#import "OpenAPICrawler.h"
+
+static NSString *const KKCrawlCheckpointVersionKey = @"version";
+static NSString *const KKCrawlCheckpointTerritoryKey = @"territory";
+static NSString *const KKCrawlCheckpointDepthKey = @"maximum_depth";
+static NSString *const KKCrawlCheckpointExpansionKey = @"expansion";
+static NSString *const KKCrawlCheckpointVisitedKey = @"visited";
+static NSString *const KKCrawlCheckpointPendingKey = @"pending";
+static NSString *const KKCrawlCheckpointFailedKey = @"failed";
+static const NSInteger KKCrawlCheckpointVersion = 1;
+
+typedef NS_ENUM(NSInteger, KKCrawlWorkKind)
+{
+	KKCrawlWorkKindArtist,
+	KKCrawlWorkKindRelatedArtists,
+	KKCrawlWorkKindAlbums,
+	KKCrawlWorkKindAlbumTracks,
+};
+
+/** A pending fetch. */
+@interface KKCrawlWorkItem : NSObject
+@property (assign, nonatomic) KKCrawlWorkKind kind;
+@property (strong, nonatomic) NSString *nodeID;
+@property (assign, nonatomic) NSUInteger depth;
+@property (assign, nonatomic) NSInteger offset;
+@property (strong, nonatomic) NSURLSessionDataTask *task;
+@end
+
+@implementation KKCrawlWorkItem
+
++ (instancetype)itemWithKind:(KKCrawlWorkKind)kind nodeID:(NSString *)nodeID depth:(NSUInteger)depth offset:(NSInteger)offset
+{
+	KKCrawlWorkItem *item = [[KKCrawlWorkItem alloc] init];
+	item.kind = kind;
+	item.nodeID = nodeID;
+	item.depth = depth;
+	item.offset = offset;
+	return item;
+}
+
++ (instancetype)itemWithPropertyList:(NSArray *)propertyList
+{
+	if (![propertyList isKindOfClass:[NSArray class]] || propertyList.count != 4 || ![propertyList[1] isKindOfClass:[NSString class]]) {
+		return nil;
+	}
+	KKCrawlWorkKind kind = [propertyList[0] integerValue];
+	if (kind < KKCrawlWorkKindArtist || kind > KKCrawlWorkKindAlbumTracks) {
+		return nil;
+	}
+	return [self itemWithKind:kind nodeID:propertyList[1] depth:[propertyList[2] unsignedIntegerValue] offset:[propertyList[3] integerValue]];
+}
+
+- (NSArray *)propertyList
+{
+	return @[@(self.kind), self.nodeID, @(self.depth), @(self.offset)];
+}
+
+@end
+
+@interface KKArtistGraphCrawler ()
+@property (strong, nonatomic) KKBOXOpenAPI *API;
+@property (assign, nonatomic) KKTerritoryCode territory;
+@property (strong, nonatomic) NSMutableSet <NSString *> *visited;
+/** FIFO, so that artists are visited breadth-first. */
+@property (strong, nonatomic) NSMutableArray <KKCrawlWorkItem *> *pending;
+@property (strong, nonatomic) NSMutableArray <KKCrawlWorkItem *> *inFlight;
+/** The fetches that failed, kept in checkpoints so that a resumed crawl retries them. */
+@property (strong, nonatomic) NSMutableArray <KKCrawlWorkItem *> *failed;
+@property (assign, nonatomic) NSUInteger completedRequestCount;
+@property (assign, nonatomic, getter=isRunning) BOOL running;
+@property (assign, nonatomic) BOOL finished;
+@end
+
+@implementation KKArtistGraphCrawler
+
+- (instancetype)initWithAPI:(KKBOXOpenAPI *)API territory:(KKTerritoryCode)territory
+{
+	NSParameterAssert(API);
+	self = [super init];
+	if (self) {
+		self.API = API;
+		self.territory = territory;
+		self.maximumDepth = 1;
+		self.expansion = KKCrawlExpansionAll;
+		self.maximumConcurrentRequests = 4;
+		self.visited = [[NSMutableSet alloc] init];
+		self.pending = [[NSMutableArray alloc] init];
+		self.inFlight = [[NSMutableArray alloc] init];
+		self.failed = [[NSMutableArray alloc] init];
+	}
+	return self;
+}
+
+- (instancetype)initWithAPI:(KKBOXOpenAPI *)API seedArtistIDs:(NSArray <NSString *> *)seedArtistIDs territory:(KKTerritoryCode)territory
+{
+	NSParameterAssert(seedArtistIDs);
+	self = [self initWithAPI:API territory:territory];
+	if (self) {
+		for (NSString *artistID in seedArtistIDs) {
+			[self.pending addObject:[KKCrawlWorkItem itemWithKind:KKCrawlWorkKindArtist nodeID:artistID depth:0 offset:0]];
+		}
+	}
+	return self;
+}
+
+- (instancetype)initWithAPI:(KKBOXOpenAPI *)API checkpoint:(NSDictionary *)checkpoint
+{
+	NSParameterAssert(checkpoint);
+	if ([checkpoint[KKCrawlCheckpointVersionKey] integerValue] != KKCrawlCheckpointVersion) {
+		return nil;
+	}
+	self = [self initWithAPI:API territory:(KKTerritoryCode) [checkpoint[KKCrawlCheckpointTerritoryKey] unsignedIntegerValue]];
+	if (self) {
+		self.maximumDepth = [checkpoint[KKCrawlCheckpointDepthKey] unsignedIntegerValue];
+		self.expansion = (KKCrawlExpansion) [checkpoint[KKCrawlCheckpointExpansionKey] unsignedIntegerValue];
+		NSArray *visited = checkpoint[KKCrawlCheckpointVisitedKey];
+		NSArray *pending = checkpoint[KKCrawlCheckpointPendingKey];
+		NSArray *failed = checkpoint[KKCrawlCheckpointFailedKey] ?: @[];
+		if (![visited isKindOfClass:[NSArray class]] || ![pending isKindOfClass:[NSArray class]] || ![failed isKindOfClass:[NSArray class]]) {
+			return nil;
+		}
+		[self.visited addObjectsFromArray:visited];
+		// The failed fetches are retried first.
+		for (NSArray *propertyList in [failed arrayByAddingObjectsFromArray:pending]) {
+			KKCrawlWorkItem *item = [KKCrawlWorkItem itemWithPropertyList:propertyList];
+			if (!item) {
+				return nil;
+			}
+			[self.pending addObject:item];
+		}
+	}
+	return self;
+}
+
+- (NSDictionary *)checkpoint
+{
+	NSMutableArray *pending = [[NSMutableArray alloc] init];
+	for (KKCrawlWorkItem *item in self.inFlight) {
+		[pending addObject:[item propertyList]];
+	}
+	for (KKCrawlWorkItem *item in self.pending) {
+		[pending addObject:[item propertyList]];
+	}
+	NSMutableArray *failed = [[NSMutableArray alloc] init];
+	for (KKCrawlWorkItem *item in self.failed) {
+		[failed addObject:[item propertyList]];
+	}
+	return @{KKCrawlCheckpointVersionKey: @(KKCrawlCheckpointVersion),
+		KKCrawlCheckpointTerritoryKey: @(self.territory),
+		KKCrawlCheckpointDepthKey: @(self.maximumDepth),
+		KKCrawlCheckpointExpansionKey: @(self.expansion),
+		KKCrawlCheckpointVisitedKey: [self.visited allObjects],
+		KKCrawlCheckpointPendingKey: pending,
+		KKCrawlCheckpointFailedKey: failed};
+}
+
+- (NSUInteger)pendingRequestCount
+{
+	return self.pending.count;
+}
+
+#pragma mark - Controlling
+
+- (void)start
+{
+	NSAssert([NSThread isMainThread], @"The crawler must be used on the main thread.");
+	NSAssert(self.maximumConcurrentRequests > 0, @"maximumConcurrentRequests must be greater than 0.");
+	if (self.finished || self.running) {
+		return;
+	}
+	self.running = YES;
+	[self _pump];
+}
+
+- (void)pause
+{
+	self.running = NO;
+}
+
+- (void)cancel
+{
+	if (self.finished) {
+		return;
+	}
+	for (KKCrawlWorkItem *item in self.inFlight) {
+		[item.task cancel];
+	}
+	[self _finishWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+}
+
+- (void)_finishWithError:(NSError *)error
+{
+	self.finished = YES;
+	self.running = NO;
+	[self.delegate crawlerDidFinish:self error:error];
+}
+
+#pragma mark - Graph
+
+- (void)_visitArtist:(KKArtistInfo *)artist depth:(NSUInteger)depth
+{
+	NSString *key = [@"artist:" stringByAppendingString:artist.artistID];
+	if (!artist.artistID.length || [self.visited containsObject:key]) {
+		return;
+	}
+	[self.visited addObject:key];
+	if ([self.delegate respondsToSelector:@selector(crawler:didDiscoverArtist:depth:)]) {
+		[self.delegate crawler:self didDiscoverArtist:artist depth:depth];
+	}
+	if ((self.expansion & KKCrawlExpansionRelatedArtists) && depth < self.maximumDepth) {
+		[self.pending addObject:[KKCrawlWorkItem itemWithKind:KKCrawlWorkKindRelatedArtists nodeID:artist.artistID depth:depth offset:0]];
+	}
+	if (self.expansion & KKCrawlExpansionAlbums) {
+		[self.pending addObject:[KKCrawlWorkItem itemWithKind:KKCrawlWorkKindAlbums nodeID:artist.artistID depth:depth offset:0]];
+	}
+}
+
+- (void)_visitAlbum:(KKAlbumInfo *)album depth:(NSUInteger)depth
+{
+	NSString *key = [@"album:" stringByAppendingString:album.albumID];
+	if (!album.albumID.length || [self.visited containsObject:key]) {
+		return;
+	}
+	[self.visited addObject:key];
+	if ([self.delegate respondsToSelector:@selector(crawler:didDiscoverAlbum:)]) {
+		[self.delegate crawler:self didDiscoverAlbum:album];
+	}
+	if (self.expansion & KKCrawlExpansionAlbumTracks) {
+		[self.pending addObject:[KKCrawlWorkItem itemWithKind:KKCrawlWorkKindAlbumTracks nodeID:album.albumID depth:depth offset:0]];
+	}
+}
+
+- (void)_enqueueNextPageOfItem:(KKCrawlWorkItem *)item count:(NSUInteger)count summary:(KKSummary *)summary
+{
+	NSInteger nextOffset = item.offset + (NSInteger) count;
+	if (count > 0 && nextOffset < summary.total) {
+		[self.pending addObject:[KKCrawlWorkItem itemWithKind:item.kind nodeID:item.nodeID depth:item.depth offset:nextOffset]];
+	}
+}
+
+#pragma mark - Fetching
+
+- (void)_pump
+{
+	while (self.running && self.inFlight.count < self.maximumConcurrentRequests && self.pending.count > 0) {
+		KKCrawlWorkItem *item = self.pending.firstObject;
+		[self.pending removeObjectAtIndex:0];
+		[self.inFlight addObject:item];
+		item.task = [self _fetchItem:item];
+	}
+	if (!self.finished && self.inFlight.count == 0 && self.pending.count == 0) {
+		[self _finishWithError:nil];
+	}
+}
+
+- (void)_completeItem:(KKCrawlWorkItem *)item error:(NSError *)error
+{
+	item.task = nil;
+	[self.inFlight removeObject:item];
+	self.completedRequestCount++;
+	if (error) {
+		[self.failed addObject:item];
+		if ([self.delegate respondsToSelector:@selector(crawler:didFailWithError:)]) {
+			[self.delegate crawler:self didFailWithError:error];
+		}
+	}
+	[self _pump];
+}
+
+- (NSURLSessionDataTask *)_fetchItem:(KKCrawlWorkItem *)item
+{
+	NSString *nodeID = item.nodeID;
+	switch (item.kind) {
+		case KKCrawlWorkKindArtist:
+			return [self.API fetchArtistInfoWithArtistID:nodeID territory:self.territory callback:^(KKArtistInfo *artist, NSError *error) {
+				if (self.finished) {
+					return;
+				}
+				if (artist) {
+					[self _visitArtist:artist depth:item.depth];
+				}
+				[self _completeItem:item error:error];
+			}];
+		case KKCrawlWorkKindRelatedArtists:
+			return [self.API fetchRelatedArtistsWithArtistID:nodeID territory:self.territory offset:item.offset limit:20 callback:^(NSArray <KKArtistInfo *> *artists, KKPagingInfo *paging, KKSummary *summary, NSError *error) {
+				if (self.finished) {
+					return;
+				}
+				if (artists) {
+					if ([self.delegate respondsToSelector:@selector(crawler:didFetchRelatedArtists:ofArtistID:)]) {
+						[self.delegate crawler:self didFetchRelatedArtists:artists ofArtistID:nodeID];
+					}
+					for (KKArtistInfo *artist in artists) {
+						[self _visitArtist:artist depth:item.depth + 1];
+					}
+					[self _enqueueNextPageOfItem:item count:artists.count summary:summary];
+				}
+				[self _completeItem:item error:error];
+			}];
+		case KKCrawlWorkKindAlbums:
+			return [self.API fetchAlbumsBelongToArtistID:nodeID territory:self.territory offset:item.offset limit:100 callback:^(NSArray <KKAlbumInfo *> *albums, KKPagingInfo *paging, KKSummary *summary, NSError *error) {
+				if (self.finished) {
+					return;
+				}
+				for (KKAlbumInfo *album in albums) {
+					[self _visitAlbum:album depth:item.depth];
+				}
+				[self _enqueueNextPageOfItem:item count:albums.count summary:summary];
+				[self _completeItem:item error:error];
+			}];
+		case KKCrawlWorkKindAlbumTracks:
+			return [self.API fetchTracksWithAlbumID:nodeID territory:self.territory offset:item.offset limit:100 callback:^(NSArray <KKTrackInfo *> *tracks, KKPagingInfo *paging, KKSummary *summary, NSError *error) {
+				if (self.finished) {
+					return;
+				}
+				if (tracks && [self.delegate respondsToSelector:@selector(crawler:didDiscoverTracks:inAlbumID:)]) {
+					[self.delegate crawler:self didDiscoverTracks:tracks inAlbumID:nodeID];
+				}
+				[self _enqueueNextPageOfItem:item count:tracks.count summary:summary];
+				[self _completeItem:item error:error];
+			}];
+	}
+	NSAssert(NO, @"Unknown crawl work kind %ld", (long) item.kind);
+	return nil;
+}
+
+@end
@@ -0,0 +1,506 @@
+//
+// OpenAPIEndpoint.m
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+#import "OpenAPI.h"
+#import "OpenAPI+Privates.h"
+#import "OpenAPICatalogStore.h"
+#import "OpenAPIEndpointMetrics.h"
+#import "OpenAPICatalogSnapshot.h"
+#import <objc/runtime.h>
+
+@interface KKEndpointMetrics ()
+@property (readwrite, strong, nonnull, nonatomic) NSString *name;
+@property (readwrite, assign, nonatomic) NSUInteger requestCount;
+@property (readwrite, assign, nonatomic) NSUInteger coalescedCount;
+@property (readwrite, assign, nonatomic) NSUInteger retryCount;
+@property (readwrite, assign, nonatomic) NSUInteger failureCount;
+@property (readwrite, assign, nonatomic) NSUInteger objectCount;
+@property (readwrite, assign, nonatomic) NSTimeInterval totalLatency;
+/** The amount of the calls that were sent and answered. */
+@property (assign, nonatomic) NSUInteger responseCount;
+@end
+
+@class KKEndpointTask;
+
+/** A call in flight, and the callers waiting for it. */
+@interface KKEndpointCall : NSObject
+@property (assign, nonatomic) const KKEndpointDescriptor *endpoint;
+@property (strong, nonatomic) NSURL *URL;
+/** The key of the call in the calls in flight. */
+@property (strong, nonatomic) NSString *key;
+/** The path and the query without the offset and the limit, which names the call in snapshots. */
+@property (strong, nonatomic) NSString *requestKey;
+@property (assign, nonatomic) NSInteger offset;
+/** The task of the current attempt. */
+@property (strong) NSURLSessionDataTask *task;
+/** Set once the callers are being called back. Guarded by synchronizing on the calls in flight. */
+@property (assign, nonatomic) BOOL finished;
+/** The callers still waiting. Guarded by synchronizing on the calls in flight. */
+@property (strong, nonatomic) NSMutableArray<KKEndpointTask *> *waiters;
+/** Set when every caller has given up. Guarded by synchronizing on the calls in flight. */
+@property (assign, nonatomic) BOOL cancelled;
+@property (strong, nonatomic) dispatch_queue_t callbackQueue;
+@property (assign, nonatomic) NSUInteger attempt;
+@property (assign, nonatomic) CFAbsoluteTime startTime;
+@end
+
+/**
+ * The task handed to a caller of an endpoint call. It forwards to the
+ * task of the current attempt, which is replaced when the call is
+ * retried, but reports the state of the whole call. Cancelling it only
+ * gives up this caller; the call is cancelled once none of its callers
+ * is left.
+ */
+@interface KKEndpointTask : NSProxy
+- (instancetype)initWithAPI:(KKBOXOpenAPI *)API callback:(KKEndpointCallback)callback callbackQueue:(dispatch_queue_t)callbackQueue;
+@property (strong, nonatomic) KKBOXOpenAPI *API;
+@property (strong, nonatomic) KKEndpointCall *call;
+@property (copy, nonatomic) KKEndpointCallback callback;
+@property (strong, nonatomic) dispatch_queue_t callbackQueue;
+@property (assign) BOOL cancelled;
+@end
+
+static NSString *KKEscapedPathComponent(NSString *string)
+{
+	static NSCharacterSet *allowedCharacters;
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		NSMutableCharacterSet *set = [[NSCharacterSet URLPathAllowedCharacterSet] mutableCopy];
+		[set removeCharactersInString:@"/"];
+		allowedCharacters = [set copy];
+	});
+	return [string stringByAddingPercentEncodingWithAllowedCharacters:allowedCharacters];
+}
+
+static NSString *KKEscapedQueryValue(NSString *string)
+{
+	static NSCharacterSet *allowedCharacters;
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		NSMutableCharacterSet *set = [[NSCharacterSet URLQueryAllowedCharacterSet] mutableCopy];
+		[set removeCharactersInString:@"&=+#"];
+		allowedCharacters = [set copy];
+	});
+	return [string stringByAddingPercentEncodingWithAllowedCharacters:allowedCharacters];
+}
+
+/** The value at a dot-separated key path, or nil if a step is not a dictionary. */
+static id KKValueAtKeyPath(NSDictionary *dictionary, NSString *keyPath)
+{
+	id value = dictionary;
+	for (NSString *key in [keyPath componentsSeparatedByString:@"."]) {
+		if (![value isKindOfClass:[NSDictionary class]]) {
+			return nil;
+		}
+		value = value[key];
+	}
+	return value;
+}
+
+/** If an error may go away by sending the request again. */
+static BOOL KKIsTransientError(NSError *error)
+{
+	if (![error.domain isEqualToString:NSURLErrorDomain]) {
+		return NO;
+	}
+	switch (error.code) {
+		case NSURLErrorTimedOut:
+		case NSURLErrorNetworkConnectionLost:
+		case NSURLErrorCannotConnectToHost:
+		case NSURLErrorCannotFindHost:
+		case NSURLErrorDNSLookupFailed:
+		case NSURLErrorNotConnectedToInternet:
+			return YES;
+		default:
+			return NO;
+	}
+}
+
+@implementation KKBOXOpenAPI (Endpoints)
+
+- (NSURLSessionDataTask *)_taskWithEndpoint:(const KKEndpointDescriptor *)endpoint ID:(NSString *)ID parameters:(NSDictionary<NSString *, NSString *> *)parameters territory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit callback:(KKEndpointCallback)callback
+{
+	NSParameterAssert(endpoint);
+	NSParameterAssert(callback);
+
+	NSString *requestKey = nil;
+	NSURL *URL = [self _URLForEndpoint:endpoint ID:ID parameters:parameters territory:territory offset:offset limit:limit requestKey:&requestKey];
+
+	KKEndpointCall *call = [[KKEndpointCall alloc] init];
+	call.endpoint = endpoint;
+	call.URL = URL;
+	call.key = URL.absoluteString;
+	call.requestKey = requestKey;
+	call.offset = endpoint->paged ? offset : 0;
+	call.waiters = [NSMutableArray array];
+	call.callbackQueue = [self _currentCallbackQueue];
+	call.startTime = CFAbsoluteTimeGetCurrent();
+
+	KKEndpointTask *task = [[KKEndpointTask alloc] initWithAPI:self callback:callback callbackQueue:call.callbackQueue];
+
+	KKEndpointResult *snapshotResult = [self _snapshotResultOfEndpoint:endpoint requestKey:call.requestKey offset:offset limit:limit];
+	if (snapshotResult) {
+		[self _updateMetricsForEndpoint:endpoint usingBlock:^(KKEndpointMetrics *metrics) {
+			metrics.requestCount++;
+			metrics.objectCount += snapshotResult.objects.count + (snapshotResult.object ? 1 : 0);
+		}];
+		// The call never goes out, so the task of the caller forwards to
+		// one that is never sent.
+		call.task = [self.URLSession dataTaskWithURL:URL];
+		[call.task cancel];
+		task.call = call;
+		[call.waiters addObject:task];
+		dispatch_async(call.callbackQueue, ^{
+			[self _callBackWaiters:[self _takeWaitersOfCall:call] ofCall:call result:snapshotResult error:nil];
+		});
+		return (NSURLSessionDataTask *)task;
+	}
+
+	// The task is created under the lock, so that a call joining this
+	// one always finds it.
+	@synchronized (self.endpointCalls) {
+		KKEndpointCall *inFlightCall = self.coalescesRequests ? self.endpointCalls[call.key] : nil;
+		[self _updateMetricsForEndpoint:endpoint usingBlock:^(KKEndpointMetrics *metrics) {
+			metrics.requestCount++;
+			if (inFlightCall) {
+				metrics.coalescedCount++;
+			}
+		}];
+		if (inFlightCall) {
+			task.call = inFlightCall;
+			[inFlightCall.waiters addObject:task];
+			return (NSURLSessionDataTask *)task;
+		}
+		if (self.coalescesRequests) {
+			self.endpointCalls[call.key] = call;
+		}
+		task.call = call;
+		[call.waiters addObject:task];
+		call.task = [self _sendEndpointCall:call];
+		return (NSURLSessionDataTask *)task;
+	}
+}
+
+- (NSURL *)_URLForEndpoint:(const KKEndpointDescriptor *)endpoint ID:(NSString *)ID parameters:(NSDictionary<NSString *, NSString *> *)parameters territory:(KKTerritoryCode)territory offset:(NSInteger)offset limit:(NSInteger)limit requestKey:(NSString **)outRequestKey
+{
+	NSString *path = endpoint->pathTemplate;
+	if (ID) {
+		path = [path stringByReplacingOccurrencesOfString:@"{id}" withString:KKEscapedPathComponent(ID)];
+	}
+	NSMutableString *requestKey = [NSMutableString stringWithFormat:@"%@?territory=%@", path, KKStringFromTerritoryCode(territory)];
+	for (NSString *name in [parameters.allKeys sortedArrayUsingSelector:@selector(compare:)]) {
+		[requestKey appendFormat:@"&%@=%@", name, KKEscapedQueryValue(parameters[name])];
+	}
+	NSMutableString *URLString = [NSMutableString stringWithFormat:@"%@%@", self.APIBaseURL.absoluteString, requestKey];
+	if (endpoint->paged) {
+		[URLString appendFormat:@"&offset=%ld&limit=%ld", (long) offset, (long) limit];
+	}
+	if (outRequestKey) {
+		*outRequestKey = [requestKey copy];
+	}
+	return [NSURL URLWithString:URLString];
+}
+
+- (NSURLSessionDataTask *)_sendEndpointCall:(KKEndpointCall *)call
+{
+	return [self _apiTaskWithURL:call.URL endpointKey:call.endpoint->pathTemplate callbackQueue:call.callbackQueue callback:^(id JSONObject, NSError *error) {
+		if (error && call.attempt < self.maximumRetryCount && KKIsTransientError(error)) {
+			NSTimeInterval delay = self.retryInterval * pow(2, call.attempt);
+			call.attempt++;
+			[self _updateMetricsForEndpoint:call.endpoint usingBlock:^(KKEndpointMetrics *metrics) {
+				metrics.retryCount++;
+			}];
+			dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t) (delay * NSEC_PER_SEC)), call.callbackQueue, ^{
+				@synchronized (self.endpointCalls) {
+					// Every caller gave up during the wait.
+					if (call.cancelled) {
+						return;
+					}
+					call.task = [self _sendEndpointCall:call];
+				}
+			});
+			return;
+		}
+		[self _finishEndpointCall:call JSONObject:JSONObject error:error];
+	}];
+}
+
+- (void)_finishEndpointCall:(KKEndpointCall *)call JSONObject:(id)JSONObject error:(NSError *)error
+{
+	KKEndpointResult *result = nil;
+	if (!error) {
+		if ([JSONObject isKindOfClass:[NSDictionary class]]) {
+			result = [self _resultOfEndpoint:call.endpoint dictionary:JSONObject];
+			[self.snapshotBuilder _recordResult:result paged:call.endpoint->paged requestKey:call.requestKey offset:call.offset];
+		}
+		else {
+			error = [NSError errorWithDomain:KKBOXOpenAPIErrorDomain code:1 userInfo:@{NSLocalizedDescriptionKey: @"Invalid response"}];
+		}
+	}
+
+	NSArray<KKEndpointTask *> *waiters = [self _takeWaitersOfCall:call];
+	[self _updateMetricsForEndpoint:call.endpoint usingBlock:^(KKEndpointMetrics *metrics) {
+		metrics.responseCount++;
+		metrics.totalLatency += CFAbsoluteTimeGetCurrent() - call.startTime;
+		metrics.objectCount += result.objects.count + (result.object ? 1 : 0);
+		if (error) {
+			metrics.failureCount += waiters.count;
+		}
+	}];
+	[self _callBackWaiters:waiters ofCall:call result:result error:error];
+}
+
+/** Finish a call and take the callers still waiting for it. */
+- (NSArray<KKEndpointTask *> *)_takeWaitersOfCall:(KKEndpointCall *)call
+{
+	@synchronized (self.endpointCalls) {
+		if (self.endpointCalls[call.key] == call) {
+			[self.endpointCalls removeObjectForKey:call.key];
+		}
+		// Callers cannot give up once they are being called back.
+		call.finished = YES;
+		NSArray<KKEndpointTask *> *waiters = [call.waiters copy];
+		[call.waiters removeAllObjects];
+		return waiters;
+	}
+}
+
+/** Called on the queue of the call. */
+- (void)_callBackWaiters:(NSArray<KKEndpointTask *> *)waiters ofCall:(KKEndpointCall *)call result:(KKEndpointResult *)result error:(NSError *)error
+{
+	// The response comes on the queue of the call; the callers that
+	// joined from other queues are called back on theirs.
+	for (KKEndpointTask *waiter in waiters) {
+		KKEndpointCallback callback = waiter.callback;
+		if (waiter.callbackQueue == call.callbackQueue) {
+			callback(result, error);
+		}
+		else {
+			dispatch_async(waiter.callbackQueue, ^{
+				callback(result, error);
+			});
+		}
+	}
+}
+
+- (KKEndpointResult *)_resultOfEndpoint:(const KKEndpointDescriptor *)endpoint dictionary:(NSDictionary *)dictionary
+{
+	Class modelClass = objc_getClass(endpoint->modelClassName);
+	NSAssert(modelClass, @"Unknown model class %s", endpoint->modelClassName);
+	KKEndpointResult *result = [[KKEndpointResult alloc] init];
+
+	if (endpoint->shape == KKEndpointShapeObject) {
+		result.object = [[modelClass alloc] initWithDictionary:dictionary];
+	}
+	else {
+		NSMutableArray *objects = [[NSMutableArray alloc] init];
+		NSArray *list = KKValueAtKeyPath(dictionary, endpoint->dataKeyPath);
+		if ([list isKindOfClass:[NSArray class]]) {
+			for (NSDictionary *objectDictionary in list) {
+				[objects addObject:[[modelClass alloc] initWithDictionary:objectDictionary]];
+			}
+		}
+		result.objects = objects;
+	}
+	if (endpoint->shape == KKEndpointShapeContainerAndList) {
+		// The container is made of everything but its list.
+		NSString *listKey = [endpoint->dataKeyPath componentsSeparatedByString:@"."].firstObject;
+		NSMutableDictionary *containerDictionary = [dictionary mutableCopy];
+		[containerDictionary removeObjectForKey:listKey];
+		id containerJSONObject = KKIsStaleJSONObject(dictionary) ? KKStaleCopyOfJSONObject(containerDictionary) : containerDictionary;
+		result.object = [[objc_getClass(endpoint->containerClassName) alloc] initWithDictionary:containerJSONObject];
+	}
+	if (endpoint->pagingKeyPath) {
+		NSDictionary *pagingDictionary = endpoint->pagingKeyPath.length ? KKValueAtKeyPath(dictionary, endpoint->pagingKeyPath) : dictionary;
+		if ([pagingDictionary isKindOfClass:[NSDictionary class]]) {
+			result.paging = [[KKPagingInfo alloc] initWithDictionary:pagingDictionary[@"paging"]];
+			result.summary = [[KKSummary alloc] initWithDictionary:pagingDictionary[@"summary"]];
+		}
+		else {
+			result.paging = [[KKPagingInfo alloc] initWithDictionary:nil];
+			result.summary = [[KKSummary alloc] initWithDictionary:nil];
+		}
+	}
+
+	KKCatalogStore *catalogStore = self.catalogStore;
+	if (catalogStore) {
+		if (result.object) {
+			[catalogStore storeObject:result.object];
+		}
+		if (result.objects.count) {
+			[catalogStore storeObjects:result.objects];
+		}
+	}
+	return result;
+}
+
+/** The result of a call answered by the catalog snapshot, or nil if the snapshot cannot answer it. */
+- (KKEndpointResult *)_snapshotResultOfEndpoint:(const KKEndpointDescriptor *)endpoint requestKey:(NSString *)requestKey offset:(NSInteger)offset limit:(NSInteger)limit
+{
+	KKCatalogSnapshot *snapshot = self.catalogSnapshot;
+	if (!snapshot) {
+		return nil;
+	}
+	id object = nil;
+	NSArray *objects = nil;
+	KKPagingInfo *paging = nil;
+	NSInteger total = 0;
+	if (![snapshot _lookUpRequestKey:requestKey modelClass:objc_getClass(endpoint->modelClassName) object:&object objects:&objects paging:&paging total:&total]) {
+		return nil;
+	}
+	// The snapshot must hold what the endpoint returns.
+	if ((endpoint->shape != KKEndpointShapeList) != (object != nil) || (endpoint->shape != KKEndpointShapeObject) != (objects != nil)) {
+		return nil;
+	}
+
+	KKEndpointResult *result = [[KKEndpointResult alloc] init];
+	result.object = object;
+	result.objects = objects;
+	if (objects && endpoint->paged) {
+		if (offset < 0 || limit < 0) {
+			return nil;
+		}
+		// Only a page that the snapshot has all of, or that runs past
+		// the end of a list the snapshot has all of.
+		NSUInteger start = (NSUInteger)offset;
+		NSUInteger end = (NSUInteger)offset + (NSUInteger)limit;
+		if (end > objects.count && (NSInteger)objects.count < total) {
+			return nil;
+		}
+		start = MIN(start, objects.count);
+		result.objects = [objects subarrayWithRange:NSMakeRange(start, MIN(end, objects.count) - start)];
+	}
+	if (endpoint->pagingKeyPath) {
+		NSMutableDictionary *pagingDictionary = [NSMutableDictionary dictionary];
+		if (endpoint->paged) {
+			pagingDictionary[@"offset"] = @(offset);
+			pagingDictionary[@"limit"] = @(limit);
+			if (offset > 0) {
+				pagingDictionary[@"previous"] = [NSString stringWithFormat:@"%@%@&offset=%ld&limit=%ld", self.APIBaseURL.absoluteString, requestKey, (long) MAX(offset - limit, 0), (long) limit];
+			}
+			if (limit > 0 && offset + limit < total) {
+				pagingDictionary[@"next"] = [NSString stringWithFormat:@"%@%@&offset=%ld&limit=%ld", self.APIBaseURL.absoluteString, requestKey, (long) (offset + limit), (long) limit];
+			}
+		}
+		// An object that embeds a page of a list keeps the paging the
+		// API gave, which leads to another endpoint.
+		result.paging = paging ?: [[KKPagingInfo alloc] initWithDictionary:pagingDictionary];
+		result.summary = [[KKSummary alloc] initWithDictionary:@{@"total": @(total)}];
+	}
+	return result;
+}
+
+- (void)_updateMetricsForEndpoint:(const KKEndpointDescriptor *)endpoint usingBlock:(void (^)(KKEndpointMetrics *metrics))block
+{
+	@synchronized (self.mutableEndpointMetrics) {
+		KKEndpointMetrics *metrics = self.mutableEndpointMetrics[endpoint->pathTemplate];
+		if (!metrics) {
+			metrics = [[KKEndpointMetrics alloc] init];
+			metrics.name = endpoint->pathTemplate;
+			self.mutableEndpointMetrics[endpoint->pathTemplate] = metrics;
+		}
+		block(metrics);
+	}
+}
+
+@end
+
+@implementation KKEndpointMetrics
+
+- (id)copyWithZone:(NSZone *)zone
+{
+	KKEndpointMetrics *copy = [[KKEndpointMetrics allocWithZone:zone] init];
+	copy.name = self.name;
+	copy.requestCount = self.requestCount;
+	copy.coalescedCount = self.coalescedCount;
+	copy.retryCount = self.retryCount;
+	copy.failureCount = self.failureCount;
+	copy.objectCount = self.objectCount;
+	copy.totalLatency = self.totalLatency;
+	copy.responseCount = self.responseCount;
+	return copy;
+}
+
+- (NSTimeInterval)averageLatency
+{
+	return self.responseCount ? self.totalLatency / self.responseCount : 0;
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<%@ %@ requests:%lu coalesced:%lu retries:%lu failures:%lu objects:%lu average latency:%.3fs>", NSStringFromClass([self class]), self.name, (unsigned long) self.requestCount, (unsigned long) self.coalescedCount, (unsigned long) self.retryCount, (unsigned long) self.failureCount, (unsigned long) self.objectCount, self.averageLatency];
+}
+
+@end
+
+@implementation KKEndpointResult
+@end
+
+@implementation KKEndpointCall
+@end
+
+@implementation KKEndpointTask
+
+- (instancetype)initWithAPI:(KKBOXOpenAPI *)API callback:(KKEndpointCallback)callback callbackQueue:(dispatch_queue_t)callbackQueue
+{
+	self.API = API;
+	self.callback = callback;
+	self.callbackQueue = callbackQueue;
+	return self;
+}
+
+- (void)cancel
+{
+	KKBOXOpenAPI *API = self.API;
+	KKEndpointCall *call = self.call;
+	NSURLSessionDataTask *callTask = nil;
+	@synchronized (API.endpointCalls) {
+		// The proxies may compare equal to each other through their
+		// tasks, so they are looked up by identity.
+		if ([call.waiters indexOfObjectIdenticalTo:self] == NSNotFound) {
+			return;
+		}
+		[call.waiters removeObjectIdenticalTo:self];
+		self.cancelled = YES;
+		if (!call.waiters.count) {
+			call.cancelled = YES;
+			callTask = call.task;
+			if (API.endpointCalls[call.key] == call) {
+				[API.endpointCalls removeObjectForKey:call.key];
+			}
+		}
+	}
+	KKEndpointCallback callback = self.callback;
+	NSError *error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:@{NSURLErrorFailingURLErrorKey: call.URL}];
+	dispatch_async(self.callbackQueue, ^{
+		callback(nil, error);
+	});
+	[callTask cancel];
+}
+
+- (NSURLSessionTaskState)state
+{
+	if (self.cancelled) {
+		return NSURLSessionTaskStateCanceling;
+	}
+	// The task of an attempt may be done while the call waits to be
+	// retried, or to answer from the response cache.
+	@synchronized (self.API.endpointCalls) {
+		return self.call.finished ? NSURLSessionTaskStateCompleted : NSURLSessionTaskStateRunning;
+	}
+}
+
+- (NSMethodSignature *)methodSignatureForSelector:(SEL)selector
+{
+	return [self.call.task methodSignatureForSelector:selector];
+}
+
+- (void)forwardInvocation:(NSInvocation *)invocation
+{
+	[invocation invokeWithTarget:self.call.task];
+}
+
+@end
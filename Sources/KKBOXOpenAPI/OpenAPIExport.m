@@ -0,0 +1,356 @@
+//
+// OpenAPIExport.m
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+#import "OpenAPIExport.h"
+#import "OpenAPI+Privates.h"
+
+typedef NS_ENUM(NSUInteger, KKExportJobKind)
+{
+	KKExportJobKindCharts,
+	KKExportJobKindFeaturedPlaylists,
+	KKExportJobKindNewReleaseCategories,
+	KKExportJobKindPlaylistTracks,
+	KKExportJobKindNewReleaseAlbums,
+};
+
+/** A page that is still to be fetched. */
+@interface KKExportJob : NSObject
+@property (assign, nonatomic) KKExportJobKind kind;
+@property (assign, nonatomic) KKTerritoryCode territory;
+@property (strong, nonatomic) NSString *parentID;
+@property (assign, nonatomic) NSInteger offset;
+@end
+
+@implementation KKExportJob
+@end
+
+static NSDictionary <NSString *, id> *KKExportRecordFromObject(KKBOXOpenAPIObject *object)
+{
+	NSMutableDictionary *record = [[NSMutableDictionary alloc] init];
+	if ([object isKindOfClass:[KKTrackInfo class]]) {
+		KKTrackInfo *track = (KKTrackInfo *)object;
+		record[@"kind"] = @"track";
+		record[@"id"] = track.trackID;
+		record[@"name"] = track.trackName;
+		record[@"url"] = track.trackURL.absoluteString;
+		record[@"album_id"] = track.album.albumID;
+		record[@"album_name"] = track.album.albumName;
+		record[@"artist_id"] = track.album.artist.artistID;
+		record[@"artist_name"] = track.album.artist.artistName;
+		record[@"duration"] = @(track.duration);
+		record[@"explicitness"] = @(track.explicitness);
+	}
+	else if ([object isKindOfClass:[KKAlbumInfo class]]) {
+		KKAlbumInfo *album = (KKAlbumInfo *)object;
+		record[@"kind"] = @"album";
+		record[@"id"] = album.albumID;
+		record[@"name"] = album.albumName;
+		record[@"url"] = album.albumURL.absoluteString;
+		record[@"artist_id"] = album.artist.artistID;
+		record[@"artist_name"] = album.artist.artistName;
+		record[@"explicitness"] = @(album.explicitness);
+		record[@"release_date"] = album.releaseDate;
+	}
+	else if ([object isKindOfClass:[KKPlaylistInfo class]]) {
+		KKPlaylistInfo *playlist = (KKPlaylistInfo *)object;
+		record[@"kind"] = @"playlist";
+		record[@"id"] = playlist.playlistID;
+		record[@"name"] = playlist.playlistTitle;
+		record[@"url"] = playlist.playlistURL.absoluteString;
+		record[@"updated_at"] = playlist.lastUpdateDate;
+	}
+	else if ([object isKindOfClass:[KKNewReleaseAlbumsCategory class]]) {
+		KKNewReleaseAlbumsCategory *category = (KKNewReleaseAlbumsCategory *)object;
+		record[@"kind"] = @"category";
+		record[@"id"] = category.categoryID;
+		record[@"name"] = category.categoryTitle;
+	}
+	return record;
+}
+
+static NSString *KKExportCSVField(id value)
+{
+	NSString *string = [value isKindOfClass:[NSString class]] ? value : ([value respondsToSelector:@selector(stringValue)] ? [value stringValue] : @"");
+	if ([string rangeOfCharacterFromSet:[NSCharacterSet characterSetWithCharactersInString:@",\"\r\n"]].location == NSNotFound) {
+		return string;
+	}
+	return [NSString stringWithFormat:@"\"%@\"", [string stringByReplacingOccurrencesOfString:@"\"" withString:@"\"\""]];
+}
+
+@interface KKExportPipeline ()
+@property (strong, nonatomic) KKBOXOpenAPI *API;
+@property (strong, nonatomic) NSURL *outputURL;
+@property (assign, nonatomic) KKExportFormat format;
+@property (strong, nonatomic) NSOutputStream *outputStream;
+@property (copy, nonatomic) void (^completion)(NSUInteger, NSError *);
+
+/** Pending pages. Used as a stack so that the children of a page are fetched before its next page. */
+@property (strong, nonatomic) NSMutableArray <KKExportJob *> *jobs;
+@property (strong, nonatomic) NSURLSessionDataTask *currentTask;
+@property (strong, nonatomic) dispatch_queue_t writeQueue;
+@property (strong, nonatomic) dispatch_queue_t waitQueue;
+@property (strong, nonatomic) dispatch_semaphore_t bufferSlots;
+@property (assign, nonatomic) BOOL fetching;
+@property (assign, nonatomic) BOOL finished;
+@property (strong, nonatomic) NSError *writeError;
+@property (assign) NSUInteger recordCount;
+@end
+
+@implementation KKExportPipeline
+
+- (instancetype)initWithAPI:(KKBOXOpenAPI *)API outputURL:(NSURL *)outputURL format:(KKExportFormat)format
+{
+	NSParameterAssert(API);
+	NSParameterAssert(outputURL);
+	self = [super init];
+	if (self) {
+		self.API = API;
+		self.outputURL = outputURL;
+		self.format = format;
+		self.territories = @[@(KKTerritoryCodeTaiwan), @(KKTerritoryCodeHongKong), @(KKTerritoryCodeSingapore), @(KKTerritoryCodeMalaysia), @(KKTerritoryCodeJapan)];
+		self.contents = KKExportContentAll;
+		self.columns = [KKExportPipeline availableColumns];
+		self.pageSize = 100;
+		self.maximumBufferedPages = 2;
+		self.jobs = [[NSMutableArray alloc] init];
+		self.writeQueue = dispatch_queue_create("com.kkbox.openapi.export.write", DISPATCH_QUEUE_SERIAL);
+		self.waitQueue = dispatch_queue_create("com.kkbox.openapi.export.wait", DISPATCH_QUEUE_SERIAL);
+	}
+	return self;
+}
+
++ (NSArray <NSString *> *)availableColumns
+{
+	return @[@"kind", @"territory", @"parent_id", @"id", @"name", @"url", @"artist_id", @"artist_name", @"album_id", @"album_name", @"duration", @"explicitness", @"release_date", @"updated_at"];
+}
+
+#pragma mark - Sink
+
+- (void)_writeString:(NSString *)string
+{
+	if (self.writeError) {
+		return;
+	}
+	NSData *data = [string dataUsingEncoding:NSUTF8StringEncoding];
+	const uint8_t *bytes = data.bytes;
+	NSUInteger remaining = data.length;
+	while (remaining > 0) {
+		NSInteger written = [self.outputStream write:bytes maxLength:remaining];
+		if (written <= 0) {
+			NSError *error = self.outputStream.streamError ?: [NSError errorWithDomain:KKBOXOpenAPIErrorDomain code:3 userInfo:@{NSLocalizedDescriptionKey: @"Failed to write the export file"}];
+			self.writeError = error;
+			// Stop fetching instead of walking the rest of the catalog.
+			dispatch_async(dispatch_get_main_queue(), ^{
+				[self.currentTask cancel];
+				[self _finishWithError:error];
+			});
+			return;
+		}
+		bytes += written;
+		remaining -= (NSUInteger) written;
+	}
+}
+
+- (NSString *)_lineForRecord:(NSDictionary *)record
+{
+	if (self.format == KKExportFormatCSV) {
+		NSMutableArray *fields = [[NSMutableArray alloc] initWithCapacity:self.columns.count];
+		for (NSString *column in self.columns) {
+			[fields addObject:KKExportCSVField(record[column])];
+		}
+		return [[fields componentsJoinedByString:@","] stringByAppendingString:@"\n"];
+	}
+	NSMutableDictionary *selected = [[NSMutableDictionary alloc] initWithCapacity:self.columns.count];
+	for (NSString *column in self.columns) {
+		selected[column] = record[column] ?: [NSNull null];
+	}
+	NSData *JSONData = [NSJSONSerialization dataWithJSONObject:selected options:0 error:nil];
+	return [[[NSString alloc] initWithData:JSONData encoding:NSUTF8StringEncoding] stringByAppendingString:@"\n"];
+}
+
+/** Called on the write queue. */
+- (void)_writeObjects:(NSArray <KKBOXOpenAPIObject *> *)objects job:(KKExportJob *)job
+{
+	NSString *territory = KKStringFromTerritoryCode(job.territory);
+	NSUInteger count = 0;
+	for (KKBOXOpenAPIObject *object in objects) {
+		@autoreleasepool {
+			NSMutableDictionary *record = [KKExportRecordFromObject(object) mutableCopy];
+			record[@"territory"] = territory;
+			record[@"parent_id"] = job.parentID;
+			[self _writeString:[self _lineForRecord:record]];
+			count++;
+		}
+	}
+	self.recordCount += count;
+}
+
+#pragma mark - Jobs
+
+- (void)_pushJobWithKind:(KKExportJobKind)kind territory:(KKTerritoryCode)territory parentID:(NSString *)parentID offset:(NSInteger)offset
+{
+	KKExportJob *job = [[KKExportJob alloc] init];
+	job.kind = kind;
+	job.territory = territory;
+	job.parentID = parentID;
+	job.offset = offset;
+	[self.jobs addObject:job];
+}
+
+- (void)startWithCompletion:(void (^)(NSUInteger, NSError *))completion
+{
+	NSParameterAssert(completion);
+	NSAssert(!self.completion, @"An export pipeline can be started only once.");
+	NSAssert(self.maximumBufferedPages > 0, @"maximumBufferedPages must be greater than 0.");
+	self.completion = completion;
+	if (self.finished) {
+		// Cancelled before it was started; leave the output file alone.
+		dispatch_async(dispatch_get_main_queue(), ^{
+			completion(0, [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]);
+		});
+		return;
+	}
+	self.bufferSlots = dispatch_semaphore_create((long) self.maximumBufferedPages);
+	self.outputStream = [NSOutputStream outputStreamWithURL:self.outputURL append:NO];
+	[self.outputStream open];
+	if (self.format == KKExportFormatCSV) {
+		dispatch_async(self.writeQueue, ^{
+			[self _writeString:[[self.columns componentsJoinedByString:@","] stringByAppendingString:@"\n"]];
+		});
+	}
+
+	for (NSNumber *territoryNumber in [self.territories reverseObjectEnumerator]) {
+		KKTerritoryCode territory = (KKTerritoryCode) territoryNumber.unsignedIntegerValue;
+		if (self.contents & KKExportContentNewReleaseCategories) {
+			[self _pushJobWithKind:KKExportJobKindNewReleaseCategories territory:territory parentID:nil offset:0];
+		}
+		if (self.contents & KKExportContentFeaturedPlaylists) {
+			[self _pushJobWithKind:KKExportJobKindFeaturedPlaylists territory:territory parentID:nil offset:0];
+		}
+		if (self.contents & KKExportContentCharts) {
+			[self _pushJobWithKind:KKExportJobKindCharts territory:territory parentID:nil offset:0];
+		}
+	}
+	[self _pump];
+}
+
+- (void)cancel
+{
+	dispatch_async(dispatch_get_main_queue(), ^{
+		[self.currentTask cancel];
+		[self _finishWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+	});
+}
+
+/** Called on the main queue. */
+- (void)_pump
+{
+	if (self.finished || self.fetching) {
+		return;
+	}
+	KKExportJob *job = self.jobs.lastObject;
+	if (!job) {
+		[self _finishWithError:nil];
+		return;
+	}
+	[self.jobs removeLastObject];
+	self.fetching = YES;
+	dispatch_async(self.waitQueue, ^{
+		// Backpressure: wait until the writer drains a buffered page.
+		dispatch_semaphore_wait(self.bufferSlots, DISPATCH_TIME_FOREVER);
+		dispatch_async(dispatch_get_main_queue(), ^{
+			if (self.finished) {
+				dispatch_semaphore_signal(self.bufferSlots);
+				return;
+			}
+			self.currentTask = [self _fetchJob:job];
+		});
+	});
+}
+
+/** Called on the main queue when a page arrives. */
+- (void)_handleObjects:(NSArray <KKBOXOpenAPIObject *> *)objects summary:(KKSummary *)summary job:(KKExportJob *)job error:(NSError *)error
+{
+	self.fetching = NO;
+	self.currentTask = nil;
+	if (self.finished) {
+		dispatch_semaphore_signal(self.bufferSlots);
+		return;
+	}
+	if (error) {
+		dispatch_semaphore_signal(self.bufferSlots);
+		[self _finishWithError:error];
+		return;
+	}
+
+	NSInteger nextOffset = job.offset + (NSInteger) objects.count;
+	BOOL hasNextPage = objects.count > 0 && (summary.total > 0 ? nextOffset < summary.total : (NSInteger) objects.count >= self.pageSize);
+	if (hasNextPage) {
+		[self _pushJobWithKind:job.kind territory:job.territory parentID:job.parentID offset:nextOffset];
+	}
+	for (KKBOXOpenAPIObject *object in [objects reverseObjectEnumerator]) {
+		if ([object isKindOfClass:[KKPlaylistInfo class]] && (self.contents & KKExportContentPlaylistTracks)) {
+			[self _pushJobWithKind:KKExportJobKindPlaylistTracks territory:job.territory parentID:((KKPlaylistInfo *) object).playlistID offset:0];
+		}
+		else if ([object isKindOfClass:[KKNewReleaseAlbumsCategory class]] && (self.contents & KKExportContentNewReleaseAlbums)) {
+			[self _pushJobWithKind:KKExportJobKindNewReleaseAlbums territory:job.territory parentID:((KKNewReleaseAlbumsCategory *) object).categoryID offset:0];
+		}
+	}
+
+	dispatch_async(self.writeQueue, ^{
+		[self _writeObjects:objects job:job];
+		dispatch_semaphore_signal(self.bufferSlots);
+	});
+	[self _pump];
+}
+
+- (NSURLSessionDataTask *)_fetchJob:(KKExportJob *)job
+{
+	void (^listCallback)(NSArray *, KKPagingInfo *, KKSummary *, NSError *) = ^(NSArray *objects, KKPagingInfo *paging, KKSummary *summary, NSError *error) {
+		[self _handleObjects:objects summary:summary job:job error:error];
+	};
+	NSInteger offset = job.offset;
+	NSInteger limit = self.pageSize;
+	switch (job.kind) {
+		case KKExportJobKindCharts:
+			return [self.API fetchChartsForTerritory:job.territory offset:offset limit:limit callback:listCallback];
+		case KKExportJobKindFeaturedPlaylists:
+			return [self.API fetchFeaturedPlaylistsForTerritory:job.territory offset:offset limit:limit callback:listCallback];
+		case KKExportJobKindNewReleaseCategories:
+			return [self.API fetchNewReleaseAlbumCategoriesForTerritory:job.territory offset:offset limit:limit callback:listCallback];
+		case KKExportJobKindPlaylistTracks:
+			return [self.API fetchTracksInPlaylistWithPlaylistID:job.parentID territory:job.territory offset:offset limit:limit callback:listCallback];
+		case KKExportJobKindNewReleaseAlbums:
+			return [self.API fetchNewReleaseAlbumsUnderCategory:job.parentID territory:job.territory offset:offset limit:limit callback:^(KKNewReleaseAlbumsCategory *category, NSArray <KKAlbumInfo *> *albums, KKPagingInfo *paging, KKSummary *summary, NSError *error) {
+				listCallback(albums, paging, summary, error);
+			}];
+	}
+	NSAssert(NO, @"Unknown export job kind %lu", (unsigned long) job.kind);
+	return nil;
+}
+
+/** Called on the main queue. */
+- (void)_finishWithError:(NSError *)error
+{
+	if (self.finished) {
+		return;
+	}
+	self.finished = YES;
+	[self.jobs removeAllObjects];
+	dispatch_async(self.writeQueue, ^{
+		[self.outputStream close];
+		NSError *finalError = error ?: self.writeError;
+		NSUInteger recordCount = self.recordCount;
+		dispatch_async(dispatch_get_main_queue(), ^{
+			// Nil when the pipeline is cancelled before it is started.
+			if (self.completion) {
+				self.completion(recordCount, finalError);
+			}
+		});
+	});
+}
+
+@end
@@ -0,0 +1,118 @@
+//
+// OpenAPIHedging.m
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+#import "OpenAPIHedging.h"
+#import "OpenAPI+Privates.h"
+
+/** A circular buffer of the recent latencies of an endpoint. */
+@interface KKLatencyWindow : NSObject
+@property (strong, nonatomic) NSMutableArray <NSNumber *> *samples;
+@property (assign, nonatomic) NSUInteger nextIndex;
+@end
+
+@implementation KKLatencyWindow
+@end
+
+@interface KKHedgingPolicy ()
+@property (strong, nonatomic) NSMutableDictionary <NSString *, KKLatencyWindow *> *windows;
+@property (assign) NSUInteger requestCount;
+@property (assign) NSUInteger hedgeCount;
+@property (assign) NSUInteger hedgeWinCount;
+@end
+
+@implementation KKHedgingPolicy
+
+- (instancetype)init
+{
+	self = [super init];
+	if (self) {
+		self.percentile = 0.95;
+		self.minimumDelay = 0.05;
+		self.maximumHedgeRatio = 0.05;
+		self.windowSize = 100;
+		self.minimumSampleCount = 20;
+		self.windows = [[NSMutableDictionary alloc] init];
+	}
+	return self;
+}
+
+- (void)reset
+{
+	@synchronized (self) {
+		[self.windows removeAllObjects];
+		self.requestCount = 0;
+		self.hedgeCount = 0;
+		self.hedgeWinCount = 0;
+	}
+}
+
+- (double)hedgeRate
+{
+	@synchronized (self) {
+		return self.requestCount ? (double) self.hedgeCount / self.requestCount : 0;
+	}
+}
+
+- (double)hedgeWinRate
+{
+	@synchronized (self) {
+		return self.hedgeCount ? (double) self.hedgeWinCount / self.hedgeCount : 0;
+	}
+}
+
+- (NSTimeInterval)hedgeDelayForEndpointKey:(NSString *)key
+{
+	@synchronized (self) {
+		self.requestCount++;
+		NSArray <NSNumber *> *samples = self.windows[key].samples;
+		if (samples.count == 0 || samples.count < self.minimumSampleCount) {
+			return -1;
+		}
+		NSArray <NSNumber *> *sorted = [samples sortedArrayUsingSelector:@selector(compare:)];
+		double percentile = MIN(MAX(self.percentile, 0), 1);
+		NSUInteger index = MIN((NSUInteger) (percentile * sorted.count), sorted.count - 1);
+		return MAX([sorted[index] doubleValue], self.minimumDelay);
+	}
+}
+
+- (BOOL)acquireHedge
+{
+	@synchronized (self) {
+		if (self.hedgeCount + 1 > self.maximumHedgeRatio * self.requestCount) {
+			return NO;
+		}
+		self.hedgeCount++;
+		return YES;
+	}
+}
+
+- (void)recordHedgeWin
+{
+	@synchronized (self) {
+		self.hedgeWinCount++;
+	}
+}
+
+- (void)recordLatency:(NSTimeInterval)latency forEndpointKey:(NSString *)key
+{
+	@synchronized (self) {
+		KKLatencyWindow *window = self.windows[key];
+		if (!window) {
+			window = [[KKLatencyWindow alloc] init];
+			window.samples = [[NSMutableArray alloc] init];
+			self.windows[key] = window;
+		}
+		if (window.samples.count < self.windowSize) {
+			[window.samples addObject:@(latency)];
+		}
+		else if (self.windowSize > 0) {
+			window.samples[window.nextIndex % window.samples.count] = @(latency);
+			window.nextIndex = (window.nextIndex + 1) % window.samples.count;
+		}
+	}
+}
+
+@end
@@ -0,0 +1,460 @@
+//
+// OpenAPIImageLoader.m
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+#import "OpenAPIImageLoader.h"
+#import "OpenAPI.h"
+@import ImageIO;
+
+typedef void (^KKImageLoaderCompletion)(KKImage *, NSError *);
+
+/** 64-bit FNV-1a, used to name the cache files. */
+static uint64_t KKFNV1aHash(NSString *string)
+{
+	const char *bytes = string.UTF8String;
+	uint64_t hash = 14695981039346656037ULL;
+	for (; *bytes; bytes++) {
+		hash ^= (uint8_t) *bytes;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+static KKImage *KKDecodeImage(NSData *data, NSUInteger *cost)
+{
+	CGImageSourceRef source = CGImageSourceCreateWithData((__bridge CFDataRef) data, NULL);
+	if (!source) {
+		return nil;
+	}
+	// Decode now, on this queue, rather than lazily when the image is
+	// first drawn.
+	NSDictionary *options = @{(__bridge NSString *) kCGImageSourceShouldCacheImmediately: @YES};
+	CGImageRef CGImage = CGImageSourceCreateImageAtIndex(source, 0, (__bridge CFDictionaryRef) options);
+	CFRelease(source);
+	if (!CGImage) {
+		return nil;
+	}
+	*cost = CGImageGetBytesPerRow(CGImage) * CGImageGetHeight(CGImage);
+#if TARGET_OS_OSX
+	KKImage *image = [[NSImage alloc] initWithCGImage:CGImage size:NSZeroSize];
+#else
+	KKImage *image = [UIImage imageWithCGImage:CGImage];
+#endif
+	CGImageRelease(CGImage);
+	return image;
+}
+
+#pragma mark -
+
+/** A node of the doubly linked list of the memory cache. */
+@interface KKImageCacheNode : NSObject
+{
+@public
+	NSString *_key;
+	KKImage *_image;
+	NSUInteger _cost;
+	KKImageCacheNode *_next;
+	__unsafe_unretained KKImageCacheNode *_previous;
+}
+@end
+
+@implementation KKImageCacheNode
+@end
+
+/** A download shared by every load of the same URL. */
+@interface KKImageLoadOperation : NSObject
+@property (strong, nonatomic) NSString *key;
+@property (strong, nonatomic) NSURL *URL;
+@property (strong, nonatomic) NSMutableArray <KKImageLoadRequest *> *requests;
+@property (strong, nonatomic, nullable) NSURLSessionDataTask *task;
+@property (assign, nonatomic) BOOL cancelled;
+@end
+
+@implementation KKImageLoadOperation
+@end
+
+@interface KKImageLoadRequest ()
+@property (weak, nonatomic) KKImageLoader *loader;
+@property (weak, nonatomic) KKImageLoadOperation *operation;
+@property (copy, nonatomic) KKImageLoaderCompletion completion;
+@end
+
+@interface KKImageLoader ()
+- (void)_cancelRequest:(KKImageLoadRequest *)request;
+@end
+
+@implementation KKImageLoadRequest
+
+- (void)cancel
+{
+	[self.loader _cancelRequest:self];
+}
+
+@end
+
+#pragma mark -
+
+@interface KKImageLoader ()
+@property (strong, nonatomic) NSURLSession *URLSession;
+@property (strong, nonatomic, nullable) NSURL *cacheDirectoryURL;
+@property (strong, nonatomic) dispatch_queue_t IOQueue;
+@property (strong, nonatomic) dispatch_queue_t decodeQueue;
+@property (strong, nonatomic) NSMutableDictionary <NSString *, KKImageLoadOperation *> *operations;
+@property (strong, nonatomic) NSMutableDictionary <NSString *, KKImageCacheNode *> *memoryNodes;
+/** The most recently used node. */
+@property (strong, nonatomic, nullable) KKImageCacheNode *head;
+/** The least recently used node. */
+@property (unsafe_unretained, nonatomic, nullable) KKImageCacheNode *tail;
+@property (assign) NSUInteger memoryUsage;
+@property (assign, nonatomic) NSUInteger writesSinceTrim;
+@end
+
+@implementation KKImageLoader
+
++ (KKImageLoader *)sharedLoader
+{
+	static KKImageLoader *sharedLoader;
+	static dispatch_once_t onceToken;
+	dispatch_once(&onceToken, ^{
+		sharedLoader = [[KKImageLoader alloc] init];
+	});
+	return sharedLoader;
+}
+
+- (instancetype)init
+{
+	NSURL *cachesURL = [[NSFileManager defaultManager] URLsForDirectory:NSCachesDirectory inDomains:NSUserDomainMask].firstObject;
+	return [self initWithURLSession:[NSURLSession sharedSession] cacheDirectoryURL:[cachesURL URLByAppendingPathComponent:@"KKBOXOpenAPIImages" isDirectory:YES]];
+}
+
+- (instancetype)initWithURLSession:(NSURLSession *)URLSession cacheDirectoryURL:(NSURL *)cacheDirectoryURL
+{
+	NSParameterAssert(URLSession);
+	self = [super init];
+	if (self) {
+		self.URLSession = URLSession;
+		self.cacheDirectoryURL = cacheDirectoryURL;
+		self.IOQueue = dispatch_queue_create("com.kkbox.openapi.image-loader.io", DISPATCH_QUEUE_SERIAL);
+		self.decodeQueue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+		self.operations = [[NSMutableDictionary alloc] init];
+		self.memoryNodes = [[NSMutableDictionary alloc] init];
+		self.memoryCapacity = 32 * 1024 * 1024;
+		self.diskCapacity = 128 * 1024 * 1024;
+		if (cacheDirectoryURL) {
+			[[NSFileManager defaultManager] createDirectoryAtURL:cacheDirectoryURL withIntermediateDirectories:YES attributes:nil error:nil];
+		}
+	}
+	return self;
+}
+
+#pragma mark - Loading
+
+- (KKImageLoadRequest *)loadImageWithURL:(NSURL *)URL completion:(void (^)(KKImage *, NSError *))completion
+{
+	NSParameterAssert(URL);
+	NSParameterAssert(completion);
+	NSString *key = URL.absoluteString;
+	KKImageLoadRequest *request = [[KKImageLoadRequest alloc] init];
+	request.loader = self;
+	request.completion = completion;
+
+	KKImageLoadOperation *operation = nil;
+	@synchronized (self) {
+		KKImage *image = [self _memoryImageForKey:key];
+		if (image) {
+			request.completion = nil;
+			dispatch_async(dispatch_get_main_queue(), ^{
+				completion(image, nil);
+			});
+			return request;
+		}
+		operation = self.operations[key];
+		if (operation) {
+			request.operation = operation;
+			[operation.requests addObject:request];
+			return request;
+		}
+		operation = [[KKImageLoadOperation alloc] init];
+		operation.key = key;
+		operation.URL = URL;
+		operation.requests = [NSMutableArray arrayWithObject:request];
+		request.operation = operation;
+		self.operations[key] = operation;
+	}
+
+	dispatch_async(self.IOQueue, ^{
+		NSURL *fileURL = [self _fileURLForKey:key];
+		NSData *data = fileURL ? [NSData dataWithContentsOfURL:fileURL options:NSDataReadingMappedIfSafe error:nil] : nil;
+		if (data) {
+			[fileURL setResourceValue:[NSDate date] forKey:NSURLContentModificationDateKey error:nil];
+			dispatch_async(self.decodeQueue, ^{
+				if (![self _decodeData:data forOperation:operation]) {
+					// The file is damaged; drop it and fetch the image again.
+					dispatch_async(self.IOQueue, ^{
+						[[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+						[self _downloadForOperation:operation];
+					});
+				}
+			});
+			return;
+		}
+		[self _downloadForOperation:operation];
+	});
+	return request;
+}
+
+- (KKImageLoadRequest *)loadImageFromImages:(NSArray <KKImageInfo *> *)images pixelSize:(CGSize)pixelSize completion:(void (^)(KKImage *, NSError *))completion
+{
+	NSParameterAssert(completion);
+	NSURL *URL = [KKImageInfo bestImageInImages:images forPixelSize:pixelSize].imageURL;
+	if (!URL) {
+		NSError *error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorBadURL userInfo:@{NSLocalizedDescriptionKey: @"There is no image with a URL."}];
+		dispatch_async(dispatch_get_main_queue(), ^{
+			completion(nil, error);
+		});
+		return nil;
+	}
+	return [self loadImageWithURL:URL completion:completion];
+}
+
+- (void)_downloadForOperation:(KKImageLoadOperation *)operation
+{
+	@synchronized (self) {
+		if (operation.cancelled) {
+			return;
+		}
+		operation.task = [self.URLSession dataTaskWithURL:operation.URL completionHandler:^(NSData *data, NSURLResponse *response, NSError *error) {
+			if (!error && [response isKindOfClass:[NSHTTPURLResponse class]]) {
+				NSInteger statusCode = ((NSHTTPURLResponse *)response).statusCode;
+				if (statusCode < 200 || statusCode >= 300) {
+					error = [NSError errorWithDomain:KKBOXOpenAPIErrorDomain code:statusCode userInfo:@{NSLocalizedDescriptionKey: [NSHTTPURLResponse localizedStringForStatusCode:statusCode]}];
+				}
+			}
+			if (error) {
+				[self _finishOperation:operation image:nil error:error];
+				return;
+			}
+			dispatch_async(self.decodeQueue, ^{
+				if (![self _decodeData:data forOperation:operation]) {
+					NSError *error = [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCannotDecodeContentData userInfo:@{NSLocalizedDescriptionKey: @"Unable to decode the image."}];
+					[self _finishOperation:operation image:nil error:error];
+					return;
+				}
+				dispatch_async(self.IOQueue, ^{
+					[self _writeData:data forKey:operation.key];
+				});
+			});
+		}];
+		[operation.task resume];
+	}
+}
+
+/** Decode the data and finish the operation with the image. Leaves the operation running if the data is not an image. */
+- (BOOL)_decodeData:(NSData *)data forOperation:(KKImageLoadOperation *)operation
+{
+	NSUInteger cost = 0;
+	KKImage *image = KKDecodeImage(data, &cost);
+	if (!image) {
+		return NO;
+	}
+	@synchronized (self) {
+		[self _setMemoryImage:image cost:cost forKey:operation.key];
+	}
+	[self _finishOperation:operation image:image error:nil];
+	return YES;
+}
+
+- (void)_finishOperation:(KKImageLoadOperation *)operation image:(KKImage *)image error:(NSError *)error
+{
+	NSArray <KKImageLoadRequest *> *requests = nil;
+	@synchronized (self) {
+		if (self.operations[operation.key] == operation) {
+			[self.operations removeObjectForKey:operation.key];
+		}
+		requests = [operation.requests copy];
+		[operation.requests removeAllObjects];
+	}
+	dispatch_async(dispatch_get_main_queue(), ^{
+		for (KKImageLoadRequest *request in requests) {
+			KKImageLoaderCompletion completion = request.completion;
+			request.completion = nil;
+			if (completion) {
+				completion(image, error);
+			}
+		}
+	});
+}
+
+- (void)_cancelRequest:(KKImageLoadRequest *)request
+{
+	@synchronized (self) {
+		request.completion = nil;
+		KKImageLoadOperation *operation = request.operation;
+		if (!operation) {
+			return;
+		}
+		[operation.requests removeObject:request];
+		if (operation.requests.count == 0 && self.operations[operation.key] == operation) {
+			operation.cancelled = YES;
+			[operation.task cancel];
+			[self.operations removeObjectForKey:operation.key];
+		}
+	}
+}
+
+#pragma mark - Memory Cache
+
+// The methods below must be called while holding the lock.
+
+- (void)_unlinkNode:(KKImageCacheNode *)node
+{
+	if (node->_previous) {
+		node->_previous->_next = node->_next;
+	}
+	else {
+		self.head = node->_next;
+	}
+	if (node->_next) {
+		node->_next->_previous = node->_previous;
+	}
+	else {
+		self.tail = node->_previous;
+	}
+	node->_next = nil;
+	node->_previous = nil;
+}
+
+- (void)_insertNodeAtHead:(KKImageCacheNode *)node
+{
+	node->_next = self.head;
+	node->_previous = nil;
+	if (self.head) {
+		self.head->_previous = node;
+	}
+	self.head = node;
+	if (!self.tail) {
+		self.tail = node;
+	}
+}
+
+- (KKImage *)_memoryImageForKey:(NSString *)key
+{
+	KKImageCacheNode *node = self.memoryNodes[key];
+	if (!node) {
+		return nil;
+	}
+	if (node != self.head) {
+		[self _unlinkNode:node];
+		[self _insertNodeAtHead:node];
+	}
+	return node->_image;
+}
+
+- (void)_setMemoryImage:(KKImage *)image cost:(NSUInteger)cost forKey:(NSString *)key
+{
+	KKImageCacheNode *node = self.memoryNodes[key];
+	if (node) {
+		self.memoryUsage -= node->_cost;
+		[self _unlinkNode:node];
+	}
+	else {
+		node = [[KKImageCacheNode alloc] init];
+		node->_key = key;
+		self.memoryNodes[key] = node;
+	}
+	node->_image = image;
+	node->_cost = cost;
+	self.memoryUsage += cost;
+	[self _insertNodeAtHead:node];
+	while (self.memoryUsage > self.memoryCapacity && self.tail) {
+		KKImageCacheNode *tail = self.tail;
+		self.memoryUsage -= tail->_cost;
+		[self.memoryNodes removeObjectForKey:tail->_key];
+		[self _unlinkNode:tail];
+	}
+}
+
+- (KKImage *)cachedImageForURL:(NSURL *)URL
+{
+	@synchronized (self) {
+		return [self _memoryImageForKey:URL.absoluteString];
+	}
+}
+
+- (void)removeAllCachedImages
+{
+	@synchronized (self) {
+		while (self.tail) {
+			[self _unlinkNode:self.tail];
+		}
+		[self.memoryNodes removeAllObjects];
+		self.memoryUsage = 0;
+	}
+	dispatch_async(self.IOQueue, ^{
+		if (!self.cacheDirectoryURL) {
+			return;
+		}
+		NSArray <NSURL *> *fileURLs = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:self.cacheDirectoryURL includingPropertiesForKeys:nil options:0 error:nil];
+		for (NSURL *fileURL in fileURLs) {
+			[[NSFileManager defaultManager] removeItemAtURL:fileURL error:nil];
+		}
+	});
+}
+
+#pragma mark - Disk Cache
+
+// The methods below run on the IO queue.
+
+- (NSURL *)_fileURLForKey:(NSString *)key
+{
+	NSString *name = [NSString stringWithFormat:@"%016llx", (unsigned long long) KKFNV1aHash(key)];
+	return [self.cacheDirectoryURL URLByAppendingPathComponent:name isDirectory:NO];
+}
+
+- (void)_writeData:(NSData *)data forKey:(NSString *)key
+{
+	NSURL *fileURL = [self _fileURLForKey:key];
+	if (!fileURL) {
+		return;
+	}
+	[data writeToURL:fileURL atomically:YES];
+	// Listing the directory is not free, so trim only every now and then.
+	if (++self.writesSinceTrim >= 32) {
+		self.writesSinceTrim = 0;
+		[self _trimDiskCache];
+	}
+}
+
+- (void)_trimDiskCache
+{
+	NSArray *keys = @[NSURLContentModificationDateKey, NSURLFileSizeKey];
+	NSArray <NSURL *> *fileURLs = [[NSFileManager defaultManager] contentsOfDirectoryAtURL:self.cacheDirectoryURL includingPropertiesForKeys:keys options:NSDirectoryEnumerationSkipsHiddenFiles error:nil];
+	NSMutableArray <NSDictionary *> *files = [[NSMutableArray alloc] initWithCapacity:fileURLs.count];
+	unsigned long long totalSize = 0;
+	for (NSURL *fileURL in fileURLs) {
+		NSDictionary *values = [fileURL resourceValuesForKeys:keys error:nil];
+		if (!values) {
+			continue;
+		}
+		totalSize += [values[NSURLFileSizeKey] unsignedLongLongValue];
+		[files addObject:@{@"url": fileURL, @"date": values[NSURLContentModificationDateKey] ?: [NSDate distantPast], @"size": values[NSURLFileSizeKey] ?: @0}];
+	}
+	if (totalSize <= self.diskCapacity) {
+		return;
+	}
+	[files sortUsingComparator:^NSComparisonResult(NSDictionary *a, NSDictionary *b) {
+		return [a[@"date"] compare:b[@"date"]];
+	}];
+	for (NSDictionary *file in files) {
+		if (totalSize <= self.diskCapacity) {
+			break;
+		}
+		if ([[NSFileManager defaultManager] removeItemAtURL:file[@"url"] error:nil]) {
+			totalSize -= [file[@"size"] unsignedLongLongValue];
+		}
+	}
+}
+
+@end
@@ -0,0 +1,197 @@
+//
+// OpenAPIMultiTerritory.m
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+#import "OpenAPIMultiTerritory.h"
+#import "OpenAPI+Privates.h"
+
+static const KKTerritoryCode KKAllTerritoryCodes[] = {KKTerritoryCodeTaiwan, KKTerritoryCodeHongKong, KKTerritoryCodeSingapore, KKTerritoryCodeMalaysia, KKTerritoryCodeJapan};
+
+static NSString *KKMultiTerritoryObjectID(id object)
+{
+	if ([object isKindOfClass:[KKTrackInfo class]]) {
+		return ((KKTrackInfo *)object).trackID;
+	}
+	if ([object isKindOfClass:[KKPlaylistInfo class]]) {
+		return ((KKPlaylistInfo *)object).playlistID;
+	}
+	if ([object isKindOfClass:[KKAlbumInfo class]]) {
+		return ((KKAlbumInfo *)object).albumID;
+	}
+	if ([object isKindOfClass:[KKArtistInfo class]]) {
+		return ((KKArtistInfo *)object).artistID;
+	}
+	return nil;
+}
+
+@interface KKMultiTerritoryResults <ObjectType> ()
+@property (strong, nonatomic, nonnull) NSArray <ObjectType> *objects;
+@property (assign, nonatomic) KKTerritoryMask succeededTerritories;
+@property (strong, nonatomic, nonnull) NSDictionary <NSNumber *, NSError *> *errors;
+@property (strong, nonatomic) NSDictionary <NSString *, NSNumber *> *membership;
+@property (strong, nonatomic) NSDictionary <NSNumber *, NSArray *> *objectsByTerritory;
+@end
+
+@implementation KKMultiTerritoryResults
+
+- (instancetype)initWithObjectsByTerritory:(NSDictionary <NSNumber *, NSArray *> *)objectsByTerritory errors:(NSDictionary <NSNumber *, NSError *> *)errors
+{
+	self = [super init];
+	if (self) {
+		NSMutableArray *merged = [[NSMutableArray alloc] init];
+		NSMutableDictionary <NSString *, id> *shared = [[NSMutableDictionary alloc] init];
+		NSMutableDictionary <NSString *, NSNumber *> *membership = [[NSMutableDictionary alloc] init];
+		NSMutableDictionary <NSNumber *, NSArray *> *canonicalObjectsByTerritory = [[NSMutableDictionary alloc] init];
+		KKTerritoryMask succeeded = KKTerritoryMaskNone;
+
+		for (size_t i = 0; i < sizeof(KKAllTerritoryCodes) / sizeof(KKAllTerritoryCodes[0]); i++) {
+			KKTerritoryCode territory = KKAllTerritoryCodes[i];
+			NSArray *objects = objectsByTerritory[@(territory)];
+			if (!objects) {
+				continue;
+			}
+			succeeded |= (KKTerritoryMask) (1 << territory);
+			NSMutableArray *canonicalObjects = [[NSMutableArray alloc] initWithCapacity:objects.count];
+			for (id object in objects) {
+				NSString *objectID = KKMultiTerritoryObjectID(object);
+				if (!objectID.length) {
+					[merged addObject:object];
+					[canonicalObjects addObject:object];
+					continue;
+				}
+				id existing = shared[objectID];
+				if (!existing) {
+					existing = object;
+					shared[objectID] = object;
+					[merged addObject:object];
+				}
+				[canonicalObjects addObject:existing];
+				membership[objectID] = @([membership[objectID] unsignedIntegerValue] | (1 << territory));
+			}
+			canonicalObjectsByTerritory[@(territory)] = canonicalObjects;
+		}
+
+		self.objects = merged;
+		self.membership = membership;
+		self.objectsByTerritory = canonicalObjectsByTerritory;
+		self.succeededTerritories = succeeded;
+		self.errors = errors;
+	}
+	return self;
+}
+
+- (KKTerritoryMask)territoriesForObjectID:(NSString *)objectID
+{
+	return (KKTerritoryMask) [self.membership[objectID] unsignedIntegerValue];
+}
+
+- (NSArray *)objectsForTerritory:(KKTerritoryCode)territory
+{
+	return self.objectsByTerritory[@(territory)] ?: @[];
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<%@ %p> %lu objects, territories %lu, errors %@", NSStringFromClass([self class]), self, (unsigned long) self.objects.count, (unsigned long) self.succeededTerritories, self.errors];
+}
+
+@end
+
+@implementation KKBOXOpenAPI (MultiTerritory)
+
+- (NSArray <NSURLSessionDataTask *> *)_fetchForTerritories:(KKTerritoryMask)territories request:(NSURLSessionDataTask *(^)(KKTerritoryCode territory, void (^done)(NSArray *objects, NSError *error)))request callback:(void (^)(KKMultiTerritoryResults *, NSError *))callback
+{
+	NSParameterAssert(request);
+	NSParameterAssert(callback);
+	NSParameterAssert(territories != KKTerritoryMaskNone);
+
+	NSMutableDictionary <NSNumber *, NSArray *> *objectsByTerritory = [[NSMutableDictionary alloc] init];
+	NSMutableDictionary <NSNumber *, NSError *> *errors = [[NSMutableDictionary alloc] init];
+	NSMutableArray <NSURLSessionDataTask *> *tasks = [[NSMutableArray alloc] init];
+	dispatch_queue_t callbackQueue = [self _currentCallbackQueue];
+	dispatch_group_t group = dispatch_group_create();
+
+	for (size_t i = 0; i < sizeof(KKAllTerritoryCodes) / sizeof(KKAllTerritoryCodes[0]); i++) {
+		KKTerritoryCode territory = KKAllTerritoryCodes[i];
+		if (!(territories & (1 << territory))) {
+			continue;
+		}
+		dispatch_group_enter(group);
+		// The callbacks may run concurrently on a queue given to
+		// performWithCallbackQueue:block:.
+		NSURLSessionDataTask *task = request(territory, ^(NSArray *objects, NSError *error) {
+			@synchronized (objectsByTerritory) {
+				if (error) {
+					errors[@(territory)] = error;
+				}
+				else {
+					objectsByTerritory[@(territory)] = objects ?: @[];
+				}
+			}
+			dispatch_group_leave(group);
+		});
+		[tasks addObject:task];
+	}
+
+	if (!tasks.count) {
+		NSError *error = [NSError errorWithDomain:KKBOXOpenAPIErrorDomain code:6 userInfo:@{NSLocalizedDescriptionKey: @"No valid territory is given"}];
+		dispatch_async(callbackQueue, ^{
+			callback(nil, error);
+		});
+		return tasks;
+	}
+
+	dispatch_group_notify(group, callbackQueue, ^{
+		if (objectsByTerritory.count == 0) {
+			NSError *error = nil;
+			for (size_t i = 0; i < sizeof(KKAllTerritoryCodes) / sizeof(KKAllTerritoryCodes[0]) && !error; i++) {
+				error = errors[@(KKAllTerritoryCodes[i])];
+			}
+			callback(nil, error);
+			return;
+		}
+		KKMultiTerritoryResults *results = [[KKMultiTerritoryResults alloc] initWithObjectsByTerritory:objectsByTerritory errors:errors];
+		callback(results, nil);
+	});
+	return tasks;
+}
+
+- (NSArray <NSURLSessionDataTask *> *)fetchTrackWithTrackID:(NSString *)trackID territories:(KKTerritoryMask)territories callback:(void (^)(KKMultiTerritoryResults <KKTrackInfo *> *, NSError *))callback
+{
+	return [self _fetchForTerritories:territories request:^NSURLSessionDataTask *(KKTerritoryCode territory, void (^done)(NSArray *, NSError *)) {
+		return [self fetchTrackWithTrackID:trackID territory:territory callback:^(KKTrackInfo *track, NSError *error) {
+			done(track ? @[track] : nil, error);
+		}];
+	} callback:callback];
+}
+
+- (NSArray <NSURLSessionDataTask *> *)fetchChartsForTerritories:(KKTerritoryMask)territories callback:(void (^)(KKMultiTerritoryResults <KKPlaylistInfo *> *, NSError *))callback
+{
+	return [self _fetchForTerritories:territories request:^NSURLSessionDataTask *(KKTerritoryCode territory, void (^done)(NSArray *, NSError *)) {
+		return [self fetchChartsForTerritory:territory callback:^(NSArray <KKPlaylistInfo *> *playlists, KKPagingInfo *paging, KKSummary *summary, NSError *error) {
+			done(playlists, error);
+		}];
+	} callback:callback];
+}
+
+- (NSArray <NSURLSessionDataTask *> *)fetchFeaturedPlaylistsForTerritories:(KKTerritoryMask)territories callback:(void (^)(KKMultiTerritoryResults <KKPlaylistInfo *> *, NSError *))callback
+{
+	return [self _fetchForTerritories:territories request:^NSURLSessionDataTask *(KKTerritoryCode territory, void (^done)(NSArray *, NSError *)) {
+		return [self fetchFeaturedPlaylistsForTerritory:territory callback:^(NSArray <KKPlaylistInfo *> *playlists, KKPagingInfo *paging, KKSummary *summary, NSError *error) {
+			done(playlists, error);
+		}];
+	} callback:callback];
+}
+
+- (NSArray <NSURLSessionDataTask *> *)fetchNewHitsPlaylistsForTerritories:(KKTerritoryMask)territories callback:(void (^)(KKMultiTerritoryResults <KKPlaylistInfo *> *, NSError *))callback
+{
+	return [self _fetchForTerritories:territories request:^NSURLSessionDataTask *(KKTerritoryCode territory, void (^done)(NSArray *, NSError *)) {
+		return [self fetchNewHitsPlaylistsForTerritory:territory callback:^(NSArray <KKPlaylistInfo *> *playlists, KKPagingInfo *paging, KKSummary *summary, NSError *error) {
+			done(playlists, error);
+		}];
+	} callback:callback];
+}
+
+@end
@@ -6,11 +6,13 @@
 
 #import "OpenAPIObjects.h"
 #import "OpenAPI.h"
+#import "OpenAPI+Privates.h"
 
 @interface KKBOXOpenAPIObject ()
 - (void)handleDictionary;
 
 @property (strong, nonatomic, nullable) NSDictionary *dictionary;
+@property (assign, nonatomic, getter=isStale) BOOL stale;
 @end
 
 @interface KKPagingInfo ()
@@ -205,6 +207,7 @@
 	if (self) {
 		if ([dictionary isKindOfClass:[NSDictionary class]]) {
 			self.dictionary = dictionary;
+			self.stale = KKIsStaleJSONObject(dictionary);
 			[self handleDictionary];
 		}
 	}
@@ -215,6 +218,27 @@
 {
 }
 
++ (BOOL)supportsSecureCoding
+{
+	return YES;
+}
+
+- (void)encodeWithCoder:(NSCoder *)coder
+{
+	[coder encodeObject:[KKBinaryArchive archivedDataWithObjects:@[self]] forKey:@"archive"];
+}
+
+- (instancetype)initWithCoder:(NSCoder *)coder
+{
+	NSData *data = [coder decodeObjectOfClass:[NSData class] forKey:@"archive"];
+	KKBinaryArchive *archive = data ? [[KKBinaryArchive alloc] initWithData:data error:nil] : nil;
+	NSDictionary *dictionary = [archive _dictionaryAtIndex:0 className:NULL];
+	if (!dictionary) {
+		return nil;
+	}
+	return [self initWithDictionary:dictionary];
+}
+
 - (NSString *)description
 {
 	NSString *description = [NSString stringWithFormat:@"<%@ %p> %@", NSStringFromClass([self class]), self, [self.dictionary description]];
@@ -236,7 +260,7 @@
 		self.previous = [NSURL URLWithString:dictionary[@"previous"]];
 	}
 	if ([dictionary[@"next"] isKindOfClass:[NSString class]]) {
-		self.previous = [NSURL URLWithString:dictionary[@"next"]];
+		self.next = [NSURL URLWithString:dictionary[@"next"]];
 	}
 }
 @end
@@ -265,6 +289,27 @@
 		self.imageURL = [NSURL URLWithString:dictionary[@"url"]];
 	}
 }
+
++ (KKImageInfo *)bestImageInImages:(NSArray <KKImageInfo *> *)images forPixelSize:(CGSize)pixelSize
+{
+	KKImageInfo *smallestCovering = nil;
+	KKImageInfo *largest = nil;
+	for (KKImageInfo *image in images) {
+		if (!image.imageURL) {
+			continue;
+		}
+		CGFloat area = image.width * image.height;
+		if (!largest || area > largest.width * largest.height) {
+			largest = image;
+		}
+		if (image.width >= pixelSize.width && image.height >= pixelSize.height) {
+			if (!smallestCovering || area < smallestCovering.width * smallestCovering.height) {
+				smallestCovering = image;
+			}
+		}
+	}
+	return smallestCovering ?: largest;
+}
 @end
 
 @implementation KKArtistInfo
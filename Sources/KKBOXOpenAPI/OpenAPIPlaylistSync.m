@@ -0,0 +1,259 @@
+//
+// OpenAPIPlaylistSync.m
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+#import "OpenAPIPlaylistSync.h"
+
+static const NSInteger KKPlaylistSyncPageSize = 100;
+
+@interface KKPlaylistSnapshot ()
+@property (strong, nonatomic, nonnull) NSString *playlistID;
+@property (strong, nonatomic, nullable) NSString *lastUpdateDate;
+@property (strong, nonatomic, nonnull) NSArray <NSString *> *trackIDs;
+@end
+
+@implementation KKPlaylistSnapshot
+
+- (instancetype)initWithPlaylistID:(NSString *)playlistID lastUpdateDate:(NSString *)lastUpdateDate trackIDs:(NSArray <NSString *> *)trackIDs
+{
+	NSParameterAssert(playlistID);
+	NSParameterAssert(trackIDs);
+	self = [super init];
+	if (self) {
+		self.playlistID = playlistID;
+		self.lastUpdateDate = lastUpdateDate;
+		self.trackIDs = [trackIDs copy];
+	}
+	return self;
+}
+
++ (BOOL)supportsSecureCoding
+{
+	return YES;
+}
+
+- (void)encodeWithCoder:(NSCoder *)aCoder
+{
+	[aCoder encodeObject:self.playlistID forKey:@"id"];
+	[aCoder encodeObject:self.lastUpdateDate forKey:@"updated_at"];
+	[aCoder encodeObject:self.trackIDs forKey:@"track_ids"];
+}
+
+- (instancetype)initWithCoder:(NSCoder *)aDecoder
+{
+	NSString *playlistID = [aDecoder decodeObjectOfClass:[NSString class] forKey:@"id"];
+	NSString *lastUpdateDate = [aDecoder decodeObjectOfClass:[NSString class] forKey:@"updated_at"];
+	NSArray *trackIDs = [aDecoder decodeObjectOfClasses:[NSSet setWithObjects:[NSArray class], [NSString class], nil] forKey:@"track_ids"];
+	if (!playlistID || !trackIDs) {
+		return nil;
+	}
+	return [self initWithPlaylistID:playlistID lastUpdateDate:lastUpdateDate trackIDs:trackIDs];
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<%@ %p> %@ updated at %@, %lu tracks", NSStringFromClass([self class]), self, self.playlistID, self.lastUpdateDate, (unsigned long) self.trackIDs.count];
+}
+
+@end
+
+@interface KKPlaylistMove ()
+@property (assign, nonatomic) NSUInteger fromIndex;
+@property (assign, nonatomic) NSUInteger toIndex;
+@end
+
+@implementation KKPlaylistMove
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<%@ %p> %lu -> %lu", NSStringFromClass([self class]), self, (unsigned long) self.fromIndex, (unsigned long) self.toIndex];
+}
+
+@end
+
+@interface KKPlaylistDelta ()
+@property (strong, nonatomic, nonnull) KKPlaylistSnapshot *snapshot;
+@property (assign, nonatomic) BOOL hasChanges;
+@property (strong, nonatomic, nonnull) NSIndexSet *deletedIndexes;
+@property (strong, nonatomic, nonnull) NSIndexSet *insertedIndexes;
+@property (strong, nonatomic, nonnull) NSArray <KKPlaylistMove *> *moves;
+@property (strong, nonatomic, nonnull) NSArray <KKTrackInfo *> *insertedTracks;
+@end
+
+@implementation KKPlaylistDelta
+
++ (instancetype)unchangedDeltaWithSnapshot:(KKPlaylistSnapshot *)snapshot
+{
+	KKPlaylistDelta *delta = [[KKPlaylistDelta alloc] init];
+	delta.snapshot = snapshot;
+	delta.deletedIndexes = [NSIndexSet indexSet];
+	delta.insertedIndexes = [NSIndexSet indexSet];
+	delta.moves = @[];
+	delta.insertedTracks = @[];
+	return delta;
+}
+
++ (instancetype)deltaFromSnapshot:(KKPlaylistSnapshot *)oldSnapshot toSnapshot:(KKPlaylistSnapshot *)newSnapshot
+{
+	NSParameterAssert(newSnapshot);
+	NSArray <NSString *> *oldIDs = oldSnapshot.trackIDs ?: @[];
+	NSArray <NSString *> *newIDs = newSnapshot.trackIDs;
+	NSUInteger oldCount = oldIDs.count;
+	NSUInteger newCount = newIDs.count;
+
+	// Match the k-th occurrence of an ID in the new list with its k-th
+	// occurrence in the old list.
+	NSMutableDictionary <NSString *, NSMutableArray <NSNumber *> *> *oldPositions = [[NSMutableDictionary alloc] initWithCapacity:oldCount];
+	for (NSUInteger i = 0; i < oldCount; i++) {
+		NSMutableArray *positions = oldPositions[oldIDs[i]];
+		if (!positions) {
+			positions = [[NSMutableArray alloc] init];
+			oldPositions[oldIDs[i]] = positions;
+		}
+		[positions addObject:@(i)];
+	}
+	NSMutableDictionary <NSString *, NSNumber *> *usedCounts = [[NSMutableDictionary alloc] init];
+	NSMutableIndexSet *matchedOld = [[NSMutableIndexSet alloc] init];
+	NSMutableIndexSet *inserted = [[NSMutableIndexSet alloc] init];
+	// Parallel arrays of the matched tracks, ordered by their new index.
+	NSMutableData *matchedNewData = [NSMutableData dataWithLength:newCount * sizeof(NSUInteger)];
+	NSMutableData *matchedOldData = [NSMutableData dataWithLength:newCount * sizeof(NSUInteger)];
+	NSUInteger *matchedNew = matchedNewData.mutableBytes;
+	NSUInteger *matchedOldIndexes = matchedOldData.mutableBytes;
+	NSUInteger matchedCount = 0;
+	for (NSUInteger j = 0; j < newCount; j++) {
+		NSString *trackID = newIDs[j];
+		NSArray <NSNumber *> *positions = oldPositions[trackID];
+		NSUInteger used = [usedCounts[trackID] unsignedIntegerValue];
+		if (used >= positions.count) {
+			[inserted addIndex:j];
+			continue;
+		}
+		usedCounts[trackID] = @(used + 1);
+		NSUInteger oldIndex = [positions[used] unsignedIntegerValue];
+		[matchedOld addIndex:oldIndex];
+		matchedNew[matchedCount] = j;
+		matchedOldIndexes[matchedCount] = oldIndex;
+		matchedCount++;
+	}
+	NSMutableIndexSet *deleted = [[NSMutableIndexSet alloc] initWithIndexesInRange:NSMakeRange(0, oldCount)];
+	[deleted removeIndexes:matchedOld];
+
+	// The longest increasing subsequence of the old indexes stays in
+	// place; everything else among the matched tracks moves.
+	NSMutableData *tailsData = [NSMutableData dataWithLength:(matchedCount + 1) * sizeof(NSUInteger)];
+	NSMutableData *previousData = [NSMutableData dataWithLength:(matchedCount + 1) * sizeof(NSInteger)];
+	NSUInteger *tails = tailsData.mutableBytes;
+	NSInteger *previous = previousData.mutableBytes;
+	NSUInteger length = 0;
+	for (NSUInteger k = 0; k < matchedCount; k++) {
+		NSUInteger low = 0;
+		NSUInteger high = length;
+		while (low < high) {
+			NSUInteger middle = (low + high) / 2;
+			if (matchedOldIndexes[tails[middle]] < matchedOldIndexes[k]) {
+				low = middle + 1;
+			}
+			else {
+				high = middle;
+			}
+		}
+		previous[k] = low > 0 ? (NSInteger) tails[low - 1] : -1;
+		tails[low] = k;
+		if (low == length) {
+			length++;
+		}
+	}
+	NSMutableIndexSet *stable = [[NSMutableIndexSet alloc] init];
+	for (NSInteger k = length > 0 ? (NSInteger) tails[length - 1] : -1; k >= 0; k = previous[k]) {
+		[stable addIndex:(NSUInteger) k];
+	}
+	NSMutableArray <KKPlaylistMove *> *moves = [[NSMutableArray alloc] init];
+	for (NSUInteger k = 0; k < matchedCount; k++) {
+		if ([stable containsIndex:k]) {
+			continue;
+		}
+		KKPlaylistMove *move = [[KKPlaylistMove alloc] init];
+		move.fromIndex = matchedOldIndexes[k];
+		move.toIndex = matchedNew[k];
+		[moves addObject:move];
+	}
+
+	KKPlaylistDelta *delta = [self unchangedDeltaWithSnapshot:newSnapshot];
+	delta.deletedIndexes = deleted;
+	delta.insertedIndexes = inserted;
+	delta.moves = moves;
+	delta.hasChanges = deleted.count > 0 || inserted.count > 0 || moves.count > 0;
+	return delta;
+}
+
+- (NSString *)description
+{
+	return [NSString stringWithFormat:@"<%@ %p> %@, %lu deleted, %lu inserted, %lu moved", NSStringFromClass([self class]), self, self.snapshot.playlistID, (unsigned long) self.deletedIndexes.count, (unsigned long) self.insertedIndexes.count, (unsigned long) self.moves.count];
+}
+
+@end
+
+@implementation KKBOXOpenAPI (PlaylistSync)
+
+- (void)_fetchPlaylistTracksWithPlaylistID:(NSString *)playlistID territory:(KKTerritoryCode)territory tracks:(NSMutableArray <KKTrackInfo *> *)tracks total:(NSInteger)total completion:(void (^)(NSError *))completion
+{
+	if ((NSInteger) tracks.count >= total) {
+		completion(nil);
+		return;
+	}
+	[self fetchTracksInPlaylistWithPlaylistID:playlistID territory:territory offset:(NSInteger) tracks.count limit:KKPlaylistSyncPageSize callback:^(NSArray <KKTrackInfo *> *page, KKPagingInfo *paging, KKSummary *summary, NSError *error) {
+		if (error) {
+			completion(error);
+			return;
+		}
+		[tracks addObjectsFromArray:page];
+		// Stop on an empty page, in case the playlist shrinks while it
+		// is being fetched.
+		[self _fetchPlaylistTracksWithPlaylistID:playlistID territory:territory tracks:tracks total:page.count ? summary.total : 0 completion:completion];
+	}];
+}
+
+- (NSURLSessionDataTask *)syncPlaylistWithPlaylistID:(NSString *)playlistID snapshot:(KKPlaylistSnapshot *)snapshot territory:(KKTerritoryCode)territory callback:(void (^)(KKPlaylistDelta *, NSError *))callback
+{
+	NSParameterAssert(playlistID);
+	NSParameterAssert(callback);
+	NSParameterAssert(!snapshot || [snapshot.playlistID isEqualToString:playlistID]);
+
+	return [self fetchPlaylistWithPlaylistID:playlistID territory:territory callback:^(KKPlaylistInfo *playlist, KKPagingInfo *paging, KKSummary *summary, NSError *error) {
+		if (error) {
+			callback(nil, error);
+			return;
+		}
+		if (snapshot.lastUpdateDate && [snapshot.lastUpdateDate isEqualToString:playlist.lastUpdateDate]) {
+			callback([KKPlaylistDelta unchangedDeltaWithSnapshot:snapshot], nil);
+			return;
+		}
+		NSMutableArray <KKTrackInfo *> *tracks = [playlist.tracks mutableCopy];
+		NSInteger total = tracks.count ? summary.total : 0;
+		[self _fetchPlaylistTracksWithPlaylistID:playlistID territory:territory tracks:tracks total:total completion:^(NSError *pageError) {
+			if (pageError) {
+				callback(nil, pageError);
+				return;
+			}
+			// A track without an ID cannot be diffed, and would put an
+			// NSNull in the snapshot.
+			NSMutableArray <KKTrackInfo *> *syncedTracks = [[NSMutableArray alloc] initWithCapacity:tracks.count];
+			NSMutableArray <NSString *> *trackIDs = [[NSMutableArray alloc] initWithCapacity:tracks.count];
+			for (KKTrackInfo *track in tracks) {
+				if (track.trackID) {
+					[syncedTracks addObject:track];
+					[trackIDs addObject:track.trackID];
+				}
+			}
+			KKPlaylistSnapshot *newSnapshot = [[KKPlaylistSnapshot alloc] initWithPlaylistID:playlistID lastUpdateDate:playlist.lastUpdateDate trackIDs:trackIDs];
+			KKPlaylistDelta *delta = [KKPlaylistDelta deltaFromSnapshot:snapshot toSnapshot:newSnapshot];
+			delta.insertedTracks = [syncedTracks objectsAtIndexes:delta.insertedIndexes];
+			callback(delta, nil);
+		}];
+	}];
+}
+
+@end
@@ -0,0 +1,166 @@
+//
+// OpenAPIRadioQueue.m
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+#import "OpenAPIRadioQueue.h"
+
+typedef void (^KKRadioStationQueueCallback)(KKTrackInfo *, NSError *);
+
+@interface KKRadioStationQueue ()
+@property (strong, nonatomic) KKBOXOpenAPI *API;
+@property (strong, nonatomic) NSString *stationID;
+@property (assign, nonatomic) KKRadioStationKind kind;
+@property (assign, nonatomic) KKTerritoryCode territory;
+@property (strong, nonatomic, nullable) KKRadioStation *station;
+@property (strong, nonatomic) NSMutableArray <KKTrackInfo *> *buffer;
+/** The IDs of the tracks served or buffered. */
+@property (strong, nonatomic) NSMutableSet <NSString *> *seenTrackIDs;
+@property (strong, nonatomic) NSMutableArray <KKRadioStationQueueCallback> *waitingCallbacks;
+@property (strong, nonatomic, nullable) NSURLSessionDataTask *task;
+@property (assign, nonatomic) NSInteger nextOffset;
+/** Bumped on cancel, so that late responses are ignored. */
+@property (assign, nonatomic) NSUInteger generation;
+@property (assign, nonatomic, getter=isExhausted) BOOL exhausted;
+@end
+
+@implementation KKRadioStationQueue
+
+- (instancetype)initWithAPI:(KKBOXOpenAPI *)API stationID:(NSString *)stationID kind:(KKRadioStationKind)kind territory:(KKTerritoryCode)territory
+{
+	NSParameterAssert(API);
+	NSParameterAssert(stationID);
+	self = [super init];
+	if (self) {
+		self.API = API;
+		self.stationID = stationID;
+		self.kind = kind;
+		self.territory = territory;
+		self.buffer = [[NSMutableArray alloc] init];
+		self.seenTrackIDs = [[NSMutableSet alloc] init];
+		self.waitingCallbacks = [[NSMutableArray alloc] init];
+		self.lookAheadCount = 20;
+		self.lowWatermark = 5;
+		self.pageSize = 20;
+	}
+	return self;
+}
+
+- (NSArray <KKTrackInfo *> *)bufferedTracks
+{
+	return [self.buffer copy];
+}
+
+- (void)prefetch
+{
+	[self _refillIfNeeded];
+}
+
+- (void)dequeueTrackWithCallback:(void (^)(KKTrackInfo *, NSError *))callback
+{
+	NSParameterAssert(callback);
+	NSAssert([NSThread isMainThread], @"The queue must be used on the main thread.");
+	if (self.buffer.count > 0) {
+		KKTrackInfo *track = self.buffer.firstObject;
+		[self.buffer removeObjectAtIndex:0];
+		[self _refillIfNeeded];
+		callback(track, nil);
+		return;
+	}
+	if (self.exhausted) {
+		callback(nil, nil);
+		return;
+	}
+	[self.waitingCallbacks addObject:[callback copy]];
+	[self _refillIfNeeded];
+}
+
+- (void)cancel
+{
+	[self.task cancel];
+	self.task = nil;
+	self.generation++;
+	[self.buffer removeAllObjects];
+	[self _failWaitingCallbacksWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+}
+
+#pragma mark -
+
+- (void)_refillIfNeeded
+{
+	if (self.task || self.exhausted) {
+		return;
+	}
+	if (self.buffer.count >= self.lowWatermark && self.waitingCallbacks.count == 0) {
+		return;
+	}
+	[self _fetchNextPage];
+}
+
+- (void)_fetchNextPage
+{
+	NSUInteger generation = self.generation;
+	void (^callback)(KKRadioStation *, NSArray <KKTrackInfo *> *, KKPagingInfo *, KKSummary *, NSError *) = ^(KKRadioStation *station, NSArray <KKTrackInfo *> *tracks, KKPagingInfo *paging, KKSummary *summary, NSError *error) {
+		if (generation != self.generation) {
+			return;
+		}
+		self.task = nil;
+		if (error) {
+			[self _failWaitingCallbacksWithError:error];
+			return;
+		}
+		if (!self.station) {
+			self.station = station;
+		}
+		[self _appendPage:tracks paging:paging summary:summary];
+		// Once a refill starts, keep fetching until the look-ahead
+		// buffer is full, not just until it is above the watermark.
+		if (self.buffer.count < self.lookAheadCount && !self.exhausted) {
+			[self _fetchNextPage];
+		}
+	};
+	if (self.kind == KKRadioStationKindGenre) {
+		self.task = [self.API fetchGenreStationWithStationID:self.stationID territory:self.territory offset:self.nextOffset limit:self.pageSize callback:callback];
+	}
+	else {
+		self.task = [self.API fetchMoodStationWithStationID:self.stationID territory:self.territory offset:self.nextOffset limit:self.pageSize callback:callback];
+	}
+}
+
+- (void)_appendPage:(NSArray <KKTrackInfo *> *)tracks paging:(KKPagingInfo *)paging summary:(KKSummary *)summary
+{
+	self.nextOffset += (NSInteger) tracks.count;
+	// Responses without a summary still link the next page.
+	BOOL hasNextPage = summary.total > 0 ? self.nextOffset < summary.total : paging.next != nil;
+	if (tracks.count == 0 || !hasNextPage) {
+		self.exhausted = YES;
+	}
+	for (KKTrackInfo *track in tracks) {
+		if (!track.trackID.length || [self.seenTrackIDs containsObject:track.trackID]) {
+			continue;
+		}
+		[self.seenTrackIDs addObject:track.trackID];
+		[self.buffer addObject:track];
+	}
+	while (self.waitingCallbacks.count > 0 && (self.buffer.count > 0 || self.exhausted)) {
+		KKRadioStationQueueCallback callback = self.waitingCallbacks.firstObject;
+		[self.waitingCallbacks removeObjectAtIndex:0];
+		KKTrackInfo *track = self.buffer.firstObject;
+		if (track) {
+			[self.buffer removeObjectAtIndex:0];
+		}
+		callback(track, nil);
+	}
+}
+
+- (void)_failWaitingCallbacksWithError:(NSError *)error
+{
+	NSArray <KKRadioStationQueueCallback> *callbacks = [self.waitingCallbacks copy];
+	[self.waitingCallbacks removeAllObjects];
+	for (KKRadioStationQueueCallback callback in callbacks) {
+		callback(nil, error);
+	}
+}
+
+@end
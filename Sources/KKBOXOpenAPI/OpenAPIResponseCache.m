@@ -0,0 +1,156 @@
+//
+// OpenAPIResponseCache.m
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+#import "OpenAPIResponseCache.h"
+#import "OpenAPI+Privates.h"
+
+static NSString *KKHeaderValue(NSHTTPURLResponse *response, NSString *name)
+{
+	// Header names are case-insensitive, and -valueForHTTPHeaderField:
+	// is not available on older systems.
+	NSDictionary *headers = response.allHeaderFields;
+	for (NSString *key in headers) {
+		if ([key caseInsensitiveCompare:name] == NSOrderedSame) {
+			return headers[key];
+		}
+	}
+	return nil;
+}
+
+@implementation KKCachedResponse
+@end
+
+@interface KKResponseCache ()
+@property (strong, nonatomic) NSMutableDictionary <NSString *, KKCachedResponse *> *responses;
+/** Least recently used first. */
+@property (strong, nonatomic) NSMutableOrderedSet <NSString *> *recentKeys;
+@property (assign) unsigned long long byteCount;
+@property (assign) NSUInteger requestCount;
+@property (assign) NSUInteger notModifiedCount;
+@property (assign) unsigned long long bytesSaved;
+@end
+
+@implementation KKResponseCache
+
+- (instancetype)init
+{
+	self = [super init];
+	if (self) {
+		self.responses = [[NSMutableDictionary alloc] init];
+		self.recentKeys = [[NSMutableOrderedSet alloc] init];
+		self.maximumByteCount = 2 * 1024 * 1024;
+	}
+	return self;
+}
+
+- (void)removeAllResponses
+{
+	@synchronized (self) {
+		[self.responses removeAllObjects];
+		[self.recentKeys removeAllObjects];
+		self.byteCount = 0;
+	}
+}
+
+- (void)resetStatistics
+{
+	@synchronized (self) {
+		self.requestCount = 0;
+		self.notModifiedCount = 0;
+		self.bytesSaved = 0;
+	}
+}
+
+- (NSUInteger)responseCount
+{
+	@synchronized (self) {
+		return self.responses.count;
+	}
+}
+
+- (KKCachedResponse *)cachedResponseForURL:(NSURL *)URL
+{
+	NSString *key = URL.absoluteString;
+	@synchronized (self) {
+		KKCachedResponse *cachedResponse = self.responses[key];
+		if (cachedResponse) {
+			[self.recentKeys removeObject:key];
+			[self.recentKeys addObject:key];
+		}
+		return cachedResponse;
+	}
+}
+
+- (void)prepareRequest:(NSMutableURLRequest *)request withCachedResponse:(KKCachedResponse *)cachedResponse
+{
+	if (!cachedResponse.ETag && !cachedResponse.lastModified) {
+		return;
+	}
+	// The URL loading system must not answer from its own cache, or
+	// our conditional headers would be ignored.
+	request.cachePolicy = NSURLRequestReloadIgnoringLocalCacheData;
+	if (cachedResponse.ETag) {
+		[request setValue:cachedResponse.ETag forHTTPHeaderField:@"If-None-Match"];
+	}
+	if (cachedResponse.lastModified) {
+		[request setValue:cachedResponse.lastModified forHTTPHeaderField:@"If-Modified-Since"];
+	}
+}
+
+- (BOOL)isNotModifiedResponse:(NSURLResponse *)response cachedResponse:(KKCachedResponse *)cachedResponse
+{
+	@synchronized (self) {
+		self.requestCount++;
+		if (!cachedResponse || ![response isKindOfClass:[NSHTTPURLResponse class]] || ((NSHTTPURLResponse *)response).statusCode != 304) {
+			return NO;
+		}
+		self.notModifiedCount++;
+		self.bytesSaved += cachedResponse.byteCount;
+		return YES;
+	}
+}
+
+- (void)storeJSONObject:(id)JSONObject byteCount:(NSUInteger)byteCount forResponse:(NSURLResponse *)response URL:(NSURL *)URL keepsWithoutValidators:(BOOL)keepsWithoutValidators
+{
+	if (![response isKindOfClass:[NSHTTPURLResponse class]]) {
+		return;
+	}
+	NSString *ETag = KKHeaderValue((NSHTTPURLResponse *)response, @"ETag");
+	NSString *lastModified = KKHeaderValue((NSHTTPURLResponse *)response, @"Last-Modified");
+	NSString *key = URL.absoluteString;
+	@synchronized (self) {
+		// The remembered response, if any, is out of date.
+		[self _removeResponseForKey:key];
+		if ((!ETag && !lastModified && !keepsWithoutValidators) || byteCount > self.maximumByteCount) {
+			return;
+		}
+		KKCachedResponse *cachedResponse = [[KKCachedResponse alloc] init];
+		cachedResponse.ETag = ETag;
+		cachedResponse.lastModified = lastModified;
+		cachedResponse.JSONObject = JSONObject;
+		cachedResponse.byteCount = byteCount;
+		self.responses[key] = cachedResponse;
+		[self.recentKeys addObject:key];
+		self.byteCount += byteCount;
+		while (self.byteCount > self.maximumByteCount && self.recentKeys.count) {
+			[self _removeResponseForKey:self.recentKeys.firstObject];
+		}
+	}
+}
+
+/** Called while holding the lock. */
+- (void)_removeResponseForKey:(NSString *)key
+{
+	KKCachedResponse *cachedResponse = self.responses[key];
+	if (!cachedResponse) {
+		return;
+	}
+	self.byteCount -= cachedResponse.byteCount;
+	[self.responses removeObjectForKey:key];
+	[self.recentKeys removeObject:key];
+}
+
+@end
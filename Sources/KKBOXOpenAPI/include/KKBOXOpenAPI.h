@@ -11,3 +11,18 @@ FOUNDATION_EXPORT const unsigned char KKBOXOpenAPIiOSVersionString[];
 
 #import "OpenAPI.h"
 #import "OpenAPIObjects.h"
+#import "OpenAPICatalogStore.h"
+#import "OpenAPIExport.h"
+#import "OpenAPIMultiTerritory.h"
+#import "OpenAPICrawler.h"
+#import "OpenAPIResponseCache.h"
+#import "OpenAPIPlaylistSync.h"
+#import "OpenAPIRadioQueue.h"
+#import "OpenAPIImageLoader.h"
+#import "OpenAPIHedging.h"
+#import "OpenAPICircuitBreaker.h"
+#import "OpenAPIEndpointMetrics.h"
+#import "OpenAPIBinaryArchive.h"
+#import "OpenAPICatalogSnapshot.h"
+#import "OpenAPIBulkDownload.h"
+#import "NSData+LFHTTPFormExtensions.h"
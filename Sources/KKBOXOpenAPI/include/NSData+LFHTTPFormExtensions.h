@@ -29,5 +29,11 @@
 #import <Foundation/Foundation.h>
 
 @interface NSData (LFHTTPFormExtensions)
-+ (id)dataAsWWWURLEncodedFormFromDictionary:(NSDictionary *)formDictionary;
+/**
+ * Encodes a dictionary as an `application/x-www-form-urlencoded` body.
+ * The pairs are sorted by key, so the same dictionary always gives the
+ * same bytes. Values that are not strings are encoded by their
+ * descriptions.
+ */
++ (nonnull NSData *)dataAsWWWURLEncodedFormFromDictionary:(nonnull NSDictionary *)formDictionary NS_SWIFT_NAME(dataAsWWWURLEncodedForm(from:));
 @end
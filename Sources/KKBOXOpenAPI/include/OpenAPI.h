@@ -8,6 +8,14 @@
 
 #import "OpenAPIObjects.h"
 
+@class KKCatalogStore;
+@class KKResponseCache;
+@class KKHedgingPolicy;
+@class KKCircuitBreaker;
+@class KKEndpointMetrics;
+@class KKCatalogSnapshot;
+@class KKCatalogSnapshotBuilder;
+
 /**
  * The access token object. You need a valid access token to access
  * KKBOX's APIs. To obtain an access token, please read about KKBOX's
@@ -51,6 +59,25 @@ typedef NS_ENUM(NSUInteger, KKTerritoryCode)
 	KKTerritoryCodeJapan,
 } NS_SWIFT_NAME(KKBOXOpenAPI.Territory);
 
+/** A set of territories. Each bit is `1 << KKTerritoryCode`. */
+typedef NS_OPTIONS(NSUInteger, KKTerritoryMask)
+{
+	/** No territory */
+	KKTerritoryMaskNone = 0,
+	/** Taiwan */
+	KKTerritoryMaskTaiwan = 1 << KKTerritoryCodeTaiwan,
+	/** HongKong */
+	KKTerritoryMaskHongKong = 1 << KKTerritoryCodeHongKong,
+	/** Singapore */
+	KKTerritoryMaskSingapore = 1 << KKTerritoryCodeSingapore,
+	/** Malaysia */
+	KKTerritoryMaskMalaysia = 1 << KKTerritoryCodeMalaysia,
+	/** Japan */
+	KKTerritoryMaskJapan = 1 << KKTerritoryCodeJapan,
+	/** All the territories */
+	KKTerritoryMaskAll = KKTerritoryMaskTaiwan | KKTerritoryMaskHongKong | KKTerritoryMaskSingapore | KKTerritoryMaskMalaysia | KKTerritoryMaskJapan
+} NS_SWIFT_NAME(KKBOXOpenAPI.TerritoryMask);
+
 /** The search types used by the search API. */
 typedef NS_OPTIONS(NSUInteger, KKSearchType)
 {
@@ -141,10 +168,100 @@ typedef void (^KKBOXOpenAPIDataCallback)(id _Nullable, NSError *_Nullable);
 /** Clear existing access token. */
 - (void)logout;
 
+/**
+ * Call the callbacks of the API calls made with the receiver inside a
+ * block on a given queue, instead of the main queue. The responses of
+ * these calls are parsed on the queue too. The block is run right
+ * away on the current thread; calls made elsewhere are not affected.
+ *
+ * @param queue the queue to call the callbacks on
+ * @param block a block that makes API calls
+ */
+- (void)performWithCallbackQueue:(nonnull dispatch_queue_t)queue block:(NS_NOESCAPE void (^_Nonnull)(void))block NS_SWIFT_NAME(perform(callbackQueue:_:));
+
 /** The current access token. */
 @property (readwrite, strong, nullable, nonatomic) KKAccessToken *accessToken;
 /** If there is a valid access token. */
 @property (readonly, assign) BOOL loggedIn;
+/**
+ * The URL that the paths of the API calls are appended to, such as
+ * `tracks/{id}`. It must end with a slash. `https://api.kkbox.com/v1.1/`
+ * by default; point it at a stand-in server to test without the real
+ * API.
+ */
+@property (strong, nonnull, nonatomic) NSURL *APIBaseURL;
+/** The URL of the OAuth token endpoint. `https://account.kkbox.com/oauth2/token` by default. */
+@property (strong, nonnull, nonatomic) NSURL *tokenURL;
+/**
+ * The URL session used to send requests. The shared session by
+ * default. You can assign a session with your own configuration,
+ * for example, one whose protocol classes serve local fixtures.
+ */
+@property (strong, nonnull, nonatomic) NSURLSession *URLSession;
+/**
+ * An optional local catalog store. When set, every track, album,
+ * artist and playlist parsed from an API response is upserted into
+ * it. Nil by default.
+ */
+@property (strong, nullable, nonatomic) KKCatalogStore *catalogStore;
+/**
+ * An optional read-only snapshot. When set, calls found in the
+ * snapshot are answered from it without a network request, on the
+ * callback queue as usual, and their objects are not added to
+ * `catalogStore`. A page of a list is answered if the snapshot has
+ * all of it, or has the list up to its end. Nil by default.
+ */
+@property (strong, nullable, nonatomic) KKCatalogSnapshot *catalogSnapshot;
+/**
+ * An optional builder. When set, the result of every successful call
+ * that is not answered by `catalogSnapshot` is recorded into it. Nil
+ * by default.
+ */
+@property (strong, nullable, nonatomic) KKCatalogSnapshotBuilder *snapshotBuilder;
+/**
+ * An optional cache of the validators and the decoded JSON of API
+ * responses. When set, requesting an unchanged resource again costs a
+ * `304 Not Modified` response instead of a full download, and
+ * `circuitBreaker` can answer from it while a circuit is open. Nil by
+ * default.
+ */
+@property (strong, nullable, nonatomic) KKResponseCache *responseCache;
+/**
+ * An optional policy for hedging slow requests with duplicates. Nil
+ * by default.
+ */
+@property (strong, nullable, nonatomic) KKHedgingPolicy *hedgingPolicy;
+/**
+ * An optional circuit breaker. When set, calls to a failing endpoint
+ * fail fast, or are answered with a response from `responseCache`,
+ * if one is set, marked as stale. Nil by default.
+ */
+@property (strong, nullable, nonatomic) KKCircuitBreaker *circuitBreaker;
+/**
+ * If a call that is identical to a call in flight joins it instead of
+ * sending another request. Every joined call still gets a task of its
+ * own: cancelling it only fails that call with NSURLErrorCancelled,
+ * and the shared request is cancelled once all of them are. NO by
+ * default.
+ */
+@property (assign, nonatomic) BOOL coalescesRequests;
+/**
+ * How many times a call is sent again after a transient network
+ * error, such as a timeout or a lost connection. 0 by default. The
+ * task returned by the call stands for the retries too, so cancelling
+ * it during a retry or the wait before one stops the call.
+ */
+@property (assign, nonatomic) NSUInteger maximumRetryCount;
+/**
+ * The wait before the first retry. Every later retry waits twice as
+ * long as the previous one. 0.5 seconds by default.
+ */
+@property (assign, nonatomic) NSTimeInterval retryInterval;
+/** The metrics of the endpoints called so far, keyed by their names. */
+@property (readonly, strong, nonnull) NSDictionary<NSString *, KKEndpointMetrics *> *endpointMetrics;
+
+/** Reset the metrics of all the endpoints. */
+- (void)resetEndpointMetrics;
 @end
 
 #pragma mark - Client Credential Log-in Flow
@@ -163,6 +280,17 @@ typedef void (^KKBOXOpenAPIDataCallback)(id _Nullable, NSError *_Nullable);
 - (nonnull NSURLSessionDataTask *)fetchAccessTokenByClientCredentialWithCallback:(nonnull KKBOXOpenAPILoginCallback)callback;
 @end
 
+/**
+ * The tasks returned by the calls below stand for the whole call,
+ * including its retries, and calls answered by `catalogSnapshot` or
+ * `circuitBreaker` without a request. They are running until the
+ * callback is called, even between the requests of a call.
+ *
+ * They are proxies, not the tasks of `URLSession`, and forward other
+ * messages to the task of the current request. So they do not match
+ * the tasks of the session by identity, and `isKindOfClass:` and
+ * `class` do not tell what they are.
+ */
 @interface KKBOXOpenAPI (API)
 
 #pragma mark - Song Tracks
@@ -0,0 +1,80 @@
+//
+// OpenAPIBinaryArchive.h
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+@import Foundation;
+
+#import "OpenAPIObjects.h"
+
+/** The version of the format that `KKBinaryArchive` writes. */
+FOUNDATION_EXPORT const NSUInteger KKBinaryArchiveVersion;
+
+/**
+ * A compact binary form of model objects, to keep them in caches or
+ * to hand them to other processes without re-encoding JSON.
+ *
+ * An archive starts with a magic number and a format version,
+ * followed by a table of every distinct string in the objects, such
+ * as dictionary keys, IDs and names, and then the objects. Integers
+ * are written as variable-length integers, strings as indexes into
+ * the table, and lists of available territories as bit masks.
+ *
+ * An archive is read in place: creating an instance only walks the
+ * lengths of the strings and the objects, and each object is decoded
+ * from the bytes when it is asked for. Use
+ * `-initWithContentsOfURL:error:` to read a memory-mapped file.
+ *
+ * Instances are immutable and thread-safe.
+ */
+NS_SWIFT_NAME(BinaryArchive)
+@interface KKBinaryArchive : NSObject
+
+/**
+ * Encode model objects.
+ *
+ * @param objects the objects
+ * @return the archived data
+ */
++ (nonnull NSData *)archivedDataWithObjects:(nonnull NSArray <KKBOXOpenAPIObject *> *)objects NS_SWIFT_NAME(archivedData(with:));
+
+/**
+ * Read an archive.
+ *
+ * @param data the archived data. It is retained, not copied.
+ * @param error set if the data is not an archive or is written in a
+ * newer version of the format
+ * @return A KKBinaryArchive instance, or nil on failure
+ */
+- (nullable instancetype)initWithData:(nonnull NSData *)data error:(NSError *_Nullable *_Nullable)error;
+
+/**
+ * Read an archive from a file, mapped into memory.
+ *
+ * @param URL the URL of the file
+ * @param error set if the file cannot be read or is not an archive
+ * @return A KKBinaryArchive instance, or nil on failure
+ */
+- (nullable instancetype)initWithContentsOfURL:(nonnull NSURL *)URL error:(NSError *_Nullable *_Nullable)error;
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+/** The version of the format that the archive is written in. */
+@property (readonly, assign, nonatomic) NSUInteger version;
+/** The amount of the objects in the archive. */
+@property (readonly, assign, nonatomic) NSUInteger count;
+
+/**
+ * Decode an object.
+ *
+ * @param index the index of the object
+ * @return the object, or nil if its bytes are malformed or its class
+ * is unknown
+ */
+- (nullable KKBOXOpenAPIObject *)objectAtIndex:(NSUInteger)index;
+
+/** All the objects that can be decoded, in order. */
+@property (readonly, strong, nonatomic, nonnull) NSArray <KKBOXOpenAPIObject *> *objects;
+
+@end
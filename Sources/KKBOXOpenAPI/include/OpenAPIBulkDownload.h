@@ -0,0 +1,144 @@
+//
+// OpenAPIBulkDownload.h
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+@import Foundation;
+
+#import "OpenAPI.h"
+
+@class KKBulkDownloader;
+
+/** The lists that a bulk downloader fetches. */
+typedef NS_ENUM(NSUInteger, KKBulkDownloadList)
+{
+	/** The tracks of an album. The ID is an album ID. */
+	KKBulkDownloadListAlbumTracks,
+	/** The playlists of a children category. The ID is a category ID. */
+	KKBulkDownloadListChildrenCategoryPlaylists,
+	/** The albums of a new-release category. The ID is a category ID. */
+	KKBulkDownloadListNewReleaseAlbums,
+} NS_SWIFT_NAME(BulkDownloader.List);
+
+/**
+ * The sink of the objects fetched by a bulk downloader. All the
+ * methods are called on the main queue.
+ */
+NS_SWIFT_NAME(BulkDownloaderDelegate)
+@protocol KKBulkDownloaderDelegate <NSObject>
+/**
+ * Called when the downloader stops, either because every list is
+ * fetched, or because of an error or a call to `cancel`. The progress
+ * is kept in the manifest either way.
+ *
+ * @param downloader the downloader
+ * @param error nil if every list is fetched
+ */
+- (void)bulkDownloaderDidFinish:(nonnull KKBulkDownloader *)downloader error:(nullable NSError *)error NS_SWIFT_NAME(bulkDownloaderDidFinish(_:error:));
+@optional
+/**
+ * Called with the objects of a list as they are read from a
+ * downloaded page, in order. A page is delivered in one or more
+ * batches of at most `batchSize` objects.
+ *
+ * @param downloader the downloader
+ * @param objects the objects, such as KKTrackInfo, KKPlaylistInfo or
+ * KKAlbumInfo objects
+ * @param list the list
+ * @param ID the ID of the album or the category
+ */
+- (void)bulkDownloader:(nonnull KKBulkDownloader *)downloader didReceiveObjects:(nonnull NSArray <KKBOXOpenAPIObject *> *)objects ofList:(KKBulkDownloadList)list ID:(nonnull NSString *)ID NS_SWIFT_NAME(bulkDownloader(_:didReceive:list:id:));
+/**
+ * Called when every page of a list is fetched.
+ *
+ * @param downloader the downloader
+ * @param list the list
+ * @param ID the ID of the album or the category
+ */
+- (void)bulkDownloader:(nonnull KKBulkDownloader *)downloader didFinishList:(KKBulkDownloadList)list ID:(nonnull NSString *)ID NS_SWIFT_NAME(bulkDownloader(_:didFinish:id:));
+@end
+
+/**
+ * Fetches every page of long lists to files instead of memory.
+ *
+ * The pages are fetched one after another with download tasks, so the
+ * response bodies go to the disk, and each page is read back from its
+ * file in a streaming way, in batches of `batchSize` objects. Reading
+ * waits while a batch is being delivered to the delegate, so at most
+ * two batches are held in memory however slow the delegate is, and
+ * never the whole page. The downloader keeps a manifest of the lists and
+ * of how far each has got in its directory, updated after every page.
+ * A downloader created later with the same directory continues where
+ * the last one stopped, including a page interrupted in the middle if
+ * the system produced resume data for it.
+ *
+ * Pass a background session configuration to keep downloading while
+ * the app is suspended.
+ *
+ * The downloader must be started and used on the main thread.
+ */
+NS_SWIFT_NAME(BulkDownloader)
+@interface KKBulkDownloader : NSObject
+
+/**
+ * Create a downloader that fetches with the session configuration of
+ * the API object.
+ *
+ * @param API the API object. It must have a valid access token.
+ * @param directoryURL the directory for the manifest and the
+ * downloaded pages. It is created if needed, and if it holds a
+ * manifest, the lists in it are loaded.
+ * @return A KKBulkDownloader instance
+ */
+- (nonnull instancetype)initWithAPI:(nonnull KKBOXOpenAPI *)API directoryURL:(nonnull NSURL *)directoryURL NS_SWIFT_NAME(init(api:directoryURL:));
+
+/**
+ * Create a downloader.
+ *
+ * @param API the API object. It must have a valid access token.
+ * @param directoryURL the directory for the manifest and the
+ * downloaded pages
+ * @param configuration the configuration of the session that the
+ * downloader creates, such as a background configuration
+ * @return A KKBulkDownloader instance
+ */
+- (nonnull instancetype)initWithAPI:(nonnull KKBOXOpenAPI *)API directoryURL:(nonnull NSURL *)directoryURL configuration:(nonnull NSURLSessionConfiguration *)configuration NS_DESIGNATED_INITIALIZER NS_SWIFT_NAME(init(api:directoryURL:configuration:));
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+/**
+ * Add a list to fetch. Does nothing if the manifest already has the
+ * list, fetched or not.
+ *
+ * @param list the list
+ * @param ID the ID of the album or the category
+ * @param territory the territory
+ */
+- (void)addList:(KKBulkDownloadList)list ID:(nonnull NSString *)ID territory:(KKTerritoryCode)territory NS_SWIFT_NAME(add(_:id:territory:));
+
+/** Start or resume fetching. */
+- (void)start;
+/**
+ * Stop fetching. The page in flight is cancelled, and its resume data
+ * is kept in the manifest. Call `start` to continue.
+ */
+- (void)cancel;
+
+/** The sink of the fetched objects. */
+@property (weak, nullable, nonatomic) id <KKBulkDownloaderDelegate> delegate;
+/** The directory of the manifest and the downloaded pages. */
+@property (readonly, strong, nonnull, nonatomic) NSURL *directoryURL;
+/**
+ * The amount of objects asked for in each request. 500 by default.
+ * The API may return fewer; the next page starts after the objects
+ * actually returned.
+ */
+@property (assign, nonatomic) NSInteger pageSize;
+/** The max amount of objects in a `bulkDownloader:didReceiveObjects:ofList:ID:` call. 100 by default. */
+@property (assign, nonatomic) NSUInteger batchSize;
+/** The amount of the lists in the manifest that are not fetched yet. */
+@property (readonly, assign, nonatomic) NSUInteger pendingListCount;
+/** If the downloader is running. */
+@property (readonly, assign, nonatomic, getter=isRunning) BOOL running;
+@end
@@ -0,0 +1,95 @@
+//
+// OpenAPICatalogSnapshot.h
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+@import Foundation;
+
+#import "OpenAPIObjects.h"
+
+/** The version of the file format that `KKCatalogSnapshotBuilder` writes. */
+FOUNDATION_EXPORT const NSUInteger KKCatalogSnapshotVersion;
+
+/**
+ * Records the results of API calls and writes them into a snapshot
+ * file that `KKCatalogSnapshot` reads.
+ *
+ * Assign an instance to the `snapshotBuilder` property of a
+ * `KKBOXOpenAPI` object, make the calls that the snapshot should
+ * answer, such as the charts and the featured playlists of every
+ * territory and their tracks, and then write the snapshot. The pages
+ * of a list are joined as long as they follow one another from
+ * offset 0. The class is thread-safe.
+ */
+NS_SWIFT_NAME(CatalogSnapshotBuilder)
+@interface KKCatalogSnapshotBuilder : NSObject
+
+/** The amount of the distinct requests recorded so far, not counting the pages. */
+@property (readonly, assign, nonatomic) NSUInteger requestCount;
+
+/** Forget everything recorded so far. */
+- (void)removeAllResults;
+
+/**
+ * Write a snapshot of the results recorded so far.
+ *
+ * Every model object is written once, however many lists it is in.
+ * The file holds the strings and the objects, a table of their
+ * offsets, and a hash index from the requests to the objects that
+ * answer them.
+ *
+ * @param URL the file URL to write to. Existing contents are replaced.
+ * @param error set on failure
+ * @return YES on success
+ */
+- (BOOL)writeToURL:(nonnull NSURL *)URL error:(NSError *_Nullable *_Nullable)error;
+
+@end
+
+/**
+ * A read-only snapshot of API results, written by
+ * `KKCatalogSnapshotBuilder`.
+ *
+ * The file is memory-mapped, and opening it only checks its header,
+ * so it costs the same however large the snapshot is, and the
+ * processes that open the same file share its pages. Assign an
+ * instance to the `catalogSnapshot` property of a `KKBOXOpenAPI`
+ * object to answer the calls found in the snapshot without a network
+ * request. The model objects in a list are built from the file when
+ * they are accessed.
+ *
+ * Instances are immutable and thread-safe.
+ */
+NS_SWIFT_NAME(CatalogSnapshot)
+@interface KKCatalogSnapshot : NSObject
+
+/**
+ * Open a snapshot file.
+ *
+ * @param URL the file URL of the snapshot
+ * @param error set if the file cannot be mapped, is not a snapshot,
+ * or is written in a newer version of the format
+ * @return A KKCatalogSnapshot instance, or nil on failure
+ */
+- (nullable instancetype)initWithContentsOfURL:(nonnull NSURL *)URL error:(NSError *_Nullable *_Nullable)error;
+
+/**
+ * Read a snapshot held in memory.
+ *
+ * @param data the contents of a snapshot file. It is retained, not
+ * copied.
+ * @param error set if the data is not a snapshot, or is written in a
+ * newer version of the format
+ * @return A KKCatalogSnapshot instance, or nil on failure
+ */
+- (nullable instancetype)initWithData:(nonnull NSData *)data error:(NSError *_Nullable *_Nullable)error;
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+/** The amount of the requests that the snapshot answers. */
+@property (readonly, assign, nonatomic) NSUInteger requestCount;
+/** The amount of the distinct model objects in the snapshot. */
+@property (readonly, assign, nonatomic) NSUInteger objectCount;
+
+@end
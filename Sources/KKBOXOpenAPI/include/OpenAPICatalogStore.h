@@ -0,0 +1,120 @@
+//
+// OpenAPICatalogStore.h
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+@import Foundation;
+
+#import "OpenAPIObjects.h"
+#import "OpenAPI.h"
+
+/**
+ * An in-memory, client-side store of the catalog entities fetched
+ * from KKBOX's Open API.
+ *
+ * Tracks, albums, artists and playlists are upserted into the store
+ * keyed by their IDs. The store keeps a sorted index of normalized
+ * names for local look-up and prefix search, and secondary indexes
+ * from artists to albums and from albums to tracks, so that many
+ * queries can be answered without a network call.
+ *
+ * Assign an instance to the `catalogStore` property of a
+ * `KKBOXOpenAPI` object to have every parsed entity stored
+ * automatically. The class is thread-safe.
+ */
+NS_SWIFT_NAME(CatalogStore)
+@interface KKCatalogStore : NSObject
+
+/**
+ * Upsert an object into the store. Tracks, albums, artists and
+ * playlists are stored; the albums and artists embedded in them are
+ * stored as well if they are not known yet. Search results are
+ * unwrapped and each of their lists is stored. Other objects are
+ * ignored.
+ *
+ * @param object the object to store
+ */
+- (void)storeObject:(nonnull KKBOXOpenAPIObject *)object NS_SWIFT_NAME(store(_:));
+
+/**
+ * Upsert an array of objects into the store.
+ *
+ * @param objects the objects to store
+ */
+- (void)storeObjects:(nonnull NSArray <KKBOXOpenAPIObject *> *)objects NS_SWIFT_NAME(store(_:));
+
+/** Remove everything from the store. */
+- (void)removeAllObjects;
+
+/**
+ * Find a stored track.
+ *
+ * @param trackID the ID of the track
+ * @return the track, or nil if it is not stored
+ */
+- (nullable KKTrackInfo *)trackWithID:(nonnull NSString *)trackID NS_SWIFT_NAME(track(id:));
+
+/**
+ * Find a stored album.
+ *
+ * @param albumID the ID of the album
+ * @return the album, or nil if it is not stored
+ */
+- (nullable KKAlbumInfo *)albumWithID:(nonnull NSString *)albumID NS_SWIFT_NAME(album(id:));
+
+/**
+ * Find a stored artist.
+ *
+ * @param artistID the ID of the artist
+ * @return the artist, or nil if it is not stored
+ */
+- (nullable KKArtistInfo *)artistWithID:(nonnull NSString *)artistID NS_SWIFT_NAME(artist(id:));
+
+/**
+ * Find a stored playlist.
+ *
+ * @param playlistID the ID of the playlist
+ * @return the playlist, or nil if it is not stored
+ */
+- (nullable KKPlaylistInfo *)playlistWithID:(nonnull NSString *)playlistID NS_SWIFT_NAME(playlist(id:));
+
+/**
+ * The stored albums that belong to an artist, in the order they were
+ * first seen.
+ *
+ * @param artistID the ID of the artist
+ * @return the albums
+ */
+- (nonnull NSArray <KKAlbumInfo *> *)albumsOfArtistWithID:(nonnull NSString *)artistID NS_SWIFT_NAME(albums(artistID:));
+
+/**
+ * The stored tracks contained in an album, sorted by their track
+ * order in the album.
+ *
+ * @param albumID the ID of the album
+ * @return the tracks
+ */
+- (nonnull NSArray <KKTrackInfo *> *)tracksInAlbumWithID:(nonnull NSString *)albumID NS_SWIFT_NAME(tracks(albumID:));
+
+/**
+ * Search the stored entities whose names begin with a given prefix.
+ * The match ignores case, diacritics and character width.
+ *
+ * @param prefix the prefix of the names
+ * @param types the kinds of entities to return. Pass
+ * `KKSearchTypeNone` to return every kind.
+ * @param limit the max amount of the results. Pass 0 for no limit.
+ * @return the matching entities, sorted by their normalized names
+ */
+- (nonnull NSArray <KKBOXOpenAPIObject *> *)objectsWithNamePrefix:(nonnull NSString *)prefix types:(KKSearchType)types limit:(NSUInteger)limit NS_SWIFT_NAME(objects(namePrefix:types:limit:));
+
+/** The amount of the stored tracks. */
+@property (readonly, assign) NSUInteger trackCount;
+/** The amount of the stored albums. */
+@property (readonly, assign) NSUInteger albumCount;
+/** The amount of the stored artists. */
+@property (readonly, assign) NSUInteger artistCount;
+/** The amount of the stored playlists. */
+@property (readonly, assign) NSUInteger playlistCount;
+@end
@@ -0,0 +1,77 @@
+//
+// OpenAPICircuitBreaker.h
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+@import Foundation;
+
+/** The states of the circuit of an endpoint. */
+typedef NS_ENUM(NSInteger, KKCircuitState)
+{
+	/** Requests are sent as usual. */
+	KKCircuitStateClosed,
+	/** Requests fail immediately without being sent. */
+	KKCircuitStateOpen,
+	/** A few trial requests are sent to probe whether the endpoint has recovered. */
+	KKCircuitStateHalfOpen,
+} NS_SWIFT_NAME(CircuitBreaker.State);
+
+/**
+ * Posted on the main queue when the circuit of an endpoint changes
+ * its state. The object is the circuit breaker.
+ */
+extern NSString *_Nonnull const KKCircuitBreakerStateDidChangeNotification NS_SWIFT_NAME(CircuitBreaker.stateDidChangeNotification);
+/** The key of the endpoint in the user info of the notification. */
+extern NSString *_Nonnull const KKCircuitBreakerEndpointKey NS_SWIFT_NAME(CircuitBreaker.endpointKey);
+/** The key of the new `KKCircuitState` in the user info of the notification. */
+extern NSString *_Nonnull const KKCircuitBreakerStateKey NS_SWIFT_NAME(CircuitBreaker.stateKey);
+
+/**
+ * A circuit breaker that keeps a circuit per endpoint. Endpoints are
+ * told apart by their names, as in `-[KKBOXOpenAPI endpointMetrics]`,
+ * for example `albums/{id}/tracks`.
+ *
+ * A circuit opens when the ratio of failed calls among the recent
+ * ones reaches `failureRateThreshold`. Transport errors, HTTP 5xx and
+ * 429 responses, and calls slower than `slowCallDuration` count as
+ * failures. While a circuit is open, API calls to its endpoint fail
+ * immediately, or are answered with a remembered response marked as
+ * stale (see `KKBOXOpenAPIObject.stale`). After `openDuration` the
+ * circuit becomes half-open, and lets `trialCallCount` calls through:
+ * if all of them succeed it closes, and if any fails it opens again.
+ *
+ * The breaker is thread-safe.
+ */
+NS_SWIFT_NAME(CircuitBreaker)
+@interface KKCircuitBreaker : NSObject
+
+/**
+ * The state of the circuit of an endpoint.
+ *
+ * @param endpoint the name of the endpoint, such as `tracks/{id}`
+ * @return the state
+ */
+- (KKCircuitState)stateForEndpoint:(nonnull NSString *)endpoint NS_SWIFT_NAME(state(endpoint:));
+
+/** Close every circuit and forget the recent calls. */
+- (void)reset;
+
+/** The states of the known endpoints, keyed by their names. */
+@property (readonly, nonnull) NSDictionary <NSString *, NSNumber *> *endpointStates;
+/** The amount of calls that failed fast because their circuit was open. */
+@property (readonly, assign) NSUInteger rejectedCallCount;
+
+/** The ratio of failed calls that opens a circuit. 0.5 by default. */
+@property (assign) double failureRateThreshold;
+/** A circuit does not open before it has seen this many calls. 10 by default. */
+@property (assign) NSUInteger minimumCallCount;
+/** The amount of recent calls considered per endpoint. 20 by default. */
+@property (assign) NSUInteger windowSize;
+/** Successful calls slower than this count as failures. 10 seconds by default. */
+@property (assign) NSTimeInterval slowCallDuration;
+/** How long a circuit stays open before probing. 30 seconds by default. */
+@property (assign) NSTimeInterval openDuration;
+/** The amount of trial calls in the half-open state. 3 by default. */
+@property (assign) NSUInteger trialCallCount;
+@end
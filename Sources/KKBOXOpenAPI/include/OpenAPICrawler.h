@@ -0,0 +1,158 @@
+//
+// OpenAPICrawler.h
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+@import Foundation;
+
+#import "OpenAPI.h"
+
+@class KKArtistGraphCrawler;
+
+/** What the crawler fetches for every artist it visits. */
+typedef NS_OPTIONS(NSUInteger, KKCrawlExpansion)
+{
+	/** Fetch related artists, and visit them until the depth limit is reached. */
+	KKCrawlExpansionRelatedArtists = 1 << 0,
+	/** Fetch the albums of the artist. */
+	KKCrawlExpansionAlbums = 1 << 1,
+	/** Fetch the tracks of every fetched album. */
+	KKCrawlExpansionAlbumTracks = 1 << 2,
+	/** Everything above. */
+	KKCrawlExpansionAll = KKCrawlExpansionRelatedArtists | KKCrawlExpansionAlbums | KKCrawlExpansionAlbumTracks
+} NS_SWIFT_NAME(ArtistGraphCrawler.Expansion);
+
+/**
+ * The sink of the entities discovered by a crawler. All the methods
+ * are called on the main queue. Every entity is reported only once.
+ */
+NS_SWIFT_NAME(ArtistGraphCrawlerDelegate)
+@protocol KKArtistGraphCrawlerDelegate <NSObject>
+/**
+ * Called when the crawler stops, either because there is nothing left
+ * to fetch, or because it was cancelled.
+ *
+ * @param crawler the crawler
+ * @param error nil if the crawl completed
+ */
+- (void)crawlerDidFinish:(nonnull KKArtistGraphCrawler *)crawler error:(nullable NSError *)error;
+@optional
+/**
+ * Called when an artist is discovered.
+ *
+ * @param crawler the crawler
+ * @param artist the artist
+ * @param depth how many related-artist hops the artist is from a seed
+ */
+- (void)crawler:(nonnull KKArtistGraphCrawler *)crawler didDiscoverArtist:(nonnull KKArtistInfo *)artist depth:(NSUInteger)depth;
+/**
+ * Called when the related artists of an artist are fetched. The list
+ * includes artists that were already discovered, so that the edges of
+ * the graph can be recorded.
+ *
+ * @param crawler the crawler
+ * @param artists the related artists
+ * @param artistID the ID of the artist
+ */
+- (void)crawler:(nonnull KKArtistGraphCrawler *)crawler didFetchRelatedArtists:(nonnull NSArray <KKArtistInfo *> *)artists ofArtistID:(nonnull NSString *)artistID;
+/**
+ * Called when an album is discovered.
+ *
+ * @param crawler the crawler
+ * @param album the album
+ */
+- (void)crawler:(nonnull KKArtistGraphCrawler *)crawler didDiscoverAlbum:(nonnull KKAlbumInfo *)album;
+/**
+ * Called when the tracks of an album are fetched.
+ *
+ * @param crawler the crawler
+ * @param tracks the tracks
+ * @param albumID the ID of the album
+ */
+- (void)crawler:(nonnull KKArtistGraphCrawler *)crawler didDiscoverTracks:(nonnull NSArray <KKTrackInfo *> *)tracks inAlbumID:(nonnull NSString *)albumID;
+/**
+ * Called when a single fetch fails. The crawler skips the node and
+ * goes on. The fetch stays in `checkpoint`, so a crawler resumed from
+ * it retries the fetch.
+ *
+ * @param crawler the crawler
+ * @param error the error
+ */
+- (void)crawler:(nonnull KKArtistGraphCrawler *)crawler didFailWithError:(nonnull NSError *)error;
+@end
+
+/**
+ * Crawls the graph of related artists, their discography and album
+ * tracks, starting from a set of seed artists.
+ *
+ * The crawler keeps a visited set so that no node is fetched twice,
+ * a queue of pending fetches, and never has more than
+ * `maximumConcurrentRequests` requests in flight. Its progress can be
+ * saved with `checkpoint` and resumed later by creating a new crawler
+ * with the checkpoint.
+ *
+ * The crawler must be started and used on the main thread.
+ */
+NS_SWIFT_NAME(ArtistGraphCrawler)
+@interface KKArtistGraphCrawler : NSObject
+
+/**
+ * Create a crawler.
+ *
+ * @param API the API object used to fetch. It must have a valid access
+ * token.
+ * @param seedArtistIDs the IDs of the artists to start from
+ * @param territory the territory
+ * @return A KKArtistGraphCrawler instance
+ */
+- (nonnull instancetype)initWithAPI:(nonnull KKBOXOpenAPI *)API seedArtistIDs:(nonnull NSArray <NSString *> *)seedArtistIDs territory:(KKTerritoryCode)territory NS_SWIFT_NAME(init(api:seedArtistIDs:territory:));
+
+/**
+ * Create a crawler that resumes from a checkpoint.
+ *
+ * @param API the API object used to fetch
+ * @param checkpoint a checkpoint returned by `checkpoint`
+ * @return A KKArtistGraphCrawler instance, or nil if the checkpoint is
+ * invalid.
+ */
+- (nullable instancetype)initWithAPI:(nonnull KKBOXOpenAPI *)API checkpoint:(nonnull NSDictionary *)checkpoint NS_SWIFT_NAME(init(api:checkpoint:));
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+/** Start or resume crawling. */
+- (void)start;
+/**
+ * Stop issuing new requests. The requests in flight are allowed to
+ * finish. Call `start` to continue.
+ */
+- (void)pause;
+/** Stop crawling and cancel the requests in flight. */
+- (void)cancel;
+
+/**
+ * A property-list snapshot of the crawl state: the settings, the
+ * visited set and the pending fetches, including the ones in flight
+ * and the ones that failed.
+ * Pass it to `initWithAPI:checkpoint:` to resume.
+ */
+@property (readonly, nonnull) NSDictionary *checkpoint;
+
+/** The sink of the discovered entities. */
+@property (weak, nullable, nonatomic) id <KKArtistGraphCrawlerDelegate> delegate;
+/**
+ * How many related-artist hops to follow from the seeds. 1 by
+ * default; 0 visits the seeds only.
+ */
+@property (assign, nonatomic) NSUInteger maximumDepth;
+/** What to fetch for every visited artist. `KKCrawlExpansionAll` by default. */
+@property (assign, nonatomic) KKCrawlExpansion expansion;
+/** The max amount of requests in flight. 4 by default. */
+@property (assign, nonatomic) NSUInteger maximumConcurrentRequests;
+/** The amount of the completed requests. */
+@property (readonly, assign, nonatomic) NSUInteger completedRequestCount;
+/** The amount of the pending fetches, excluding the ones in flight. */
+@property (readonly, assign, nonatomic) NSUInteger pendingRequestCount;
+/** If the crawler is running. */
+@property (readonly, assign, nonatomic, getter=isRunning) BOOL running;
+@end
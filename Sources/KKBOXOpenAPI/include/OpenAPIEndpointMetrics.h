@@ -0,0 +1,35 @@
+//
+// OpenAPIEndpointMetrics.h
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+@import Foundation;
+
+/**
+ * The counters of the calls to one endpoint of KKBOX's Open API, as
+ * collected by `KKBOXOpenAPI`. An endpoint is named after its path
+ * with the ID replaced by `{id}`, like `albums/{id}/tracks`.
+ *
+ * The objects returned by `-[KKBOXOpenAPI endpointMetrics]` are
+ * snapshots and do not change afterwards.
+ */
+NS_SWIFT_NAME(EndpointMetrics)
+@interface KKEndpointMetrics : NSObject <NSCopying>
+/** The name of the endpoint. */
+@property (readonly, strong, nonnull, nonatomic) NSString *name;
+/** The amount of the calls, including the coalesced ones. */
+@property (readonly, assign, nonatomic) NSUInteger requestCount;
+/** The amount of the calls that joined an identical call in flight instead of sending a request. */
+@property (readonly, assign, nonatomic) NSUInteger coalescedCount;
+/** The amount of the requests sent again after a transient network error. */
+@property (readonly, assign, nonatomic) NSUInteger retryCount;
+/** The amount of the calls that ended with an error. */
+@property (readonly, assign, nonatomic) NSUInteger failureCount;
+/** The amount of the model objects parsed from the responses. */
+@property (readonly, assign, nonatomic) NSUInteger objectCount;
+/** The total time from sending the calls to parsing their responses, retries included. */
+@property (readonly, assign, nonatomic) NSTimeInterval totalLatency;
+/** `totalLatency` divided by the amount of the answered calls that were not coalesced. */
+@property (readonly, assign, nonatomic) NSTimeInterval averageLatency;
+@end
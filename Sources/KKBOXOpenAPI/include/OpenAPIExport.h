@@ -0,0 +1,107 @@
+//
+// OpenAPIExport.h
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+@import Foundation;
+
+#import "OpenAPI.h"
+
+/** The file formats that the export pipeline writes. */
+typedef NS_ENUM(NSUInteger, KKExportFormat)
+{
+	/** One JSON object per line. */
+	KKExportFormatNDJSON,
+	/** Comma-separated values with a header row. */
+	KKExportFormatCSV,
+} NS_SWIFT_NAME(ExportPipeline.Format);
+
+/** The contents that the export pipeline fetches. */
+typedef NS_OPTIONS(NSUInteger, KKExportContent)
+{
+	/** Chart playlists. */
+	KKExportContentCharts = 1 << 0,
+	/** Featured playlists. */
+	KKExportContentFeaturedPlaylists = 1 << 1,
+	/** New release album categories. */
+	KKExportContentNewReleaseCategories = 1 << 2,
+	/** The tracks in every exported chart and featured playlist. */
+	KKExportContentPlaylistTracks = 1 << 3,
+	/** The albums in every exported new release category. */
+	KKExportContentNewReleaseAlbums = 1 << 4,
+	/** Everything above. */
+	KKExportContentAll = KKExportContentCharts | KKExportContentFeaturedPlaylists | KKExportContentNewReleaseCategories | KKExportContentPlaylistTracks | KKExportContentNewReleaseAlbums
+} NS_SWIFT_NAME(ExportPipeline.Content);
+
+/**
+ * A pipeline that dumps charts, featured playlists, new release
+ * categories and their tracks and albums to a file.
+ *
+ * Items are written to the file sink page by page as the pages
+ * arrive, so the memory that the pipeline uses is bounded by the page
+ * size and `maximumBufferedPages`, regardless of the size of the
+ * catalog. Only one page is fetched at a time, and no new page is
+ * fetched while `maximumBufferedPages` pages are waiting to be
+ * written.
+ */
+NS_SWIFT_NAME(ExportPipeline)
+@interface KKExportPipeline : NSObject
+
+/**
+ * Create a new pipeline.
+ *
+ * @param API the API object used to fetch pages. It must have a valid
+ * access token.
+ * @param outputURL the file URL to write to. Existing contents are
+ * replaced.
+ * @param format the file format
+ * @return A KKExportPipeline instance
+ */
+- (nonnull instancetype)initWithAPI:(nonnull KKBOXOpenAPI *)API outputURL:(nonnull NSURL *)outputURL format:(KKExportFormat)format NS_DESIGNATED_INITIALIZER;
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+/**
+ * The columns that the pipeline can write: kind, territory,
+ * parent_id, id, name, url, artist_id, artist_name, album_id,
+ * album_name, duration, explicitness, release_date and updated_at.
+ * `kind` is one of "playlist", "track", "album" and "category";
+ * `parent_id` is the ID of the playlist or category that an item is
+ * listed in.
+ */
+@property (class, readonly, nonnull) NSArray <NSString *> *availableColumns;
+
+/**
+ * Start the export. Each pipeline can be started only once.
+ *
+ * @param completion called on the main queue with the amount of the
+ * written records, or an error.
+ */
+- (void)startWithCompletion:(nonnull void (^)(NSUInteger recordCount, NSError *_Nullable error))completion NS_SWIFT_NAME(start(completion:));
+
+/**
+ * Stop fetching. The completion is called with a cancellation error,
+ * also when the pipeline is started after it is cancelled.
+ */
+- (void)cancel;
+
+/** The territories to export. All the territories by default. */
+@property (strong, nonnull, nonatomic) NSArray <NSNumber *> *territories;
+/** The contents to export. `KKExportContentAll` by default. */
+@property (assign, nonatomic) KKExportContent contents;
+/**
+ * The columns to write, a subset of `availableColumns` in
+ * any order. All the available columns by default.
+ */
+@property (strong, nonnull, nonatomic) NSArray <NSString *> *columns;
+/** The amount of items requested per page. 100 by default. */
+@property (assign, nonatomic) NSInteger pageSize;
+/**
+ * The max amount of fetched pages waiting to be written before the
+ * pipeline stops fetching. 2 by default.
+ */
+@property (assign, nonatomic) NSUInteger maximumBufferedPages;
+/** The amount of the records written so far. */
+@property (readonly, assign) NSUInteger recordCount;
+@end
@@ -0,0 +1,64 @@
+//
+// OpenAPIHedging.h
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+@import Foundation;
+
+/**
+ * A policy for hedging API requests.
+ *
+ * When a request to an endpoint has not completed after `percentile`
+ * of the recent latencies of that endpoint, a duplicate request is
+ * sent. Hedges go out on a session with the configuration of the URL
+ * session of the API, but without its delegate and with connections
+ * of its own, so that a hedge does not wait behind the slow request.
+ * The first successful response wins; errors, 5xx and 429 responses
+ * only win if the other request fails too. The request that loses is
+ * cancelled. An original request is timed whether or not it lost, up
+ * to when it was cancelled, so that hedges do not pull the latencies
+ * down. Endpoints are
+ * told apart by their names, as in `-[KKBOXOpenAPI endpointMetrics]`,
+ * so `tracks/A` and `tracks/B` share the latencies of `tracks/{id}`.
+ *
+ * Hedges are capped by `maximumHedgeRatio`, so that the extra load on
+ * the server stays bounded even when every request is slow.
+ *
+ * All the API calls are idempotent GET requests, so sending them twice
+ * is safe. The policy is thread-safe.
+ */
+NS_SWIFT_NAME(HedgingPolicy)
+@interface KKHedgingPolicy : NSObject
+
+/** Reset the recent latencies and the metrics. */
+- (void)reset;
+
+/**
+ * The percentile of the recent latencies of an endpoint after which a
+ * hedge is sent, between 0 and 1. 0.95 by default.
+ */
+@property (assign) double percentile;
+/** The least delay before a hedge is sent. 0.05 seconds by default. */
+@property (assign) NSTimeInterval minimumDelay;
+/** The max ratio of hedges to requests. 0.05 by default. */
+@property (assign) double maximumHedgeRatio;
+/** The amount of recent latencies kept per endpoint. 100 by default. */
+@property (assign) NSUInteger windowSize;
+/**
+ * Requests to an endpoint are not hedged until this many latencies of
+ * the endpoint are known. 20 by default.
+ */
+@property (assign) NSUInteger minimumSampleCount;
+
+/** The amount of the requests sent under the policy. */
+@property (readonly, assign) NSUInteger requestCount;
+/** The amount of the hedges sent. */
+@property (readonly, assign) NSUInteger hedgeCount;
+/** The amount of the hedges that answered before the original requests. */
+@property (readonly, assign) NSUInteger hedgeWinCount;
+/** `hedgeCount` divided by `requestCount`. */
+@property (readonly, assign) double hedgeRate;
+/** `hedgeWinCount` divided by `hedgeCount`. */
+@property (readonly, assign) double hedgeWinRate;
+@end
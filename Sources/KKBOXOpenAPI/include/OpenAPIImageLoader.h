@@ -0,0 +1,102 @@
+//
+// OpenAPIImageLoader.h
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+@import Foundation;
+
+#import "OpenAPIObjects.h"
+
+#if TARGET_OS_OSX
+@import AppKit;
+/** The image class of the platform. */
+typedef NSImage KKImage;
+#else
+/** The image class of the platform. */
+typedef UIImage KKImage;
+#endif
+
+/** A pending image load. */
+NS_SWIFT_NAME(ImageLoadRequest)
+@interface KKImageLoadRequest : NSObject
+/**
+ * Stop waiting for the image. The completion block is not called. The
+ * download is cancelled only if nobody else is waiting for the same
+ * image.
+ */
+- (void)cancel;
+@end
+
+/**
+ * Downloads and decodes images, with a memory cache and a disk cache.
+ *
+ * - Loads of the same URL in flight at the same time share one
+ *   download.
+ * - Decoded images are kept in memory, and the least recently used
+ *   ones are dropped once they take more than `memoryCapacity` bytes.
+ * - Downloaded bytes are kept on disk, and the least recently used
+ *   files are removed once they take more than `diskCapacity` bytes.
+ *   A file that no longer decodes is removed and downloaded again.
+ * - Images are decoded off the main thread, so that drawing them does
+ *   not decode on the main thread again.
+ */
+NS_SWIFT_NAME(ImageLoader)
+@interface KKImageLoader : NSObject
+
+/** A loader using the shared URL session and the default cache directory. */
+@property (class, readonly, strong, nonnull) KKImageLoader *sharedLoader NS_SWIFT_NAME(shared);
+
+/**
+ * Create a loader.
+ *
+ * @param URLSession the URL session used to download images
+ * @param cacheDirectoryURL the directory of the disk cache, or nil to
+ * disable the disk cache. The directory is created if needed.
+ * @return A KKImageLoader instance
+ */
+- (nonnull instancetype)initWithURLSession:(nonnull NSURLSession *)URLSession cacheDirectoryURL:(nullable NSURL *)cacheDirectoryURL NS_DESIGNATED_INITIALIZER;
+
+/** Create a loader using the shared URL session and the default cache directory. */
+- (nonnull instancetype)init;
+
+/**
+ * Load an image.
+ *
+ * @param URL the URL of the image
+ * @param completion called on the main queue with the decoded image,
+ * or an error.
+ * @return the request, which you can cancel
+ */
+- (nonnull KKImageLoadRequest *)loadImageWithURL:(nonnull NSURL *)URL completion:(nonnull void (^)(KKImage *_Nullable, NSError *_Nullable))completion NS_SWIFT_NAME(loadImage(url:completion:));
+
+/**
+ * Load the image that best fits a size from a list of variants.
+ *
+ * @param images the variants, for example the `images` of an album
+ * @param pixelSize the target size in pixels
+ * @param completion called on the main queue with the decoded image,
+ * or an error.
+ * @return the request, or nil if there is no image with a URL. The
+ * completion is then called with an NSURLErrorBadURL error.
+ */
+- (nullable KKImageLoadRequest *)loadImageFromImages:(nonnull NSArray <KKImageInfo *> *)images pixelSize:(CGSize)pixelSize completion:(nonnull void (^)(KKImage *_Nullable, NSError *_Nullable))completion NS_SWIFT_NAME(loadImage(from:pixelSize:completion:));
+
+/**
+ * The image in the memory cache.
+ *
+ * @param URL the URL of the image
+ * @return the image, or nil if it is not in memory
+ */
+- (nullable KKImage *)cachedImageForURL:(nonnull NSURL *)URL NS_SWIFT_NAME(cachedImage(url:));
+
+/** Empty the memory and the disk caches. */
+- (void)removeAllCachedImages;
+
+/** The max bytes of decoded images kept in memory. 32 MB by default. */
+@property (assign) NSUInteger memoryCapacity;
+/** The bytes of decoded images in memory. */
+@property (readonly, assign) NSUInteger memoryUsage;
+/** The max bytes of image files kept on disk. 128 MB by default. */
+@property (assign) unsigned long long diskCapacity;
+@end
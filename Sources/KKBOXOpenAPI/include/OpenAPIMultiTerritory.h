@@ -0,0 +1,97 @@
+//
+// OpenAPIMultiTerritory.h
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+@import Foundation;
+
+#import "OpenAPI.h"
+
+/**
+ * The merged results of a request sent to several territories.
+ *
+ * Entities that appear in more than one territory are listed once,
+ * and the territories where they appear are recorded. Such entities
+ * share one parsed object, the one from the first territory (in
+ * `KKTerritoryCode` order) that listed them.
+ */
+NS_SWIFT_NAME(MultiTerritoryResults)
+@interface KKMultiTerritoryResults <__covariant ObjectType> : NSObject
+
+/**
+ * The merged and de-duplicated objects, ordered by the first
+ * territory they appear in, then by their order in that territory.
+ */
+@property (readonly, strong, nonatomic, nonnull) NSArray <ObjectType> *objects;
+/** The territories whose requests succeeded. */
+@property (readonly, assign, nonatomic) KKTerritoryMask succeededTerritories;
+/** The errors of the territories whose requests failed, keyed by `KKTerritoryCode`. */
+@property (readonly, strong, nonatomic, nonnull) NSDictionary <NSNumber *, NSError *> *errors;
+
+/**
+ * The territories that list an object.
+ *
+ * @param objectID the ID of the object
+ * @return the territories
+ */
+- (KKTerritoryMask)territoriesForObjectID:(nonnull NSString *)objectID NS_SWIFT_NAME(territories(objectID:));
+
+/**
+ * The objects listed in a territory, in their original order.
+ *
+ * @param territory the territory
+ * @return the objects, or an empty array if the territory was not
+ * requested or failed.
+ */
+- (nonnull NSArray <ObjectType> *)objectsForTerritory:(KKTerritoryCode)territory NS_SWIFT_NAME(objects(territory:));
+@end
+
+/**
+ * Variants of the API calls that accept several territories at once.
+ * The per-territory requests are sent concurrently and their results
+ * merged. The callback fails only if every territory fails, or if the
+ * mask has no valid territory.
+ *
+ * Each method returns the tasks of the per-territory requests so that
+ * you can cancel them.
+ */
+@interface KKBOXOpenAPI (MultiTerritory)
+
+/**
+ * Fetch a song track in several territories.
+ *
+ * @param trackID the ID of the song track
+ * @param territories the territories
+ * @param callback the callback block
+ * @return the NSURLSessionDataTask objects of the requests.
+ */
+- (nonnull NSArray <NSURLSessionDataTask *> *)fetchTrackWithTrackID:(nonnull NSString *)trackID territories:(KKTerritoryMask)territories callback:(nonnull void (^)(KKMultiTerritoryResults <KKTrackInfo *> *_Nullable, NSError *_Nullable))callback NS_SWIFT_NAME(fetchTrack(id:territories:callback:));
+
+/**
+ * Fetch the charts of several territories.
+ *
+ * @param territories the territories
+ * @param callback the callback block
+ * @return the NSURLSessionDataTask objects of the requests.
+ */
+- (nonnull NSArray <NSURLSessionDataTask *> *)fetchChartsForTerritories:(KKTerritoryMask)territories callback:(nonnull void (^)(KKMultiTerritoryResults <KKPlaylistInfo *> *_Nullable, NSError *_Nullable))callback NS_SWIFT_NAME(fetchCharts(territories:callback:));
+
+/**
+ * Fetch the featured playlists of several territories.
+ *
+ * @param territories the territories
+ * @param callback the callback block
+ * @return the NSURLSessionDataTask objects of the requests.
+ */
+- (nonnull NSArray <NSURLSessionDataTask *> *)fetchFeaturedPlaylistsForTerritories:(KKTerritoryMask)territories callback:(nonnull void (^)(KKMultiTerritoryResults <KKPlaylistInfo *> *_Nullable, NSError *_Nullable))callback NS_SWIFT_NAME(fetchFeaturedPlaylists(territories:callback:));
+
+/**
+ * Fetch the new hits playlists of several territories.
+ *
+ * @param territories the territories
+ * @param callback the callback block
+ * @return the NSURLSessionDataTask objects of the requests.
+ */
+- (nonnull NSArray <NSURLSessionDataTask *> *)fetchNewHitsPlaylistsForTerritories:(KKTerritoryMask)territories callback:(nonnull void (^)(KKMultiTerritoryResults <KKPlaylistInfo *> *_Nullable, NSError *_Nullable))callback NS_SWIFT_NAME(fetchNewHitsPlaylists(territories:callback:));
+@end
@@ -17,8 +17,13 @@
 #endif
 
 
-/** The model objects used in KKBOX's Open API. */
-@interface KKBOXOpenAPIObject : NSObject
+/**
+ The model objects used in KKBOX's Open API.
+
+ The objects support secure coding. They are archived in the compact
+ form of `KKBinaryArchive`.
+ */
+@interface KKBOXOpenAPIObject : NSObject <NSSecureCoding>
 /**
  Create an instance by a given dictionary.
 
@@ -26,6 +31,11 @@
  @return A KKBOXOpenAPIObject instance.
  */
 - (nonnull instancetype)initWithDictionary:(nonnull NSDictionary *)dictionary;
+/**
+ * If the object comes from a remembered response, served because the
+ * circuit of its endpoint is open or the request failed.
+ */
+@property (readonly, assign, nonatomic, getter=isStale) BOOL stale;
 @end
 
 /** The object that represents the pagination of a API response in list type. */
@@ -57,6 +67,17 @@ NS_SWIFT_NAME(ImageInfo)
 @property (readonly, assign, nonatomic) CGFloat height;
 /** URL of the image. */
 @property (readonly, strong, nonatomic, nullable) NSURL *imageURL NS_SWIFT_NAME(url);
+
+/**
+ * Pick the image that best fits a target size: the smallest image
+ * that is at least as large as the target in both dimensions, or the
+ * largest image if none is. Images without a URL are ignored.
+ *
+ * @param images the images, for example the `images` of an album
+ * @param pixelSize the target size in pixels, not in points
+ * @return the image, or nil if there is no image with a URL
+ */
++ (nullable KKImageInfo *)bestImageInImages:(nonnull NSArray <KKImageInfo *> *)images forPixelSize:(CGSize)pixelSize NS_SWIFT_NAME(bestImage(in:pixelSize:));
 @end
 
 /** The object represents information about an artist on KKBOX. */
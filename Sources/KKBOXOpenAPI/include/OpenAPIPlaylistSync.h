@@ -0,0 +1,119 @@
+//
+// OpenAPIPlaylistSync.h
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+@import Foundation;
+
+#import "OpenAPI.h"
+
+/**
+ * A compact record of a playlist at a point in time: only the track
+ * IDs in order and when the playlist was updated. Keep one per
+ * mirrored playlist and pass it to the next sync.
+ */
+NS_SWIFT_NAME(PlaylistSnapshot)
+@interface KKPlaylistSnapshot : NSObject <NSSecureCoding>
+
+/**
+ * Create a snapshot.
+ *
+ * @param playlistID the ID of the playlist
+ * @param lastUpdateDate the `updated_at` value of the playlist, or nil
+ * if it has none
+ * @param trackIDs the IDs of the tracks in the playlist, in order
+ * @return A KKPlaylistSnapshot instance
+ */
+- (nonnull instancetype)initWithPlaylistID:(nonnull NSString *)playlistID lastUpdateDate:(nullable NSString *)lastUpdateDate trackIDs:(nonnull NSArray <NSString *> *)trackIDs NS_DESIGNATED_INITIALIZER;
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+/** The ID of the playlist. */
+@property (readonly, strong, nonatomic, nonnull) NSString *playlistID;
+/**
+ * When was the playlist updated. Nil if the playlist has no
+ * `updated_at`, in which case every sync fetches all the tracks.
+ */
+@property (readonly, strong, nonatomic, nullable) NSString *lastUpdateDate;
+/** The IDs of the tracks in the playlist, in order. */
+@property (readonly, strong, nonatomic, nonnull) NSArray <NSString *> *trackIDs;
+@end
+
+/** A track that stays in a playlist but changes its position. */
+NS_SWIFT_NAME(PlaylistMove)
+@interface KKPlaylistMove : NSObject
+/** The index of the track in the old snapshot. */
+@property (readonly, assign, nonatomic) NSUInteger fromIndex;
+/** The index of the track in the new snapshot. */
+@property (readonly, assign, nonatomic) NSUInteger toIndex;
+@end
+
+/**
+ * The changes between two snapshots of a playlist.
+ *
+ * The indexes follow the batch update convention of table and
+ * collection views: remove the items at `deletedIndexes` and at the
+ * `fromIndex` of every move from the old list, then insert the items
+ * at `insertedIndexes` and at the `toIndex` of every move, in
+ * ascending order, to get the new list. Tracks that keep their
+ * relative order are left untouched, and the amount of moves is
+ * minimal.
+ */
+NS_SWIFT_NAME(PlaylistDelta)
+@interface KKPlaylistDelta : NSObject
+
+/**
+ * Compute the delta between two snapshots in O(n log n) time. Repeated
+ * track IDs are matched by occurrence.
+ *
+ * @param oldSnapshot the old snapshot, or nil for an empty playlist
+ * @param newSnapshot the new snapshot
+ * @return A KKPlaylistDelta instance, without `insertedTracks`.
+ */
++ (nonnull instancetype)deltaFromSnapshot:(nullable KKPlaylistSnapshot *)oldSnapshot toSnapshot:(nonnull KKPlaylistSnapshot *)newSnapshot NS_SWIFT_NAME(init(from:to:));
+
+/**
+ * The new snapshot. Store it in place of the old one. It is the old
+ * snapshot if the playlist did not change.
+ */
+@property (readonly, strong, nonatomic, nonnull) KKPlaylistSnapshot *snapshot;
+/**
+ * If the playlist changed. When the `updated_at` of the playlist did
+ * not change, the tracks are not fetched and this is NO.
+ */
+@property (readonly, assign, nonatomic) BOOL hasChanges;
+/** The indexes of the removed tracks in the old snapshot. */
+@property (readonly, strong, nonatomic, nonnull) NSIndexSet *deletedIndexes;
+/** The indexes of the added tracks in the new snapshot. */
+@property (readonly, strong, nonatomic, nonnull) NSIndexSet *insertedIndexes;
+/** The tracks that change their positions, ordered by `toIndex`. */
+@property (readonly, strong, nonatomic, nonnull) NSArray <KKPlaylistMove *> *moves;
+/**
+ * The added tracks, in the order of `insertedIndexes`. Only the added
+ * tracks are delivered as full objects.
+ */
+@property (readonly, strong, nonatomic, nonnull) NSArray <KKTrackInfo *> *insertedTracks;
+@end
+
+@interface KKBOXOpenAPI (PlaylistSync)
+
+/**
+ * Sync a shared playlist against a snapshot taken earlier.
+ *
+ * The playlist is fetched first. If its `updated_at` equals the
+ * `lastUpdateDate` of the snapshot, the sync stops there and the
+ * delta has no changes. Otherwise the remaining pages of tracks are
+ * fetched and diffed against the snapshot.
+ *
+ * @param playlistID the ID of the playlist
+ * @param snapshot the snapshot of the last sync, or nil for the first
+ * sync
+ * @param territory the territory
+ * @param callback the callback block
+ * @return the NSURLSessionDataTask object of the first request.
+ * Cancelling it stops the sync only before the track pages are
+ * requested.
+ */
+- (nonnull NSURLSessionDataTask *)syncPlaylistWithPlaylistID:(nonnull NSString *)playlistID snapshot:(nullable KKPlaylistSnapshot *)snapshot territory:(KKTerritoryCode)territory callback:(nonnull void (^)(KKPlaylistDelta *_Nullable, NSError *_Nullable))callback NS_SWIFT_NAME(syncPlaylist(id:snapshot:territory:callback:));
+@end
@@ -0,0 +1,74 @@
+//
+// OpenAPIRadioQueue.h
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+@import Foundation;
+
+#import "OpenAPI.h"
+
+/** The kinds of radio stations. */
+typedef NS_ENUM(NSUInteger, KKRadioStationKind)
+{
+	/** A mood station. */
+	KKRadioStationKindMood,
+	/** A genre station. */
+	KKRadioStationKindGenre,
+} NS_SWIFT_NAME(RadioStationQueue.Kind);
+
+/**
+ * A playback queue of the tracks of a mood or genre station.
+ *
+ * The queue keeps a look-ahead buffer of tracks, and fetches the next
+ * page of the station in the background as soon as the buffer drops
+ * below `lowWatermark`, so that a player asking for the next track
+ * seldom has to wait for a round trip. A track is never served twice.
+ *
+ * The queue must be used on the main thread.
+ */
+NS_SWIFT_NAME(RadioStationQueue)
+@interface KKRadioStationQueue : NSObject
+
+/**
+ * Create a queue.
+ *
+ * @param API the API object used to fetch. It must have a valid access
+ * token.
+ * @param stationID the ID of the station
+ * @param kind whether the station is a mood or a genre station
+ * @param territory the territory
+ * @return A KKRadioStationQueue instance
+ */
+- (nonnull instancetype)initWithAPI:(nonnull KKBOXOpenAPI *)API stationID:(nonnull NSString *)stationID kind:(KKRadioStationKind)kind territory:(KKTerritoryCode)territory NS_SWIFT_NAME(init(api:stationID:kind:territory:));
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+/** Start filling the buffer without taking a track. */
+- (void)prefetch;
+
+/**
+ * Take the next track.
+ *
+ * @param callback called immediately if a track is buffered, otherwise
+ * on the main queue once the next page arrives. The track is nil when
+ * the station has no more tracks or the fetch failed.
+ */
+- (void)dequeueTrackWithCallback:(nonnull void (^)(KKTrackInfo *_Nullable, NSError *_Nullable))callback NS_SWIFT_NAME(dequeueTrack(callback:));
+
+/** Cancel the fetch in flight, and drop the buffered tracks. */
+- (void)cancel;
+
+/** The station. Nil until the first page arrives. */
+@property (readonly, strong, nonatomic, nullable) KKRadioStation *station;
+/** The tracks fetched but not served yet. */
+@property (readonly, strong, nonatomic, nonnull) NSArray <KKTrackInfo *> *bufferedTracks;
+/** The amount of tracks the queue tries to keep buffered. 20 by default. */
+@property (assign, nonatomic) NSUInteger lookAheadCount;
+/** The buffer is refilled when it drops below this. 5 by default. */
+@property (assign, nonatomic) NSUInteger lowWatermark;
+/** The amount of tracks requested per page. 20 by default. */
+@property (assign, nonatomic) NSInteger pageSize;
+/** If every page of the station has been fetched. */
+@property (readonly, assign, nonatomic, getter=isExhausted) BOOL exhausted;
+@end
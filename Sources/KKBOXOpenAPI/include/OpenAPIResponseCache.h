@@ -0,0 +1,47 @@
+//
+// OpenAPIResponseCache.h
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+@import Foundation;
+
+/**
+ * Remembers the validators (`ETag` and `Last-Modified`) and the
+ * decoded JSON of API responses, keyed by URL.
+ *
+ * When a URL is requested again, the client sends `If-None-Match` and
+ * `If-Modified-Since`. If the server answers `304 Not Modified`, the
+ * remembered JSON is returned without downloading the body or decoding
+ * it again. Responses without a validator are only remembered when
+ * the API has a circuit breaker, to serve as stale fallbacks while a
+ * circuit is open.
+ *
+ * The cache is bounded by the body sizes of the responses, although
+ * their decoded JSON takes some more memory. The cache is thread-safe.
+ */
+NS_SWIFT_NAME(ResponseCache)
+@interface KKResponseCache : NSObject
+
+/** Forget all the remembered responses. The statistics are kept. */
+- (void)removeAllResponses;
+/** Reset the statistics to zero. */
+- (void)resetStatistics;
+
+/**
+ * The max sum of the body sizes of the remembered responses. The least
+ * recently used ones are dropped first, and a larger response is not
+ * remembered at all. 2 MB by default.
+ */
+@property (assign) unsigned long long maximumByteCount;
+/** The amount of the remembered responses. */
+@property (readonly, assign) NSUInteger responseCount;
+/** The sum of the body sizes of the remembered responses. */
+@property (readonly, assign) unsigned long long byteCount;
+/** The amount of the responses received from the server. */
+@property (readonly, assign) NSUInteger requestCount;
+/** The amount of the `304 Not Modified` responses. */
+@property (readonly, assign) NSUInteger notModifiedCount;
+/** The sum of the body sizes that `304` responses did not have to download. */
+@property (readonly, assign) unsigned long long bytesSaved;
+@end
@@ -0,0 +1,306 @@
+//
+// OpenAPI+Async.swift
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+import Foundation
+@_exported import KKBOXOpenAPI
+
+/// Holds the data task of a call, so that a cancellation that comes
+/// before or after the task is created cancels it.
+final class DataTaskBox: @unchecked Sendable {
+	private let lock = NSLock()
+	private var task: URLSessionDataTask?
+	private var cancelled = false
+
+	func set(_ task: URLSessionDataTask) {
+		self.lock.lock()
+		self.task = task
+		let cancelled = self.cancelled
+		self.lock.unlock()
+		if cancelled {
+			task.cancel()
+		}
+	}
+
+	func cancel() {
+		self.lock.lock()
+		self.cancelled = true
+		let task = self.task
+		self.lock.unlock()
+		task?.cancel()
+	}
+}
+
+@available(macOS 10.15, iOS 13.0, tvOS 13.0, watchOS 6.0, *)
+extension KKBOXOpenAPI {
+	/// A page of the items of a paged endpoint.
+	public struct Page<Item> {
+		/// The items in the page.
+		public var items: [Item]
+		/// Where the page is.
+		public var paging: PagingInfo
+		/// The total amount of the items.
+		public var summary: Summary
+	}
+
+	/// The queue that the callbacks of the async calls are called on.
+	/// The responses are parsed there too, and the calls resume their
+	/// tasks from it, so that nothing waits for the main queue.
+	private static let asyncCallbackQueue = DispatchQueue(label: "com.kkbox.openapi.async", qos: .userInitiated, attributes: .concurrent)
+
+	private static var invalidResponseError: Error {
+		return NSError(domain: KKBOXOpenAPIErrorDomain, code: 1, userInfo: [NSLocalizedDescriptionKey: "Invalid response"])
+	}
+
+	/// Make an API call and wait for its callback. Cancelling the current
+	/// task cancels the data task of the call, or the retry it is
+	/// waiting for.
+	func call<T>(_ start: (@escaping (Result<T, Error>) -> Void) -> URLSessionDataTask) async throws -> T {
+		let box = DataTaskBox()
+		return try await withTaskCancellationHandler {
+			try await withCheckedThrowingContinuation { (continuation: CheckedContinuation<T, Error>) in
+				var task: URLSessionDataTask?
+				self.perform(callbackQueue: KKBOXOpenAPI.asyncCallbackQueue) {
+					task = start { result in
+						continuation.resume(with: result.mapError { (error: Error) -> Error in
+							if let error = error as? URLError, error.code == .cancelled {
+								return CancellationError()
+							}
+							return error
+						})
+					}
+				}
+				box.set(task!)
+			}
+		} onCancel: {
+			box.cancel()
+		}
+	}
+
+	static func result<T>(_ value: T?, _ error: Error?) -> Result<T, Error> {
+		guard let value = value else {
+			return .failure(error ?? KKBOXOpenAPI.invalidResponseError)
+		}
+		return .success(value)
+	}
+
+	static func page<T>(_ items: [T]?, _ paging: PagingInfo?, _ summary: Summary?, _ error: Error?) -> Result<Page<T>, Error> {
+		guard let items = items, let paging = paging, let summary = summary else {
+			return .failure(error ?? KKBOXOpenAPI.invalidResponseError)
+		}
+		return .success(Page(items: items, paging: paging, summary: summary))
+	}
+
+	static func page<C, T>(_ container: C?, _ items: [T]?, _ paging: PagingInfo?, _ summary: Summary?, _ error: Error?) -> Result<(C, Page<T>), Error> {
+		guard let container = container else {
+			return .failure(error ?? KKBOXOpenAPI.invalidResponseError)
+		}
+		return page(items, paging, summary, error).map { (container, $0) }
+	}
+
+	// MARK: - Song Tracks
+
+	/// Fetch a song track.
+	public func fetchTrack(id: String, territory: Territory) async throws -> TrackInfo {
+		try await self.call { done in
+			self.fetchTrack(id: id, territory: territory) { done(KKBOXOpenAPI.result($0, $1)) }
+		}
+	}
+
+	// MARK: - Albums
+
+	/// Fetch an album.
+	public func fetchAlbum(id: String, territory: Territory) async throws -> KKAlbumInfo {
+		try await self.call { done in
+			self.fetchAlbum(id: id, territory: territory) { done(KKBOXOpenAPI.result($0, $1)) }
+		}
+	}
+
+	/// Fetch a page of the song tracks in an album.
+	public func fetchAlbumTracks(id: String, territory: Territory, offset: Int = 0, limit: Int = 500) async throws -> Page<TrackInfo> {
+		try await self.call { done in
+			self.fetchAlbumTracks(id: id, territory: territory, offset: offset, limit: limit) { done(KKBOXOpenAPI.page($0, $1, $2, $3)) }
+		}
+	}
+
+	// MARK: - Artists
+
+	/// Fetch an artist.
+	public func fetchArtist(id: String, territory: Territory) async throws -> ArtistInfo {
+		try await self.call { done in
+			self.fetchArtist(id: id, territory: territory) { done(KKBOXOpenAPI.result($0, $1)) }
+		}
+	}
+
+	/// Fetch a page of the albums of an artist.
+	public func fetchArtistAlbums(id: String, territory: Territory, offset: Int = 0, limit: Int = 200) async throws -> Page<KKAlbumInfo> {
+		try await self.call { done in
+			self.fetchArtistAlbums(id: id, territory: territory, offset: offset, limit: limit) { done(KKBOXOpenAPI.page($0, $1, $2, $3)) }
+		}
+	}
+
+	/// Fetch a page of the top tracks of an artist.
+	public func fetchArtistTopTracks(id: String, territory: Territory, offset: Int = 0, limit: Int = 200) async throws -> Page<TrackInfo> {
+		try await self.call { done in
+			self.fetchArtistTopTracks(id: id, territory: territory, offset: offset, limit: limit) { done(KKBOXOpenAPI.page($0, $1, $2, $3)) }
+		}
+	}
+
+	/// Fetch a page of the artists related to an artist.
+	public func fetchRelatedArtists(id: String, territory: Territory, offset: Int = 0, limit: Int = 20) async throws -> Page<ArtistInfo> {
+		try await self.call { done in
+			self.fetchRelatedArtists(id: id, territory: territory, offset: offset, limit: limit) { done(KKBOXOpenAPI.page($0, $1, $2, $3)) }
+		}
+	}
+
+	// MARK: - Shared Playlists
+
+	/// Fetch a playlist, with the paging info of its song tracks.
+	public func fetchPlaylist(id: String, territory: Territory) async throws -> (playlist: PlaylistInfo, paging: PagingInfo, summary: Summary) {
+		try await self.call { done in
+			self.fetchPlaylist(id: id, territory: territory) { playlist, paging, summary, error in
+				guard let playlist = playlist, let paging = paging, let summary = summary else {
+					done(.failure(error ?? KKBOXOpenAPI.invalidResponseError))
+					return
+				}
+				done(.success((playlist, paging, summary)))
+			}
+		}
+	}
+
+	/// Fetch a page of the song tracks in a playlist.
+	public func fetchPlaylistTracks(id: String, territory: Territory, offset: Int = 0, limit: Int = 20) async throws -> Page<TrackInfo> {
+		try await self.call { done in
+			self.fetchPlaylistTracks(id: id, territory: territory, offset: offset, limit: limit) { done(KKBOXOpenAPI.page($0, $1, $2, $3)) }
+		}
+	}
+
+	// MARK: - Featured Playlists
+
+	/// Fetch a page of the featured playlists.
+	public func fetchFeaturedPlaylists(territory: Territory, offset: Int = 0, limit: Int = 100) async throws -> Page<PlaylistInfo> {
+		try await self.call { done in
+			self.fetchFeaturedPlaylists(territory: territory, offset: offset, limit: limit) { done(KKBOXOpenAPI.page($0, $1, $2, $3)) }
+		}
+	}
+
+	// MARK: - New-Hits Playlists
+
+	/// Fetch a page of the new-hits playlists.
+	public func fetchNewHitsPlaylists(territory: Territory, offset: Int = 0, limit: Int = 10) async throws -> Page<PlaylistInfo> {
+		try await self.call { done in
+			self.fetchNewHitsPlaylists(territory: territory, offset: offset, limit: limit) { done(KKBOXOpenAPI.page($0, $1, $2, $3)) }
+		}
+	}
+
+	// MARK: - Featured Playlists Categories
+
+	/// Fetch a page of the featured playlist categories.
+	public func fetchFeaturedPlaylistCategories(territory: Territory, offset: Int = 0, limit: Int = 100) async throws -> Page<FeaturedPlaylistCategory> {
+		try await self.call { done in
+			self.fetchFeaturedPlaylistCategories(territory: territory, offset: offset, limit: limit) { done(KKBOXOpenAPI.page($0, $1, $2, $3)) }
+		}
+	}
+
+	/// Fetch a featured playlist category and a page of its playlists.
+	public func fetchFeaturedPlaylistCategoryPlaylists(category: String, territory: Territory, offset: Int = 0, limit: Int = 100) async throws -> (category: FeaturedPlaylistCategory, playlists: Page<PlaylistInfo>) {
+		try await self.call { done in
+			self.fetchFeaturedPlaylistCategoryPlaylists(category: category, territory: territory, offset: offset, limit: limit) { done(KKBOXOpenAPI.page($0, $1, $2, $3, $4)) }
+		}
+	}
+
+	// MARK: - Radio
+
+	/// Fetch the mood stations.
+	public func fetchMoodStations(territory: Territory) async throws -> Page<RadioStation> {
+		try await self.call { done in
+			self.fetchMoodStations(territory: territory) { done(KKBOXOpenAPI.page($0, $1, $2, $3)) }
+		}
+	}
+
+	/// Fetch a mood station and a page of its song tracks.
+	public func fetchMoodStation(id: String, territory: Territory, offset: Int = 0, limit: Int = 100) async throws -> (station: RadioStation, tracks: Page<TrackInfo>) {
+		try await self.call { done in
+			self.fetchMoodStation(id: id, territory: territory, offset: offset, limit: limit) { done(KKBOXOpenAPI.page($0, $1, $2, $3, $4)) }
+		}
+	}
+
+	/// Fetch the genre stations.
+	public func fetchGenreStations(territory: Territory) async throws -> Page<RadioStation> {
+		try await self.call { done in
+			self.fetchGenreStations(territory: territory) { done(KKBOXOpenAPI.page($0, $1, $2, $3)) }
+		}
+	}
+
+	/// Fetch a genre station and a page of its song tracks.
+	public func fetchGenreStation(id: String, territory: Territory, offset: Int = 0, limit: Int = 100) async throws -> (station: RadioStation, tracks: Page<TrackInfo>) {
+		try await self.call { done in
+			self.fetchGenreStation(id: id, territory: territory, offset: offset, limit: limit) { done(KKBOXOpenAPI.page($0, $1, $2, $3, $4)) }
+		}
+	}
+
+	// MARK: - Search
+
+	/// Search for artists, albums, song tracks and playlists.
+	public func search(keyword: String, types: SearchType, territory: Territory, offset: Int = 0, limit: Int = 50) async throws -> SearchResults {
+		try await self.call { done in
+			self.search(keyword: keyword, types: types, territory: territory, offset: offset, limit: limit) { done(KKBOXOpenAPI.result($0, $1)) }
+		}
+	}
+
+	// MARK: - New Releases
+
+	/// Fetch a page of the categories of the new-release albums.
+	public func fetchNewReleaseAlbumCategories(territory: Territory, offset: Int = 0, limit: Int = 100) async throws -> Page<NewReleaseAlbumsCategory> {
+		try await self.call { done in
+			self.fetchNewReleaseAlbumCategories(territory: territory, offset: offset, limit: limit) { done(KKBOXOpenAPI.page($0, $1, $2, $3)) }
+		}
+	}
+
+	/// Fetch a category of the new-release albums and a page of its albums.
+	public func fetchNewReleaseAlbums(id: String, territory: Territory, offset: Int = 0, limit: Int = 200) async throws -> (category: NewReleaseAlbumsCategory, albums: Page<KKAlbumInfo>) {
+		try await self.call { done in
+			self.fetchNewReleaseAlbums(id: id, territory: territory, offset: offset, limit: limit) { done(KKBOXOpenAPI.page($0, $1, $2, $3, $4)) }
+		}
+	}
+
+	// MARK: - Charts
+
+	/// Fetch a page of the charts.
+	public func fetchCharts(territory: Territory, offset: Int = 0, limit: Int = 50) async throws -> Page<PlaylistInfo> {
+		try await self.call { done in
+			self.fetchCharts(territory: territory, offset: offset, limit: limit) { done(KKBOXOpenAPI.page($0, $1, $2, $3)) }
+		}
+	}
+
+	// MARK: - Children Contents
+
+	/// Fetch the children categories.
+	public func fetchChildrenCategories(territory: Territory) async throws -> Page<KKChildrenCategory> {
+		try await self.call { done in
+			self.fetchChildrenCategories(territory: territory) { done(KKBOXOpenAPI.page($0, $1, $2, $3)) }
+		}
+	}
+
+	/// Fetch a children category.
+	public func fetchChildrenCategory(id: String, territory: Territory) async throws -> (group: ChildrenCategoryGroup, paging: PagingInfo, summary: Summary) {
+		try await self.call { done in
+			self.fetchChildrenCategory(id: id, territory: territory) { group, paging, summary, error in
+				guard let group = group, let paging = paging, let summary = summary else {
+					done(.failure(error ?? KKBOXOpenAPI.invalidResponseError))
+					return
+				}
+				done(.success((group, paging, summary)))
+			}
+		}
+	}
+
+	/// Fetch a page of the playlists in a children category.
+	public func fetchChildrenCategoryPlaylists(id: String, territory: Territory, offset: Int = 0, limit: Int = 100) async throws -> Page<PlaylistInfo> {
+		try await self.call { done in
+			self.fetchChildrenCategoryPlaylists(id: id, territory: territory, offset: offset, limit: limit) { done(KKBOXOpenAPI.page($0, $1, $2, $3)) }
+		}
+	}
+}
@@ -0,0 +1,138 @@
+//
+// PageSequence.swift
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+import Foundation
+import KKBOXOpenAPI
+
+/// The items of a paged endpoint, fetched a page at a time as they are
+/// iterated. The next page is requested only when the items of the
+/// current one run out, and iterating stops at the end of the list,
+/// at the first error, or when the task is cancelled.
+@available(macOS 10.15, iOS 13.0, tvOS 13.0, watchOS 6.0, *)
+public struct PageSequence<Item>: AsyncSequence {
+	public typealias Element = Item
+
+	/// How many items are requested at a time.
+	public let pageSize: Int
+	let fetchPage: (_ offset: Int, _ limit: Int) async throws -> KKBOXOpenAPI.Page<Item>
+
+	public init(pageSize: Int, fetchPage: @escaping (_ offset: Int, _ limit: Int) async throws -> KKBOXOpenAPI.Page<Item>) {
+		precondition(pageSize > 0)
+		self.pageSize = pageSize
+		self.fetchPage = fetchPage
+	}
+
+	public struct AsyncIterator: AsyncIteratorProtocol {
+		let sequence: PageSequence
+		var items = [Item]()
+		var index = 0
+		var offset = 0
+		var finished = false
+
+		public mutating func next() async throws -> Item? {
+			while self.index == self.items.count {
+				if self.finished {
+					return nil
+				}
+				try Task.checkCancellation()
+				let page = try await self.sequence.fetchPage(self.offset, self.sequence.pageSize)
+				self.items = page.items
+				self.index = 0
+				self.offset += page.items.count
+				let total = page.summary.total
+				if page.items.isEmpty || (total > 0 && self.offset >= total) {
+					self.finished = true
+				}
+			}
+			defer {
+				self.index += 1
+			}
+			return self.items[self.index]
+		}
+	}
+
+	public func makeAsyncIterator() -> AsyncIterator {
+		return AsyncIterator(sequence: self)
+	}
+}
+
+@available(macOS 10.15, iOS 13.0, tvOS 13.0, watchOS 6.0, *)
+extension KKBOXOpenAPI {
+	/// All the song tracks in an album.
+	public func albumTracks(id: String, territory: Territory, pageSize: Int = 500) -> PageSequence<TrackInfo> {
+		PageSequence(pageSize: pageSize) { try await self.fetchAlbumTracks(id: id, territory: territory, offset: $0, limit: $1) }
+	}
+
+	/// All the albums of an artist.
+	public func artistAlbums(id: String, territory: Territory, pageSize: Int = 200) -> PageSequence<KKAlbumInfo> {
+		PageSequence(pageSize: pageSize) { try await self.fetchArtistAlbums(id: id, territory: territory, offset: $0, limit: $1) }
+	}
+
+	/// All the top tracks of an artist.
+	public func artistTopTracks(id: String, territory: Territory, pageSize: Int = 200) -> PageSequence<TrackInfo> {
+		PageSequence(pageSize: pageSize) { try await self.fetchArtistTopTracks(id: id, territory: territory, offset: $0, limit: $1) }
+	}
+
+	/// All the artists related to an artist.
+	public func relatedArtists(id: String, territory: Territory, pageSize: Int = 20) -> PageSequence<ArtistInfo> {
+		PageSequence(pageSize: pageSize) { try await self.fetchRelatedArtists(id: id, territory: territory, offset: $0, limit: $1) }
+	}
+
+	/// All the song tracks in a playlist.
+	public func playlistTracks(id: String, territory: Territory, pageSize: Int = 100) -> PageSequence<TrackInfo> {
+		PageSequence(pageSize: pageSize) { try await self.fetchPlaylistTracks(id: id, territory: territory, offset: $0, limit: $1) }
+	}
+
+	/// All the featured playlists.
+	public func featuredPlaylists(territory: Territory, pageSize: Int = 100) -> PageSequence<PlaylistInfo> {
+		PageSequence(pageSize: pageSize) { try await self.fetchFeaturedPlaylists(territory: territory, offset: $0, limit: $1) }
+	}
+
+	/// All the new-hits playlists.
+	public func newHitsPlaylists(territory: Territory, pageSize: Int = 10) -> PageSequence<PlaylistInfo> {
+		PageSequence(pageSize: pageSize) { try await self.fetchNewHitsPlaylists(territory: territory, offset: $0, limit: $1) }
+	}
+
+	/// All the featured playlist categories.
+	public func featuredPlaylistCategories(territory: Territory, pageSize: Int = 100) -> PageSequence<FeaturedPlaylistCategory> {
+		PageSequence(pageSize: pageSize) { try await self.fetchFeaturedPlaylistCategories(territory: territory, offset: $0, limit: $1) }
+	}
+
+	/// All the playlists in a featured playlist category.
+	public func featuredPlaylistCategoryPlaylists(category: String, territory: Territory, pageSize: Int = 100) -> PageSequence<PlaylistInfo> {
+		PageSequence(pageSize: pageSize) { try await self.fetchFeaturedPlaylistCategoryPlaylists(category: category, territory: territory, offset: $0, limit: $1).playlists }
+	}
+
+	/// All the song tracks of a mood station.
+	public func moodStationTracks(id: String, territory: Territory, pageSize: Int = 100) -> PageSequence<TrackInfo> {
+		PageSequence(pageSize: pageSize) { try await self.fetchMoodStation(id: id, territory: territory, offset: $0, limit: $1).tracks }
+	}
+
+	/// All the song tracks of a genre station.
+	public func genreStationTracks(id: String, territory: Territory, pageSize: Int = 100) -> PageSequence<TrackInfo> {
+		PageSequence(pageSize: pageSize) { try await self.fetchGenreStation(id: id, territory: territory, offset: $0, limit: $1).tracks }
+	}
+
+	/// All the categories of the new-release albums.
+	public func newReleaseAlbumCategories(territory: Territory, pageSize: Int = 100) -> PageSequence<NewReleaseAlbumsCategory> {
+		PageSequence(pageSize: pageSize) { try await self.fetchNewReleaseAlbumCategories(territory: territory, offset: $0, limit: $1) }
+	}
+
+	/// All the albums in a category of the new-release albums.
+	public func newReleaseAlbums(id: String, territory: Territory, pageSize: Int = 200) -> PageSequence<KKAlbumInfo> {
+		PageSequence(pageSize: pageSize) { try await self.fetchNewReleaseAlbums(id: id, territory: territory, offset: $0, limit: $1).albums }
+	}
+
+	/// All the charts.
+	public func charts(territory: Territory, pageSize: Int = 50) -> PageSequence<PlaylistInfo> {
+		PageSequence(pageSize: pageSize) { try await self.fetchCharts(territory: territory, offset: $0, limit: $1) }
+	}
+
+	/// All the playlists in a children category.
+	public func childrenCategoryPlaylists(id: String, territory: Territory, pageSize: Int = 100) -> PageSequence<PlaylistInfo> {
+		PageSequence(pageSize: pageSize) { try await self.fetchChildrenCategoryPlaylists(id: id, territory: territory, offset: $0, limit: $1) }
+	}
+}
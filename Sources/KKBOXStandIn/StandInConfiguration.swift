@@ -0,0 +1,193 @@
+//
+// StandInConfiguration.swift
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+import Foundation
+
+/// How long the stand-in server waits before answering a request.
+public enum LatencyDistribution: Equatable {
+	/// Answer right away.
+	case none
+	/// Wait the same time before every answer.
+	case fixed(TimeInterval)
+	/// Wait a time picked evenly between two bounds.
+	case uniform(TimeInterval, TimeInterval)
+	/// Wait a log-normally distributed time, which has the long tail of
+	/// real network latencies.
+	case logNormal(median: TimeInterval, sigma: Double)
+
+	/// Parses `none`, `fixed:MS`, `uniform:MIN_MS:MAX_MS` or
+	/// `lognormal:MEDIAN_MS:SIGMA`.
+	public init?(_ description: String) {
+		let parts = description.split(separator: ":").map(String.init)
+		let numbers = parts.dropFirst().compactMap(Double.init)
+		guard numbers.count == parts.count - 1, numbers.allSatisfy({ $0 >= 0 }) else {
+			return nil
+		}
+		switch (parts.first, numbers.count) {
+		case ("none"?, 0):
+			self = .none
+		case ("fixed"?, 1):
+			self = .fixed(numbers[0] / 1000)
+		case ("uniform"?, 2) where numbers[0] <= numbers[1]:
+			self = .uniform(numbers[0] / 1000, numbers[1] / 1000)
+		case ("lognormal"?, 2):
+			self = .logNormal(median: numbers[0] / 1000, sigma: numbers[1])
+		default:
+			return nil
+		}
+	}
+
+	func sample(_ random: inout StandInRandom) -> TimeInterval {
+		switch self {
+		case .none:
+			return 0
+		case .fixed(let interval):
+			return interval
+		case .uniform(let lower, let upper):
+			return lower + (upper - lower) * random.nextDouble()
+		case .logNormal(let median, let sigma):
+			// Box-Muller transform for a standard normal variable.
+			let u1 = max(random.nextDouble(), Double.leastNonzeroMagnitude)
+			let u2 = random.nextDouble()
+			let z = (-2 * log(u1)).squareRoot() * cos(2 * Double.pi * u2)
+			return median * exp(sigma * z)
+		}
+	}
+}
+
+/// The settings of a stand-in server. The same settings and seed give
+/// the same catalog on every run and platform.
+public struct StandInConfiguration {
+	/// Seeds the synthetic catalog and the injected faults.
+	public var seed: UInt64 = 1
+	/// The amount of tracks in every album.
+	public var albumTrackCount = 12
+	/// The amount of tracks in every playlist and station.
+	public var playlistTrackCount = 100
+	/// The amount of albums of every artist.
+	public var artistAlbumCount = 20
+	/// The length of the other lists, such as the charts, the featured
+	/// playlists, the categories and the stations.
+	public var listCount = 50
+	/// The amount of results of every type in a search.
+	public var searchResultCount = 100
+	/// How long to wait before answering.
+	public var latency = LatencyDistribution.none
+	/// The share of the requests answered with a 500 error, from 0 to 1.
+	public var errorRate = 0.0
+	/// The share of the requests answered with a 429 error, from 0 to 1.
+	public var throttleRate = 0.0
+	/// How long an issued access token is accepted.
+	public var tokenLifetime: TimeInterval = 3600
+
+	public init() {}
+
+	/// The command-line options that `apply(option:value:)` takes.
+	public static let usage = """
+		--seed N                the seed of the catalog and the faults (1)
+		--album-tracks N        tracks per album (12)
+		--playlist-tracks N     tracks per playlist and station (100)
+		--artist-albums N       albums per artist (20)
+		--list-size N           length of the charts and the other lists (50)
+		--search-results N      results per type in a search (100)
+		--latency SPEC          none, fixed:MS, uniform:MIN_MS:MAX_MS or lognormal:MEDIAN_MS:SIGMA (none)
+		--error-rate R          share of requests answered with 500 (0)
+		--throttle-rate R       share of requests answered with 429 (0)
+		--token-lifetime S      seconds an access token is accepted (3600)
+	"""
+
+	/// Applies a command-line option.
+	///
+	/// - Returns: false if the option is unknown or its value is invalid.
+	public mutating func apply(option: String, value: String) -> Bool {
+		func count(_ keyPath: WritableKeyPath<StandInConfiguration, Int>) -> Bool {
+			guard let number = Int(value), number >= 0 else {
+				return false
+			}
+			self[keyPath: keyPath] = number
+			return true
+		}
+		func rate(_ keyPath: WritableKeyPath<StandInConfiguration, Double>) -> Bool {
+			guard let number = Double(value), number >= 0, number <= 1 else {
+				return false
+			}
+			self[keyPath: keyPath] = number
+			return true
+		}
+		switch option {
+		case "--seed":
+			guard let seed = UInt64(value) else {
+				return false
+			}
+			self.seed = seed
+			return true
+		case "--album-tracks":
+			return count(\.albumTrackCount)
+		case "--playlist-tracks":
+			return count(\.playlistTrackCount)
+		case "--artist-albums":
+			return count(\.artistAlbumCount)
+		case "--list-size":
+			return count(\.listCount)
+		case "--search-results":
+			return count(\.searchResultCount)
+		case "--latency":
+			guard let latency = LatencyDistribution(value) else {
+				return false
+			}
+			self.latency = latency
+			return true
+		case "--error-rate":
+			return rate(\.errorRate)
+		case "--throttle-rate":
+			return rate(\.throttleRate)
+		case "--token-lifetime":
+			guard let lifetime = TimeInterval(value), lifetime >= 0 else {
+				return false
+			}
+			self.tokenLifetime = lifetime
+			return true
+		default:
+			return false
+		}
+	}
+}
+
+/// SplitMix64, so that a seed gives the same numbers on every platform.
+struct StandInRandom {
+	private var state: UInt64
+
+	init(seed: UInt64) {
+		self.state = seed
+	}
+
+	/// Seeded by a string, such as the kind and the ID of an object.
+	init(seed: UInt64, _ key: String) {
+		var hash: UInt64 = 0xcbf29ce484222325
+		for byte in key.utf8 {
+			hash = (hash ^ UInt64(byte)) &* 0x100000001b3
+		}
+		self.state = seed ^ hash
+	}
+
+	mutating func next() -> UInt64 {
+		self.state &+= 0x9e3779b97f4a7c15
+		var z = self.state
+		z = (z ^ (z >> 30)) &* 0xbf58476d1ce4e5b9
+		z = (z ^ (z >> 27)) &* 0x94d049bb133111eb
+		return z ^ (z >> 31)
+	}
+
+	/// A number in [0, 1).
+	mutating func nextDouble() -> Double {
+		return Double(self.next() >> 11) / Double(UInt64(1) << 53)
+	}
+
+	/// A number in [0, bound).
+	mutating func next(below bound: Int) -> Int {
+		return Int(self.next() % UInt64(max(bound, 1)))
+	}
+}
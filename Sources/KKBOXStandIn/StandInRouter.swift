@@ -0,0 +1,350 @@
+//
+// StandInRouter.swift
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+import Foundation
+
+/// A parsed HTTP request.
+public struct StandInRequest {
+	public var method: String
+	/// The percent-decoded path, such as `/v1.1/tracks/abc`.
+	public var path: String
+	public var query: [String: String]
+	/// The header fields, keyed by lowercase names.
+	public var headers: [String: String]
+	public var body: Data
+
+	public init(method: String, path: String, query: [String: String] = [:], headers: [String: String] = [:], body: Data = Data()) {
+		self.method = method
+		self.path = path
+		self.query = query
+		self.headers = headers
+		self.body = body
+	}
+}
+
+/// An HTTP response.
+public struct StandInResponse {
+	public var statusCode: Int
+	public var headers: [String: String]
+	public var body: Data
+
+	static func json(_ object: Any, statusCode: Int = 200, headers: [String: String] = [:]) -> StandInResponse {
+		let body = (try? JSONSerialization.data(withJSONObject: object, options: [])) ?? Data()
+		var allHeaders = headers
+		allHeaders["Content-Type"] = "application/json; charset=utf-8"
+		return StandInResponse(statusCode: statusCode, headers: allHeaders, body: body)
+	}
+
+	/// An error in the form that the API uses.
+	static func error(_ statusCode: Int, _ message: String, headers: [String: String] = [:]) -> StandInResponse {
+		return self.json(["error": ["code": statusCode, "message": message]], statusCode: statusCode, headers: headers)
+	}
+
+	static func reasonPhrase(_ statusCode: Int) -> String {
+		switch statusCode {
+		case 200: return "OK"
+		case 400: return "Bad Request"
+		case 401: return "Unauthorized"
+		case 404: return "Not Found"
+		case 405: return "Method Not Allowed"
+		case 429: return "Too Many Requests"
+		case 500: return "Internal Server Error"
+		default: return "Unknown"
+		}
+	}
+}
+
+/// Answers the routes of the API with a synthetic catalog.
+///
+/// Every object is made from its ID and the seed, so the same request
+/// always gets the same body, and any ID is found. The faults and the
+/// latencies are drawn from a sequence seeded by the seed, so a run
+/// that sends the requests in the same order sees the same faults.
+/// The class is thread-safe.
+public final class StandInRouter {
+	public let configuration: StandInConfiguration
+	private let lock = NSLock()
+	private var requestNumber: UInt64 = 0
+	private var tokens = [String: Date]()
+
+	public init(configuration: StandInConfiguration) {
+		self.configuration = configuration
+	}
+
+	/// The response to a request, and how long to wait before sending it.
+	public func respond(to request: StandInRequest) -> (response: StandInResponse, delay: TimeInterval) {
+		self.lock.lock()
+		self.requestNumber += 1
+		var random = StandInRandom(seed: self.configuration.seed &+ self.requestNumber &* 0x2545f4914f6cdd1d)
+		self.lock.unlock()
+
+		let delay = self.configuration.latency.sample(&random)
+		if random.nextDouble() < self.configuration.throttleRate {
+			return (.error(429, "Too many requests", headers: ["Retry-After": "1"]), delay)
+		}
+		if random.nextDouble() < self.configuration.errorRate {
+			return (.error(500, "Internal server error"), delay)
+		}
+		let components = request.path.split(separator: "/").map(String.init)
+		if components == ["oauth2", "token"] {
+			return (self.token(request), delay)
+		}
+		guard components.first == "v1.1", components.count >= 2 else {
+			return (.error(404, "Not found"), delay)
+		}
+		guard request.method == "GET" else {
+			return (.error(405, "Method not allowed"), delay)
+		}
+		guard self.isAuthorized(request) else {
+			return (.error(401, "Invalid access token"), delay)
+		}
+		guard request.query["territory"] != nil else {
+			return (.error(400, "The territory is required"), delay)
+		}
+		guard let object = self.route(Array(components.dropFirst()), request) else {
+			return (.error(404, "Not found"), delay)
+		}
+		return (.json(object), delay)
+	}
+
+	// MARK: - Tokens
+
+	private func token(_ request: StandInRequest) -> StandInResponse {
+		guard request.method == "POST" else {
+			return .error(405, "Method not allowed")
+		}
+		var form = [String: String]()
+		for pair in String(decoding: request.body, as: UTF8.self).split(separator: "&") {
+			let parts = pair.split(separator: "=", maxSplits: 1).map { String($0).replacingOccurrences(of: "+", with: " ").removingPercentEncoding ?? "" }
+			form[parts[0]] = parts.count > 1 ? parts[1] : ""
+		}
+		guard request.headers["authorization"]?.hasPrefix("Basic ") == true, form["grant_type"] == "client_credentials" else {
+			return .json(["error": "invalid_client"], statusCode: 400)
+		}
+		self.lock.lock()
+		let token = "stand-in-\(self.requestNumber)-\(self.tokens.count)"
+		self.tokens[token] = Date().addingTimeInterval(self.configuration.tokenLifetime)
+		self.lock.unlock()
+		return .json(["access_token": token, "token_type": "Bearer", "expires_in": Int(self.configuration.tokenLifetime)])
+	}
+
+	private func isAuthorized(_ request: StandInRequest) -> Bool {
+		guard let authorization = request.headers["authorization"], authorization.hasPrefix("Bearer ") else {
+			return false
+		}
+		self.lock.lock()
+		defer { self.lock.unlock() }
+		guard let expiry = self.tokens[String(authorization.dropFirst("Bearer ".count))] else {
+			return false
+		}
+		return expiry > Date()
+	}
+
+	// MARK: - Routes
+
+	private func route(_ components: [String], _ request: StandInRequest) -> Any? {
+		let configuration = self.configuration
+		switch (components.count, components[0]) {
+		case (2, "tracks"):
+			return self.track(components[1])
+		case (2, "albums"):
+			return self.album(components[1])
+		case (2, "artists"):
+			return self.artist(components[1])
+		case (2, "shared-playlists"):
+			var playlist = self.playlist(components[1])
+			var firstPage = request
+			firstPage.query = ["territory": request.query["territory"]!, "offset": "0", "limit": "100"]
+			firstPage.path += "/tracks"
+			playlist["tracks"] = self.page(firstPage, total: configuration.playlistTrackCount) { self.track(self.id("playlist-track", components[1], $0)) }
+			return playlist
+		case (2, "featured-playlist-categories"):
+			var category = self.category(components[1])
+			category["playlists"] = self.page(request, total: configuration.listCount) { self.playlist(self.id("category-playlist", components[1], $0)) }
+			return category
+		case (2, "mood-stations"), (2, "genre-stations"):
+			var station = self.station(components[1], category: components[0] == "mood-stations" ? nil : "Genre")
+			station["tracks"] = self.page(request, total: configuration.playlistTrackCount) { self.track(self.id("station-track", components[1], $0)) }
+			return station
+		case (2, "new-release-categories"):
+			var category = self.category(components[1])
+			category["albums"] = self.page(request, total: configuration.listCount) { self.album(self.id("new-release", components[1], $0)) }
+			return category
+		case (2, "children-categories"):
+			var group = self.category(components[1])
+			group["subcategories"] = (0..<min(configuration.listCount, 10)).map { self.category(self.id("subcategory", components[1], $0)) }
+			return group
+		case (3, "albums") where components[2] == "tracks":
+			let album = self.album(components[1])
+			return self.page(request, total: configuration.albumTrackCount) { index -> Any in
+				var track = self.track(self.id("album-track", components[1], index))
+				track["album"] = album
+				track["track_number"] = index + 1
+				return track
+			}
+		case (3, "artists") where components[2] == "albums":
+			return self.page(request, total: configuration.artistAlbumCount) { self.album(self.id("artist-album", components[1], $0)) }
+		case (3, "artists") where components[2] == "top-tracks":
+			return self.page(request, total: configuration.listCount) { self.track(self.id("top-track", components[1], $0)) }
+		case (3, "artists") where components[2] == "related-artists":
+			return self.page(request, total: configuration.listCount) { self.artist(self.id("related-artist", components[1], $0)) }
+		case (3, "shared-playlists") where components[2] == "tracks":
+			return self.page(request, total: configuration.playlistTrackCount) { self.track(self.id("playlist-track", components[1], $0)) }
+		case (3, "children-categories") where components[2] == "playlists":
+			return self.page(request, total: configuration.listCount) { self.playlist(self.id("children-playlist", components[1], $0)) }
+		case (1, "featured-playlists"), (1, "new-hits-playlists"), (1, "charts"):
+			return self.page(request, total: configuration.listCount) { self.playlist(self.id(components[0], "", $0)) }
+		case (1, "featured-playlist-categories"), (1, "new-release-categories"), (1, "children-categories"):
+			return self.page(request, total: configuration.listCount) { self.category(self.id(components[0], "", $0)) }
+		case (1, "mood-stations"), (1, "genre-stations"):
+			return self.page(request, total: configuration.listCount) { self.station(self.id(components[0], "", $0), category: components[0] == "mood-stations" ? nil : "Genre") }
+		case (1, "search"):
+			return self.search(request)
+		default:
+			return nil
+		}
+	}
+
+	private func search(_ request: StandInRequest) -> Any? {
+		guard let keyword = request.query["q"] else {
+			return nil
+		}
+		let total = self.configuration.searchResultCount
+		let types = request.query["type"]?.split(separator: ",").map(String.init) ?? ["artist", "album", "track", "playlist"]
+		var results = self.page(request, total: total) { _ in NSNull() }
+		results["data"] = nil
+		if types.contains("track") {
+			results["tracks"] = self.page(request, total: total) { self.track(self.id("search-track", keyword, $0)) }
+		}
+		if types.contains("album") {
+			results["albums"] = self.page(request, total: total) { self.album(self.id("search-album", keyword, $0)) }
+		}
+		if types.contains("artist") {
+			results["artists"] = self.page(request, total: total) { self.artist(self.id("search-artist", keyword, $0)) }
+		}
+		if types.contains("playlist") {
+			results["playlists"] = self.page(request, total: total) { self.playlist(self.id("search-playlist", keyword, $0)) }
+		}
+		return results
+	}
+
+	/// A page of a list with `data`, `paging` and `summary`, cut by the
+	/// `offset` and `limit` of the request.
+	private func page(_ request: StandInRequest, total: Int, item: (Int) -> Any) -> [String: Any] {
+		let offset = max(Int(request.query["offset"] ?? "") ?? 0, 0)
+		let limit = min(max(Int(request.query["limit"] ?? "") ?? 50, 1), 500)
+		let range = min(offset, total)..<min(offset + limit, total)
+		let paging: [String: Any] = [
+			"offset": offset,
+			"limit": limit,
+			"previous": offset > 0 ? self.pageURL(request, offset: max(offset - limit, 0), limit: limit) : NSNull(),
+			"next": offset + limit < total ? self.pageURL(request, offset: offset + limit, limit: limit) : NSNull(),
+		]
+		return ["data": range.map(item), "paging": paging, "summary": ["total": total]]
+	}
+
+	private func pageURL(_ request: StandInRequest, offset: Int, limit: Int) -> Any {
+		var components = URLComponents()
+		components.scheme = "http"
+		let host = request.headers["host"] ?? "127.0.0.1"
+		if let colon = host.lastIndex(of: ":"), let port = Int(host[host.index(after: colon)...]) {
+			components.host = String(host[..<colon])
+			components.port = port
+		}
+		else {
+			components.host = host
+		}
+		components.path = request.path
+		var query = request.query
+		query["offset"] = String(offset)
+		query["limit"] = String(limit)
+		components.queryItems = query.keys.sorted().map { URLQueryItem(name: $0, value: query[$0]) }
+		return components.string ?? NSNull()
+	}
+
+	// MARK: - Catalog
+
+	private static let idAlphabet = Array("0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz-_")
+
+	/// The ID of an object in a list, shaped like the IDs of the API.
+	private func id(_ kind: String, _ parent: String, _ index: Int) -> String {
+		let alphabet = StandInRouter.idAlphabet
+		var random = StandInRandom(seed: self.configuration.seed, "\(kind)/\(parent)/\(index)")
+		return String((0..<18).map { _ in alphabet[random.next(below: alphabet.count)] })
+	}
+
+	private func images(_ kind: String, _ id: String) -> [[String: Any]] {
+		return [160, 500, 1000].map { ["width": $0, "height": $0, "url": "https://i.kfs.io/\(kind)/global/\(id)/fit/\($0)x\($0).jpg"] }
+	}
+
+	private func territories(_ random: inout StandInRandom) -> [String] {
+		return ["TW"] + ["HK", "SG", "MY", "JP"].filter { _ in random.next(below: 4) > 0 }
+	}
+
+	private func track(_ id: String) -> [String: Any] {
+		var random = StandInRandom(seed: self.configuration.seed, "track/\(id)")
+		return [
+			"id": id,
+			"name": "Track \(random.next(below: 100000))",
+			"duration": 120000 + random.next(below: 240000),
+			"url": "https://www.kkbox.com/tw/tc/song/\(id)",
+			"track_number": 1 + random.next(below: max(self.configuration.albumTrackCount, 1)),
+			"explicitness": random.next(below: 10) == 0,
+			"available_territories": self.territories(&random),
+			"album": self.album(self.id("track-album", id, 0)),
+		]
+	}
+
+	private func album(_ id: String) -> [String: Any] {
+		var random = StandInRandom(seed: self.configuration.seed, "album/\(id)")
+		return [
+			"id": id,
+			"name": "Album \(random.next(below: 100000))",
+			"url": "https://www.kkbox.com/tw/tc/album/\(id)",
+			"explicitness": random.next(below: 10) == 0,
+			"available_territories": self.territories(&random),
+			"release_date": String(format: "%04d-%02d-%02d", 1990 + random.next(below: 31), 1 + random.next(below: 12), 1 + random.next(below: 28)),
+			"images": self.images("album", id),
+			"artist": self.artist(self.id("album-artist", id, 0)),
+		]
+	}
+
+	private func artist(_ id: String) -> [String: Any] {
+		var random = StandInRandom(seed: self.configuration.seed, "artist/\(id)")
+		return [
+			"id": id,
+			"name": "Artist \(random.next(below: 100000))",
+			"url": "https://www.kkbox.com/tw/tc/artist/\(id)",
+			"images": self.images("artist", id),
+		]
+	}
+
+	private func playlist(_ id: String) -> [String: Any] {
+		var random = StandInRandom(seed: self.configuration.seed, "playlist/\(id)")
+		let ownerID = self.id("playlist-owner", id, 0)
+		return [
+			"id": id,
+			"title": "Playlist \(random.next(below: 100000))",
+			"description": "A synthetic playlist",
+			"url": "https://www.kkbox.com/tw/tc/playlist/\(id)",
+			"images": self.images("playlist", id),
+			"updated_at": String(format: "2020-%02d-%02dT00:00:00+08:00", 1 + random.next(below: 12), 1 + random.next(below: 28)),
+			"owner": ["id": ownerID, "name": "User \(random.next(below: 100000))", "url": "https://www.kkbox.com/tw/tc/profile/\(ownerID)", "images": self.images("user", ownerID)],
+		]
+	}
+
+	private func category(_ id: String) -> [String: Any] {
+		var random = StandInRandom(seed: self.configuration.seed, "category/\(id)")
+		return ["id": id, "title": "Category \(random.next(below: 100000))", "images": self.images("category", id)]
+	}
+
+	private func station(_ id: String, category: String?) -> [String: Any] {
+		var random = StandInRandom(seed: self.configuration.seed, "station/\(id)")
+		var station: [String: Any] = ["id": id, "name": "Station \(random.next(below: 100000))", "images": self.images("station", id)]
+		station["category"] = category
+		return station
+	}
+}
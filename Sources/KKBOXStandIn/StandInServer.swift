@@ -0,0 +1,259 @@
+//
+// StandInServer.swift
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+import Foundation
+#if canImport(Glibc)
+import Glibc
+private let streamSocketType = Int32(SOCK_STREAM.rawValue)
+#elseif canImport(Darwin)
+import Darwin
+private let streamSocketType = SOCK_STREAM
+#endif
+
+/// A failure of a socket call, with its errno.
+public struct StandInSocketError: Error, CustomStringConvertible {
+	public var call: String
+	public var code: Int32
+
+	public var description: String {
+		return "\(self.call) failed: \(String(cString: strerror(self.code)))"
+	}
+}
+
+/// An HTTP/1.1 server that answers like the KKBOX Open API, so that
+/// integrations can be tested and loaded without the real service.
+///
+/// It serves the API under `/v1.1/` and the client-credential flow of
+/// `/oauth2/token` with `StandInRouter`. It only needs POSIX sockets
+/// and Foundation, so it runs on Linux as well as on Apple platforms.
+/// Every connection is served on its own thread and kept alive between
+/// requests, and the latency of a response is spent on that thread.
+public final class StandInServer {
+	public let router: StandInRouter
+	/// The address the server listens on.
+	public private(set) var host = "127.0.0.1"
+	/// The port the server listens on, known once it is started.
+	public private(set) var port: UInt16 = 0
+	private let lock = NSLock()
+	private var listeningSocket: Int32 = -1
+
+	public init(configuration: StandInConfiguration = StandInConfiguration()) {
+		self.router = StandInRouter(configuration: configuration)
+	}
+
+	deinit {
+		self.stop()
+	}
+
+	/// The URL to assign to the `apiBaseURL` of a `KKBOXOpenAPI` object.
+	public var apiBaseURL: URL {
+		return URL(string: "http://\(self.host):\(self.port)/v1.1/")!
+	}
+
+	/// The URL to assign to the `tokenURL` of a `KKBOXOpenAPI` object.
+	public var tokenURL: URL {
+		return URL(string: "http://\(self.host):\(self.port)/oauth2/token")!
+	}
+
+	/// Start listening and accepting connections.
+	///
+	/// - Parameters:
+	///   - host: an IPv4 address to listen on
+	///   - port: the port, or 0 to pick a free one
+	public func start(host: String = "127.0.0.1", port: UInt16 = 0) throws {
+		signal(SIGPIPE, SIG_IGN)
+		let fd = socket(AF_INET, streamSocketType, 0)
+		guard fd >= 0 else {
+			throw StandInSocketError(call: "socket", code: errno)
+		}
+		var reuse: Int32 = 1
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, socklen_t(MemoryLayout<Int32>.size))
+
+		var address = sockaddr_in()
+		#if canImport(Darwin)
+		address.sin_len = UInt8(MemoryLayout<sockaddr_in>.size)
+		#endif
+		address.sin_family = sa_family_t(AF_INET)
+		address.sin_port = port.bigEndian
+		guard inet_pton(AF_INET, host, &address.sin_addr) == 1 else {
+			close(fd)
+			throw StandInSocketError(call: "inet_pton", code: EINVAL)
+		}
+		let bound = withUnsafePointer(to: &address) {
+			$0.withMemoryRebound(to: sockaddr.self, capacity: 1) {
+				bind(fd, $0, socklen_t(MemoryLayout<sockaddr_in>.size))
+			}
+		}
+		guard bound == 0, listen(fd, 128) == 0 else {
+			let code = errno
+			close(fd)
+			throw StandInSocketError(call: "bind", code: code)
+		}
+		var length = socklen_t(MemoryLayout<sockaddr_in>.size)
+		_ = withUnsafeMutablePointer(to: &address) {
+			$0.withMemoryRebound(to: sockaddr.self, capacity: 1) {
+				getsockname(fd, $0, &length)
+			}
+		}
+
+		self.lock.lock()
+		self.host = host
+		self.port = UInt16(bigEndian: address.sin_port)
+		self.listeningSocket = fd
+		self.lock.unlock()
+		let thread = Thread { [router = self.router] in
+			while true {
+				let connection = accept(fd, nil, nil)
+				if connection < 0 {
+					if errno == EINTR {
+						continue
+					}
+					return
+				}
+				Thread {
+					StandInConnection(socket: connection, router: router).serve()
+				}.start()
+			}
+		}
+		thread.name = "StandInServer.accept"
+		thread.start()
+	}
+
+	/// Stop accepting connections. The connections already open are
+	/// served until their clients close them.
+	public func stop() {
+		self.lock.lock()
+		let fd = self.listeningSocket
+		self.listeningSocket = -1
+		self.lock.unlock()
+		if fd >= 0 {
+			// Shutting down wakes the thread blocked in accept().
+			shutdown(fd, Int32(SHUT_RDWR))
+			close(fd)
+		}
+	}
+}
+
+/// Reads requests from a connection and writes the responses, until
+/// the client closes it or stays idle for 30 seconds.
+final class StandInConnection {
+	private static let maximumHeaderLength = 64 * 1024
+	private let socket: Int32
+	private let router: StandInRouter
+	private var buffer = [UInt8]()
+
+	init(socket: Int32, router: StandInRouter) {
+		self.socket = socket
+		self.router = router
+	}
+
+	func serve() {
+		defer {
+			close(self.socket)
+		}
+		var timeout = timeval(tv_sec: 30, tv_usec: 0)
+		setsockopt(self.socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, socklen_t(MemoryLayout<timeval>.size))
+		while let request = self.readRequest() {
+			let (response, delay) = self.router.respond(to: request)
+			if delay > 0 {
+				Thread.sleep(forTimeInterval: delay)
+			}
+			let keepAlive = request.headers["connection"]?.lowercased() != "close"
+			guard self.write(response, keepAlive: keepAlive), keepAlive else {
+				return
+			}
+		}
+	}
+
+	private func readRequest() -> StandInRequest? {
+		var headerLength = 0
+		while true {
+			if let end = self.endOfHeader() {
+				headerLength = end
+				break
+			}
+			guard self.buffer.count < StandInConnection.maximumHeaderLength, self.fill() else {
+				return nil
+			}
+		}
+		var lines = String(decoding: self.buffer[0..<headerLength], as: UTF8.self).components(separatedBy: "\r\n")
+		let requestLine = lines.removeFirst().split(separator: " ")
+		guard requestLine.count >= 2 else {
+			return nil
+		}
+		var headers = [String: String]()
+		for line in lines {
+			if let colon = line.firstIndex(of: ":") {
+				headers[line[..<colon].lowercased()] = line[line.index(after: colon)...].trimmingCharacters(in: .whitespaces)
+			}
+		}
+		let bodyStart = headerLength + 4
+		let bodyLength = max(Int(headers["content-length"] ?? "") ?? 0, 0)
+		while self.buffer.count < bodyStart + bodyLength {
+			guard self.fill() else {
+				return nil
+			}
+		}
+		let body = Data(self.buffer[bodyStart..<bodyStart + bodyLength])
+		self.buffer.removeFirst(bodyStart + bodyLength)
+
+		let target = String(requestLine[1])
+		let components = URLComponents(string: target)
+		var query = [String: String]()
+		for item in components?.queryItems ?? [] {
+			query[item.name] = item.value ?? ""
+		}
+		return StandInRequest(method: String(requestLine[0]), path: components?.path ?? target, query: query, headers: headers, body: body)
+	}
+
+	/// The offset of the blank line that ends the header, if it is read.
+	private func endOfHeader() -> Int? {
+		let bytes = self.buffer
+		guard bytes.count >= 4 else {
+			return nil
+		}
+		for index in 0...(bytes.count - 4) where bytes[index] == 13 && bytes[index + 1] == 10 && bytes[index + 2] == 13 && bytes[index + 3] == 10 {
+			return index
+		}
+		return nil
+	}
+
+	private func fill() -> Bool {
+		var chunk = [UInt8](repeating: 0, count: 16 * 1024)
+		let count = chunk.withUnsafeMutableBytes { recv(self.socket, $0.baseAddress, $0.count, 0) }
+		guard count > 0 else {
+			return false
+		}
+		self.buffer.append(contentsOf: chunk[0..<count])
+		return true
+	}
+
+	private func write(_ response: StandInResponse, keepAlive: Bool) -> Bool {
+		var headers = response.headers
+		headers["Content-Length"] = String(response.body.count)
+		headers["Connection"] = keepAlive ? "keep-alive" : "close"
+		var head = "HTTP/1.1 \(response.statusCode) \(StandInResponse.reasonPhrase(response.statusCode))\r\n"
+		for name in headers.keys.sorted() {
+			head += "\(name): \(headers[name]!)\r\n"
+		}
+		head += "\r\n"
+		var bytes = Array(head.utf8)
+		bytes.append(contentsOf: response.body)
+
+		var sent = 0
+		while sent < bytes.count {
+			let count = bytes.withUnsafeBytes { send(self.socket, $0.baseAddress! + sent, $0.count - sent, 0) }
+			if count < 0 && errno == EINTR {
+				continue
+			}
+			guard count > 0 else {
+				return false
+			}
+			sent += count
+		}
+		return true
+	}
+}
@@ -0,0 +1,54 @@
+//
+// main.swift
+//
+// Copyright (c) 2016-2020 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+import Foundation
+import KKBOXStandIn
+
+let usage = """
+	Usage: kkbox-stand-in [--host ADDRESS] [--port N] [options]
+
+	Serves the KKBOX Open API routes with a synthetic catalog.
+
+		--host ADDRESS          the IPv4 address to listen on (127.0.0.1)
+		--port N                the port, 0 for any free port (8080)
+	\(StandInConfiguration.usage)
+
+	"""
+
+var configuration = StandInConfiguration()
+var host = "127.0.0.1"
+var port: UInt16 = 8080
+var arguments = CommandLine.arguments.dropFirst()
+while let option = arguments.popFirst() {
+	guard let value = arguments.popFirst() else {
+		FileHandle.standardError.write(usage.data(using: .utf8)!)
+		exit(2)
+	}
+	switch option {
+	case "--host":
+		host = value
+	case "--port" where UInt16(value) != nil:
+		port = UInt16(value)!
+	default:
+		if !configuration.apply(option: option, value: value) {
+			FileHandle.standardError.write("Invalid option \(option) \(value)\n\n\(usage)".data(using: .utf8)!)
+			exit(2)
+		}
+	}
+}
+
+let server = StandInServer(configuration: configuration)
+do {
+	try server.start(host: host, port: port)
+}
+catch {
+	FileHandle.standardError.write("\(error)\n".data(using: .utf8)!)
+	exit(1)
+}
+print("API base URL: \(server.apiBaseURL)")
+print("Token URL: \(server.tokenURL)")
+fflush(stdout)
+dispatchMain()
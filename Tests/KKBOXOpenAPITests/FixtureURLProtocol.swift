@@ -0,0 +1,90 @@
+//
+// FixtureURLProtocol.swift
+//
+// Copyright (c) 2017 KKBOX Taiwan Co., Ltd. All Rights Reserved.
+//
+
+import Foundation
+
+/// Serves canned responses to the requests sent by a URL session, so
+/// that tests can run against local fixtures instead of KKBOX's
+/// servers.
+class FixtureURLProtocol: URLProtocol {
+	typealias Response = (statusCode: Int, headers: [String: String], body: Data)
+
+	/// Returns the response for a request. Set it before sending requests.
+	static var handler: ((URLRequest) -> Response)?
+
+	/// Returns how long to wait before answering a request. Nil answers
+	/// every request right away.
+	static var latency: ((URLRequest) -> TimeInterval)?
+
+	/// Returns the network error a request fails with. Nil, or a nil
+	/// error, answers the request with the handler.
+	static var failure: ((URLRequest) -> URLError?)?
+
+	private var timer: Timer?
+
+	/// A URL session whose requests are served by the handler.
+	static func makeSession() -> URLSession {
+		let configuration = URLSessionConfiguration.ephemeral
+		configuration.protocolClasses = [FixtureURLProtocol.self]
+		return URLSession(configuration: configuration)
+	}
+
+	/// Builds a JSON response.
+	static func json(_ object: Any, statusCode: Int = 200, headers: [String: String] = [:]) -> Response {
+		let body = try! JSONSerialization.data(withJSONObject: object, options: [])
+		var allHeaders = headers
+		allHeaders["Content-Type"] = "application/json"
+		allHeaders["Content-Length"] = "\(body.count)"
+		return (statusCode, allHeaders, body)
+	}
+
+	/// The value of a query item in a request.
+	static func query(_ request: URLRequest, _ name: String) -> String? {
+		let components = URLComponents(url: request.url!, resolvingAgainstBaseURL: false)
+		return components?.queryItems?.first { $0.name == name }?.value
+	}
+
+	override class func canInit(with request: URLRequest) -> Bool {
+		return true
+	}
+
+	override class func canonicalRequest(for request: URLRequest) -> URLRequest {
+		return request
+	}
+
+	override func startLoading() {
+		if let error = FixtureURLProtocol.failure?(self.request) {
+			self.client?.urlProtocol(self, didFailWithError: error)
+			return
+		}
+		guard let handler = FixtureURLProtocol.handler else {
+			self.client?.urlProtocol(self, didFailWithError: URLError(.unsupportedURL))
+			return
+		}
+		let fixture = handler(self.request)
+		let respond = {
+			let response = HTTPURLResponse(url: self.request.url!, statusCode: fixture.statusCode, httpVersion: "HTTP/1.1", headerFields: fixture.headers)!
+			self.client?.urlProtocol(self, didReceive: response, cacheStoragePolicy: .notAllowed)
+			self.client?.urlProtocol(self, didLoad: fixture.body)
+			self.client?.urlProtocolDidFinishLoading(self)
+		}
+		let delay = FixtureURLProtocol.latency?(self.request) ?? 0
+		if delay <= 0 {
+			respond()
+			return
+		}
+		// The client must be called on the loading thread, so wait on
+		// its run loop.
+		let timer = Timer(timeInterval: delay, repeats: false) { _ in respond() }
+		RunLoop.current.add(timer, forMode: .common)
+		self.timer = timer
+	}
+
+	override func stopLoading() {
+		self.timer?.invalidate()
+		self.timer = nil
+	}
+}
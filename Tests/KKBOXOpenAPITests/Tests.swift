@@ -6,6 +6,8 @@
 
 import XCTest
 import KKBOXOpenAPI
+import KKBOXOpenAPISwift
+import KKBOXStandIn
 
 class Tests: XCTestCase {
 	var API: KKBOXOpenAPI!
@@ -45,6 +47,1581 @@ class Tests: XCTestCase {
 //		XCTAssertEqual(self.API._scopeParameter([.userProfile, .userTerritory, .userAccountStatus]), "all")
 //	}
 
+	func testCatalogStore() {
+		let store = CatalogStore()
+		let artist = ["id": "artist1", "name": "Jay Chou"]
+		let album = ["id": "album1", "name": "Jay", "artist": artist] as [String: Any]
+		let tracks = [
+			TrackInfo(dictionary: ["id": "track2", "name": "星晴", "track_number": 2, "album": album]),
+			TrackInfo(dictionary: ["id": "track1", "name": "Ｊazz", "track_number": 1, "album": album]),
+		]
+		store.store(tracks)
+		XCTAssertEqual(store.trackCount, 2)
+		XCTAssertEqual(store.albumCount, 1)
+		XCTAssertEqual(store.artistCount, 1)
+		XCTAssertEqual(store.track(id: "track1")?.name, "Ｊazz")
+		XCTAssertEqual(store.albums(artistID: "artist1").map { $0.id }, ["album1"])
+		XCTAssertEqual(store.tracks(albumID: "album1").map { $0.id }, ["track1", "track2"])
+
+		let results = store.objects(namePrefix: "ja", types: [], limit: 0)
+		XCTAssertEqual(results.count, 3)
+		let onlyTracks = store.objects(namePrefix: "JA", types: [.track], limit: 0)
+		XCTAssertEqual(onlyTracks.map { ($0 as! TrackInfo).id }, ["track1"])
+
+		store.store(TrackInfo(dictionary: ["id": "track1", "name": "Blue", "track_number": 1, "album": album]))
+		XCTAssertEqual(store.objects(namePrefix: "ja", types: [.track], limit: 0).count, 0)
+		XCTAssertEqual(store.objects(namePrefix: "blu", types: [.track], limit: 0).count, 1)
+		XCTAssertEqual(store.trackCount, 2)
+	}
+
+	func testExportPipeline() {
+		self.useExplicitToken()
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		FixtureURLProtocol.handler = { request in
+			let path = request.url!.path
+			let offset = Int(FixtureURLProtocol.query(request, "offset") ?? "0")!
+			if path.hasSuffix("/charts") {
+				let playlists = offset == 0 ? [["id": "chart1", "title": "Chart, 1"], ["id": "chart2", "title": "Chart 2"]] : []
+				return FixtureURLProtocol.json(["data": playlists, "paging": ["offset": offset, "limit": 2], "summary": ["total": 2]])
+			}
+			if path.contains("/shared-playlists/") {
+				let tracks = (0..<3).map { ["id": "track\($0 + offset)", "name": "Track \($0 + offset)"] }
+				return FixtureURLProtocol.json(["data": offset < 6 ? tracks : [], "paging": ["offset": offset, "limit": 3], "summary": ["total": 6]])
+			}
+			return FixtureURLProtocol.json(["data": [], "summary": ["total": 0]])
+		}
+
+		let outputURL = URL(fileURLWithPath: NSTemporaryDirectory()).appendingPathComponent("export.csv")
+		let pipeline = ExportPipeline(api: self.API, outputURL: outputURL, format: .csv)
+		pipeline.territories = [NSNumber(value: KKBOXOpenAPI.Territory.taiwan.rawValue)]
+		pipeline.contents = [.charts, .playlistTracks]
+		pipeline.columns = ["kind", "parent_id", "id", "name"]
+		pipeline.pageSize = 3
+		pipeline.maximumBufferedPages = 1
+
+		let e = self.expectation(description: "testExportPipeline")
+		pipeline.start { count, error in
+			e.fulfill()
+			XCTAssertNil(error)
+			XCTAssertEqual(count, 14)
+			let lines = try! String(contentsOf: outputURL).split(separator: "\n")
+			XCTAssertEqual(lines.count, 15)
+			XCTAssertEqual(lines[0], "kind,parent_id,id,name")
+			XCTAssertEqual(lines[1], "playlist,,chart1,\"Chart, 1\"")
+			XCTAssertEqual(lines[2], "playlist,,chart2,Chart 2")
+			XCTAssertEqual(lines[3], "track,chart1,track0,Track 0")
+		}
+		self.wait(for: [e], timeout: 3)
+	}
+
+	func testExportPipelineStopsOnWriteError() {
+		self.useExplicitToken()
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		var requestCount = 0
+		FixtureURLProtocol.handler = { request in
+			requestCount += 1
+			let offset = Int(FixtureURLProtocol.query(request, "offset") ?? "0")!
+			let playlists = (0..<3).map { ["id": "chart\($0 + offset)", "title": "Chart"] }
+			return FixtureURLProtocol.json(["data": playlists, "summary": ["total": 300]])
+		}
+
+		// The directory does not exist, so every write fails.
+		let outputURL = URL(fileURLWithPath: NSTemporaryDirectory()).appendingPathComponent("missing/export.csv")
+		let pipeline = ExportPipeline(api: self.API, outputURL: outputURL, format: .csv)
+		pipeline.territories = [NSNumber(value: KKBOXOpenAPI.Territory.taiwan.rawValue)]
+		pipeline.contents = [.charts]
+		pipeline.pageSize = 3
+		let e = self.expectation(description: "testExportPipelineStopsOnWriteError")
+		pipeline.start { count, error in
+			e.fulfill()
+			XCTAssertNotNil(error)
+		}
+		self.wait(for: [e], timeout: 3)
+		XCTAssertLessThan(requestCount, 5)
+
+		// Cancelling a pipeline that is never started does not call back.
+		let unstarted = ExportPipeline(api: self.API, outputURL: outputURL, format: .csv)
+		unstarted.cancel()
+		let drained = self.expectation(description: "drain the main queue")
+		DispatchQueue.main.asyncAfter(deadline: .now() + 0.1) {
+			drained.fulfill()
+		}
+		self.wait(for: [drained], timeout: 1)
+
+		// Starting it after that calls back with the cancellation, without
+		// fetching or touching the output file.
+		requestCount = 0
+		let cancelledURL = URL(fileURLWithPath: NSTemporaryDirectory()).appendingPathComponent("cancelled-\(UUID().uuidString).csv")
+		let cancelled = ExportPipeline(api: self.API, outputURL: cancelledURL, format: .csv)
+		cancelled.territories = [NSNumber(value: KKBOXOpenAPI.Territory.taiwan.rawValue)]
+		cancelled.contents = [.charts]
+		cancelled.cancel()
+		let cancelledDrained = self.expectation(description: "drain the main queue again")
+		DispatchQueue.main.async {
+			cancelledDrained.fulfill()
+		}
+		self.wait(for: [cancelledDrained], timeout: 1)
+		let startedAfterCancel = self.expectation(description: "start after cancel")
+		cancelled.start { count, error in
+			startedAfterCancel.fulfill()
+			XCTAssertEqual(count, 0)
+			XCTAssertEqual((error as? URLError)?.code, .cancelled)
+		}
+		self.wait(for: [startedAfterCancel], timeout: 1)
+		XCTAssertEqual(requestCount, 0)
+		XCTAssertFalse(FileManager.default.fileExists(atPath: cancelledURL.path))
+	}
+
+	func testFetchChartsForTerritories() {
+		self.useExplicitToken()
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		FixtureURLProtocol.handler = { request in
+			switch FixtureURLProtocol.query(request, "territory") {
+			case "TW":
+				return FixtureURLProtocol.json(["data": [["id": "p1", "title": "1"], ["id": "p2", "title": "2"]]])
+			case "HK":
+				return FixtureURLProtocol.json(["data": [["id": "p2", "title": "2"], ["id": "p3", "title": "3"]]])
+			default:
+				return FixtureURLProtocol.json(["error": ["code": 404, "message": "Not found"]], statusCode: 404)
+			}
+		}
+		let e = self.expectation(description: "testFetchChartsForTerritories")
+		_ = self.API.fetchCharts(territories: [.taiwan, .hongKong, .japan]) { results, error in
+			e.fulfill()
+			XCTAssertNil(error)
+			guard let results = results else {
+				return
+			}
+			XCTAssertEqual(results.objects.map { $0.id }, ["p1", "p2", "p3"])
+			XCTAssertEqual(results.territories(objectID: "p2"), [.taiwan, .hongKong])
+			XCTAssertEqual(results.territories(objectID: "p3"), [.hongKong])
+			XCTAssertTrue(results.objects(territory: .taiwan)[1] === results.objects(territory: .hongKong)[0])
+			XCTAssertEqual(results.succeededTerritories, [.taiwan, .hongKong])
+			XCTAssertNotNil(results.errors[NSNumber(value: KKBOXOpenAPI.Territory.japan.rawValue)])
+		}
+		self.wait(for: [e], timeout: 3)
+	}
+
+	func testFetchChartsForTerritoriesOnConcurrentQueue() {
+		self.useExplicitToken()
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		FixtureURLProtocol.handler = { request in
+			let territory = FixtureURLProtocol.query(request, "territory")!
+			return FixtureURLProtocol.json(["data": [["id": territory, "title": territory]]])
+		}
+		let queue = DispatchQueue(label: "testFetchChartsForTerritoriesOnConcurrentQueue", attributes: .concurrent)
+		let e = self.expectation(description: "testFetchChartsForTerritoriesOnConcurrentQueue")
+		self.API.perform(callbackQueue: queue) {
+			_ = self.API.fetchCharts(territories: .all) { results, error in
+				e.fulfill()
+				XCTAssertFalse(Thread.isMainThread)
+				XCTAssertEqual(results?.succeededTerritories, .all)
+				XCTAssertEqual(results?.objects.count, 5)
+			}
+		}
+		self.wait(for: [e], timeout: 3)
+
+		// A mask without a known territory fails instead of calling back empty.
+		let e2 = self.expectation(description: "testFetchChartsForTerritoriesOnConcurrentQueue invalid")
+		let tasks = self.API.fetchCharts(territories: KKBOXOpenAPI.TerritoryMask(rawValue: 1 << 10)) { results, error in
+			e2.fulfill()
+			XCTAssertNil(results)
+			XCTAssertNotNil(error)
+		}
+		XCTAssertTrue(tasks.isEmpty)
+		self.wait(for: [e2], timeout: 3)
+	}
+
+	func testConditionalRequests() {
+		self.useExplicitToken()
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		var bodySize = 0
+		FixtureURLProtocol.handler = { request in
+			if request.value(forHTTPHeaderField: "If-None-Match") == "\"v1\"" {
+				return (304, ["ETag": "\"v1\""], Data())
+			}
+			let response = FixtureURLProtocol.json(["data": [["id": "p1", "title": "1"]]], headers: ["ETag": "\"v1\""])
+			bodySize = response.body.count
+			return response
+		}
+		let cache = ResponseCache()
+		self.API.responseCache = cache
+		for i in 0..<2 {
+			let e = self.expectation(description: "testConditionalRequests \(i)")
+			self.API.fetchCharts(territory: .taiwan) { playlists, _, _, error in
+				e.fulfill()
+				XCTAssertNil(error)
+				XCTAssertEqual(playlists?.map { $0.id }, ["p1"])
+			}
+			self.wait(for: [e], timeout: 3)
+		}
+		XCTAssertEqual(cache.requestCount, 2)
+		XCTAssertEqual(cache.notModifiedCount, 1)
+		XCTAssertEqual(cache.bytesSaved, UInt64(bodySize))
+		XCTAssertEqual(cache.responseCount, 1)
+
+		// Without a circuit breaker, responses without a validator
+		// are not remembered.
+		FixtureURLProtocol.handler = { _ in FixtureURLProtocol.json(["id": "t1", "name": "Track"]) }
+		let e = self.expectation(description: "testConditionalRequests no validator")
+		self.API.fetchTrack(id: "t1", territory: .taiwan) { track, error in
+			e.fulfill()
+			XCTAssertNil(error)
+		}
+		self.wait(for: [e], timeout: 3)
+		XCTAssertEqual(cache.responseCount, 1)
+		XCTAssertEqual(cache.byteCount, UInt64(bodySize))
+
+		// The cache is bounded by the body sizes.
+		FixtureURLProtocol.handler = { _ in FixtureURLProtocol.json(["data": [["id": "p1", "title": "1"]]], headers: ["ETag": "\"v1\""]) }
+		cache.maximumByteCount = UInt64(bodySize)
+		let e2 = self.expectation(description: "testConditionalRequests evicted")
+		self.API.fetchCharts(territory: .hongKong) { _, _, _, error in
+			e2.fulfill()
+			XCTAssertNil(error)
+		}
+		self.wait(for: [e2], timeout: 3)
+		XCTAssertEqual(cache.responseCount, 1)
+		XCTAssertEqual(cache.byteCount, UInt64(bodySize))
+	}
+
+	func apply(_ delta: PlaylistDelta, to old: [String]) -> [String] {
+		var list = old
+		var removed = IndexSet(delta.deletedIndexes)
+		delta.moves.forEach { removed.insert(Int($0.fromIndex)) }
+		var values = [Int: String]()
+		delta.moves.forEach { values[Int($0.toIndex)] = old[Int($0.fromIndex)] }
+		delta.insertedIndexes.forEach { values[$0] = delta.snapshot.trackIDs[$0] }
+		removed.reversed().forEach { list.remove(at: $0) }
+		values.keys.sorted().forEach { list.insert(values[$0]!, at: $0) }
+		return list
+	}
+
+	func testPlaylistDelta() {
+		let old = PlaylistSnapshot(playlistID: "p", lastUpdateDate: "1", trackIDs: ["a", "b", "c", "d", "e", "a"])
+		let new = PlaylistSnapshot(playlistID: "p", lastUpdateDate: "2", trackIDs: ["b", "a", "c", "f", "e", "d"])
+		let delta = PlaylistDelta(from: old, to: new)
+		XCTAssertTrue(delta.hasChanges)
+		XCTAssertEqual(Array(delta.deletedIndexes), [5])
+		XCTAssertEqual(Array(delta.insertedIndexes), [3])
+		XCTAssertEqual(delta.moves.count, 2)
+		XCTAssertEqual(self.apply(delta, to: old.trackIDs), new.trackIDs)
+		XCTAssertFalse(PlaylistDelta(from: new, to: new).hasChanges)
+
+		for _ in 0..<50 {
+			let before = (0..<40).map { _ in "t\(Int.random(in: 0..<30))" }
+			let after = (0..<40).map { _ in "t\(Int.random(in: 0..<30))" }
+			let randomDelta = PlaylistDelta(from: PlaylistSnapshot(playlistID: "p", lastUpdateDate: "", trackIDs: before), to: PlaylistSnapshot(playlistID: "p", lastUpdateDate: "", trackIDs: after))
+			XCTAssertEqual(self.apply(randomDelta, to: before), after)
+		}
+	}
+
+	func testSyncPlaylist() {
+		self.useExplicitToken()
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		var updatedAt = "2020-01-01"
+		FixtureURLProtocol.handler = { request in
+			let tracks = (0..<150).map { ["id": "t\($0 == 42 ? 999 : $0)", "name": "\($0)"] }
+			if request.url!.path.hasSuffix("/tracks") {
+				let offset = Int(FixtureURLProtocol.query(request, "offset")!)!
+				return FixtureURLProtocol.json(["data": Array(tracks[offset..<min(offset + 100, 150)]), "summary": ["total": 150]])
+			}
+			return FixtureURLProtocol.json(["id": "p", "title": "P", "updated_at": updatedAt, "tracks": ["data": Array(tracks[0..<20]), "summary": ["total": 150]]])
+		}
+		let old = PlaylistSnapshot(playlistID: "p", lastUpdateDate: "2019-12-31", trackIDs: (0..<150).map { "t\($0)" })
+
+		let e = self.expectation(description: "testSyncPlaylist")
+		self.API.syncPlaylist(id: "p", snapshot: old, territory: .taiwan) { delta, error in
+			e.fulfill()
+			XCTAssertNil(error)
+			XCTAssertEqual(delta?.snapshot.trackIDs.count, 150)
+			XCTAssertEqual(delta.map { Array($0.deletedIndexes) }, [42])
+			XCTAssertEqual(delta?.insertedTracks.map { $0.id }, ["t999"])
+			XCTAssertEqual(delta?.moves.count, 0)
+		}
+		self.wait(for: [e], timeout: 3)
+
+		updatedAt = "2019-12-31"
+		let unchanged = self.expectation(description: "testSyncPlaylist unchanged")
+		self.API.syncPlaylist(id: "p", snapshot: old, territory: .taiwan) { delta, error in
+			unchanged.fulfill()
+			XCTAssertNil(error)
+			XCTAssertEqual(delta?.hasChanges, false)
+			XCTAssertTrue(delta?.snapshot === old)
+		}
+		self.wait(for: [unchanged], timeout: 3)
+	}
+
+	func testSyncPlaylistWithoutDatesOrIDs() throws {
+		self.useExplicitToken()
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		FixtureURLProtocol.handler = { request in
+			let tracks: [[String: Any]] = [["id": "t0", "name": "0"], ["name": "No ID"], ["id": "t2", "name": "2"]]
+			return FixtureURLProtocol.json(["id": "p", "title": "P", "tracks": ["data": tracks, "summary": ["total": 3]]])
+		}
+
+		var snapshot: PlaylistSnapshot?
+		for round in 0..<2 {
+			let e = self.expectation(description: "testSyncPlaylistWithoutDatesOrIDs \(round)")
+			self.API.syncPlaylist(id: "p", snapshot: snapshot, territory: .taiwan) { delta, error in
+				e.fulfill()
+				XCTAssertNil(error)
+				XCTAssertNil(delta?.snapshot.lastUpdateDate)
+				XCTAssertEqual(delta?.snapshot.trackIDs, ["t0", "t2"])
+				XCTAssertEqual(delta?.insertedTracks.count, round == 0 ? 2 : 0)
+				snapshot = delta?.snapshot
+			}
+			self.wait(for: [e], timeout: 3)
+		}
+
+		let data = try NSKeyedArchiver.archivedData(withRootObject: snapshot!, requiringSecureCoding: true)
+		let decoded = try NSKeyedUnarchiver.unarchivedObject(ofClass: PlaylistSnapshot.self, from: data)
+		XCTAssertEqual(decoded?.trackIDs, ["t0", "t2"])
+		XCTAssertNil(decoded?.lastUpdateDate)
+	}
+
+	func testRadioStationQueue() {
+		self.useExplicitToken()
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		let pages = [["t0", "t1", "t2", "t3"], ["t2", "t4", "t5", "t6"], ["t7", "t8", "t9", "t10"]]
+		var requestedOffsets = [Int]()
+		let lock = NSLock()
+		FixtureURLProtocol.handler = { request in
+			let offset = Int(FixtureURLProtocol.query(request, "offset")!)!
+			lock.lock()
+			requestedOffsets.append(offset)
+			lock.unlock()
+			let tracks = offset / 4 < pages.count ? pages[offset / 4].map { ["id": $0, "name": $0] } : []
+			return FixtureURLProtocol.json(["id": "s", "name": "Station", "tracks": ["data": tracks, "summary": ["total": 12]]])
+		}
+		let queue = RadioStationQueue(api: self.API, stationID: "s", kind: .mood, territory: .taiwan)
+		queue.lookAheadCount = 6
+		queue.lowWatermark = 2
+		queue.pageSize = 4
+
+		// Prefetching fills the look-ahead buffer without a consumer.
+		queue.prefetch()
+		let filled = self.expectation(for: NSPredicate { _, _ in queue.bufferedTracks.count >= 6 }, evaluatedWith: nil)
+		self.wait(for: [filled], timeout: 3)
+		XCTAssertEqual(queue.bufferedTracks.map { $0.id }, ["t0", "t1", "t2", "t3", "t4", "t5", "t6"])
+
+		let e = self.expectation(description: "testRadioStationQueue")
+		var served = [String]()
+		func next() {
+			queue.dequeueTrack { track, error in
+				XCTAssertNil(error)
+				guard let track = track else {
+					e.fulfill()
+					return
+				}
+				served.append(track.id)
+				DispatchQueue.main.async(execute: next)
+			}
+		}
+		next()
+		self.wait(for: [e], timeout: 3)
+		XCTAssertEqual(served, (0...10).map { "t\($0)" })
+		XCTAssertEqual(requestedOffsets, [0, 4, 8])
+		XCTAssertEqual(queue.station?.name, "Station")
+		XCTAssertTrue(queue.isExhausted)
+	}
+
+	func testRadioStationQueueWithoutSummary() {
+		self.useExplicitToken()
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		FixtureURLProtocol.handler = { request in
+			let offset = Int(FixtureURLProtocol.query(request, "offset")!)!
+			let tracks = (offset..<offset + 2).map { ["id": "t\($0)", "name": "t\($0)"] }
+			// Pages linked by paging.next only, 3 pages in all.
+			var paging: [String: Any] = ["offset": offset, "limit": 2]
+			if offset < 4 {
+				paging["next"] = "https://api.kkbox.com/v1.1/mood-stations/s?territory=TW&offset=\(offset + 2)&limit=2"
+			}
+			return FixtureURLProtocol.json(["id": "s", "name": "Station", "tracks": ["data": tracks, "paging": paging]])
+		}
+		let queue = RadioStationQueue(api: self.API, stationID: "s", kind: .mood, territory: .taiwan)
+		queue.pageSize = 2
+		let e = self.expectation(description: "testRadioStationQueueWithoutSummary")
+		var served = [String]()
+		func next() {
+			queue.dequeueTrack { track, error in
+				XCTAssertNil(error)
+				guard let track = track else {
+					e.fulfill()
+					return
+				}
+				served.append(track.id)
+				DispatchQueue.main.async(execute: next)
+			}
+		}
+		next()
+		self.wait(for: [e], timeout: 3)
+		XCTAssertEqual(served, (0..<6).map { "t\($0)" })
+	}
+
+	func testBestImage() {
+		let images = [
+			ImageInfo(dictionary: ["width": 160, "height": 160, "url": "https://example.com/160.jpg"]),
+			ImageInfo(dictionary: ["width": 1000, "height": 1000, "url": "https://example.com/1000.jpg"]),
+			ImageInfo(dictionary: ["width": 500, "height": 500, "url": "https://example.com/500.jpg"]),
+		]
+		XCTAssertEqual(ImageInfo.bestImage(in: images, pixelSize: CGSize(width: 100, height: 100))?.width, 160)
+		XCTAssertEqual(ImageInfo.bestImage(in: images, pixelSize: CGSize(width: 300, height: 200))?.width, 500)
+		XCTAssertEqual(ImageInfo.bestImage(in: images, pixelSize: CGSize(width: 2000, height: 2000))?.width, 1000)
+		XCTAssertNil(ImageInfo.bestImage(in: [], pixelSize: .zero))
+	}
+
+	func testImageLoader() throws {
+		let png = Data(base64Encoded: "iVBORw0KGgoAAAANSUhEUgAAAAEAAAABCAQAAAC1HAwCAAAAC0lEQVR42mNkYAAAAAYAAjCB0C8AAAAASUVORK5CYII=")!
+		var requestCount = 0
+		var body = png
+		let lock = NSLock()
+		FixtureURLProtocol.handler = { request in
+			lock.lock()
+			defer { lock.unlock() }
+			requestCount += 1
+			return (200, ["Content-Type": "image/png"], body)
+		}
+		let directory = URL(fileURLWithPath: NSTemporaryDirectory()).appendingPathComponent("ImageLoaderTests-\(UUID().uuidString)")
+		let url = URL(string: "https://example.com/cover.png")!
+		let loader = ImageLoader(urlSession: FixtureURLProtocol.makeSession(), cacheDirectoryURL: directory)
+
+		// Loads of the same URL in flight share one download.
+		let loads = (0..<3).map { i -> XCTestExpectation in
+			let e = self.expectation(description: "testImageLoader \(i)")
+			loader.loadImage(url: url) { image, error in
+				e.fulfill()
+				XCTAssertNotNil(image)
+				XCTAssertNil(error)
+			}
+			return e
+		}
+		let cancelled = loader.loadImage(url: url) { _, _ in
+			XCTFail("A cancelled load must not complete")
+		}
+		cancelled.cancel()
+		self.wait(for: loads, timeout: 3)
+		XCTAssertEqual(requestCount, 1)
+		XCTAssertNotNil(loader.cachedImage(url: url))
+		XCTAssertGreaterThan(loader.memoryUsage, 0)
+
+		// A new loader finds the bytes on disk, once they are written.
+		let written = self.expectation(for: NSPredicate { _, _ in
+			((try? FileManager.default.contentsOfDirectory(atPath: directory.path)) ?? []).count == 1
+		}, evaluatedWith: nil)
+		self.wait(for: [written], timeout: 3)
+		let diskLoader = ImageLoader(urlSession: FixtureURLProtocol.makeSession(), cacheDirectoryURL: directory)
+		let fromDisk = self.expectation(description: "testImageLoader disk")
+		_ = diskLoader.loadImage(url: url) { image, _ in
+			fromDisk.fulfill()
+			XCTAssertNotNil(image)
+		}
+		self.wait(for: [fromDisk], timeout: 3)
+		XCTAssertEqual(requestCount, 1)
+
+		// A damaged file on disk is dropped and the image downloaded again.
+		let fileURL = directory.appendingPathComponent(try FileManager.default.contentsOfDirectory(atPath: directory.path)[0])
+		try Data("not an image".utf8).write(to: fileURL)
+		let damagedLoader = ImageLoader(urlSession: FixtureURLProtocol.makeSession(), cacheDirectoryURL: directory)
+		let fromDamagedDisk = self.expectation(description: "testImageLoader damaged disk")
+		_ = damagedLoader.loadImage(url: url) { image, error in
+			fromDamagedDisk.fulfill()
+			XCTAssertNotNil(image)
+			XCTAssertNil(error)
+		}
+		self.wait(for: [fromDamagedDisk], timeout: 3)
+		XCTAssertEqual(requestCount, 2)
+		let rewritten = self.expectation(for: NSPredicate { _, _ in
+			(try? Data(contentsOf: fileURL)) == png
+		}, evaluatedWith: nil)
+		self.wait(for: [rewritten], timeout: 3)
+		try? FileManager.default.removeItem(at: directory)
+
+		// A download that is not an image fails with a URL error.
+		lock.lock()
+		body = Data("not an image".utf8)
+		lock.unlock()
+		let undecodable = self.expectation(description: "testImageLoader undecodable")
+		_ = loader.loadImage(url: URL(string: "https://example.com/broken.png")!) { image, error in
+			undecodable.fulfill()
+			XCTAssertNil(image)
+			XCTAssertEqual((error as? URLError)?.code, .cannotDecodeContentData)
+		}
+		self.wait(for: [undecodable], timeout: 3)
+
+		// Variants without a URL fail instead of never calling back.
+		let noURL = self.expectation(description: "testImageLoader no URL")
+		let request = loader.loadImage(from: [], pixelSize: CGSize(width: 100, height: 100)) { image, error in
+			noURL.fulfill()
+			XCTAssertNil(image)
+			XCTAssertEqual((error as? URLError)?.code, .badURL)
+		}
+		XCTAssertNil(request)
+		self.wait(for: [noURL], timeout: 3)
+	}
+
+	func testHedgingPolicy() {
+		self.useExplicitToken()
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		let policy = HedgingPolicy()
+		policy.minimumSampleCount = 5
+		policy.maximumHedgeRatio = 0.5
+		self.API.hedgingPolicy = policy
+		defer {
+			FixtureURLProtocol.latency = nil
+		}
+
+		// The requests come one after another, so the latency of a
+		// request is picked when it is handled.
+		var arrivals = 0
+		var slowArrival = Int.max
+		var slowLatency: TimeInterval = 5
+		var failingArrival = Int.max
+		var latency: TimeInterval = 0
+		let lock = NSLock()
+		FixtureURLProtocol.handler = { _ in
+			lock.lock()
+			defer { lock.unlock() }
+			arrivals += 1
+			latency = arrivals == slowArrival ? slowLatency : 0
+			if arrivals == failingArrival {
+				return FixtureURLProtocol.json(["error": ["code": 503, "message": "Busy"]], statusCode: 503)
+			}
+			return FixtureURLProtocol.json(["id": "t", "name": "Track"])
+		}
+		FixtureURLProtocol.latency = { _ in
+			lock.lock()
+			defer { lock.unlock() }
+			return latency
+		}
+		for i in 0..<6 {
+			let e = self.expectation(description: "testHedgingPolicy \(i)")
+			self.API.fetchTrack(id: "track\(i)", territory: .taiwan) { track, error in
+				e.fulfill()
+				XCTAssertNil(error)
+			}
+			self.wait(for: [e], timeout: 3)
+		}
+		XCTAssertEqual(policy.hedgeCount, 0)
+
+		lock.lock()
+		slowArrival = arrivals + 1
+		lock.unlock()
+		let start = Date()
+		let e = self.expectation(description: "testHedgingPolicy slow")
+		self.API.fetchTrack(id: "slow", territory: .taiwan) { track, error in
+			e.fulfill()
+			XCTAssertNil(error)
+			XCTAssertEqual(track?.id, "t")
+		}
+		self.wait(for: [e], timeout: 3)
+		XCTAssertLessThan(Date().timeIntervalSince(start), 1)
+		XCTAssertEqual(policy.requestCount, 7)
+		XCTAssertEqual(policy.hedgeCount, 1)
+		XCTAssertEqual(policy.hedgeWinRate, 1)
+
+		// The slow original request that lost is cancelled, not left to
+		// run for its 5 seconds.
+		let cancelled = self.expectation(for: NSPredicate { _, _ in
+			let group = DispatchGroup()
+			var taskCount = 0
+			group.enter()
+			self.API.urlSession.getAllTasks { tasks in
+				taskCount = tasks.count
+				group.leave()
+			}
+			group.wait()
+			return taskCount == 0
+		}, evaluatedWith: nil)
+		self.wait(for: [cancelled], timeout: 2)
+
+		// A hedge answered with a server error does not beat a slower
+		// original request that succeeds.
+		lock.lock()
+		slowArrival = arrivals + 1
+		slowLatency = 0.5
+		failingArrival = arrivals + 2
+		lock.unlock()
+		let busy = self.expectation(description: "testHedgingPolicy busy")
+		self.API.fetchTrack(id: "busy", territory: .taiwan) { track, error in
+			busy.fulfill()
+			XCTAssertNil(error)
+			XCTAssertEqual(track?.id, "t")
+		}
+		self.wait(for: [busy], timeout: 3)
+		XCTAssertEqual(policy.requestCount, 8)
+		XCTAssertEqual(policy.hedgeCount, 2)
+		XCTAssertEqual(policy.hedgeWinRate, 0.5)
+	}
+
+	func testCircuitBreaker() {
+		self.useExplicitToken()
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		let breaker = CircuitBreaker()
+		breaker.minimumCallCount = 2
+		breaker.windowSize = 2
+		breaker.failureRateThreshold = 1
+		breaker.openDuration = 0.2
+		breaker.trialCallCount = 1
+		self.API.circuitBreaker = breaker
+		self.API.responseCache = ResponseCache()
+		// Endpoints are named after their paths, whatever the base URL.
+		self.API.apiBaseURL = URL(string: "https://gateway.example.com/kkbox/v1.1/")!
+
+		var healthy = true
+		var requestCount = 0
+		let lock = NSLock()
+		FixtureURLProtocol.handler = { _ in
+			lock.lock()
+			defer { lock.unlock() }
+			requestCount += 1
+			return healthy ? FixtureURLProtocol.json(["id": "t1", "name": "Track"]) : FixtureURLProtocol.json(["error": ["code": 500, "message": "Down"]], statusCode: 500)
+		}
+		var states = [CircuitBreaker.State]()
+		let observer = NotificationCenter.default.addObserver(forName: CircuitBreaker.stateDidChangeNotification, object: breaker, queue: nil) { note in
+			states.append(CircuitBreaker.State(rawValue: note.userInfo![CircuitBreaker.stateKey] as! Int)!)
+		}
+		defer {
+			NotificationCenter.default.removeObserver(observer)
+		}
+		func fetch(_ id: String, check: @escaping (TrackInfo?, Error?) -> Void) {
+			let e = self.expectation(description: "testCircuitBreaker \(id)")
+			self.API.fetchTrack(id: id, territory: .taiwan) { track, error in
+				e.fulfill()
+				check(track, error)
+			}
+			self.wait(for: [e], timeout: 3)
+		}
+
+		fetch("t1") { track, _ in XCTAssertEqual(track?.isStale, false) }
+		lock.lock()
+		healthy = false
+		lock.unlock()
+		// Failures fall back to the remembered response.
+		fetch("t1") { track, _ in XCTAssertEqual(track?.isStale, true) }
+		fetch("t2") { track, error in XCTAssertNil(track); XCTAssertNotNil(error) }
+		XCTAssertEqual(breaker.state(endpoint: "tracks/{id}"), .open)
+		XCTAssertEqual(breaker.endpointStates, ["tracks/{id}": NSNumber(value: CircuitBreaker.State.open.rawValue)])
+
+		// An open circuit fails fast without sending requests.
+		let sent = requestCount
+		fetch("t1") { track, _ in XCTAssertEqual(track?.isStale, true) }
+		fetch("t3") { track, error in
+			XCTAssertNil(track)
+			XCTAssertEqual((error as NSError?)?.code, 4)
+		}
+		XCTAssertEqual(requestCount, sent)
+		XCTAssertEqual(breaker.rejectedCallCount, 2)
+
+		// After the open duration a trial call closes the circuit.
+		lock.lock()
+		healthy = true
+		lock.unlock()
+		Thread.sleep(forTimeInterval: 0.25)
+		XCTAssertEqual(breaker.state(endpoint: "tracks/{id}"), .halfOpen)
+		fetch("t1") { track, error in
+			XCTAssertNil(error)
+			XCTAssertEqual(track?.isStale, false)
+		}
+		XCTAssertEqual(breaker.state(endpoint: "tracks/{id}"), .closed)
+		XCTAssertEqual(states, [.open, .halfOpen, .closed])
+	}
+
+	func archivePlaylistDictionary(trackCount: Int) -> [String: Any] {
+		let images = [160, 500, 1000].map { ["width": $0, "height": $0, "url": "https://i.kfs.io/album/global/1,0/fit/\($0)x\($0).jpg"] }
+		let artist: [String: Any] = ["id": "8q3_xzjl89Yakn_7GB", "name": "周杰倫", "url": "https://www.kkbox.com/tw/tc/artist/8q3_xzjl89Yakn_7GB", "images": images]
+		let album: [String: Any] = ["id": "KmRKnW5qmUrTnGRuxF", "name": "周杰倫的床邊故事", "url": "https://www.kkbox.com/tw/tc/album/KmRKnW5qmUrTnGRuxF", "explicitness": false, "available_territories": ["TW", "HK", "SG", "MY", "JP"], "release_date": "2016-06-24", "images": images, "artist": artist]
+		let tracks = (0..<trackCount).map { index -> [String: Any] in
+			["id": "4kxvr3wPWkaL9_y3o_\(index)", "name": "告白氣球 \(index)", "duration": 215146 + index, "url": "https://www.kkbox.com/tw/tc/song/4kxvr3wPWkaL9_y3o_\(index)", "track_number": index + 1, "explicitness": index % 2 == 0, "available_territories": ["TW", "HK", "SG", "MY"], "album": album]
+		}
+		return ["id": "4nUZM-TY2aVxZ2xaA-", "title": "華語單曲榜", "description": "", "url": "https://www.kkbox.com/tw/tc/playlist/4nUZM-TY2aVxZ2xaA-", "images": images, "updated_at": "2020-01-01T00:00:00+00:00", "owner": ["id": "KKBOX", "name": "KKBOX", "description": "", "images": images], "tracks": ["data": tracks, "paging": ["offset": 0, "limit": trackCount, "previous": NSNull(), "next": NSNull()], "summary": ["total": trackCount]]]
+	}
+
+	func testBinaryArchive() throws {
+		let playlist = PlaylistInfo(dictionary: self.archivePlaylistDictionary(trackCount: 3))
+		let track = playlist.tracks[1]
+		let paging = PagingInfo(dictionary: ["offset": -1, "limit": 10, "ratio": 0.25])
+		let data = BinaryArchive.archivedData(with: [playlist, track, paging])
+		let archive = try BinaryArchive(data: data)
+		XCTAssertEqual(archive.version, 1)
+		XCTAssertEqual(archive.count, 3)
+
+		let decodedPlaylist = try XCTUnwrap(archive.object(at: 0) as? PlaylistInfo)
+		XCTAssertEqual(decodedPlaylist.title, "華語單曲榜")
+		XCTAssertEqual(decodedPlaylist.owner.name, "KKBOX")
+		XCTAssertEqual(decodedPlaylist.tracks.map { $0.id }, playlist.tracks.map { $0.id })
+		let decodedTrack = try XCTUnwrap(archive.object(at: 1) as? TrackInfo)
+		XCTAssertEqual(decodedTrack.name, track.name)
+		XCTAssertEqual(decodedTrack.duration, track.duration)
+		XCTAssertEqual(decodedTrack.explicitness, track.explicitness)
+		XCTAssertEqual(decodedTrack.territoriesThatAvailableAt, track.territoriesThatAvailableAt)
+		XCTAssertEqual(decodedTrack.album?.territoriesThatAvailableAt.count, 5)
+		XCTAssertEqual(decodedTrack.album?.artist.images.map { $0.width }, [160, 500, 1000])
+		let decodedPaging = try XCTUnwrap(archive.object(at: 2) as? PagingInfo)
+		XCTAssertEqual(decodedPaging.offset, -1)
+		XCTAssertEqual(decodedPaging.limit, 10)
+		XCTAssertNil(archive.object(at: 3))
+
+		let url = FileManager.default.temporaryDirectory.appendingPathComponent("testBinaryArchive.kkba")
+		try data.write(to: url)
+		defer { try? FileManager.default.removeItem(at: url) }
+		XCTAssertEqual(try BinaryArchive(contentsOf: url).objects.count, 3)
+
+		let coded = try NSKeyedArchiver.archivedData(withRootObject: track, requiringSecureCoding: true)
+		let unarchived = try XCTUnwrap(NSKeyedUnarchiver.unarchivedObject(ofClass: TrackInfo.self, from: coded))
+		XCTAssertEqual(unarchived.id, track.id)
+		XCTAssertEqual(unarchived.album?.name, "周杰倫的床邊故事")
+
+		XCTAssertThrowsError(try BinaryArchive(data: Data("{}".utf8)))
+		var newer = data
+		newer[4] = 2
+		XCTAssertThrowsError(try BinaryArchive(data: newer))
+		XCTAssertThrowsError(try BinaryArchive(data: data.prefix(data.count - 1)))
+	}
+
+	func testBinaryArchiveSize() throws {
+		let dictionary = self.archivePlaylistDictionary(trackCount: 100)
+		let JSONData = try JSONSerialization.data(withJSONObject: dictionary)
+		let data = BinaryArchive.archivedData(with: [PlaylistInfo(dictionary: dictionary)])
+		XCTAssertLessThan(data.count * 3, JSONData.count)
+	}
+
+	func testBinaryArchiveDecodingPerformance() throws {
+		let data = BinaryArchive.archivedData(with: [PlaylistInfo(dictionary: self.archivePlaylistDictionary(trackCount: 1000))])
+		self.measure {
+			let playlist = try? BinaryArchive(data: data).object(at: 0) as? PlaylistInfo
+			XCTAssertEqual(playlist?.tracks.count, 1000)
+		}
+	}
+
+	func testJSONDecodingPerformance() throws {
+		let data = try JSONSerialization.data(withJSONObject: self.archivePlaylistDictionary(trackCount: 1000))
+		self.measure {
+			let dictionary = try? JSONSerialization.jsonObject(with: data) as? [String: Any]
+			let playlist = dictionary.map { PlaylistInfo(dictionary: $0) }
+			XCTAssertEqual(playlist?.tracks.count, 1000)
+		}
+	}
+
+	@available(macOS 10.15, iOS 13.0, tvOS 13.0, *)
+	func testCatalogSnapshot() async throws {
+		self.useExplicitToken()
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		var requestCount = 0
+		let lock = NSLock()
+		FixtureURLProtocol.handler = { request in
+			lock.lock()
+			requestCount += 1
+			lock.unlock()
+			let path = request.url!.path
+			if path.hasSuffix("/charts") {
+				let offset = Int(FixtureURLProtocol.query(request, "offset")!)!
+				let limit = Int(FixtureURLProtocol.query(request, "limit")!)!
+				let charts = (offset..<min(offset + limit, 5)).map { ["id": "c\($0)", "title": "Chart \($0)"] }
+				return FixtureURLProtocol.json(["data": charts, "paging": ["offset": offset, "limit": limit], "summary": ["total": 5]])
+			}
+			if path.hasSuffix("/tracks") {
+				let album = ["id": "a1", "name": "Album", "available_territories": ["TW", "HK"]] as [String: Any]
+				let tracks = (0..<3).map { ["id": "t\($0)", "name": "Track \($0)", "album": album] }
+				return FixtureURLProtocol.json(["data": tracks, "paging": ["offset": 0, "limit": 100], "summary": ["total": 3]])
+			}
+			return FixtureURLProtocol.json(["id": path.split(separator: "/").last!, "name": "Track"])
+		}
+		func sentRequestCount() -> Int {
+			lock.lock()
+			defer { lock.unlock() }
+			return requestCount
+		}
+
+		let builder = CatalogSnapshotBuilder()
+		self.API.snapshotBuilder = builder
+		_ = try await self.API.fetchCharts(territory: .taiwan, offset: 2, limit: 2)
+		_ = try await self.API.fetchCharts(territory: .taiwan, offset: 0, limit: 2)
+		_ = try await self.API.fetchCharts(territory: .taiwan, offset: 4, limit: 2)
+		_ = try await self.API.fetchPlaylistTracks(id: "c0", territory: .taiwan, offset: 0, limit: 100)
+		_ = try await self.API.fetchTrack(id: "t9", territory: .taiwan)
+		XCTAssertEqual(builder.requestCount, 3)
+		let url = FileManager.default.temporaryDirectory.appendingPathComponent("testCatalogSnapshot.kkcs")
+		try builder.write(to: url)
+		defer { try? FileManager.default.removeItem(at: url) }
+
+		let snapshot = try CatalogSnapshot(contentsOf: url)
+		XCTAssertEqual(snapshot.requestCount, 3)
+		XCTAssertEqual(snapshot.objectCount, 9)
+		self.API.snapshotBuilder = nil
+		self.API.catalogSnapshot = snapshot
+		defer { self.API.catalogSnapshot = nil }
+		let sent = sentRequestCount()
+
+		let charts = try await self.API.fetchCharts(territory: .taiwan, offset: 1, limit: 3)
+		XCTAssertEqual(charts.items.map { $0.id }, ["c1", "c2", "c3"])
+		XCTAssertEqual(charts.summary.total, 5)
+		XCTAssertEqual(charts.paging.offset, 1)
+		XCTAssertNotNil(charts.paging.next)
+		let lastCharts = try await self.API.fetchCharts(territory: .taiwan, offset: 4, limit: 10)
+		XCTAssertEqual(lastCharts.items.map { $0.title }, ["Chart 4"])
+		XCTAssertNil(lastCharts.paging.next)
+		let tracks = try await self.API.fetchPlaylistTracks(id: "c0", territory: .taiwan, offset: 1, limit: 10)
+		XCTAssertEqual(tracks.items.map { $0.id }, ["t1", "t2"])
+		XCTAssertEqual(tracks.items.first?.album?.territoriesThatAvailableAt.count, 2)
+		let track = try await self.API.fetchTrack(id: "t9", territory: .taiwan)
+		XCTAssertEqual(track.name, "Track")
+		XCTAssertEqual(sentRequestCount(), sent)
+
+		// An answered call still hands out a task that stands for the call.
+		let states: [URLSessionTask.State] = await withCheckedContinuation { continuation in
+			DispatchQueue.main.async {
+				var task: URLSessionDataTask?
+				var states = [URLSessionTask.State]()
+				task = self.API.fetchTrack(id: "t9", territory: .taiwan) { track, error in
+					XCTAssertNil(error)
+					XCTAssertEqual(track?.name, "Track")
+					states.append(task!.state)
+					continuation.resume(returning: states)
+				}
+				states.append(task!.state)
+			}
+		}
+		XCTAssertEqual(states, [.running, .completed])
+		XCTAssertEqual(sentRequestCount(), sent)
+
+		// Calls that are not in the snapshot go out.
+		_ = try await self.API.fetchTrack(id: "t10", territory: .taiwan)
+		XCTAssertEqual(sentRequestCount(), sent + 1)
+		XCTAssertThrowsError(try CatalogSnapshot(data: Data("KKBA".utf8)))
+	}
+
+	@available(macOS 10.15, iOS 13.0, tvOS 13.0, *)
+	func testCatalogSnapshotPagesThroughPlaylist() async throws {
+		self.useExplicitToken()
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		var requestCount = 0
+		let lock = NSLock()
+		FixtureURLProtocol.handler = { request in
+			lock.lock()
+			requestCount += 1
+			lock.unlock()
+			func page(offset: Int, limit: Int) -> [String: Any] {
+				let tracks = (offset..<min(offset + limit, 5)).map { ["id": "t\($0)", "name": "Track \($0)"] }
+				var paging: [String: Any] = ["offset": offset, "limit": limit]
+				if offset + limit < 5 {
+					paging["next"] = "https://api.kkbox.com/v1.1/shared-playlists/p1/tracks?territory=TW&offset=\(offset + limit)&limit=\(limit)"
+				}
+				return ["data": tracks, "paging": paging, "summary": ["total": 5]]
+			}
+			if request.url!.path.hasSuffix("/tracks") {
+				let offset = Int(FixtureURLProtocol.query(request, "offset")!)!
+				let limit = Int(FixtureURLProtocol.query(request, "limit")!)!
+				return FixtureURLProtocol.json(page(offset: offset, limit: limit))
+			}
+			return FixtureURLProtocol.json(["id": "p1", "title": "Playlist", "tracks": page(offset: 0, limit: 2)])
+		}
+		func sentRequestCount() -> Int {
+			lock.lock()
+			defer { lock.unlock() }
+			return requestCount
+		}
+
+		let builder = CatalogSnapshotBuilder()
+		self.API.snapshotBuilder = builder
+		_ = try await self.API.fetchPlaylist(id: "p1", territory: .taiwan)
+		_ = try await self.API.fetchPlaylistTracks(id: "p1", territory: .taiwan, offset: 0, limit: 2)
+		_ = try await self.API.fetchPlaylistTracks(id: "p1", territory: .taiwan, offset: 2, limit: 2)
+		_ = try await self.API.fetchPlaylistTracks(id: "p1", territory: .taiwan, offset: 4, limit: 2)
+		let url = FileManager.default.temporaryDirectory.appendingPathComponent("testCatalogSnapshotPagesThroughPlaylist.kkcs")
+		try builder.write(to: url)
+		defer { try? FileManager.default.removeItem(at: url) }
+
+		self.API.snapshotBuilder = nil
+		self.API.catalogSnapshot = try CatalogSnapshot(contentsOf: url)
+		defer { self.API.catalogSnapshot = nil }
+		let sent = sentRequestCount()
+
+		// The playlist keeps the paging and the total of its tracks,
+		// and the rest of the tracks follow from them.
+		let (playlist, paging, summary) = try await self.API.fetchPlaylist(id: "p1", territory: .taiwan)
+		XCTAssertEqual(summary.total, 5)
+		XCTAssertEqual(paging.limit, 2)
+		XCTAssertNotNil(paging.next)
+		var trackIDs = playlist.tracks.map { $0.id }
+		var offset = paging.offset + paging.limit
+		while offset < summary.total {
+			let tracks = try await self.API.fetchPlaylistTracks(id: "p1", territory: .taiwan, offset: offset, limit: paging.limit)
+			trackIDs += tracks.items.map { $0.id }
+			offset += paging.limit
+		}
+		XCTAssertEqual(trackIDs, ["t0", "t1", "t2", "t3", "t4"])
+		XCTAssertEqual(sentRequestCount(), sent)
+	}
+
+	func testEndpointPipeline() {
+		self.useExplicitToken()
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		var requests = [URLRequest]()
+		var failureCount = 1
+		let lock = NSLock()
+		FixtureURLProtocol.failure = { request in
+			lock.lock()
+			defer { lock.unlock() }
+			guard request.url!.path.hasSuffix("/t1") && failureCount > 0 else {
+				return nil
+			}
+			failureCount -= 1
+			return URLError(.networkConnectionLost)
+		}
+		FixtureURLProtocol.handler = { request in
+			lock.lock()
+			requests.append(request)
+			lock.unlock()
+			let path = request.url!.path
+			if path.hasSuffix("/playlists") {
+				return FixtureURLProtocol.json(["data": [["id": "p1", "title": "Playlist"]], "paging": ["offset": 10, "limit": 5], "summary": ["total": 11]])
+			}
+			if path.contains("/mood-stations/") {
+				return FixtureURLProtocol.json(["id": "m1", "name": "Mood", "tracks": ["data": [["id": "t1", "name": "Track"]], "paging": ["offset": 0, "limit": 100], "summary": ["total": 1]]])
+			}
+			return FixtureURLProtocol.json(["id": path.split(separator: "/").last!, "name": "Track"])
+		}
+		defer {
+			FixtureURLProtocol.failure = nil
+			FixtureURLProtocol.latency = nil
+		}
+
+		// Paging and escaping are applied to every endpoint.
+		let e1 = self.expectation(description: "testEndpointPipeline playlists")
+		self.API.fetchChildrenCategoryPlaylists(id: "a/b", territory: .taiwan, offset: 10, limit: 5) { playlists, paging, summary, error in
+			XCTAssertNil(error)
+			XCTAssertEqual(playlists?.map { $0.id }, ["p1"])
+			XCTAssertEqual(paging?.offset, 10)
+			XCTAssertEqual(summary?.total, 11)
+			e1.fulfill()
+		}
+		self.wait(for: [e1], timeout: 3)
+		XCTAssertTrue(requests[0].url!.absoluteString.contains("/children-categories/a%2Fb/playlists?"))
+		XCTAssertEqual(FixtureURLProtocol.query(requests[0], "offset"), "10")
+		XCTAssertEqual(FixtureURLProtocol.query(requests[0], "limit"), "5")
+
+		let e2 = self.expectation(description: "testEndpointPipeline station")
+		self.API.fetchMoodStation(id: "m1", territory: .taiwan) { station, tracks, _, summary, error in
+			XCTAssertNil(error)
+			XCTAssertEqual(station?.id, "m1")
+			XCTAssertEqual(station?.name, "Mood")
+			XCTAssertEqual(tracks?.map { $0.id }, ["t1"])
+			XCTAssertEqual(summary?.total, 1)
+			e2.fulfill()
+		}
+		self.wait(for: [e2], timeout: 3)
+
+		// Identical calls in flight share one request.
+		self.API.coalescesRequests = true
+		FixtureURLProtocol.latency = { _ in 0.1 }
+		let sent = requests.count
+		let e3 = self.expectation(description: "testEndpointPipeline coalesced")
+		e3.expectedFulfillmentCount = 2
+		let task1 = self.API.fetchTrack(id: "t2", territory: .taiwan) { track, _ in
+			XCTAssertEqual(track?.id, "t2")
+			e3.fulfill()
+		}
+		let task2 = self.API.fetchTrack(id: "t2", territory: .taiwan) { track, _ in
+			XCTAssertEqual(track?.id, "t2")
+			e3.fulfill()
+		}
+		self.wait(for: [e3], timeout: 3)
+		XCTAssertFalse(task1 === task2)
+		XCTAssertEqual(requests.count, sent + 1)
+
+		// Cancelling one of them only cancels that caller, and the
+		// request goes on until every caller gave up.
+		let e5 = self.expectation(description: "testEndpointPipeline coalesced cancel")
+		e5.expectedFulfillmentCount = 2
+		let cancelledTask = self.API.fetchTrack(id: "t3", territory: .taiwan) { track, error in
+			XCTAssertNil(track)
+			XCTAssertEqual((error as? URLError)?.code, .cancelled)
+			e5.fulfill()
+		}
+		_ = self.API.fetchTrack(id: "t3", territory: .taiwan) { track, error in
+			XCTAssertNil(error)
+			XCTAssertEqual(track?.id, "t3")
+			e5.fulfill()
+		}
+		cancelledTask.cancel()
+		XCTAssertEqual(cancelledTask.state, .canceling)
+		self.wait(for: [e5], timeout: 3)
+		XCTAssertEqual(requests.count, sent + 2)
+
+		// Transient errors are retried, and the task is running while the
+		// call waits to be retried.
+		FixtureURLProtocol.latency = nil
+		self.API.maximumRetryCount = 1
+		self.API.retryInterval = 1
+		let e4 = self.expectation(description: "testEndpointPipeline retried")
+		let retriedTask = self.API.fetchTrack(id: "t1", territory: .taiwan) { track, error in
+			XCTAssertNil(error)
+			XCTAssertEqual(track?.id, "t1")
+			e4.fulfill()
+		}
+		let retryScheduled = self.expectation(for: NSPredicate { _, _ in
+			self.API.endpointMetrics["tracks/{id}"]?.retryCount == 1
+		}, evaluatedWith: nil)
+		self.wait(for: [retryScheduled], timeout: 3)
+		XCTAssertEqual(retriedTask.state, .running)
+		self.wait(for: [e4], timeout: 3)
+		XCTAssertEqual(retriedTask.state, .completed)
+
+		let metrics = self.API.endpointMetrics["tracks/{id}"]
+		XCTAssertEqual(metrics?.requestCount, 5)
+		XCTAssertEqual(metrics?.coalescedCount, 2)
+		XCTAssertEqual(metrics?.retryCount, 1)
+		XCTAssertEqual(metrics?.failureCount, 0)
+		XCTAssertEqual(metrics?.objectCount, 3)
+		XCTAssertEqual(self.API.endpointMetrics["mood-stations/{id}"]?.objectCount, 2)
+	}
+
+	@available(macOS 10.15, iOS 13.0, tvOS 13.0, *)
+	func testAsyncOverlay() async throws {
+		self.useExplicitToken()
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		FixtureURLProtocol.handler = { request in
+			let path = request.url!.path
+			if path.hasSuffix("/tracks") {
+				let offset = Int(FixtureURLProtocol.query(request, "offset")!)!
+				let limit = Int(FixtureURLProtocol.query(request, "limit")!)!
+				let tracks = (offset..<min(offset + limit, 5)).map { ["id": "t\($0)", "name": "Track \($0)"] }
+				return FixtureURLProtocol.json(["data": tracks, "paging": ["offset": offset, "limit": limit], "summary": ["total": 5]])
+			}
+			return FixtureURLProtocol.json(["id": path.split(separator: "/").last!, "name": "Track"])
+		}
+		defer {
+			FixtureURLProtocol.latency = nil
+		}
+
+		// A fan-out over many IDs.
+		let ids = (0..<20).map { "t\($0)" }
+		let fetchedIDs = try await withThrowingTaskGroup(of: String.self) { group -> [String] in
+			for id in ids {
+				group.addTask {
+					let track = try await self.API.fetchTrack(id: id, territory: .taiwan)
+					return track.id
+				}
+			}
+			var fetchedIDs = [String]()
+			for try await id in group {
+				fetchedIDs.append(id)
+			}
+			return fetchedIDs
+		}
+		XCTAssertEqual(Set(fetchedIDs), Set(ids))
+
+		// Callbacks made within perform(callbackQueue:) skip the main queue.
+		let calledOnMainThread = await withCheckedContinuation { continuation in
+			self.API.perform(callbackQueue: DispatchQueue.global()) {
+				self.API.fetchTrack(id: "t1", territory: .taiwan) { _, _ in
+					continuation.resume(returning: Thread.isMainThread)
+				}
+			}
+		}
+		XCTAssertFalse(calledOnMainThread)
+
+		// Paging.
+		var trackIDs = [String]()
+		for try await track in self.API.albumTracks(id: "a1", territory: .taiwan, pageSize: 2) {
+			trackIDs.append(track.id)
+		}
+		XCTAssertEqual(trackIDs, ["t0", "t1", "t2", "t3", "t4"])
+		XCTAssertEqual(self.API.endpointMetrics["albums/{id}/tracks"]?.requestCount, 3)
+
+		// Cancelling the task cancels the request.
+		FixtureURLProtocol.latency = { _ in 5 }
+		let task = Task {
+			try await self.API.fetchTrack(id: "slow", territory: .taiwan)
+		}
+		try await Task.sleep(nanoseconds: 50_000_000)
+		task.cancel()
+		do {
+			_ = try await task.value
+			XCTFail("The call should have been cancelled")
+		}
+		catch {
+			XCTAssertTrue(error is CancellationError)
+		}
+	}
+
+	@available(macOS 10.15, iOS 13.0, tvOS 13.0, *)
+	func testCancelDuringRetry() {
+		self.useExplicitToken()
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		self.API.maximumRetryCount = 3
+		self.API.retryInterval = 0.3
+		var attempts = 0
+		var attemptExpectations = [Int: XCTestExpectation]()
+		let lock = NSLock()
+		FixtureURLProtocol.failure = { _ in
+			lock.lock()
+			attempts += 1
+			let expectation = attemptExpectations[attempts]
+			lock.unlock()
+			expectation?.fulfill()
+			return URLError(.timedOut)
+		}
+		defer {
+			FixtureURLProtocol.failure = nil
+		}
+		/// Expects the Nth attempt of the next call, or no Nth attempt.
+		func expectAttempt(_ attempt: Int, inverted: Bool = false) -> XCTestExpectation {
+			let expectation = self.expectation(description: "attempt \(attempt)")
+			expectation.isInverted = inverted
+			lock.lock()
+			attemptExpectations[attempt] = expectation
+			lock.unlock()
+			return expectation
+		}
+		func resetAttempts() {
+			lock.lock()
+			attempts = 0
+			attemptExpectations.removeAll()
+			lock.unlock()
+		}
+		func fetchExpectingCancellation(id: String, _ done: XCTestExpectation) -> Task<Void, Never> {
+			return Task {
+				do {
+					_ = try await self.API.fetchTrack(id: id, territory: .taiwan)
+					XCTFail("The call should have been cancelled")
+				}
+				catch {
+					XCTAssertTrue(error is CancellationError)
+				}
+				done.fulfill()
+			}
+		}
+
+		// The task is cancelled while the call waits to be retried.
+		let firstAttempt = expectAttempt(1)
+		let noRetry = expectAttempt(2, inverted: true)
+		let cancelled = self.expectation(description: "cancelled")
+		let task = fetchExpectingCancellation(id: "t1", cancelled)
+		self.wait(for: [firstAttempt], timeout: 3)
+		task.cancel()
+		self.wait(for: [cancelled, noRetry], timeout: 1)
+
+		// The task is cancelled after retries went out.
+		resetAttempts()
+		let thirdAttempt = expectAttempt(3)
+		let noFurtherRetry = expectAttempt(4, inverted: true)
+		let retriedCancelled = self.expectation(description: "cancelled after retries")
+		let retried = fetchExpectingCancellation(id: "t2", retriedCancelled)
+		self.wait(for: [thirdAttempt], timeout: 3)
+		retried.cancel()
+		self.wait(for: [retriedCancelled, noFurtherRetry], timeout: 1)
+		XCTAssertEqual(self.API.endpointMetrics["tracks/{id}"]?.failureCount, 0)
+	}
+
+	/// Serves a ring of artists with 2 albums each, and 5 tracks in every
+	/// album in pages of 3. The first request for the tracks of
+	/// `failingAlbumID` fails.
+	func serveArtistGraph(artistCount: Int, failingAlbumID: String? = nil) {
+		self.useExplicitToken()
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		var failingAlbumID = failingAlbumID
+		FixtureURLProtocol.handler = { request in
+			let parts = request.url!.path.split(separator: "/").map(String.init)
+			let artist = { (i: Int) in ["id": "artist\(i)", "name": "Artist \(i)"] }
+			if parts.count >= 3 && parts[parts.count - 3] == "artists" {
+				let i = Int(parts[parts.count - 2].dropFirst("artist".count))!
+				if parts.last == "related-artists" {
+					let related = (1...3).map { artist((i + $0) % artistCount) }
+					return FixtureURLProtocol.json(["data": related, "summary": ["total": 3]])
+				}
+				let albums = (0..<2).map { ["id": "album\(i)-\($0)", "name": "Album \($0)", "artist": artist(i)] }
+				return FixtureURLProtocol.json(["data": albums, "summary": ["total": 2]])
+			}
+			if parts.count >= 2 && parts[parts.count - 2] == "artists" {
+				return FixtureURLProtocol.json(artist(Int(parts.last!.dropFirst("artist".count))!))
+			}
+			let albumID = parts[parts.count - 2]
+			if albumID == failingAlbumID {
+				failingAlbumID = nil
+				return FixtureURLProtocol.json(["error": ["code": 404, "message": "Not found"]], statusCode: 404)
+			}
+			let offset = Int(FixtureURLProtocol.query(request, "offset") ?? "0")!
+			let tracks = (offset..<min(offset + 3, 5)).map { ["id": "\(albumID)-track\($0)", "name": "Track \($0)"] }
+			return FixtureURLProtocol.json(["data": tracks, "summary": ["total": 5]])
+		}
+	}
+
+	class CrawlRecorder: NSObject, ArtistGraphCrawlerDelegate {
+		var artists = [String: UInt]()
+		var albumCount = 0
+		var trackCount = 0
+		var failureCount = 0
+		var failed: (() -> Void)?
+		var finished: ((Error?) -> Void)?
+
+		func crawler(_ crawler: ArtistGraphCrawler, didDiscoverArtist artist: ArtistInfo, depth: UInt) {
+			XCTAssertNil(self.artists[artist.id])
+			self.artists[artist.id] = depth
+		}
+
+		func crawler(_ crawler: ArtistGraphCrawler, didDiscoverAlbum album: KKAlbumInfo) {
+			self.albumCount += 1
+		}
+
+		func crawler(_ crawler: ArtistGraphCrawler, didDiscoverTracks tracks: [TrackInfo], inAlbumID albumID: String) {
+			self.trackCount += tracks.count
+		}
+
+		func crawler(_ crawler: ArtistGraphCrawler, didFailWithError error: Error) {
+			self.failureCount += 1
+			self.failed?()
+		}
+
+		func crawlerDidFinish(_ crawler: ArtistGraphCrawler, error: Error?) {
+			self.finished?(error)
+		}
+	}
+
+	func testArtistGraphCrawler() {
+		self.serveArtistGraph(artistCount: 20)
+		let seeded = ArtistGraphCrawler(api: self.API, seedArtistIDs: ["artist0"], territory: .taiwan)
+		seeded.maximumDepth = 2
+		// Resume from a checkpoint taken before anything was fetched.
+		guard let crawler = ArtistGraphCrawler(api: self.API, checkpoint: seeded.checkpoint) else {
+			XCTFail("Invalid checkpoint")
+			return
+		}
+		let recorder = CrawlRecorder()
+		crawler.delegate = recorder
+		let e = self.expectation(description: "testArtistGraphCrawler")
+		recorder.finished = { error in
+			e.fulfill()
+			XCTAssertNil(error)
+			XCTAssertEqual(recorder.artists.count, 7)
+			XCTAssertEqual(recorder.artists["artist0"], 0)
+			XCTAssertEqual(recorder.artists["artist3"], 1)
+			XCTAssertEqual(recorder.artists["artist6"], 2)
+			XCTAssertEqual(recorder.albumCount, 14)
+			XCTAssertEqual(recorder.trackCount, 70)
+			XCTAssertEqual(crawler.pendingRequestCount, 0)
+		}
+		crawler.start()
+		self.wait(for: [e], timeout: 3)
+	}
+
+	func testArtistGraphCrawlerResumesMidCrawl() {
+		self.serveArtistGraph(artistCount: 20, failingAlbumID: "album0-1")
+		let first = ArtistGraphCrawler(api: self.API, seedArtistIDs: ["artist0"], territory: .taiwan)
+		first.maximumDepth = 2
+		let firstRecorder = CrawlRecorder()
+		first.delegate = firstRecorder
+		var checkpoint: [AnyHashable: Any]?
+		let e = self.expectation(description: "testArtistGraphCrawlerResumesMidCrawl")
+		firstRecorder.failed = {
+			// Stop in the middle of the crawl, right after the failure.
+			checkpoint = first.checkpoint
+			first.cancel()
+		}
+		firstRecorder.finished = { _ in e.fulfill() }
+		first.start()
+		self.wait(for: [e], timeout: 3)
+
+		guard let saved = checkpoint, let resumed = ArtistGraphCrawler(api: self.API, checkpoint: saved) else {
+			XCTFail("No checkpoint taken")
+			return
+		}
+		let recorder = CrawlRecorder()
+		resumed.delegate = recorder
+		let e2 = self.expectation(description: "testArtistGraphCrawlerResumesMidCrawl 2")
+		recorder.finished = { error in
+			e2.fulfill()
+			XCTAssertNil(error)
+			XCTAssertEqual(recorder.failureCount, 0)
+			XCTAssertGreaterThan(recorder.albumCount, 0)
+			XCTAssertTrue(Set(recorder.artists.keys).isDisjoint(with: firstRecorder.artists.keys))
+			XCTAssertEqual(firstRecorder.artists.count + recorder.artists.count, 7)
+			XCTAssertEqual(firstRecorder.albumCount + recorder.albumCount, 14)
+			// The failed album is fetched again, so no track is lost.
+			XCTAssertEqual(firstRecorder.trackCount + recorder.trackCount, 70)
+		}
+		resumed.start()
+		self.wait(for: [e2], timeout: 3)
+	}
+
+	func testArtistGraphCrawlerPerformance() {
+		self.serveArtistGraph(artistCount: 200)
+		self.measure {
+			let crawler = ArtistGraphCrawler(api: self.API, seedArtistIDs: ["artist0"], territory: .taiwan)
+			crawler.maximumDepth = 200
+			crawler.maximumConcurrentRequests = 8
+			let recorder = CrawlRecorder()
+			crawler.delegate = recorder
+			let e = self.expectation(description: "testArtistGraphCrawlerPerformance")
+			recorder.finished = { _ in e.fulfill() }
+			crawler.start()
+			self.wait(for: [e], timeout: 30)
+			XCTAssertEqual(recorder.artists.count, 200)
+		}
+	}
+
+	class BulkDownloadRecorder: NSObject, BulkDownloaderDelegate {
+		var ids = [String]()
+		var finishedLists = [String]()
+		var finished: ((Error?) -> Void)?
+
+		func bulkDownloader(_ downloader: BulkDownloader, didReceive objects: [KKBOXOpenAPIObject], list: BulkDownloader.List, id: String) {
+			self.ids += objects.map { ($0 as? TrackInfo)?.id ?? ($0 as? KKAlbumInfo)?.id ?? "" }
+		}
+
+		func bulkDownloader(_ downloader: BulkDownloader, didFinish list: BulkDownloader.List, id: String) {
+			self.finishedLists.append("\(list.rawValue) \(id)")
+		}
+
+		func bulkDownloaderDidFinish(_ downloader: BulkDownloader, error: Error?) {
+			self.finished?(error)
+		}
+	}
+
+	/// Serves 5 tracks for any album and 3 albums for any new-release
+	/// category, and returns the offsets requested so far.
+	func serveBulkDownload(failingOffset: Int? = nil) -> () -> [Int] {
+		self.useExplicitToken()
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		var offsets = [Int]()
+		var failed = false
+		let lock = NSLock()
+		FixtureURLProtocol.failure = { request in
+			lock.lock()
+			defer { lock.unlock() }
+			let offset = Int(FixtureURLProtocol.query(request, "offset")!)!
+			offsets.append(offset)
+			if offset == failingOffset && !failed {
+				failed = true
+				return URLError(.networkConnectionLost)
+			}
+			return nil
+		}
+		FixtureURLProtocol.handler = { request in
+			let offset = Int(FixtureURLProtocol.query(request, "offset")!)!
+			let limit = Int(FixtureURLProtocol.query(request, "limit")!)!
+			let paging: [String: Any] = ["offset": offset, "limit": limit, "previous": NSNull(), "next": NSNull()]
+			if request.url!.path.hasSuffix("/tracks") {
+				// Brackets and escapes in strings must not confuse the reader.
+				let tracks = (offset..<min(offset + limit, 5)).map { ["id": "t\($0)", "name": "Track \"[{\($0)}]\\"", "duration": $0 * 1000] as [String: Any] }
+				return FixtureURLProtocol.json(["data": tracks, "paging": paging, "summary": ["total": 5]])
+			}
+			let albums = (offset..<min(offset + limit, 3)).map { ["id": "a\($0)", "name": "Album \($0)", "available_territories": ["TW"]] as [String: Any] }
+			return FixtureURLProtocol.json(["id": "c1", "title": "New", "albums": ["data": albums, "paging": paging, "summary": ["total": 3]]])
+		}
+		return {
+			lock.lock()
+			defer { lock.unlock() }
+			return offsets
+		}
+	}
+
+	func testBulkDownloader() throws {
+		let requestedOffsets = self.serveBulkDownload()
+		defer { FixtureURLProtocol.failure = nil }
+		let directory = FileManager.default.temporaryDirectory.appendingPathComponent("testBulkDownloader")
+		try? FileManager.default.removeItem(at: directory)
+		defer { try? FileManager.default.removeItem(at: directory) }
+
+		let downloader = BulkDownloader(api: self.API, directoryURL: directory)
+		downloader.pageSize = 2
+		downloader.batchSize = 1
+		downloader.add(.albumTracks, id: "album1", territory: .taiwan)
+		downloader.add(.newReleaseAlbums, id: "c1", territory: .taiwan)
+		downloader.add(.albumTracks, id: "album1", territory: .taiwan)
+		XCTAssertEqual(downloader.pendingListCount, 2)
+		let recorder = BulkDownloadRecorder()
+		downloader.delegate = recorder
+		let e = self.expectation(description: "testBulkDownloader")
+		recorder.finished = { error in
+			e.fulfill()
+			XCTAssertNil(error)
+			XCTAssertEqual(recorder.ids, ["t0", "t1", "t2", "t3", "t4", "a0", "a1", "a2"])
+			XCTAssertEqual(recorder.finishedLists, ["0 album1", "2 c1"])
+			XCTAssertEqual(requestedOffsets(), [0, 2, 4, 0, 2])
+			XCTAssertEqual(downloader.pendingListCount, 0)
+		}
+		downloader.start()
+		self.wait(for: [e], timeout: 3)
+		XCTAssertEqual(try FileManager.default.contentsOfDirectory(atPath: directory.path), ["manifest.plist"])
+	}
+
+	func testBulkDownloaderResume() throws {
+		let requestedOffsets = self.serveBulkDownload(failingOffset: 2)
+		defer { FixtureURLProtocol.failure = nil }
+		let directory = FileManager.default.temporaryDirectory.appendingPathComponent("testBulkDownloaderResume")
+		try? FileManager.default.removeItem(at: directory)
+		defer { try? FileManager.default.removeItem(at: directory) }
+
+		let downloader = BulkDownloader(api: self.API, directoryURL: directory)
+		downloader.pageSize = 2
+		downloader.add(.albumTracks, id: "album1", territory: .taiwan)
+		let recorder = BulkDownloadRecorder()
+		downloader.delegate = recorder
+		let e = self.expectation(description: "testBulkDownloaderResume")
+		recorder.finished = { error in
+			e.fulfill()
+			XCTAssertEqual((error as? URLError)?.code, .networkConnectionLost)
+		}
+		downloader.start()
+		self.wait(for: [e], timeout: 3)
+		XCTAssertEqual(recorder.ids, ["t0", "t1"])
+
+		// A new downloader picks the list up from the manifest.
+		let resumed = BulkDownloader(api: self.API, directoryURL: directory)
+		resumed.pageSize = 2
+		XCTAssertEqual(resumed.pendingListCount, 1)
+		let resumedRecorder = BulkDownloadRecorder()
+		resumed.delegate = resumedRecorder
+		let e2 = self.expectation(description: "testBulkDownloaderResume 2")
+		resumedRecorder.finished = { error in
+			e2.fulfill()
+			XCTAssertNil(error)
+		}
+		resumed.start()
+		self.wait(for: [e2], timeout: 3)
+		XCTAssertEqual(resumedRecorder.ids, ["t2", "t3", "t4"])
+		XCTAssertEqual(requestedOffsets(), [0, 2, 2, 4])
+	}
+
+	func testStandInServer() throws {
+		let server = StandInServer()
+		try server.start()
+		defer { server.stop() }
+		self.API.apiBaseURL = server.apiBaseURL
+		self.API.tokenURL = server.tokenURL
+		self.API.urlSession = URLSession(configuration: .ephemeral)
+		self.waitForToken()
+
+		var firstIDs = [String]()
+		for round in 0..<2 {
+			let e = self.expectation(description: "testStandInServer \(round)")
+			self.API.fetchAlbumTracks(id: "album1", territory: .taiwan, offset: 0, limit: 5) { tracks, paging, summary, error in
+				e.fulfill()
+				XCTAssertNil(error)
+				XCTAssertEqual(tracks?.count, 5)
+				XCTAssertEqual(summary?.total, 12)
+				let ids = tracks?.map { $0.id } ?? []
+				if round == 0 {
+					firstIDs = ids
+				}
+				else {
+					XCTAssertEqual(ids, firstIDs)
+				}
+			}
+			self.wait(for: [e], timeout: 3)
+		}
+
+		var configuration = StandInConfiguration()
+		configuration.throttleRate = 1
+		let throttling = StandInServer(configuration: configuration)
+		try throttling.start()
+		defer { throttling.stop() }
+		self.API.apiBaseURL = throttling.apiBaseURL
+		self.API.maximumRetryCount = 0
+		let e = self.expectation(description: "testStandInServer throttled")
+		self.API.fetchTrack(id: "track1", territory: .taiwan) { track, error in
+			e.fulfill()
+			XCTAssertNil(track)
+			XCTAssertEqual((error as NSError?)?.code, 429)
+		}
+		self.wait(for: [e], timeout: 3)
+	}
+
+	/// The body of a request seen by a URL protocol, which gets it as a stream.
+	func body(of request: URLRequest) -> Data {
+		if let body = request.httpBody {
+			return body
+		}
+		guard let stream = request.httpBodyStream else {
+			return Data()
+		}
+		var body = Data()
+		var buffer = [UInt8](repeating: 0, count: 1024)
+		stream.open()
+		defer { stream.close() }
+		while case let count = stream.read(&buffer, maxLength: buffer.count), count > 0 {
+			body.append(buffer, count: count)
+		}
+		return body
+	}
+
+	func serveTokens() {
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		FixtureURLProtocol.handler = { request in
+			return FixtureURLProtocol.json(["access_token": "token", "expires_in": 3600, "token_type": "Bearer"])
+		}
+	}
+
+	func testTokenRequest() {
+		self.API = KKBOXOpenAPI(clientID: "client id", secret: "secret", scope: [.userTerritory, .userProfile])
+		self.API.urlSession = FixtureURLProtocol.makeSession()
+		var request: URLRequest?
+		FixtureURLProtocol.handler = { r in
+			request = r
+			return FixtureURLProtocol.json(["access_token": "token", "expires_in": 3600, "token_type": "Bearer"])
+		}
+		let e = self.expectation(description: "testTokenRequest")
+		self.API.fetchAccessTokenByClientCredential { token, error in
+			e.fulfill()
+			XCTAssertNil(error)
+			XCTAssertEqual(token?.accessToken, "token")
+		}
+		self.wait(for: [e], timeout: 3)
+		XCTAssertEqual(request?.httpMethod, "POST")
+		XCTAssertEqual(request?.value(forHTTPHeaderField: "Authorization"), "Basic " + Data("client id:secret".utf8).base64EncodedString())
+		XCTAssertEqual(request?.value(forHTTPHeaderField: "Content-Type"), "application/x-www-form-urlencoded")
+		XCTAssertEqual(request.map { String(decoding: self.body(of: $0), as: UTF8.self) }, "grant_type=client_credentials&scope=user_profile%20user_territory")
+	}
+
+	func testFormEncoding() {
+		func encode(_ form: [AnyHashable: Any]) -> String {
+			return String(decoding: NSData.dataAsWWWURLEncodedForm(from: form), as: UTF8.self)
+		}
+		XCTAssertEqual(encode(["b": "1 2", "a": "x&y+z=é"]), "a=x%26y%2Bz=%C3%A9&b=1%202")
+		XCTAssertEqual(encode(["redirect_uri": "https://example.com/a/b?c=d", "limit": 50, "ratio": 0.5]), "limit=50&ratio=0.5&redirect_uri=https://example.com/a/b?c=d")
+		XCTAssertEqual(encode(["q": "周杰倫 #1\n"]), "q=%E5%91%A8%E6%9D%B0%E5%80%AB%20%231%0A")
+		XCTAssertEqual(encode([:]), "")
+	}
+
+	func testFormEncodingPerformance() {
+		let form: [AnyHashable: Any] = [
+			"grant_type": "authorization_code",
+			"code": "8f1c2b0e6a3d4e5f9a7b6c5d4e3f2a1b",
+			"client_id": "f1ebd2b4c5a6d7e8f9a0b1c2d3e4f5a6",
+			"client_secret": "c3d4e5f6a7b8c9d0e1f2a3b4c5d6e7f8",
+			"redirect_uri": "https://example.com/oauth/callback?from=app&lang=zh-TW",
+			"scope": "user_profile user_territory user_account_status",
+			"state": "周杰倫 & friends",
+			"expires_in": 2_592_000,
+		]
+		self.measure {
+			for _ in 0..<20_000 {
+				_ = NSData.dataAsWWWURLEncodedForm(from: form)
+			}
+		}
+	}
+
+	func testTokenRequestPerformance() {
+		self.serveTokens()
+		self.measure {
+			let group = DispatchGroup()
+			for _ in 0..<200 {
+				group.enter()
+				self.API.fetchAccessTokenByClientCredential { token, error in
+					XCTAssertNotNil(token)
+					group.leave()
+				}
+			}
+			let e = self.expectation(description: "testTokenRequestPerformance")
+			group.notify(queue: .main) {
+				e.fulfill()
+			}
+			self.wait(for: [e], timeout: 10)
+		}
+	}
+
 	// MARK: -
 
 	func validate(track: TrackInfo) {